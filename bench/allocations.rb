@@ -0,0 +1,205 @@
+# -------------------------------------------------------------------------
+# allocations.rb -- allocation and memory budgets for canonical workloads
+# Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+# -------------------------------------------------------------------------
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2.1 of the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library; if not, write to the Free Software
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+# -------------------------------------------------------------------------
+#
+# Runs each workload below once over a generated file, in a forked child,
+# and reports per 1000 lines or dates the objects it allocated, the bytes
+# ObjectSpace.memsize_of_all puts on them and how far it raised the peak
+# RSS.  Objects and bytes are counted with the GC off, so that nothing
+# is freed before it is counted and the numbers do not depend on when the
+# GC happens to run; the RSS comes from a second run with the GC on.
+#
+# Each number is checked against the budget for the backend in
+# bench/budgets.json and the script fails if any is over, printing the
+# results as JSON either way.  UPDATE=1 stores the numbers of this run,
+# with some headroom, as the new budgets for the backend instead.  Budgets
+# hold for the file they were made with (its settings are kept with them)
+# and the Ruby version they were made on, as both change the counts.
+#
+#   rake bench:allocations
+#   GEDCOM_BACKEND=ruby rake bench:allocations UPDATE=1
+#
+# Settings come from the environment:
+#
+#   LINES, SEED, RECORDS, DATES and SAMPLE work as they do for
+#               bench/bench.rb, defaulting to the settings of the budgets
+#               (and LINES to 50000 without them)
+#   BUDGETS     the budget file (bench/budgets.json)
+#   UPDATE      store new budgets instead of checking them
+
+require 'gedcom'
+require 'json'
+require 'objspace'
+require File.expand_path( 'bench', File.dirname( __FILE__ ) )
+
+module GEDCOM
+  module Bench
+    module Allocations
+      BUDGETS = File.expand_path( 'budgets.json', File.dirname( __FILE__ ) )
+
+      # Enough for a few thousand dates, and to see the RSS move
+      LINES = 50_000
+
+      # Objects and bytes get 10% over what was measured; the RSS is much
+      # noisier and gets half as much again plus 1MB over the file.
+      HEADROOM = 1.1
+      RSS_HEADROOM = 1.5
+      RSS_SLACK_KB = 1024
+
+      METRICS = GEDCOM.shareable( [ "objects_per_1k", "bytes_per_1k", "rss_kb_per_1k" ] )
+
+      # [ name, unit ], and the block running the workload over the file
+      # and the sampled DATE values, as Runner#sample gives them.  The
+      # setup step builds what the workload only reads, outside the count.
+      WORKLOADS = [
+        [ "parse", "lines", nil,
+          lambda { |file, dates, setup| Parser.new.parse( file ) } ],
+        [ "parse_dates", "lines",
+          lambda { |file, dates| parser = Parser.new; parser.count_dates = true; parser },
+          lambda { |file, dates, parser| parser.parse( file ) } ],
+        [ "each_record", "lines", nil,
+          lambda { |file, dates, setup| GEDCOM.each_record( file ) { |record| record[ "BIRT" ] } } ],
+        [ "date_new", "dates", nil,
+          lambda { |file, dates, setup| dates.each { |text, calendar| Date.new( text, calendar ) { |err_msg| } } } ],
+        [ "date_first_last", "dates",
+          lambda { |file, dates| dates.collect { |text, calendar| Date.new( text, calendar ) { |err_msg| } }.compact },
+          lambda { |file, dates, parsed| parsed.each { |date| date.first; date.last } } ],
+        [ "date_to_s", "dates",
+          lambda { |file, dates| dates.collect { |text, calendar| Date.new( text, calendar ) { |err_msg| } }.compact },
+          lambda { |file, dates, parsed| parsed.each { |date| date.to_s } } ]
+      ].freeze
+
+      # Runs +workload+ over +items+ lines or dates and returns its numbers.
+      def Allocations.measure( workload, file, dates, items )
+        name, unit, setup, run = workload
+
+        counts = Bench.isolated do
+          state = setup && setup.call( file, dates )
+          GC.start
+          GC.disable
+          objects = Bench.allocations
+          bytes = ObjectSpace.memsize_of_all
+          run.call( file, dates, state )
+          result = [ Bench.allocations - objects, ObjectSpace.memsize_of_all - bytes ]
+          GC.enable
+          result
+        end
+
+        rss = Bench.isolated do
+          state = setup && setup.call( file, dates )
+          GC.start
+          peak = Bench.peak_rss
+          run.call( file, dates, state )
+          peak && Bench.peak_rss - peak
+        end
+
+        { "name" => name,
+          "unit" => unit,
+          "items" => items,
+          "objects_per_1k" => per_1k( counts[ 0 ], items ),
+          "bytes_per_1k" => per_1k( counts[ 1 ], items ),
+          "rss_kb_per_1k" => rss && per_1k( rss, items ) }
+      end
+
+      def Allocations.per_1k( value, items )
+        items > 0 ? ( value * 1000.0 / items ).round : 0
+      end
+
+      # The budget for a result: what it came to plus the headroom.
+      def Allocations.budget( result )
+        budget = { "objects_per_1k" => ( result[ "objects_per_1k" ] * HEADROOM ).ceil,
+                   "bytes_per_1k" => ( result[ "bytes_per_1k" ] * HEADROOM ).ceil }
+        if result[ "rss_kb_per_1k" ]
+          budget[ "rss_kb_per_1k" ] = ( result[ "rss_kb_per_1k" ] * RSS_HEADROOM ).ceil +
+                                      per_1k( RSS_SLACK_KB, result[ "items" ] )
+        end
+        budget
+      end
+
+      # The metrics of +result+ that are over +budget+.
+      def Allocations.over( result, budget )
+        METRICS.select { |metric| budget[ metric ] && result[ metric ] && result[ metric ] > budget[ metric ] }
+      end
+
+      # The generator options the budgets were made with, back from JSON
+      def Allocations.settings( stored )
+        { :lines => stored[ "lines" ], :seed => stored[ "seed" ], :sample => stored[ "sample" ],
+          :records => stored[ "records" ],
+          :dates => stored[ "dates" ] && stored[ "dates" ].inject( {} ) { |mix, ( key, weight )| mix.merge( key.to_sym => weight ) } }
+      end
+
+      def Allocations.run( options )
+        path = options[ :budgets ] || BUDGETS
+        budgets = File.exist?( path ) ? JSON.parse( File.read( path ) ) : {}
+        backend = GEDCOM.backend.to_s
+        stored = budgets[ backend ] || {}
+
+        options = { :lines => LINES }.merge( settings( stored[ "settings" ] || {} ).reject { |key, value| value.nil? } ).
+                    merge( options.reject { |key, value| value.nil? } )
+
+        runner = Runner.new( options )
+        file = runner.generate
+        lines, dates = runner.sample( file )
+        results = WORKLOADS.collect do |workload|
+          measure( workload, file, dates, workload[ 1 ] == "lines" ? lines : dates.length )
+        end
+
+        report = { "ruby" => "#{RUBY_VERSION}p#{RUBY_PATCHLEVEL} #{RUBY_PLATFORM}",
+                   "backend" => backend,
+                   "file" => file,
+                   "lines" => lines,
+                   "dates" => dates.length }
+
+        if options[ :update ]
+          budgets[ backend ] = { "ruby" => report[ "ruby" ],
+                                 "settings" => { "lines" => options[ :lines ], "seed" => options[ :seed ] || 1,
+                                                 "sample" => options[ :sample ] || 100_000,
+                                                 "records" => options[ :records ],
+                                                 "dates" => options[ :dates ] }.reject { |key, value| value.nil? },
+                                 "budgets" => results.inject( {} ) { |all, result| all.merge( result[ "name" ] => budget( result ) ) } }
+          File.open( path, "w" ) { |f| f.puts JSON.pretty_generate( budgets ) }
+          return report.merge( "updated" => path, "results" => results, "passed" => true )
+        end
+
+        results.each do |result|
+          budget = ( stored[ "budgets" ] || {} )[ result[ "name" ] ]
+          result[ "budget" ] = budget
+          result[ "over" ] = budget ? over( result, budget ) : []
+        end
+
+        report.merge( "budget_ruby" => stored[ "ruby" ],
+                      "results" => results,
+                      "passed" => results.all? { |result| result[ "over" ].empty? } )
+      end
+    end
+  end
+end
+
+if __FILE__ == $0
+  options = { :lines => ENV[ "LINES" ] && ENV[ "LINES" ].to_i,
+              :seed => ENV[ "SEED" ] && ENV[ "SEED" ].to_i,
+              :records => GEDCOM::Bench.weights( ENV[ "RECORDS" ] ),
+              :dates => GEDCOM::Bench.weights( ENV[ "DATES" ], true ),
+              :sample => ENV[ "SAMPLE" ] && ENV[ "SAMPLE" ].to_i,
+              :budgets => ENV[ "BUDGETS" ],
+              :update => ENV[ "UPDATE" ] && !ENV[ "UPDATE" ].empty? && ENV[ "UPDATE" ] != "0" }
+
+  result = GEDCOM::Bench::Allocations.run( options )
+  puts JSON.pretty_generate( result )
+  exit( 1 ) if !result[ "passed" ]
+end
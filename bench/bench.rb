@@ -0,0 +1,273 @@
+# -------------------------------------------------------------------------
+# bench.rb -- parser and date benchmarks with JSON results
+# Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+# -------------------------------------------------------------------------
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2.1 of the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library; if not, write to the Free Software
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+# -------------------------------------------------------------------------
+#
+# Generates a file with GEDCOM::Bench::Generator (or uses the one given),
+# times the parser and the Date operations on it, and prints the results
+# as JSON so runs from different commits can be compared.  Each benchmark
+# runs in a forked child where fork is available, so its allocation count
+# and peak RSS are its own.
+#
+#   rake bench LINES=1000000
+#   ruby -Ilib bench/bench.rb
+#
+# Settings come from the environment:
+#
+#   LINES       size of the generated file (10000)
+#   SEED        generator seed (1)
+#   RECORDS     record weights, "INDI=60,FAM=25,SOUR=5,NOTE=10"
+#   DATES       date form weights, "exact=50,phrase=0,..."
+#   FILE        benchmark this file instead of a generated one
+#   SAMPLE      number of DATE values used by the Date benchmarks (100000)
+#   ITERATIONS  runs of each benchmark; the best time is reported (3)
+#   OUTPUT      write the JSON here instead of to stdout
+
+require 'gedcom'
+require 'json'
+require 'tmpdir'
+require 'digest/md5'
+require File.expand_path( 'generator', File.dirname( __FILE__ ) )
+
+module GEDCOM
+  module Bench
+    # Calendar escapes ("@#DJULIAN@ 12 MAR 1650") are not part of the date
+    # text GEDCOM::Date parses, so they are turned into its calendar argument.
+    CALENDARS = GEDCOM.shareable( { "DGREGORIAN" => DateType::GREGORIAN, "DJULIAN" => DateType::JULIAN,
+                                    "DHEBREW" => DateType::HEBREW, "DFRENCH R" => DateType::FRENCH,
+                                    "DUNKNOWN" => DateType::UNKNOWN } )
+
+    class Runner
+      def initialize( options = {} )
+        @options = options
+        @iterations = options[ :iterations ] || 3
+        @sample = options[ :sample ] || 100_000
+      end
+
+      # Runs every benchmark and returns the results as a hash.
+      def run
+        file = @options[ :file ] || generate
+        lines, dates = sample( file )
+
+        results = []
+        results << measure( "parse", "lines", lines ) do
+          Parser.new.parse( file )
+        end
+        results << measure( "parse_pipelined", "lines", lines ) do
+          Parser.new.parse_pipelined( file )
+        end
+        results << measure( "date_new", "dates", dates.length ) do
+          dates.each { |text, calendar| Date.new( text, calendar ) { |err_msg| } }
+        end
+        results << measure( "date_valid", "dates", dates.length ) do
+          dates.each { |text, calendar| Date.valid?( text, calendar ) }
+        end
+
+        parsed = nil
+        setup = lambda { parsed ||= dates.collect { |text, calendar| Date.new( text, calendar ) { |err_msg| } }.compact }
+        results << measure( "date_sort", "dates", nil, setup ) do
+          parsed.sort
+        end
+        results << measure( "date_to_s", "dates", nil, setup ) do
+          parsed.each { |date| date.to_s }
+        end
+        results << measure( "export_csv", "lines", lines ) do
+          File.open( File::NULL, "wb" ) { |out| GEDCOM.export_events( File.binread( file ), out, :csv ) }
+        end
+        results << measure( "export_columns", "lines", lines ) do
+          File.open( File::NULL, "wb" ) { |out| GEDCOM.export_events( File.binread( file ), out, :columns ) }
+        end
+        results << measure( "query", "lines", lines ) do
+          Query.new( "INDI[BIRT.DATE < 1800].NAME" ).run( File.binread( file ) )
+        end
+        results << measure( "each_record", "lines", lines ) do
+          GEDCOM.each_record( file ) { |record| record[ "BIRT" ] }
+        end
+        results << measure( "each_event_batch", "lines", lines ) do
+          GEDCOM.each_event_batch( file ) { |batch| batch.tags }
+        end
+
+        results << measure( "validate", "lines", lines ) do
+          GEDCOM.validate( file )
+        end
+
+        results << measure( "diff", "lines", lines ) do
+          GEDCOM.diff( file, file )
+        end
+
+        if GEDCOM.respond_to?( :to_sqlite )
+          db = File.join( Dir.tmpdir, "gedcom-bench-#{Process.pid}.db" )
+          results << measure( "to_sqlite", "lines", lines ) do
+            GEDCOM.to_sqlite( file, db )
+          end
+          File.delete( db ) if File.exist?( db )
+        end
+
+        results << measure( "stats", "lines", lines ) do
+          GEDCOM.stats( file )
+        end
+
+        column = GEDCOM::DateColumn.new
+        column.load( file )
+        results << measure( "datecolumn_histogram", "dates", column.length ) do
+          column.histogram( :year, :by => :tag )
+          column.histogram( :month, :by => :qualifier )
+        end
+
+        { "commit" => commit,
+          "ruby" => "#{RUBY_VERSION}p#{RUBY_PATCHLEVEL} #{RUBY_PLATFORM}",
+          "backend" => GEDCOM.backend.to_s,
+          "file" => file,
+          "lines" => lines,
+          "generator" => @options[ :file ] ? nil : generator_settings,
+          "benchmarks" => results }
+      end
+
+      # The number of lines of +file+ and up to SAMPLE of its DATE values, as
+      # [ text, calendar ] pairs.
+      def sample( file )
+        lines = 0
+        dates = []
+        File.open( file, "r" ) do |f|
+          f.each_line do |line|
+            lines += 1
+            dates << date_text( $1 ) if dates.length < @sample && line =~ /\A\d+ DATE (.*?)\r?\n?\z/
+          end
+        end
+        [ lines, dates ]
+      end
+
+      # Generated files are kept in the temp directory, named after their
+      # settings, and reused by later runs.
+      def generate
+        settings = generator_settings
+        path = File.join( Dir.tmpdir, "gedcom-bench-#{settings[ 'lines' ]}-" +
+                                      Digest::MD5.hexdigest( settings.inspect )[ 0, 12 ] + ".ged" )
+        if !File.exist?( path )
+          Generator.new( @options ).write( path + ".tmp" )
+          File.rename( path + ".tmp", path )
+        end
+        path
+      end
+
+      private
+
+      def generator_settings
+        { "lines" => @options[ :lines ] || 10_000, "seed" => @options[ :seed ] || 1,
+          "records" => Generator::RECORD_MIX.merge( @options[ :records ] || {} ),
+          "dates" => Generator::DATE_MIX.merge( @options[ :dates ] || {} ) }
+      end
+
+      def date_text( value )
+        return [ $2, CALENDARS[ $1 ] || DateType::DEFAULT ] if value =~ /\A@#(D[A-Z ]+)@ (.*)/
+        [ value, DateType::DEFAULT ]
+      end
+
+      # Times the block over @iterations runs, after calling +setup+.
+      # +items+ (the setup's result count when nil) gives items per second.
+      def measure( name, unit, items, setup = nil )
+        Bench.isolated do
+          items ||= setup.call.length if setup
+          GC.start
+          allocated = Bench.allocations
+          times = Array.new( @iterations ) do
+            start = now
+            yield
+            now - start
+          end
+          allocated = Bench.allocations - allocated if allocated
+
+          { "name" => name,
+            "unit" => unit,
+            "items" => items,
+            "iterations" => @iterations,
+            "seconds" => times.min,
+            "median_seconds" => times.sort[ times.length / 2 ],
+            "items_per_second" => ( items / times.min ).round,
+            "allocations" => allocated && allocated / @iterations,
+            "peak_rss_kb" => Bench.peak_rss }
+        end
+      end
+
+      def now
+        defined?( Process::CLOCK_MONOTONIC ) ? Process.clock_gettime( Process::CLOCK_MONOTONIC ) : Time.now.to_f
+      end
+
+      def commit
+        id = `git rev-parse --short HEAD 2>#{File::NULL}`.strip rescue ""
+        id.empty? ? nil : id
+      end
+    end
+
+    # Runs the block in a forked child where fork is available, so that its
+    # allocations and peak RSS are its own, and returns its result (which
+    # must survive a trip through JSON).
+    def Bench.isolated
+      return yield if !Process.respond_to?( :fork ) || RUBY_PLATFORM =~ /mswin|mingw|java/
+
+      reader, writer = IO.pipe
+      pid = fork do
+        reader.close
+        writer.write( JSON.generate( yield ) )
+        writer.close
+        exit!( 0 )
+      end
+      writer.close
+      result = JSON.parse( reader.read )
+      reader.close
+      Process.wait( pid )
+      result
+    end
+
+    def Bench.allocations
+      GC.respond_to?( :stat ) && GC.stat[ :total_allocated_objects ]
+    end
+
+    # The high water mark of the process's resident set, in kB (Linux only)
+    def Bench.peak_rss
+      status = File.read( "/proc/self/status" ) rescue nil
+      status && status =~ /^VmHWM:\s*(\d+)/ ? $1.to_i : nil
+    end
+
+    # "INDI=60,FAM=25" => { "INDI" => 60, "FAM" => 25 }, with symbol keys if asked
+    def Bench.weights( text, symbols = false )
+      return nil if text.nil? || text.empty?
+      text.split( "," ).inject( {} ) do |mix, pair|
+        key, weight = pair.split( "=", 2 )
+        mix[ symbols ? key.strip.to_sym : key.strip ] = weight.to_i
+        mix
+      end
+    end
+  end
+end
+
+if __FILE__ == $0
+  options = { :lines => ENV[ "LINES" ] && ENV[ "LINES" ].to_i,
+              :seed => ENV[ "SEED" ] && ENV[ "SEED" ].to_i,
+              :records => GEDCOM::Bench.weights( ENV[ "RECORDS" ] ),
+              :dates => GEDCOM::Bench.weights( ENV[ "DATES" ], true ),
+              :file => ENV[ "FILE" ],
+              :sample => ENV[ "SAMPLE" ] && ENV[ "SAMPLE" ].to_i,
+              :iterations => ENV[ "ITERATIONS" ] && ENV[ "ITERATIONS" ].to_i }
+
+  json = JSON.pretty_generate( GEDCOM::Bench::Runner.new( options ).run )
+  if ENV[ "OUTPUT" ]
+    File.open( ENV[ "OUTPUT" ], "w" ) { |f| f.puts json }
+  else
+    puts json
+  end
+end
@@ -0,0 +1,146 @@
+# -------------------------------------------------------------------------
+# differential.rb -- checks the C date parser against the Ruby one
+# Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+# -------------------------------------------------------------------------
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2.1 of the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library; if not, write to the Free Software
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+# -------------------------------------------------------------------------
+#
+# Parses every DATE of a generated file (plus a list of awkward cases)
+# once with each backend, in two child processes, and compares what they
+# make of it: the format, both date parts, to_s and the error, if any.
+# Prints the mismatches and the speedup of the C parser as JSON, and exits
+# non-zero if there were any mismatches.
+#
+#   rake bench:differential LINES=1000000
+#
+# LINES, SEED, DATES and FILE work as they do for bench/bench.rb.
+
+require 'rbconfig'
+require 'json'
+require File.expand_path( 'bench', File.dirname( __FILE__ ) )
+
+module GEDCOM
+  module Bench
+    module Differential
+      # Dates the generator does not make: statuses, other calendars,
+      # partial ranges and malformed text.
+      EXTRA = [ "", "  ", "1850", "0", "1 JAN 0", "31 FEB 1850", "MAR", "12 MAR", "JANUARY 1850",
+                "BET 1850", "BET 1850 AND", "AND 1850", "FROM 1850", "TO 1850", "FROM 1850 TO",
+                "FROM JAN 1850 TO FEB 1850", "BET MAR 1850 AND 1860", "BEF 1850/51", "1850/",
+                "1 JAN 1850 1851", "ABT", "ABT (x)", "INT 1850", "INT 1850 (census", "INT (census)",
+                "(phrase", "(phrase) 1850", "1850 (phrase)", "44 BC", "44 BC 12", "JAN 44 BC",
+                "CHILD", "STILLBORN", "DEAD", "DNS", "DNSCAN", "BIC", "INFANT", "PRE1970",
+                "CHILD 1850", "FIRST DAY OF 2008", "12 mar 1850", "abt 1850", "1-2-1850",
+                "12 MAR 1850 BC", "1 APRIL 2007/08", "@#DJULIAN@ 1 JAN 1600", "12 SEPT 1850",
+                "A 1850", "JANX 1850", "ABT1850", "abt\t12 jan 1850", "12 MAR 1850.", "(caf\xC3\xA9)",
+                [ "1 TSH 5750", DateType::HEBREW ], [ "ADAR SHENI 5750", DateType::HEBREW ],
+                [ "ADAR 5750", DateType::HEBREW ], [ "1 VEND 11", DateType::FRENCH ],
+                [ "JOUR COMP 11", DateType::FRENCH ], [ "JOUR 11", DateType::FRENCH ],
+                [ "12 MAR 1650", DateType::JULIAN ], [ "1650/51", DateType::JULIAN ],
+                [ "12 MAR 1650 BC", DateType::JULIAN ], [ "12 MAR 1650", DateType::UNKNOWN ] ]
+
+      # Everything the two backends should agree on for one date
+      def Differential.describe( date, error )
+        [ error, date.format, date.is_date?, part( date.first ), date.is_range? ? part( date.last ) : nil, date.to_s ]
+      end
+
+      def Differential.part( part )
+        return [ part.calendar, part.compliance, part.phrase ] if part.compliance == DatePart::PHRASE
+        [ part.calendar, part.compliance,
+          part.has_day? ? part.day : nil, part.has_month? ? part.month : nil,
+          part.has_year? ? part.year : nil, part.has_year_span? ? part.to_year : nil,
+          part.calendar == DateType::GREGORIAN && part.compliance == DatePart::NONE ? part.epoch : nil ]
+      rescue DateFormatException => e
+        [ part.calendar, part.compliance, e.message ]
+      end
+
+      # Runs in the child: parses the dates in +input+ (JSON) and prints
+      # the backend, the best time and the descriptions as JSON.
+      def Differential.worker( input )
+        dates = JSON.parse( File.read( input ) )
+        results = nil
+        best = nil
+        3.times do
+          start = Process.clock_gettime( Process::CLOCK_MONOTONIC )
+          parsed = dates.collect do |text, calendar|
+            error = nil
+            date = Date.new( text, calendar ) { |err_msg| error = err_msg }
+            [ date, error ]
+          end
+          time = Process.clock_gettime( Process::CLOCK_MONOTONIC ) - start
+          best = time if best.nil? || time < best
+          results ||= parsed.collect { |date, error| describe( date, error ) }
+        end
+        puts JSON.generate( "backend" => GEDCOM.backend.to_s, "seconds" => best, "results" => results )
+      end
+
+      def Differential.run( options )
+        runner = Runner.new( options )
+        file = options[ :file ] || runner.send( :generate )
+        dates = []
+        File.open( file, "r" ) do |f|
+          f.each_line do |line|
+            dates << runner.send( :date_text, $1 ) if line =~ /\A\d+ DATE (.*?)\r?\n?\z/
+          end
+        end
+        dates = dates.uniq + EXTRA.collect { |text, calendar| [ text, calendar || DateType::DEFAULT ] }
+
+        input = File.join( Dir.tmpdir, "gedcom-differential-#{Process.pid}.json" )
+        File.open( input, "w" ) { |f| f.write( JSON.generate( dates ) ) }
+        begin
+          native, ruby = [ "native", "ruby" ].collect do |backend|
+            output = IO.popen( [ { "GEDCOM_BACKEND" => backend }, RbConfig.ruby, "-I", File.expand_path( '../lib', File.dirname( __FILE__ ) ),
+                                 __FILE__, "--worker", input ] ) { |io| io.read }
+            raise "#{backend} worker failed" if !$?.success?
+            JSON.parse( output )
+          end
+        ensure
+          File.delete( input )
+        end
+
+        mismatches = []
+        dates.each_with_index do |( text, calendar ), i|
+          next if native[ "results" ][ i ] == ruby[ "results" ][ i ]
+          mismatches << { "date" => text, "calendar" => calendar,
+                          "native" => native[ "results" ][ i ], "ruby" => ruby[ "results" ][ i ] }
+        end
+
+        { "file" => file,
+          "dates" => dates.length,
+          "native_seconds" => native[ "seconds" ],
+          "ruby_seconds" => ruby[ "seconds" ],
+          "speedup" => ( ruby[ "seconds" ] / native[ "seconds" ] ).round( 1 ),
+          "mismatches" => mismatches.length,
+          "examples" => mismatches.first( 20 ) }
+      end
+    end
+  end
+end
+
+if __FILE__ == $0
+  if ARGV[ 0 ] == "--worker"
+    GEDCOM::Bench::Differential.worker( ARGV[ 1 ] )
+  else
+    report = GEDCOM::Bench::Differential.run( :lines => ( ENV[ "LINES" ] || 200_000 ).to_i,
+                                              :seed => ENV[ "SEED" ] && ENV[ "SEED" ].to_i,
+                                              :dates => GEDCOM::Bench.weights( ENV[ "DATES" ], true ),
+                                              :file => ENV[ "FILE" ] )
+    # one line per example
+    examples = report[ "examples" ].collect { |example| "\n    " + JSON.generate( example ) }
+    json = JSON.pretty_generate( report.merge( "examples" => "EXAMPLES" ) )
+    puts json.sub( '"EXAMPLES"' ) { "[" + examples.join( "," ) + "\n  ]" }
+    exit( report[ "mismatches" ] == 0 )
+  end
+end
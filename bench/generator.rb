@@ -0,0 +1,248 @@
+# -------------------------------------------------------------------------
+# generator.rb -- deterministic synthetic GEDCOM files for benchmarks
+# Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+# -------------------------------------------------------------------------
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2.1 of the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library; if not, write to the Free Software
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+# -------------------------------------------------------------------------
+#
+# Writes GEDCOM files of any size from a seed.  The same seed, size and mix
+# always give the same bytes, so results from different commits can be
+# compared.  Records are written as they are made, so a 50M line file
+# takes no more memory than a 10k line one.
+#
+#   GEDCOM::Bench::Generator.new( :lines => 1_000_000, :seed => 7 ).write( "big.ged" )
+#
+# or, from the command line:
+#
+#   ruby bench/generator.rb LINES [FILE] [SEED]
+
+module GEDCOM
+  module Bench
+    class Generator
+      # Relative weights of the level 0 records
+      RECORD_MIX = { "INDI" => 60, "FAM" => 25, "SOUR" => 5, "NOTE" => 10 }
+
+      # Relative weights of the DATE forms
+      DATE_MIX = {
+        :exact => 50,       # 12 MAR 1850
+        :month => 10,       # MAR 1850
+        :year => 10,        # 1850
+        :approximate => 8,  # ABT 1850, CAL MAR 1850, EST 1850
+        :range => 6,        # BEF 1850, AFT 1850, BET 1850 AND 1860
+        :period => 4,       # FROM 1850 TO 1860
+        :julian => 4,       # @#DJULIAN@ 12 MAR 1650
+        :dual => 2,         # 12 FEB 1700/01
+        :interpreted => 2,  # INT 1850 (census)
+        :phrase => 2,       # (after the war)
+        :bc => 2            # 44 BC
+      }
+
+      MONTHS = %w[ JAN FEB MAR APR MAY JUN JUL AUG SEP OCT NOV DEC ]
+      MONTH_DAYS = [ 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 ]
+
+      GIVEN = %w[ John William James George Charles Thomas Henry Joseph Edward
+                  Robert Mary Elizabeth Sarah Anne Margaret Jane Catherine Ellen
+                  Alice Emma Maria Johann Anna Pierre Marie Giuseppe Jan Olaf ]
+      SURNAMES = %w[ Smith Jones Taylor Brown Williams Wilson Johnson Davies
+                     Robinson Wright Thompson Evans Walker White Roberts Green
+                     Hall Wood Jackson Clarke Muller Schmidt Schneider Fischer
+                     Dubois Moreau Rossi Russo Jansen Nilsson Kowalski Novak ]
+      PLACES = [ "London, England", "Leeds, Yorkshire, England", "Boston, Suffolk, Massachusetts, USA",
+                 "Hamburg, Germany", "Lyon, France", "Napoli, Italy", "Utrecht, Netherlands",
+                 "Uppsala, Sweden", "Krakow, Poland", "Cork, Ireland" ]
+      WORDS = %w[ the of and to in was he his with for a her at by on as from
+                  parish register records baptism family farm church mill moved
+                  married emigrated inherited witness estate census ]
+      PHRASES = [ "(after the war)", "(in her youth)", "(before the flood)", "(unknown)" ]
+
+      attr_reader :lines
+
+      # Options: :lines (the size of the file, 10_000 by default), :seed,
+      # :records and :dates (weights overriding RECORD_MIX and DATE_MIX).
+      def initialize( options = {} )
+        @lines = options[ :lines ] || 10_000
+        @seed = options[ :seed ] || 1
+        @records = weights( RECORD_MIX.merge( options[ :records ] || {} ) )
+        @dates = weights( DATE_MIX.merge( options[ :dates ] || {} ) )
+      end
+
+      # Writes the file to +path+, or to an IO.  Returns the number of lines.
+      def write( path )
+        return File.open( path, "wb" ) { |f| write( f ) } if path.kind_of?( String )
+
+        buffer = ""
+        count = each_line do |line|
+          buffer << line << "\n"
+          if buffer.length > 65536
+            path.write( buffer )
+            buffer = ""
+          end
+        end
+        path.write( buffer )
+        count
+      end
+
+      # Yields each line of the file, without its terminator.  Returns the
+      # number of lines.
+      def each_line
+        @random = Random.new( @seed )
+        @individuals = @families = @sources = @notes = 0
+
+        count = 0
+        record = [ "0 HEAD", "1 SOUR GEDCOM-Ruby", "2 NAME Benchmark generator", "1 GEDC",
+                   "2 VERS 5.5", "2 FORM LINEAGE-LINKED", "1 CHAR ASCII" ]
+        while count + record.length < @lines
+          record.each { |line| yield line }
+          count += record.length
+          record = make_record( pick( @records ) )
+        end
+
+        yield "0 TRLR"
+        count + 1
+      end
+
+      private
+
+      # [ [ item, cumulative weight ], ... ] for pick
+      def weights( mix )
+        total = 0
+        mix.collect { |item, weight| [ item, total += weight ] }.reject { |item, weight| weight == 0 }
+      end
+
+      def pick( table )
+        roll = @random.rand( table.last[ 1 ] )
+        table.each { |item, weight| return item if roll < weight }
+      end
+
+      def choose( array )
+        array[ @random.rand( array.length ) ]
+      end
+
+      def chance( percent )
+        @random.rand( 100 ) < percent
+      end
+
+      # Individuals and families made so far are the only ones referred to,
+      # so most files begin with a run of individuals.
+      def make_record( tag )
+        tag = "INDI" if tag != "NOTE" && tag != "SOUR" && @individuals < 2
+        case tag
+        when "INDI" then individual
+        when "FAM" then family
+        when "SOUR" then source
+        when "NOTE" then note
+        end
+      end
+
+      def individual
+        @individuals += 1
+        lines = [ "0 @I#{@individuals}@ INDI",
+                  "1 NAME #{choose( GIVEN )} #{chance( 20 ) ? choose( GIVEN ) + ' ' : ''}/#{choose( SURNAMES )}/",
+                  "1 SEX #{chance( 50 ) ? 'M' : 'F'}" ]
+        year = 1500 + @random.rand( 450 )
+        event( lines, "BIRT", year )
+        event( lines, "CHR", year ) if chance( 30 )
+        event( lines, "DEAT", year + 1 + @random.rand( 90 ) ) if chance( 60 )
+        event( lines, "BURI", year + 1 + @random.rand( 90 ) ) if chance( 25 )
+        lines << "1 OCCU #{choose( WORDS )} #{choose( WORDS )}" if chance( 20 )
+        lines << "1 FAMC @F#{1 + @random.rand( @families )}@" if @families > 0 && chance( 60 )
+        lines << "1 FAMS @F#{1 + @random.rand( @families )}@" if @families > 0 && chance( 40 )
+        citation( lines, 1 ) if @sources > 0 && chance( 30 )
+        lines << "1 NOTE @N#{1 + @random.rand( @notes )}@" if @notes > 0 && chance( 10 )
+        lines
+      end
+
+      def family
+        @families += 1
+        lines = [ "0 @F#{@families}@ FAM",
+                  "1 HUSB @I#{1 + @random.rand( @individuals )}@",
+                  "1 WIFE @I#{1 + @random.rand( @individuals )}@" ]
+        event( lines, "MARR", 1520 + @random.rand( 450 ) ) if chance( 70 )
+        @random.rand( 6 ).times { lines << "1 CHIL @I#{1 + @random.rand( @individuals )}@" }
+        lines
+      end
+
+      def source
+        @sources += 1
+        [ "0 @S#{@sources}@ SOUR",
+          "1 TITL #{choose( PLACES ).split( ',' ).first} #{choose( WORDS )} #{choose( WORDS )}",
+          "1 AUTH #{choose( GIVEN )} #{choose( SURNAMES )}",
+          "1 PUBL #{1800 + @random.rand( 200 )}" ]
+      end
+
+      # Notes run over several CONT and CONC lines
+      def note
+        @notes += 1
+        lines = [ "0 @N#{@notes}@ NOTE #{text( 8 )}" ]
+        @random.rand( 5 ).times do
+          lines << "1 #{chance( 70 ) ? 'CONT' : 'CONC'} #{text( 12 )}"
+        end
+        lines
+      end
+
+      def text( words )
+        Array.new( 1 + @random.rand( words ) ) { choose( WORDS ) }.join( " " )
+      end
+
+      def citation( lines, level )
+        lines << "#{level} SOUR @S#{1 + @random.rand( @sources )}@"
+        lines << "#{level + 1} PAGE #{1 + @random.rand( 400 )}" if chance( 50 )
+      end
+
+      def event( lines, tag, year )
+        lines << "1 #{tag}"
+        lines << "2 DATE #{date( year )}" if chance( 90 )
+        lines << "2 PLAC #{choose( PLACES )}" if chance( 70 )
+        citation( lines, 2 ) if @sources > 0 && chance( 10 )
+      end
+
+      def date( year )
+        case pick( @dates )
+        when :exact then day_month( year ) + " #{year}"
+        when :month then "#{choose( MONTHS )} #{year}"
+        when :year then year.to_s
+        when :approximate then "#{choose( %w[ ABT CAL EST ] )} #{chance( 50 ) ? choose( MONTHS ) + ' ' : ''}#{year}"
+        when :range
+          case @random.rand( 3 )
+          when 0 then "BEF #{year}"
+          when 1 then "AFT #{day_month( year )} #{year}"
+          else "BET #{year} AND #{year + 1 + @random.rand( 10 )}"
+          end
+        when :period then "FROM #{year} TO #{year + 1 + @random.rand( 30 )}"
+        when :julian then "@#DJULIAN@ #{day_month( year )} #{year - 100}"
+        when :dual then "#{1 + @random.rand( 28 )} #{choose( %w[ JAN FEB MAR ] )} #{year}/#{'%02d' % ( ( year + 1 ) % 100 )}"
+        when :interpreted then "INT #{year} #{choose( PHRASES )}"
+        when :phrase then choose( PHRASES )
+        when :bc then "#{1 + @random.rand( 500 )} BC"
+        end
+      end
+
+      def day_month( year )
+        month = @random.rand( 12 )
+        "#{1 + @random.rand( MONTH_DAYS[ month ] )} #{MONTHS[ month ]}"
+      end
+    end
+  end
+end
+
+if __FILE__ == $0
+  if ARGV.empty?
+    puts "usage: ruby bench/generator.rb LINES [FILE] [SEED]"
+    exit 1
+  end
+
+  generator = GEDCOM::Bench::Generator.new( :lines => ARGV[ 0 ].to_i, :seed => ( ARGV[ 2 ] || 1 ).to_i )
+  generator.write( ARGV[ 1 ] || $stdout )
+end
@@ -0,0 +1,150 @@
+# -------------------------------------------------------------------------
+# ractors.rb -- parses several files at once with a pool of Ractors
+# Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+# -------------------------------------------------------------------------
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2.1 of the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library; if not, write to the Free Software
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+# -------------------------------------------------------------------------
+#
+# Generates FILES files (or uses the ones given) and reads each of them
+# with GEDCOM.each_record, parsing every DATE on the way, first one file
+# after the other and then with a pool of Ractors in the same process.
+# Prints both times, the speedup and whether the two runs agreed, as JSON.
+# Needs Ruby 3.0 or later.
+#
+#   rake bench:ractors FILES=8 LINES=200000
+#   ruby -Ilib bench/ractors.rb
+#
+# Settings come from the environment:
+#
+#   FILES       number of files to generate, with seeds SEED, SEED+1, ... (4)
+#   RACTORS     size of the pool (FILES)
+#   LINES, SEED, RECORDS and DATES work as they do for bench/bench.rb
+#   FILE        a comma-separated list of files to read instead
+#   ITERATIONS  runs of each way; the best time is reported (3)
+
+require 'gedcom'
+require 'json'
+require File.expand_path( 'bench', File.dirname( __FILE__ ) )
+
+module GEDCOM
+  module Bench
+    module Ractors
+      # What one file comes to: [ records, dates, dates that did not parse,
+      # dates per format ].  Ractors can call this as it only reads
+      # shareable constants.
+      def Ractors.parse_file( path )
+        records = dates = errors = 0
+        formats = Hash.new( 0 )
+
+        GEDCOM.each_record( path ) do |record|
+          records += 1
+          stack = [ record ]
+          while ( node = stack.pop )
+            if node.tag == "DATE"
+              date = Ractors.parse_date( node.value ) { errors += 1 }
+              formats[ date.format ] += 1 if date
+              dates += 1
+            end
+            stack.concat( node.children )
+          end
+        end
+
+        [ records, dates, errors, formats.sort ]
+      end
+
+      def Ractors.parse_date( value, &failed )
+        return Date.try_parse( $2, CALENDARS[ $1 ] || DateType::DEFAULT ) { failed.call; nil } if value =~ /\A@#(D[A-Z ]+)@ (.*)/
+        Date.try_parse( value ) { failed.call; nil }
+      end
+
+      # Hands the paths to +size+ Ractors through a pipe Ractor and
+      # collects the results in the order of +paths+.
+      def Ractors.pool( paths, size )
+        pipe = Ractor.new do
+          loop { Ractor.yield( Ractor.receive ) }
+        end
+
+        workers = Array.new( size ) do
+          Ractor.new( pipe ) do |source|
+            while ( job = source.take )
+              index, path = job
+              Ractor.yield( [ index, Ractors.parse_file( path ) ] )
+            end
+          end
+        end
+
+        paths.each_with_index { |path, index| pipe.send( [ index, path ].freeze ) }
+
+        results = []
+        paths.length.times do
+          worker, ( index, result ) = Ractor.select( *workers )
+          results[ index ] = result
+        end
+
+        # a nil job ends each worker's loop
+        size.times { pipe.send( nil ) }
+        workers.each { |worker| worker.take }
+        results
+      end
+
+      def Ractors.run( options )
+        paths = options[ :files ] || Array.new( options[ :count ] || 4 ) do |i|
+          Runner.new( options.merge( :seed => ( options[ :seed ] || 1 ) + i ) ).generate
+        end
+        size = options[ :ractors ] || paths.length
+        iterations = options[ :iterations ] || 3
+
+        sequential = ractors = nil
+        times = Array.new( iterations ) do
+          start = Process.clock_gettime( Process::CLOCK_MONOTONIC )
+          sequential = paths.collect { |path| parse_file( path ) }
+          middle = Process.clock_gettime( Process::CLOCK_MONOTONIC )
+          ractors = pool( paths, size )
+          [ middle - start, Process.clock_gettime( Process::CLOCK_MONOTONIC ) - middle ]
+        end
+        best = times.transpose.collect( &:min )
+
+        { "ruby" => "#{RUBY_VERSION}p#{RUBY_PATCHLEVEL} #{RUBY_PLATFORM}",
+          "backend" => GEDCOM.backend.to_s,
+          "files" => paths,
+          "ractors" => size,
+          "iterations" => iterations,
+          "records" => sequential.inject( 0 ) { |sum, result| sum + result[ 0 ] },
+          "dates" => sequential.inject( 0 ) { |sum, result| sum + result[ 1 ] },
+          "sequential_seconds" => best[ 0 ],
+          "ractor_seconds" => best[ 1 ],
+          "speedup" => ( best[ 0 ] / best[ 1 ] ).round( 2 ),
+          "same_results" => sequential == ractors }
+      end
+    end
+  end
+end
+
+if __FILE__ == $0
+  Warning[ :experimental ] = false if Warning.respond_to?( :[]= )
+
+  options = { :lines => ENV[ "LINES" ] && ENV[ "LINES" ].to_i,
+              :seed => ENV[ "SEED" ] && ENV[ "SEED" ].to_i,
+              :records => GEDCOM::Bench.weights( ENV[ "RECORDS" ] ),
+              :dates => GEDCOM::Bench.weights( ENV[ "DATES" ], true ),
+              :files => ENV[ "FILE" ] && ENV[ "FILE" ].split( "," ),
+              :count => ENV[ "FILES" ] && ENV[ "FILES" ].to_i,
+              :ractors => ENV[ "RACTORS" ] && ENV[ "RACTORS" ].to_i,
+              :iterations => ENV[ "ITERATIONS" ] && ENV[ "ITERATIONS" ].to_i }
+
+  result = GEDCOM::Bench::Ractors.run( options )
+  puts JSON.pretty_generate( result )
+  exit( 1 ) if !result[ "same_results" ]
+end
@@ -1,3 +1,18 @@
 require 'mkmf'
 
+have_header( "ruby/encoding.h" )
+have_header( "pthread.h" )
+have_header( "stdatomic.h" )
+have_func( "rb_thread_call_without_gvl", "ruby/thread.h" )
+have_func( "rb_gc_mark_movable", "ruby.h" )
+have_const( "RUBY_TYPED_EMBEDDABLE", "ruby.h" )
+have_func( "rb_ext_ractor_safe", "ruby.h" )
+have_const( "RUBY_TYPED_FROZEN_SHAREABLE", "ruby.h" )
+
+# the static tracepoints of gedcom_probes.h, where systemtap-sdt is there
+have_header( "sys/sdt.h" )
+
+# GEDCOM.to_sqlite is only there if SQLite is
+have_library( "sqlite3", "sqlite3_open", "sqlite3.h" ) && have_header( "sqlite3.h" )
+
 create_makefile( "_gedcom" )
@@ -17,21 +17,60 @@
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  * ------------------------------------------------------------------------- */
 
+#include <errno.h>
 #include <ruby.h>
+#ifdef HAVE_RUBY_ENCODING_H
+#include <ruby/encoding.h>
+#endif
+#ifdef HAVE_RB_THREAD_CALL_WITHOUT_GVL
+#include <ruby/thread.h>
+#endif
 
 #include "gedcom_types.h"
 #include "gedcom_date.h"
-
+#include "gedcom_anniversary.h"
+#include "gedcom_name.h"
+#include "gedcom_dedupe.h"
+#include "gedcom_writer.h"
+#include "gedcom_record.h"
+#include "gedcom_export.h"
+#include "gedcom_query.h"
+#include "gedcom_stream.h"
+#include "gedcom_pipeline.h"
+#include "gedcom_validate.h"
+#include "gedcom_diff.h"
+#include "gedcom_stats.h"
+#include "gedcom_datecolumn.h"
+#include "gedcom_probes.h"
+#ifdef HAVE_SQLITE3_H
+#include "gedcom_sqlite.h"
+#endif
+
+
+/* class and module handles, set once by Init__gedcom and only read after
+ * that, so they are safe to use from any Ractor */
 
 static VALUE mGEDCOM;
 static VALUE cDate;
 static VALUE cDatePart;
+static VALUE cDateError;
 static VALUE eDateFormatException;
+static VALUE cAnniversaryIndex;
+static VALUE mName;
+static VALUE cNameIndex;
+static VALUE cDuplicateFinder;
+static VALUE cWriter;
+static VALUE cQuery;
+static VALUE cRecord;
+static VALUE cEventBatch;
+static VALUE cDateColumn;
 
 
 static VALUE static_gedcom_date_new( int    argc,
                                      VALUE *argv,
                                      VALUE  klass );
+static VALUE static_gedcom_date_valid( int argc, VALUE *argv, VALUE klass );
+static VALUE static_gedcom_date_try_parse( int argc, VALUE *argv, VALUE klass );
 
 static VALUE static_gedcom_date_get_format( VALUE self );
 static VALUE static_gedcom_date_get_date1( VALUE self );
@@ -54,19 +93,168 @@ static VALUE static_gedcom_date_to_year( VALUE self );
 static VALUE static_gedcom_date_epoch( VALUE self );
 static VALUE static_gedcom_datepart_to_s( VALUE self );
 
+static VALUE static_gedcom_dateerror_message( VALUE self );
+static VALUE static_gedcom_dateerror_text( VALUE self );
+static VALUE static_gedcom_dateerror_date( VALUE self );
+
+static VALUE static_gedcom_anniversary_new( VALUE klass );
+static VALUE static_gedcom_anniversary_add( VALUE self, VALUE tag, VALUE id, VALUE date );
+static VALUE static_gedcom_anniversary_on( VALUE self, VALUE tag, VALUE month, VALUE day );
+static VALUE static_gedcom_anniversary_in_month( VALUE self, VALUE tag, VALUE month );
+static VALUE static_gedcom_anniversary_events( VALUE self );
+static VALUE static_gedcom_anniversary_remove( VALUE self, VALUE ids );
+
+static VALUE static_gedcom_name_split( VALUE self, VALUE value );
+static VALUE static_gedcom_name_normalize( VALUE self, VALUE text );
+static VALUE static_gedcom_name_soundex( VALUE self, VALUE text );
+static VALUE static_gedcom_name_dm_soundex( VALUE self, VALUE text );
+
+static VALUE static_gedcom_nameindex_new( VALUE klass );
+static VALUE static_gedcom_nameindex_add( VALUE self, VALUE id, VALUE value );
+static VALUE static_gedcom_nameindex_surname( VALUE self, VALUE prefix );
+static VALUE static_gedcom_nameindex_given( VALUE self, VALUE prefix );
+static VALUE static_gedcom_nameindex_soundex( VALUE self, VALUE name );
+static VALUE static_gedcom_nameindex_dm_soundex( VALUE self, VALUE name );
+static VALUE static_gedcom_nameindex_remove( VALUE self, VALUE ids );
+
+static VALUE static_gedcom_dedupe_new( VALUE klass );
+static VALUE static_gedcom_dedupe_add( int argc, VALUE *argv, VALUE self );
+static VALUE static_gedcom_dedupe_candidates( int argc, VALUE *argv, VALUE self );
+static VALUE static_gedcom_dedupe_size( VALUE self );
+
+static VALUE static_gedcom_writer_new( int argc, VALUE *argv, VALUE klass );
+static VALUE static_gedcom_writer_line( int argc, VALUE *argv, VALUE self );
+static VALUE static_gedcom_writer_date( int argc, VALUE *argv, VALUE self );
+static VALUE static_gedcom_writer_flush( VALUE self );
+static VALUE static_gedcom_writer_close( VALUE self );
+static VALUE static_gedcom_writer_lines( VALUE self );
+
+static VALUE static_gedcom_scan_records( VALUE self, VALUE text );
+
+static VALUE static_gedcom_export_events( int argc, VALUE *argv, VALUE self );
+
+static VALUE static_gedcom_query_new( VALUE klass, VALUE source );
+static VALUE static_gedcom_query_each( VALUE self, VALUE text );
+static VALUE static_gedcom_query_run( VALUE self, VALUE text );
+
+static VALUE static_gedcom_each_record( VALUE self, VALUE path );
+static VALUE static_gedcom_record_level( VALUE self );
+static VALUE static_gedcom_record_xref( VALUE self );
+static VALUE static_gedcom_record_tag( VALUE self );
+static VALUE static_gedcom_record_value( VALUE self );
+static VALUE static_gedcom_record_children( VALUE self );
+static VALUE static_gedcom_record_each( VALUE self );
+static VALUE static_gedcom_record_child( VALUE self, VALUE tag );
+static VALUE static_gedcom_record_to_s( VALUE self );
+
+static VALUE static_gedcom_each_event( int argc, VALUE *argv, VALUE self );
+static VALUE static_gedcom_each_event_batch( int argc, VALUE *argv, VALUE self );
+static VALUE static_gedcom_eventbatch_length( VALUE self );
+static VALUE static_gedcom_eventbatch_level( VALUE self, VALUE index );
+static VALUE static_gedcom_eventbatch_tag( VALUE self, VALUE index );
+static VALUE static_gedcom_eventbatch_value( VALUE self, VALUE index );
+static VALUE static_gedcom_eventbatch_levels( VALUE self );
+static VALUE static_gedcom_eventbatch_tags( VALUE self );
+static VALUE static_gedcom_eventbatch_values( VALUE self );
+static VALUE static_gedcom_eventbatch_each( VALUE self );
+
+static VALUE static_gedcom_validate( int argc, VALUE *argv, VALUE self );
+
+static VALUE static_gedcom_diff( int argc, VALUE *argv, VALUE self );
+
+#ifdef HAVE_SQLITE3_H
+static VALUE static_gedcom_to_sqlite( VALUE self, VALUE path, VALUE dbPath );
+#endif
+
+static VALUE static_gedcom_stats( int argc, VALUE *argv, VALUE self );
+
+static VALUE static_gedcom_datecolumn_new( VALUE klass );
+static VALUE static_gedcom_datecolumn_add( int argc, VALUE *argv, VALUE self );
+static VALUE static_gedcom_datecolumn_load( VALUE self, VALUE path );
+static VALUE static_gedcom_datecolumn_length( VALUE self );
+static VALUE static_gedcom_datecolumn_tags( VALUE self );
+static VALUE static_gedcom_datecolumn_min( int argc, VALUE *argv, VALUE self );
+static VALUE static_gedcom_datecolumn_max( int argc, VALUE *argv, VALUE self );
+static VALUE static_gedcom_datecolumn_mask( int argc, VALUE *argv, VALUE self );
+static VALUE static_gedcom_datecolumn_histogram( int argc, VALUE *argv, VALUE self );
+
+
+/* Dates, date parts and date errors are plain copies of the parser's
+ * structs that hold no references, so on rubies that support it they are
+ * embedded in the object slot itself and their size is already accounted
+ * for. */
+
+#ifdef HAVE_CONST_RUBY_TYPED_EMBEDDABLE
+#define GEDCOM_TYPED_EMBEDDABLE RUBY_TYPED_EMBEDDABLE
+#else
+#define GEDCOM_TYPED_EMBEDDABLE 0
+#endif
+
+/* nothing changes them after they are made either, so once frozen (as
+ * Ractor.make_shareable does) they can be passed between Ractors.  The
+ * same holds for compiled queries. */
+
+#ifdef HAVE_CONST_RUBY_TYPED_FROZEN_SHAREABLE
+#define GEDCOM_TYPED_FROZEN_SHAREABLE RUBY_TYPED_FROZEN_SHAREABLE
+#else
+#define GEDCOM_TYPED_FROZEN_SHAREABLE 0
+#endif
+
+static size_t static_gedcom_date_memsize( const void *ptr )
+{
+#ifdef HAVE_CONST_RUBY_TYPED_EMBEDDABLE
+  return 0;
+#else
+  return sizeof( gedDATEVALUE_t );
+#endif
+}
 
-static VALUE static_gedcom_date_new( int    argc,
-                                     VALUE *argv,
-                                     VALUE  klass )
+
+static size_t static_gedcom_datepart_memsize( const void *ptr )
+{
+#ifdef HAVE_CONST_RUBY_TYPED_EMBEDDABLE
+  return 0;
+#else
+  return sizeof( gedDATE_t );
+#endif
+}
+
+
+static const rb_data_type_t static_gedcom_date_type = {
+  "GEDCOM::Date",
+  { 0, RUBY_TYPED_DEFAULT_FREE, static_gedcom_date_memsize, },
+  0, 0,
+  RUBY_TYPED_FREE_IMMEDIATELY | RUBY_TYPED_WB_PROTECTED | GEDCOM_TYPED_EMBEDDABLE |
+  GEDCOM_TYPED_FROZEN_SHAREABLE
+};
+
+static const rb_data_type_t static_gedcom_datepart_type = {
+  "GEDCOM::DatePart",
+  { 0, RUBY_TYPED_DEFAULT_FREE, static_gedcom_datepart_memsize, },
+  0, 0,
+  RUBY_TYPED_FREE_IMMEDIATELY | RUBY_TYPED_WB_PROTECTED | GEDCOM_TYPED_EMBEDDABLE |
+  GEDCOM_TYPED_FROZEN_SHAREABLE
+};
+
+static const rb_data_type_t static_gedcom_dateerror_type = {
+  "GEDCOM::DateError",
+  { 0, RUBY_TYPED_DEFAULT_FREE, static_gedcom_date_memsize, },
+  0, 0,
+  RUBY_TYPED_FREE_IMMEDIATELY | RUBY_TYPED_WB_PROTECTED | GEDCOM_TYPED_EMBEDDABLE |
+  GEDCOM_TYPED_FROZEN_SHAREABLE
+};
+
+
+/* parses the ( date [, type] ) arguments of Date.new, Date.valid? and
+ * Date.try_parse into 'parsed_date', returning the parser's result */
+
+static int static_gedcom_date_parse( int             argc,
+                                     VALUE          *argv,
+                                     gedDATEVALUE_t *parsed_date )
 {
-  char *s_date;
   int   i_type;
-  int   rc;
   VALUE date;
   VALUE type;
-  VALUE new_date;
-  gedDATEVALUE_t parsed_date;
-  gedDATEVALUE_t *temp;
 
   if( rb_scan_args( argc, argv, "11", &date, &type ) == 1 )
   {
@@ -76,23 +264,61 @@ static VALUE static_gedcom_date_new( int    argc,
   {
     i_type = FIX2INT( type );
   }
-    
-  s_date = STR2CSTR( date );
 
-  rc = parseGEDCOMDate( s_date, &parsed_date, i_type );
+  return parseGEDCOMDate( StringValueCStr( date ), parsed_date, i_type );
+}
 
-  if( rc != 0 )
-  {
-    VALUE err_msg;
 
-    err_msg = rb_str_new2( "format error at '" );
+/* the text that could not be parsed is in whichever part the parser
+ * was working on when it failed */
 
-    if( parsed_date.date1.flags & gfNONSTANDARD )
-      rb_str_cat( err_msg, parsed_date.date1.data.phrase, strlen( parsed_date.date1.data.phrase ) );
-    else
-      rb_str_cat( err_msg, parsed_date.date2.data.phrase, strlen( parsed_date.date2.data.phrase ) );
+static ofCHAR_t* static_gedcom_date_error_text( gedDATEVALUE_t *parsed_date )
+{
+  if( parsed_date->date1.flags & gfNONSTANDARD )
+    return parsed_date->date1.data.phrase;
+
+  return parsed_date->date2.data.phrase;
+}
+
+
+static VALUE static_gedcom_date_error_message( gedDATEVALUE_t *parsed_date )
+{
+  VALUE     err_msg;
+  ofCHAR_t *text;
+
+  text = static_gedcom_date_error_text( parsed_date );
+
+  err_msg = rb_str_new2( "format error at '" );
+  rb_str_cat( err_msg, (char*)text, strlen( (char*)text ) );
+  rb_str_cat( err_msg, "'", 1 );
+
+  return err_msg;
+}
+
+
+static VALUE static_gedcom_date_wrap( VALUE klass, const rb_data_type_t *type, gedDATEVALUE_t *parsed_date )
+{
+  gedDATEVALUE_t *temp;
+  VALUE           new_date;
 
-    rb_str_cat( err_msg, "'", 1 );
+  new_date = TypedData_Make_Struct( klass, gedDATEVALUE_t, type, temp );
+  memcpy( temp, parsed_date, sizeof( *parsed_date ) );
+
+  return new_date;
+}
+
+
+static VALUE static_gedcom_date_new( int    argc,
+                                     VALUE *argv,
+                                     VALUE  klass )
+{
+  gedDATEVALUE_t parsed_date;
+
+  if( static_gedcom_date_parse( argc, argv, &parsed_date ) != 0 )
+  {
+    VALUE err_msg;
+
+    err_msg = static_gedcom_date_error_message( &parsed_date );
 
     if( rb_block_given_p() )
     {
@@ -100,14 +326,75 @@ static VALUE static_gedcom_date_new( int    argc,
     }
     else
     {
-      rb_raise( eDateFormatException, STR2CSTR( err_msg ) );
+      rb_raise( eDateFormatException, "%s", StringValueCStr( err_msg ) );
     }
   }
 
-  new_date = Data_Make_Struct( klass, gedDATEVALUE_t, 0, 0, temp );
-  memcpy( temp, &parsed_date, sizeof( parsed_date ) );
+  return static_gedcom_date_wrap( klass, &static_gedcom_date_type, &parsed_date );
+}
 
-  return new_date;
+
+/* Date.valid? parses into the stack and allocates nothing */
+
+static VALUE static_gedcom_date_valid( int argc, VALUE *argv, VALUE klass )
+{
+  gedDATEVALUE_t parsed_date;
+
+  return ( static_gedcom_date_parse( argc, argv, &parsed_date ) == 0 ) ? Qtrue : Qfalse;
+}
+
+
+/* Date.try_parse returns nil for text that does not parse, or yields a
+ * DateError holding the failed parse; its message is only built if it
+ * is asked for */
+
+static VALUE static_gedcom_date_try_parse( int argc, VALUE *argv, VALUE klass )
+{
+  gedDATEVALUE_t parsed_date;
+
+  if( static_gedcom_date_parse( argc, argv, &parsed_date ) == 0 )
+  {
+    return static_gedcom_date_wrap( klass, &static_gedcom_date_type, &parsed_date );
+  }
+
+  if( rb_block_given_p() )
+  {
+    return rb_yield( static_gedcom_date_wrap( cDateError, &static_gedcom_dateerror_type, &parsed_date ) );
+  }
+
+  return Qnil;
+}
+
+
+static VALUE static_gedcom_dateerror_message( VALUE self )
+{
+  gedDATEVALUE_t *date;
+
+  TypedData_Get_Struct( self, gedDATEVALUE_t, &static_gedcom_dateerror_type, date );
+
+  return static_gedcom_date_error_message( date );
+}
+
+
+static VALUE static_gedcom_dateerror_text( VALUE self )
+{
+  gedDATEVALUE_t *date;
+
+  TypedData_Get_Struct( self, gedDATEVALUE_t, &static_gedcom_dateerror_type, date );
+
+  return rb_str_new2( (char*)static_gedcom_date_error_text( date ) );
+}
+
+
+/* the Date that Date.new makes of the text when it is given a block */
+
+static VALUE static_gedcom_dateerror_date( VALUE self )
+{
+  gedDATEVALUE_t *date;
+
+  TypedData_Get_Struct( self, gedDATEVALUE_t, &static_gedcom_dateerror_type, date );
+
+  return static_gedcom_date_wrap( cDate, &static_gedcom_date_type, date );
 }
 
 
@@ -115,9 +402,9 @@ static VALUE static_gedcom_date_get_format( VALUE self )
 {
   gedDATEVALUE_t *date;
 
-  Data_Get_Struct( self, gedDATEVALUE_t, date );
+  TypedData_Get_Struct( self, gedDATEVALUE_t, &static_gedcom_date_type, date );
 
-  return FIX2INT( date->flags );
+  return INT2FIX( date->flags );
 }
 
 
@@ -127,9 +414,9 @@ static VALUE static_gedcom_date_get_date1( VALUE self )
   gedDATE_t      *date_part;
   VALUE           date1;
 
-  Data_Get_Struct( self, gedDATEVALUE_t, date );
+  TypedData_Get_Struct( self, gedDATEVALUE_t, &static_gedcom_date_type, date );
 
-  date1 = Data_Make_Struct( cDatePart, gedDATE_t, 0, 0, date_part );
+  date1 = TypedData_Make_Struct( cDatePart, gedDATE_t, &static_gedcom_datepart_type, date_part );
   memcpy( date_part, &date->date1, sizeof( gedDATE_t ) );
 
   return date1;
@@ -142,9 +429,9 @@ static VALUE static_gedcom_date_get_date2( VALUE self )
   gedDATE_t      *date_part;
   VALUE           date2;
 
-  Data_Get_Struct( self, gedDATEVALUE_t, date );
+  TypedData_Get_Struct( self, gedDATEVALUE_t, &static_gedcom_date_type, date );
 
-  date2 = Data_Make_Struct( cDatePart, gedDATE_t, 0, 0, date_part );
+  date2 = TypedData_Make_Struct( cDatePart, gedDATE_t, &static_gedcom_datepart_type, date_part );
   memcpy( date_part, &date->date2, sizeof( gedDATE_t ) );
 
   return date2;
@@ -155,7 +442,7 @@ static VALUE static_gedcom_date_get_type( VALUE self )
 {
   gedDATE_t *date_part;
 
-  Data_Get_Struct( self, gedDATE_t, date_part );
+  TypedData_Get_Struct( self, gedDATE_t, &static_gedcom_datepart_type, date_part );
 
   return INT2FIX( date_part->type );
 }
@@ -165,7 +452,7 @@ static VALUE static_gedcom_date_get_flags( VALUE self )
 {
   gedDATE_t *date_part;
 
-  Data_Get_Struct( self, gedDATE_t, date_part );
+  TypedData_Get_Struct( self, gedDATE_t, &static_gedcom_datepart_type, date_part );
 
   return INT2FIX( date_part->flags );
 }
@@ -175,7 +462,7 @@ static VALUE static_gedcom_date_get_phrase( VALUE self )
 {
   gedDATE_t *date_part;
 
-  Data_Get_Struct( self, gedDATE_t, date_part );
+  TypedData_Get_Struct( self, gedDATE_t, &static_gedcom_datepart_type, date_part );
 
   if( date_part->flags != gfPHRASE )
     rb_raise( eDateFormatException, "date does not contain a phrase" );
@@ -188,9 +475,9 @@ static VALUE static_gedcom_date_has_day( VALUE self )
 {
   gedDATE_t *date_part;
 
-  Data_Get_Struct( self, gedDATE_t, date_part );
+  TypedData_Get_Struct( self, gedDATE_t, &static_gedcom_datepart_type, date_part );
 
-  if( date_part->flags == gfPHRASE )
+  if( date_part->flags != gfNONE )
     return Qfalse;
 
   return ( ( date_part->data.dateOther.flags & gfNODAY ) ? Qfalse : Qtrue );
@@ -201,9 +488,9 @@ static VALUE static_gedcom_date_has_month( VALUE self )
 {
   gedDATE_t *date_part;
 
-  Data_Get_Struct( self, gedDATE_t, date_part );
+  TypedData_Get_Struct( self, gedDATE_t, &static_gedcom_datepart_type, date_part );
 
-  if( date_part->flags == gfPHRASE )
+  if( date_part->flags != gfNONE )
     return Qfalse;
 
   return ( ( date_part->data.dateOther.flags & gfNOMONTH ) ? Qfalse : Qtrue );
@@ -214,9 +501,9 @@ static VALUE static_gedcom_date_has_year( VALUE self )
 {
   gedDATE_t *date_part;
 
-  Data_Get_Struct( self, gedDATE_t, date_part );
+  TypedData_Get_Struct( self, gedDATE_t, &static_gedcom_datepart_type, date_part );
 
-  if( date_part->flags == gfPHRASE )
+  if( date_part->flags != gfNONE )
     return Qfalse;
 
   return ( ( date_part->data.dateOther.flags & gfNOYEAR ) ? Qfalse : Qtrue );
@@ -227,9 +514,9 @@ static VALUE static_gedcom_date_has_year_span( VALUE self )
 {
   gedDATE_t *date_part;
 
-  Data_Get_Struct( self, gedDATE_t, date_part );
+  TypedData_Get_Struct( self, gedDATE_t, &static_gedcom_datepart_type, date_part );
 
-  if( date_part->flags == gfPHRASE )
+  if( date_part->flags != gfNONE )
     return Qfalse;
 
   return ( ( date_part->data.dateOther.flags & gfYEARSPAN ) ? Qtrue : Qfalse );
@@ -240,9 +527,9 @@ static VALUE static_gedcom_date_day( VALUE self )
 {
   gedDATE_t *date_part;
 
-  Data_Get_Struct( self, gedDATE_t, date_part );
+  TypedData_Get_Struct( self, gedDATE_t, &static_gedcom_datepart_type, date_part );
 
-  if( date_part->flags == gfPHRASE || date_part->data.dateOther.flags & gfNODAY )
+  if( date_part->flags != gfNONE || date_part->data.dateOther.flags & gfNODAY )
     rb_raise( eDateFormatException, "date has no day" );
 
   return INT2FIX( date_part->data.dateOther.day );
@@ -253,9 +540,9 @@ static VALUE static_gedcom_date_month( VALUE self )
 {
   gedDATE_t *date_part;
 
-  Data_Get_Struct( self, gedDATE_t, date_part );
+  TypedData_Get_Struct( self, gedDATE_t, &static_gedcom_datepart_type, date_part );
 
-  if( date_part->flags == gfPHRASE || date_part->data.dateOther.flags & gfNOMONTH )
+  if( date_part->flags != gfNONE || date_part->data.dateOther.flags & gfNOMONTH )
     rb_raise( eDateFormatException, "date has no month" );
 
   return INT2FIX( date_part->data.dateOther.month );
@@ -266,9 +553,9 @@ static VALUE static_gedcom_date_year( VALUE self )
 {
   gedDATE_t *date_part;
 
-  Data_Get_Struct( self, gedDATE_t, date_part );
+  TypedData_Get_Struct( self, gedDATE_t, &static_gedcom_datepart_type, date_part );
 
-  if( date_part->flags == gfPHRASE || date_part->data.dateOther.flags & gfNOYEAR )
+  if( date_part->flags != gfNONE || date_part->data.dateOther.flags & gfNOYEAR )
     rb_raise( eDateFormatException, "date has no year" );
 
   return INT2FIX( date_part->data.dateOther.year );
@@ -279,9 +566,9 @@ static VALUE static_gedcom_date_to_year( VALUE self )
 {
   gedDATE_t *date_part;
 
-  Data_Get_Struct( self, gedDATE_t, date_part );
+  TypedData_Get_Struct( self, gedDATE_t, &static_gedcom_datepart_type, date_part );
 
-  if( date_part->flags == gfPHRASE || ( date_part->data.dateOther.flags & gfYEARSPAN == 0 ) )
+  if( date_part->flags != gfNONE || ( date_part->data.dateOther.flags & gfYEARSPAN ) == 0 )
     rb_raise( eDateFormatException, "date has no year span" );
 
   return INT2FIX( date_part->data.dateGregorian.year2 );
@@ -292,9 +579,9 @@ static VALUE static_gedcom_date_epoch( VALUE self )
 {
   gedDATE_t *date_part;
 
-  Data_Get_Struct( self, gedDATE_t, date_part );
+  TypedData_Get_Struct( self, gedDATE_t, &static_gedcom_datepart_type, date_part );
 
-  if( date_part->flags == gfPHRASE || date_part->type != gctGREGORIAN )
+  if( date_part->flags != gfNONE || date_part->type != gctGREGORIAN )
     rb_raise( eDateFormatException, "only gregorian dates have epoch" );
 
   return rb_str_new2( ( date_part->data.dateGregorian.adbc == gedadbcBC ) ? "BC" : "AD" );
@@ -306,7 +593,7 @@ static VALUE static_gedcom_date_to_s( VALUE self )
   gedDATEVALUE_t *date;
   char text[ 512 ];
 
-  Data_Get_Struct( self, gedDATEVALUE_t, date );
+  TypedData_Get_Struct( self, gedDATEVALUE_t, &static_gedcom_date_type, date );
 
   buildGEDCOMDateString( date, text );
 
@@ -319,7 +606,7 @@ static VALUE static_gedcom_datepart_to_s( VALUE self )
   gedDATE_t *date_part;
   char       text[ 512 ];
 
-  Data_Get_Struct( self, gedDATE_t, date_part );
+  TypedData_Get_Struct( self, gedDATE_t, &static_gedcom_datepart_type, date_part );
 
   buildGEDCOMDatePartString( date_part, text );
 
@@ -331,7 +618,7 @@ static VALUE static_gedcom_date_is_date( VALUE self )
 {
   gedDATEVALUE_t *date;
 
-  Data_Get_Struct( self, gedDATEVALUE_t, date );
+  TypedData_Get_Struct( self, gedDATEVALUE_t, &static_gedcom_date_type, date );
 
   switch( date->flags )
   {
@@ -357,7 +644,7 @@ static VALUE static_gedcom_date_is_range( VALUE self )
 {
   gedDATEVALUE_t *date;
 
-  Data_Get_Struct( self, gedDATEVALUE_t, date );
+  TypedData_Get_Struct( self, gedDATEVALUE_t, &static_gedcom_date_type, date );
 
   switch( date->flags )
   {
@@ -370,83 +657,2998 @@ static VALUE static_gedcom_date_is_range( VALUE self )
 }
 
 
-void Init__gedcom()
+static void static_gedcom_anniversary_free( void *ptr )
 {
-  VALUE cDateType;
+  freeAnniversaryIndex( (gedANNIVERSARYINDEX_t*)ptr );
+  xfree( ptr );
+}
 
-  mGEDCOM   = rb_define_module( "GEDCOM" );
-  cDate     = rb_define_class_under( mGEDCOM, "Date", rb_cObject );
-  cDatePart = rb_define_class_under( mGEDCOM, "DatePart", rb_cObject );
 
-  eDateFormatException = rb_define_class_under( mGEDCOM, "DateFormatException", rb_eException );
+static size_t static_gedcom_anniversary_memsize( const void *ptr )
+{
+  return sizeof( gedANNIVERSARYINDEX_t ) + (size_t)getAnniversaryIndexMemory( (gedANNIVERSARYINDEX_t*)ptr );
+}
 
-  rb_define_const( cDate, "NONE",  INT2FIX( gcNONE ) );
 
-  rb_define_const( cDate, "ABOUT",       INT2FIX( gcABOUT ) );
-  rb_define_const( cDate, "CALCULATED",  INT2FIX( gcCALCULATED ) );
-  rb_define_const( cDate, "ESTIMATED",   INT2FIX( gcESTIMATED ) );
-  rb_define_const( cDate, "BEFORE",      INT2FIX( gcBEFORE ) );
-  rb_define_const( cDate, "AFTER",       INT2FIX( gcAFTER ) );
-  rb_define_const( cDate, "BETWEEN",     INT2FIX( gcBETWEEN ) );
-  rb_define_const( cDate, "FROM",        INT2FIX( gcFROM ) );
-  rb_define_const( cDate, "TO",          INT2FIX( gcTO ) );
-  rb_define_const( cDate, "FROMTO",      INT2FIX( gcFROMTO ) );
-  rb_define_const( cDate, "INTERPRETED", INT2FIX( gcINTERPRETED ) );
+static const rb_data_type_t static_gedcom_anniversary_type = {
+  "GEDCOM::AnniversaryIndex",
+  { 0, static_gedcom_anniversary_free, static_gedcom_anniversary_memsize, },
+  0, 0,
+  RUBY_TYPED_FREE_IMMEDIATELY | RUBY_TYPED_WB_PROTECTED
+};
 
-  rb_define_const( cDate, "CHILD",       INT2FIX( gcCHILD ) );
-  rb_define_const( cDate, "CLEARED",     INT2FIX( gcCLEARED ) );
-  rb_define_const( cDate, "COMPLETED",   INT2FIX( gcCOMPLETED ) );
-  rb_define_const( cDate, "INFANT",      INT2FIX( gcINFANT ) );
-  rb_define_const( cDate, "PRE1970",     INT2FIX( gcPRE1970 ) );
-  rb_define_const( cDate, "QUALIFIED",   INT2FIX( gcQUALIFIED ) );
-  rb_define_const( cDate, "STILLBORN",   INT2FIX( gcSTILLBORN ) );
-  rb_define_const( cDate, "SUBMITTED",   INT2FIX( gcSUBMITTED ) );
-  rb_define_const( cDate, "UNCLEARED",   INT2FIX( gcUNCLEARED ) );
-  rb_define_const( cDate, "BIC",         INT2FIX( gcBIC ) );
-  rb_define_const( cDate, "DNS",         INT2FIX( gcDNS ) );
-  rb_define_const( cDate, "DNSCAN",      INT2FIX( gcDNSCAN ) );
-  rb_define_const( cDate, "DEAD",        INT2FIX( gcDEAD ) );
 
-  rb_define_singleton_method( cDate, "new", static_gedcom_date_new, -1 );
-  
-  rb_define_method( cDate, "format", static_gedcom_date_get_format, 0 );
-  rb_define_method( cDate, "first", static_gedcom_date_get_date1, 0 );
-  rb_define_method( cDate, "last", static_gedcom_date_get_date2, 0 );
-  rb_define_method( cDate, "to_s", static_gedcom_date_to_s, 0 );
-  rb_define_method( cDate, "is_date?", static_gedcom_date_is_date, 0 );
-  rb_define_method( cDate, "is_range?", static_gedcom_date_is_range, 0 );
+static VALUE static_gedcom_idlist_to_a( gedIDLIST_t *list )
+{
+  VALUE    ids;
+  ofUI32_t i;
 
-  rb_define_const( cDatePart, "NONE",        INT2FIX( gfNONE ) );
-  rb_define_const( cDatePart, "PHRASE",      INT2FIX( gfPHRASE ) );
-  rb_define_const( cDatePart, "NONSTANDARD", INT2FIX( gfNONSTANDARD ) );
+  if( list == 0 )
+    return rb_ary_new();
 
-  rb_define_const( cDatePart, "NOFLAG",      INT2FIX( gfNOFLAG ) );
-  rb_define_const( cDatePart, "NODAY",       INT2FIX( gfNODAY ) );
-  rb_define_const( cDatePart, "NOMONTH",     INT2FIX( gfNOMONTH ) );
-  rb_define_const( cDatePart, "NOYEAR",      INT2FIX( gfNOYEAR ) );
-  rb_define_const( cDatePart, "YEARSPAN",    INT2FIX( gfYEARSPAN ) );
+  ids = rb_ary_new2( list->count );
+  for( i = 0; i < list->count; i++ )
+    rb_ary_push( ids, UINT2NUM( list->ids[ i ] ) );
 
-  rb_define_method( cDatePart, "calendar",        static_gedcom_date_get_type, 0 );
-  rb_define_method( cDatePart, "compliance",      static_gedcom_date_get_flags, 0 );
-  rb_define_method( cDatePart, "phrase",          static_gedcom_date_get_phrase, 0 );
-  rb_define_method( cDatePart, "has_day?",        static_gedcom_date_has_day, 0 );
-  rb_define_method( cDatePart, "has_month?",      static_gedcom_date_has_month, 0 );
-  rb_define_method( cDatePart, "has_year?",       static_gedcom_date_has_year, 0 );
-  rb_define_method( cDatePart, "has_year_span?",  static_gedcom_date_has_year_span, 0 );
-  rb_define_method( cDatePart, "day",             static_gedcom_date_day, 0 );
-  rb_define_method( cDatePart, "month",           static_gedcom_date_month, 0 );
-  rb_define_method( cDatePart, "year",            static_gedcom_date_year, 0 );
-  rb_define_method( cDatePart, "to_year",         static_gedcom_date_to_year, 0 );
-  rb_define_method( cDatePart, "epoch",           static_gedcom_date_epoch, 0 );
-  rb_define_method( cDatePart, "to_s",            static_gedcom_datepart_to_s, 0 );
+  return ids;
+}
 
-  cDateType = rb_define_class_under( mGEDCOM, "DateType", rb_cObject );
 
-  rb_define_const( cDateType, "GREGORIAN", INT2FIX( gctGREGORIAN ) );
-  rb_define_const( cDateType, "JULIAN",    INT2FIX( gctJULIAN ) );
-  rb_define_const( cDateType, "HEBREW",    INT2FIX( gctHEBREW ) );
-  rb_define_const( cDateType, "FRENCH",    INT2FIX( gctFRENCH ) );
-  rb_define_const( cDateType, "FUTURE",    INT2FIX( gctFUTURE ) );
-  rb_define_const( cDateType, "UNKNOWN",   INT2FIX( gctUNKNOWN ) );
-  rb_define_const( cDateType, "DEFAULT",   INT2FIX( gctDEFAULT ) );
+/* takes either a GEDCOM::Date or the raw DATE text, in which case no Date
+ * object needs to be allocated at all.  Returns 0 for nil or text that does
+ * not parse.  A Date is copied out, since an embedded one may move if the
+ * caller allocates before using the result. */
+
+static gedDATEVALUE_t* static_gedcom_date_value( VALUE date, gedDATEVALUE_t *parsed_date )
+{
+  gedDATEVALUE_t *value;
+
+  if( NIL_P( date ) )
+    return 0;
+
+  if( rb_obj_is_kind_of( date, cDate ) )
+  {
+    TypedData_Get_Struct( date, gedDATEVALUE_t, &static_gedcom_date_type, value );
+    memcpy( parsed_date, value, sizeof( *parsed_date ) );
+    return parsed_date;
+  }
+
+  if( parseGEDCOMDate( (ofCHAR_t*)StringValueCStr( date ), parsed_date, gctDEFAULT ) != 0 )
+    return 0;
+
+  return parsed_date;
+}
+
+
+static VALUE static_gedcom_anniversary_new( VALUE klass )
+{
+  gedANNIVERSARYINDEX_t *index;
+  VALUE                  new_index;
+
+  new_index = TypedData_Make_Struct( klass, gedANNIVERSARYINDEX_t, &static_gedcom_anniversary_type, index );
+  initAnniversaryIndex( index );
+
+  return new_index;
+}
+
+
+static VALUE static_gedcom_anniversary_add( VALUE self, VALUE tag, VALUE id, VALUE date )
+{
+  gedANNIVERSARYINDEX_t *index;
+  gedDATEVALUE_t         parsed_date;
+  gedDATEVALUE_t        *value;
+  int                    rc;
+
+  TypedData_Get_Struct( self, gedANNIVERSARYINDEX_t, &static_gedcom_anniversary_type, index );
+
+  value = static_gedcom_date_value( date, &parsed_date );
+  if( value == 0 )
+    return Qfalse;
+
+  rc = addAnniversary( index, (ofCHAR_t*)StringValueCStr( tag ), NUM2UINT( id ), value );
+
+  if( rc < 0 )
+    rb_raise( rb_eNoMemError, "failed to grow anniversary index" );
+
+  return ( rc > 0 ? Qtrue : Qfalse );
+}
+
+
+static VALUE static_gedcom_anniversary_on( VALUE self, VALUE tag, VALUE month, VALUE day )
+{
+  gedANNIVERSARYINDEX_t *index;
+
+  TypedData_Get_Struct( self, gedANNIVERSARYINDEX_t, &static_gedcom_anniversary_type, index );
+
+  return static_gedcom_idlist_to_a( findAnniversariesOn( index, (ofCHAR_t*)StringValueCStr( tag ), NUM2INT( month ), NUM2INT( day ) ) );
+}
+
+
+static VALUE static_gedcom_anniversary_in_month( VALUE self, VALUE tag, VALUE month )
+{
+  gedANNIVERSARYINDEX_t *index;
+
+  TypedData_Get_Struct( self, gedANNIVERSARYINDEX_t, &static_gedcom_anniversary_type, index );
+
+  return static_gedcom_idlist_to_a( findAnniversariesIn( index, (ofCHAR_t*)StringValueCStr( tag ), NUM2INT( month ) ) );
+}
+
+
+static VALUE static_gedcom_anniversary_events( VALUE self )
+{
+  gedANNIVERSARYINDEX_t *index;
+  VALUE                  events;
+  int                    i;
+
+  TypedData_Get_Struct( self, gedANNIVERSARYINDEX_t, &static_gedcom_anniversary_type, index );
+
+  events = rb_ary_new2( index->count );
+  for( i = 0; i < index->count; i++ )
+    rb_ary_push( events, rb_str_new2( (char*)index->events[ i ]->tag ) );
+
+  return events;
+}
+
+
+/* fills 'list' with the ids in the array 'ids', sorted and unique */
+
+static void static_gedcom_a_to_idlist( VALUE ids, gedIDLIST_t *list )
+{
+  long i;
+
+  Check_Type( ids, T_ARRAY );
+
+  initIdList( list );
+  for( i = 0; i < RARRAY_LEN( ids ); i++ )
+  {
+    if( appendIdList( list, NUM2UINT( RARRAY_PTR( ids )[ i ] ) ) != 0 )
+    {
+      freeIdList( list );
+      rb_raise( rb_eNoMemError, "failed to build id list" );
+    }
+  }
+
+  uniqueIdList( list );
+}
+
+
+static VALUE static_gedcom_anniversary_remove( VALUE self, VALUE ids )
+{
+  gedANNIVERSARYINDEX_t *index;
+  gedIDLIST_t            removed;
+
+  TypedData_Get_Struct( self, gedANNIVERSARYINDEX_t, &static_gedcom_anniversary_type, index );
+
+  static_gedcom_a_to_idlist( ids, &removed );
+  removeAnniversaries( index, &removed );
+  freeIdList( &removed );
+
+  return self;
+}
+
+
+static VALUE static_gedcom_str_part( VALUE str, long start, long length )
+{
+  VALUE part;
+
+  part = rb_str_new( RSTRING_PTR( str ) + start, length );
+#ifdef HAVE_RUBY_ENCODING_H
+  rb_enc_copy( part, str );
+#endif
+
+  return part;
+}
+
+
+static VALUE static_gedcom_name_split( VALUE self, VALUE value )
+{
+  gedNAME_t name;
+
+  splitGEDCOMName( (ofCHAR_t*)StringValueCStr( value ), &name );
+
+  return rb_ary_new3( 3, static_gedcom_str_part( value, name.givenStart, name.givenLength ),
+                         static_gedcom_str_part( value, name.surnameStart, name.surnameLength ),
+                         static_gedcom_str_part( value, name.suffixStart, name.suffixLength ) );
+}
+
+
+static int static_gedcom_name_normalize_into( VALUE text, ofCHAR_t *buffer )
+{
+  StringValue( text );
+
+  return normalizeGEDCOMName( (ofCHAR_t*)RSTRING_PTR( text ), RSTRING_LEN( text ), buffer, gcMAXNAMESIZE );
+}
+
+
+static VALUE static_gedcom_name_normalize( VALUE self, VALUE text )
+{
+  ofCHAR_t normalized[ gcMAXNAMESIZE ];
+  int      length;
+
+  length = static_gedcom_name_normalize_into( text, normalized );
+
+  return rb_str_new( (char*)normalized, length );
+}
+
+
+static VALUE static_gedcom_name_soundex( VALUE self, VALUE text )
+{
+  ofCHAR_t normalized[ gcMAXNAMESIZE ];
+  ofCHAR_t code[ gcSOUNDEXSIZE ];
+
+  static_gedcom_name_normalize_into( text, normalized );
+  soundexGEDCOMName( normalized, code );
+
+  return rb_str_new2( (char*)code );
+}
+
+
+static VALUE static_gedcom_name_dm_soundex( VALUE self, VALUE text )
+{
+  ofCHAR_t normalized[ gcMAXNAMESIZE ];
+  ofCHAR_t codes[ gcMAXDMCODES ][ gcDMSOUNDEXSIZE ];
+  VALUE    result;
+  int      count;
+  int      i;
+
+  static_gedcom_name_normalize_into( text, normalized );
+  count = dmSoundexGEDCOMName( normalized, codes, gcMAXDMCODES );
+
+  result = rb_ary_new2( count );
+  for( i = 0; i < count; i++ )
+    rb_ary_push( result, rb_str_new2( (char*)codes[ i ] ) );
+
+  return result;
+}
+
+
+static void static_gedcom_nameindex_free( void *ptr )
+{
+  freeNameIndex( (gedNAMEINDEX_t*)ptr );
+  xfree( ptr );
+}
+
+
+static size_t static_gedcom_nameindex_memsize( const void *ptr )
+{
+  return sizeof( gedNAMEINDEX_t ) + (size_t)getNameIndexMemory( (gedNAMEINDEX_t*)ptr );
+}
+
+
+static const rb_data_type_t static_gedcom_nameindex_type = {
+  "GEDCOM::NameIndex",
+  { 0, static_gedcom_nameindex_free, static_gedcom_nameindex_memsize, },
+  0, 0,
+  RUBY_TYPED_FREE_IMMEDIATELY | RUBY_TYPED_WB_PROTECTED
+};
+
+
+static VALUE static_gedcom_nameindex_new( VALUE klass )
+{
+  gedNAMEINDEX_t *index;
+  VALUE           new_index;
+
+  new_index = TypedData_Make_Struct( klass, gedNAMEINDEX_t, &static_gedcom_nameindex_type, index );
+  initNameIndex( index );
+
+  return new_index;
+}
+
+
+static VALUE static_gedcom_nameindex_add( VALUE self, VALUE id, VALUE value )
+{
+  gedNAMEINDEX_t *index;
+
+  TypedData_Get_Struct( self, gedNAMEINDEX_t, &static_gedcom_nameindex_type, index );
+
+  if( addName( index, NUM2UINT( id ), (ofCHAR_t*)StringValueCStr( value ) ) != 0 )
+    rb_raise( rb_eNoMemError, "failed to grow name index" );
+
+  return self;
+}
+
+
+/* looks up each of the 'count' keys and returns the union of their ids */
+
+static VALUE static_gedcom_nameindex_find( VALUE self, int kind, ofCHAR_t *keys, int key_size, int count, int prefix )
+{
+  gedNAMEINDEX_t *index;
+  gedIDLIST_t     result;
+  VALUE           ids;
+  int             i;
+  int             rc;
+
+  TypedData_Get_Struct( self, gedNAMEINDEX_t, &static_gedcom_nameindex_type, index );
+
+  initIdList( &result );
+
+  for( i = 0, rc = 0; i < count && rc == 0; i++ )
+    rc = findNames( index, kind, keys + i * key_size, prefix, &result );
+
+  if( count > 1 )
+    uniqueIdList( &result );
+
+  ids = static_gedcom_idlist_to_a( &result );
+  freeIdList( &result );
+
+  if( rc != 0 )
+    rb_raise( rb_eNoMemError, "failed to search name index" );
+
+  return ids;
+}
+
+
+static VALUE static_gedcom_nameindex_surname( VALUE self, VALUE prefix )
+{
+  ofCHAR_t normalized[ gcMAXNAMESIZE ];
+
+  static_gedcom_name_normalize_into( prefix, normalized );
+
+  return static_gedcom_nameindex_find( self, gnkSURNAME, normalized, 0, 1, 1 );
+}
+
+
+static VALUE static_gedcom_nameindex_given( VALUE self, VALUE prefix )
+{
+  ofCHAR_t normalized[ gcMAXNAMESIZE ];
+
+  static_gedcom_name_normalize_into( prefix, normalized );
+
+  return static_gedcom_nameindex_find( self, gnkGIVEN, normalized, 0, 1, 1 );
+}
+
+
+static VALUE static_gedcom_nameindex_soundex( VALUE self, VALUE name )
+{
+  ofCHAR_t normalized[ gcMAXNAMESIZE ];
+  ofCHAR_t code[ gcSOUNDEXSIZE ];
+
+  static_gedcom_name_normalize_into( name, normalized );
+  soundexGEDCOMName( normalized, code );
+
+  if( code[ 0 ] == '\0' )
+    return rb_ary_new();
+
+  return static_gedcom_nameindex_find( self, gnkSOUNDEX, code, 0, 1, 0 );
+}
+
+
+static VALUE static_gedcom_nameindex_dm_soundex( VALUE self, VALUE name )
+{
+  ofCHAR_t normalized[ gcMAXNAMESIZE ];
+  ofCHAR_t codes[ gcMAXDMCODES ][ gcDMSOUNDEXSIZE ];
+  int      count;
+
+  static_gedcom_name_normalize_into( name, normalized );
+  count = dmSoundexGEDCOMName( normalized, codes, gcMAXDMCODES );
+
+  return static_gedcom_nameindex_find( self, gnkDMSOUNDEX, codes[ 0 ], gcDMSOUNDEXSIZE, count, 0 );
+}
+
+
+static VALUE static_gedcom_nameindex_remove( VALUE self, VALUE ids )
+{
+  gedNAMEINDEX_t *index;
+  gedIDLIST_t     removed;
+
+  TypedData_Get_Struct( self, gedNAMEINDEX_t, &static_gedcom_nameindex_type, index );
+
+  static_gedcom_a_to_idlist( ids, &removed );
+  removeNames( index, &removed );
+  freeIdList( &removed );
+
+  return self;
+}
+
+
+/* the set with a flag that is set while candidates sorts and scores it
+ * without the GVL, when other threads must keep their hands off it */
+
+typedef struct {
+  gedDEDUPESET_t set;
+  int            busy;
+} static_gedcom_dedupe_t;
+
+
+static void static_gedcom_dedupe_free( void *ptr )
+{
+  freeDedupeSet( &( (static_gedcom_dedupe_t*)ptr )->set );
+  xfree( ptr );
+}
+
+
+static size_t static_gedcom_dedupe_memsize( const void *ptr )
+{
+  return sizeof( static_gedcom_dedupe_t ) +
+         (size_t)getDedupeSetMemory( &( (static_gedcom_dedupe_t*)ptr )->set );
+}
+
+
+static const rb_data_type_t static_gedcom_dedupe_type = {
+  "GEDCOM::DuplicateFinder",
+  { 0, static_gedcom_dedupe_free, static_gedcom_dedupe_memsize, },
+  0, 0,
+  RUBY_TYPED_FREE_IMMEDIATELY | RUBY_TYPED_WB_PROTECTED
+};
+
+
+static static_gedcom_dedupe_t* static_gedcom_dedupe_get( VALUE self )
+{
+  static_gedcom_dedupe_t *finder;
+
+  TypedData_Get_Struct( self, static_gedcom_dedupe_t, &static_gedcom_dedupe_type, finder );
+  if( finder->busy )
+    rb_raise( rb_eRuntimeError, "duplicate finder used while it searches" );
+
+  return finder;
+}
+
+
+static VALUE static_gedcom_dedupe_new( VALUE klass )
+{
+  static_gedcom_dedupe_t *finder;
+  VALUE                   new_finder;
+
+  new_finder = TypedData_Make_Struct( klass, static_gedcom_dedupe_t, &static_gedcom_dedupe_type, finder );
+  initDedupeSet( &finder->set );
+
+  return new_finder;
+}
+
+
+static VALUE static_gedcom_dedupe_add( int argc, VALUE *argv, VALUE self )
+{
+  gedDEDUPESET_t *set;
+  gedDATEVALUE_t  parsed_birth;
+  gedDATEVALUE_t  parsed_death;
+  ofCHAR_t       *relatives[ gcMAXRELATIVES ];
+  VALUE           id;
+  VALUE           name;
+  VALUE           sex;
+  VALUE           birth;
+  VALUE           death;
+  VALUE           family;
+  int             count;
+  int             rc;
+
+  rb_scan_args( argc, argv, "24", &id, &name, &sex, &birth, &death, &family );
+
+  set = &static_gedcom_dedupe_get( self )->set;
+
+  count = 0;
+  if( !NIL_P( family ) )
+  {
+    Check_Type( family, T_ARRAY );
+    for( ; count < RARRAY_LEN( family ) && count < gcMAXRELATIVES; count++ )
+      relatives[ count ] = (ofCHAR_t*)StringValueCStr( RARRAY_PTR( family )[ count ] );
+  }
+
+  rc = addDedupePerson( set, NUM2UINT( id ), (ofCHAR_t*)StringValueCStr( name ),
+                        NIL_P( sex ) ? 0 : (ofCHAR_t*)StringValueCStr( sex ),
+                        static_gedcom_date_value( birth, &parsed_birth ),
+                        static_gedcom_date_value( death, &parsed_death ),
+                        relatives, count );
+
+  if( rc < 0 )
+    rb_raise( rb_eNoMemError, "failed to grow duplicate finder" );
+
+  return ( rc > 0 ? Qtrue : Qfalse );
+}
+
+
+typedef struct {
+  static_gedcom_dedupe_t *finder;
+  gedDEDUPESEARCH_t       search;
+  int                     min_score;
+  int                     threads;
+  int                     started;
+  gedDEDUPEPAIR_t        *pairs;
+  ofUI32_t                count;
+  int                     rc;
+} static_gedcom_dedupe_args_t;
+
+
+/* the first round sorts the set, the others score gcDEDUPEROUND people */
+
+static void* static_gedcom_dedupe_round( void *data )
+{
+  static_gedcom_dedupe_args_t *args = (static_gedcom_dedupe_args_t*)data;
+
+  if( args->started )
+    args->rc = runDuplicateRound( &args->search );
+  else
+  {
+    startDuplicateSearch( &args->search, &args->finder->set, args->min_score, args->threads );
+    args->started = 1;
+    args->rc = 1;
+  }
+
+  return 0;
+}
+
+
+static VALUE static_gedcom_dedupe_run( VALUE data )
+{
+  static_gedcom_dedupe_args_t *args = (static_gedcom_dedupe_args_t*)data;
+  VALUE                        result;
+  ofUI32_t                     i;
+
+  do
+  {
+#ifdef HAVE_RB_THREAD_CALL_WITHOUT_GVL
+    rb_thread_call_without_gvl( static_gedcom_dedupe_round, args, RUBY_UBF_IO, 0 );
+#else
+    static_gedcom_dedupe_round( args );
+#endif
+    if( args->rc > 0 )
+      rb_thread_check_ints();
+  } while( args->rc > 0 );
+
+  if( args->rc == 0 )
+    args->rc = finishDuplicateSearch( &args->search, &args->pairs, &args->count );
+
+  if( args->rc != 0 )
+    rb_raise( rb_eNoMemError, "failed to score duplicate candidates" );
+
+  result = rb_ary_new2( args->count );
+  for( i = 0; i < args->count; i++ )
+    rb_ary_push( result, rb_ary_new3( 3, UINT2NUM( args->pairs[ i ].id1 ),
+                                         UINT2NUM( args->pairs[ i ].id2 ),
+                                         INT2FIX( args->pairs[ i ].score ) ) );
+
+  return result;
+}
+
+
+static VALUE static_gedcom_dedupe_close( VALUE data )
+{
+  static_gedcom_dedupe_args_t *args = (static_gedcom_dedupe_args_t*)data;
+
+  if( args->started )
+    closeDuplicateSearch( &args->search );
+  free( args->pairs );
+  args->finder->busy = 0;
+
+  return Qnil;
+}
+
+
+/* the search runs in rounds without the interpreter lock, so other ruby
+ * threads keep going while the workers score the blocks and interrupts
+ * are seen between rounds.  The finder is busy until it is done. */
+
+static VALUE static_gedcom_dedupe_candidates( int argc, VALUE *argv, VALUE self )
+{
+  static_gedcom_dedupe_args_t args;
+  VALUE                       min_score;
+  VALUE                       threads;
+
+  rb_scan_args( argc, argv, "02", &min_score, &threads );
+
+  args.finder = static_gedcom_dedupe_get( self );
+  args.min_score = NIL_P( min_score ) ? gcDEDUPEMINSCORE : NUM2INT( min_score );
+  args.threads = NIL_P( threads ) ? 1 : NUM2INT( threads );
+  args.started = 0;
+  args.pairs = 0;
+  args.count = 0;
+  args.rc = 0;
+
+  args.finder->busy = 1;
+
+  return rb_ensure( static_gedcom_dedupe_run, (VALUE)&args, static_gedcom_dedupe_close, (VALUE)&args );
+}
+
+
+static VALUE static_gedcom_dedupe_size( VALUE self )
+{
+  return UINT2NUM( static_gedcom_dedupe_get( self )->set.count );
+}
+
+
+typedef struct {
+  gedWRITER_t writer;
+  VALUE       io;
+  int         closed;
+} static_gedcom_writer_t;
+
+
+/* the engine keeps a pointer to the struct as its write context, so the
+ * writer is never embedded; only the io it writes to can move */
+
+static void static_gedcom_writer_mark( void *ptr )
+{
+  static_gedcom_writer_t *writer = (static_gedcom_writer_t*)ptr;
+
+#ifdef HAVE_RB_GC_MARK_MOVABLE
+  rb_gc_mark_movable( writer->io );
+#else
+  rb_gc_mark( writer->io );
+#endif
+}
+
+
+static void static_gedcom_writer_free( void *ptr )
+{
+  static_gedcom_writer_t *writer = (static_gedcom_writer_t*)ptr;
+
+  freeWriter( &writer->writer );
+  xfree( writer );
+}
+
+
+static size_t static_gedcom_writer_memsize( const void *ptr )
+{
+  static_gedcom_writer_t *writer = (static_gedcom_writer_t*)ptr;
+
+  return sizeof( static_gedcom_writer_t ) + (size_t)getWriterMemory( &writer->writer );
+}
+
+
+#ifdef HAVE_RB_GC_MARK_MOVABLE
+static void static_gedcom_writer_compact( void *ptr )
+{
+  static_gedcom_writer_t *writer = (static_gedcom_writer_t*)ptr;
+
+  writer->io = rb_gc_location( writer->io );
+}
+#endif
+
+
+static const rb_data_type_t static_gedcom_writer_type = {
+  "GEDCOM::Writer",
+  { static_gedcom_writer_mark, static_gedcom_writer_free, static_gedcom_writer_memsize,
+#ifdef HAVE_RB_GC_MARK_MOVABLE
+    static_gedcom_writer_compact,
+#endif
+  },
+  0, 0,
+  RUBY_TYPED_FREE_IMMEDIATELY | RUBY_TYPED_WB_PROTECTED
+};
+
+
+/* hands a full buffer to the io's write method */
+
+static int static_gedcom_writer_write( void *context, ofCHAR_t *data, ofUI32_t length )
+{
+  static_gedcom_writer_t *writer = (static_gedcom_writer_t*)context;
+
+  rb_funcall( writer->io, rb_intern( "write" ), 1, rb_str_new( (char*)data, length ) );
+
+  return 0;
+}
+
+
+static static_gedcom_writer_t* static_gedcom_writer_get( VALUE self )
+{
+  static_gedcom_writer_t *writer;
+
+  TypedData_Get_Struct( self, static_gedcom_writer_t, &static_gedcom_writer_type, writer );
+
+  if( writer->closed )
+    rb_raise( rb_eIOError, "closed writer" );
+
+  return writer;
+}
+
+
+static VALUE static_gedcom_writer_new( int argc, VALUE *argv, VALUE klass )
+{
+  static_gedcom_writer_t *writer;
+  VALUE                   new_writer;
+  VALUE                   io;
+  VALUE                   line_limit;
+
+  rb_scan_args( argc, argv, "11", &io, &line_limit );
+
+  new_writer = TypedData_Make_Struct( klass, static_gedcom_writer_t, &static_gedcom_writer_type, writer );
+  RB_OBJ_WRITE( new_writer, &writer->io, io );
+
+  if( initWriter( &writer->writer, NIL_P( line_limit ) ? gcMAXLINELENGTH : NUM2INT( line_limit ),
+                  static_gedcom_writer_write, writer ) != 0 )
+    rb_raise( rb_eNoMemError, "failed to allocate writer buffer" );
+
+  return new_writer;
+}
+
+
+static VALUE static_gedcom_writer_line( int argc, VALUE *argv, VALUE self )
+{
+  static_gedcom_writer_t *writer;
+  VALUE                   level;
+  VALUE                   tag;
+  VALUE                   value;
+  VALUE                   xref;
+
+  rb_scan_args( argc, argv, "22", &level, &tag, &value, &xref );
+
+  writer = static_gedcom_writer_get( self );
+
+  if( !NIL_P( value ) )
+    StringValue( value );
+
+  if( writeGEDCOMLine( &writer->writer, NUM2INT( level ),
+                       NIL_P( xref ) ? 0 : (ofCHAR_t*)StringValueCStr( xref ),
+                       (ofCHAR_t*)StringValueCStr( tag ),
+                       NIL_P( value ) ? 0 : (ofCHAR_t*)RSTRING_PTR( value ),
+                       NIL_P( value ) ? 0 : RSTRING_LEN( value ) ) != 0 )
+    rb_raise( rb_eNoMemError, "failed to grow writer buffer" );
+
+  return self;
+}
+
+
+/* writes a GEDCOM::Date in the GEDCOM date grammar; DATE text is written
+ * as it is given */
+
+static VALUE static_gedcom_writer_date( int argc, VALUE *argv, VALUE self )
+{
+  static_gedcom_writer_t *writer;
+  gedDATEVALUE_t          parsed_date;
+  VALUE                   level;
+  VALUE                   date;
+  VALUE                   tag;
+  int                     rc;
+
+  rb_scan_args( argc, argv, "21", &level, &date, &tag );
+
+  writer = static_gedcom_writer_get( self );
+
+  if( NIL_P( date ) )
+    return self;
+
+  if( NIL_P( tag ) )
+    tag = rb_str_new2( "DATE" );
+
+  if( rb_obj_is_kind_of( date, cDate ) )
+  {
+    static_gedcom_date_value( date, &parsed_date );
+    rc = writeGEDCOMDate( &writer->writer, NUM2INT( level ), (ofCHAR_t*)StringValueCStr( tag ), &parsed_date );
+  }
+  else
+  {
+    StringValue( date );
+    rc = writeGEDCOMLine( &writer->writer, NUM2INT( level ), 0, (ofCHAR_t*)StringValueCStr( tag ),
+                          (ofCHAR_t*)RSTRING_PTR( date ), RSTRING_LEN( date ) );
+  }
+
+  if( rc != 0 )
+    rb_raise( rb_eNoMemError, "failed to grow writer buffer" );
+
+  return self;
+}
+
+
+static VALUE static_gedcom_writer_flush( VALUE self )
+{
+  flushWriter( &static_gedcom_writer_get( self )->writer );
+
+  return self;
+}
+
+
+static VALUE static_gedcom_writer_close( VALUE self )
+{
+  static_gedcom_writer_t *writer;
+
+  writer = static_gedcom_writer_get( self );
+
+  flushWriter( &writer->writer );
+  freeWriter( &writer->writer );
+  writer->closed = 1;
+
+  return Qnil;
+}
+
+
+static VALUE static_gedcom_writer_lines( VALUE self )
+{
+  static_gedcom_writer_t *writer;
+
+  TypedData_Get_Struct( self, static_gedcom_writer_t, &static_gedcom_writer_type, writer );
+
+  return UINT2NUM( writer->writer.lines );
+}
+
+
+/* returns [ xref, tag, offset, length, hash ] for each level 0 record of
+ * 'text', with a nil xref for records that have none */
+
+static VALUE static_gedcom_scan_records( VALUE self, VALUE text )
+{
+  gedRECORDLIST_t list;
+  gedRECORD_t    *record;
+  VALUE           records;
+  ofUI32_t        i;
+
+  StringValue( text );
+
+  initRecordList( &list );
+  if( scanGEDCOMRecords( (ofCHAR_t*)RSTRING_PTR( text ), RSTRING_LEN( text ), &list ) != 0 )
+  {
+    freeRecordList( &list );
+    rb_raise( rb_eNoMemError, "failed to scan records" );
+  }
+
+  records = rb_ary_new2( list.count );
+  for( i = 0; i < list.count; i++ )
+  {
+    record = &list.records[ i ];
+
+    rb_ary_push( records, rb_ary_new3( 5,
+      record->xrefLength > 0 ? static_gedcom_str_part( text, record->offset + record->xrefOffset, record->xrefLength ) : Qnil,
+      static_gedcom_str_part( text, record->offset + record->tagOffset, record->tagLength ),
+      ULL2NUM( record->offset ),
+      ULL2NUM( record->length ),
+      ULL2NUM( record->hash ) ) );
+  }
+
+  freeRecordList( &list );
+
+  return records;
+}
+
+
+typedef struct {
+  gedEXPORTER_t exporter;
+  VALUE         text;
+  VALUE         io;
+  int           threads;
+  ofUI32_t      first;
+  ofUI32_t      count;
+  int           rc;
+} static_gedcom_export_args_t;
+
+
+static void* static_gedcom_export_encode( void *data )
+{
+  static_gedcom_export_args_t *args = (static_gedcom_export_args_t*)data;
+
+  args->rc = encodeExportBatches( &args->exporter, args->first, args->count, args->threads );
+
+  return 0;
+}
+
+
+/* encodes a round of batches without the GVL, then hands them to the io in
+ * order with it */
+
+static VALUE static_gedcom_export_write( VALUE data )
+{
+  static_gedcom_export_args_t *args = (static_gedcom_export_args_t*)data;
+  gedEXPORTBUFFER_t           *batch;
+  ofUI32_t                     round;
+  ofUI32_t                     i;
+
+  if( initExporter( &args->exporter, (ofCHAR_t*)RSTRING_PTR( args->text ), RSTRING_LEN( args->text ),
+                    args->exporter.format ) != 0 )
+    rb_raise( rb_eNoMemError, "failed to scan records" );
+
+  round = args->threads * 4;
+  if( round > gcMAXEXPORTROUND )
+    round = gcMAXEXPORTROUND;
+
+  for( args->first = 0; args->first < args->exporter.batchCount; args->first += args->count )
+  {
+    args->count = args->exporter.batchCount - args->first;
+    if( args->count > round )
+      args->count = round;
+
+#ifdef HAVE_RB_THREAD_CALL_WITHOUT_GVL
+    rb_thread_call_without_gvl( static_gedcom_export_encode, args, RUBY_UBF_IO, 0 );
+#else
+    static_gedcom_export_encode( args );
+#endif
+
+    if( args->rc != 0 )
+      rb_raise( rb_eNoMemError, "failed to encode export batch" );
+
+    for( i = 0; i < args->count; i++ )
+    {
+      batch = &args->exporter.batches[ i ];
+      if( batch->length > 0 )
+        rb_funcall( args->io, rb_intern( "write" ), 1, rb_str_new( (char*)batch->data, batch->length ) );
+    }
+  }
+
+  return ULL2NUM( args->exporter.rows );
+}
+
+
+static VALUE static_gedcom_export_free( VALUE data )
+{
+  freeExporter( &( (static_gedcom_export_args_t*)data )->exporter );
+
+  return Qnil;
+}
+
+
+/* writes one row per event of each INDI record of 'text' to 'io', as CSV
+ * or in column batches, and returns the number of rows.  The text is
+ * frozen (or copied) first, since the batches are read without the GVL. */
+
+static VALUE static_gedcom_export_events( int argc, VALUE *argv, VALUE self )
+{
+  static_gedcom_export_args_t args;
+  VALUE                       text;
+  VALUE                       io;
+  VALUE                       format;
+  VALUE                       threads;
+  VALUE                       rows;
+
+  rb_scan_args( argc, argv, "22", &text, &io, &format, &threads );
+
+  memset( &args, 0, sizeof( args ) );
+
+  if( NIL_P( format ) || format == ID2SYM( rb_intern( "csv" ) ) )
+    args.exporter.format = gcEXPORTCSV;
+  else if( format == ID2SYM( rb_intern( "columns" ) ) )
+    args.exporter.format = gcEXPORTCOLUMNS;
+  else
+    rb_raise( rb_eArgError, "unknown export format (expected :csv or :columns)" );
+
+  StringValue( text );
+  args.text = rb_str_new_frozen( text );
+  args.io = io;
+  args.threads = NIL_P( threads ) ? 1 : NUM2INT( threads );
+  if( args.threads < 1 )
+    args.threads = 1;
+  if( args.threads > gcMAXEXPORTTHREADS )
+    args.threads = gcMAXEXPORTTHREADS;
+
+  rows = rb_ensure( static_gedcom_export_write, (VALUE)&args, static_gedcom_export_free, (VALUE)&args );
+
+  RB_GC_GUARD( args.text );
+
+  return rows;
+}
+
+
+static size_t static_gedcom_query_memsize( const void *ptr )
+{
+  return sizeof( gedQUERY_t );
+}
+
+
+static const rb_data_type_t static_gedcom_query_type = {
+  "GEDCOM::Query",
+  { 0, RUBY_TYPED_DEFAULT_FREE, static_gedcom_query_memsize, },
+  0, 0,
+  RUBY_TYPED_FREE_IMMEDIATELY | RUBY_TYPED_WB_PROTECTED | GEDCOM_TYPED_FROZEN_SHAREABLE
+};
+
+
+/* compiles 'source', raising ArgumentError where it stops making sense */
+
+static VALUE static_gedcom_query_new( VALUE klass, VALUE source )
+{
+  gedQUERY_t *query;
+  VALUE       new_query;
+  ofUI32_t    error;
+  char       *text;
+
+  new_query = TypedData_Make_Struct( klass, gedQUERY_t, &static_gedcom_query_type, query );
+
+  text = StringValueCStr( source );
+  if( compileQuery( (ofCHAR_t*)text, query, &error ) != 0 )
+    rb_raise( rb_eArgError, "bad query at '%s'", text + error );
+
+  return new_query;
+}
+
+
+typedef struct {
+  gedQUERYRUN_t run;
+  VALUE         text;
+  VALUE         matches;   /* Qnil to yield them instead */
+  int           rc;
+} static_gedcom_query_args_t;
+
+
+static void* static_gedcom_query_match( void *data )
+{
+  static_gedcom_query_args_t *args = (static_gedcom_query_args_t*)data;
+
+  args->rc = runQuery( &args->run, gcQUERYBATCHSIZE );
+
+  return 0;
+}
+
+
+/* finds a batch of matches without the GVL, then hands them over with it,
+ * until the text runs out */
+
+static VALUE static_gedcom_query_loop( VALUE data )
+{
+  static_gedcom_query_args_t *args = (static_gedcom_query_args_t*)data;
+  gedQUERYMATCH_t            *match;
+  VALUE                       pair;
+  ofUI32_t                    i;
+
+  do
+  {
+#ifdef HAVE_RB_THREAD_CALL_WITHOUT_GVL
+    rb_thread_call_without_gvl( static_gedcom_query_match, args, RUBY_UBF_IO, 0 );
+#else
+    static_gedcom_query_match( args );
+#endif
+
+    if( args->rc < 0 )
+      rb_raise( rb_eNoMemError, "failed to run query" );
+
+    for( i = 0; i < args->run.count; i++ )
+    {
+      match = &args->run.matches[ i ];
+      pair = rb_ary_new3( 2,
+        match->xrefLength > 0 ? static_gedcom_str_part( args->text, match->xrefOffset, match->xrefLength ) : Qnil,
+        static_gedcom_str_part( args->text, match->valueOffset, match->valueLength ) );
+
+      if( NIL_P( args->matches ) )
+        rb_yield( pair );
+      else
+        rb_ary_push( args->matches, pair );
+    }
+  } while( args->rc > 0 );
+
+  return Qnil;
+}
+
+
+static VALUE static_gedcom_query_free( VALUE data )
+{
+  freeQueryRun( &( (static_gedcom_query_args_t*)data )->run );
+
+  return Qnil;
+}
+
+
+/* runs the query over 'text', frozen (or copied) first since it is read
+ * without the GVL */
+
+static void static_gedcom_query_exec( VALUE self, VALUE text, VALUE matches )
+{
+  static_gedcom_query_args_t args;
+  gedQUERY_t                *query;
+
+  TypedData_Get_Struct( self, gedQUERY_t, &static_gedcom_query_type, query );
+
+  StringValue( text );
+  args.text = rb_str_new_frozen( text );
+  args.matches = matches;
+  args.rc = 0;
+  initQueryRun( &args.run, query, (ofCHAR_t*)RSTRING_PTR( args.text ), RSTRING_LEN( args.text ) );
+
+  rb_ensure( static_gedcom_query_loop, (VALUE)&args, static_gedcom_query_free, (VALUE)&args );
+
+  RB_GC_GUARD( args.text );
+}
+
+
+/* yields [ xref, value ] for each match in 'text', with a nil xref for
+ * records that have none */
+
+static VALUE static_gedcom_query_each( VALUE self, VALUE text )
+{
+  RETURN_ENUMERATOR( self, 1, &text );
+
+  static_gedcom_query_exec( self, text, Qnil );
+
+  return self;
+}
+
+
+static VALUE static_gedcom_query_run( VALUE self, VALUE text )
+{
+  VALUE matches;
+
+  matches = rb_ary_new();
+  static_gedcom_query_exec( self, text, matches );
+
+  return matches;
+}
+
+
+static void static_gedcom_reader_free( void *ptr )
+{
+  closeRecordReader( (gedRECORDREADER_t*)ptr );
+  xfree( ptr );
+}
+
+
+static size_t static_gedcom_reader_memsize( const void *ptr )
+{
+  return sizeof( gedRECORDREADER_t ) + (size_t)getRecordReaderMemory( (gedRECORDREADER_t*)ptr );
+}
+
+
+static const rb_data_type_t static_gedcom_reader_type = {
+  "GEDCOM::RecordReader",
+  { 0, static_gedcom_reader_free, static_gedcom_reader_memsize, },
+  0, 0,
+  RUBY_TYPED_FREE_IMMEDIATELY | RUBY_TYPED_WB_PROTECTED
+};
+
+
+/* a record is a node of the reader's current record, good for as long as
+ * the reader has not moved on */
+
+typedef struct {
+  VALUE    reader;
+  ofUI32_t node;
+  ofUI64_t generation;
+} static_gedcom_record_t;
+
+
+static void static_gedcom_record_mark( void *ptr )
+{
+  static_gedcom_record_t *record = (static_gedcom_record_t*)ptr;
+
+#ifdef HAVE_RB_GC_MARK_MOVABLE
+  rb_gc_mark_movable( record->reader );
+#else
+  rb_gc_mark( record->reader );
+#endif
+}
+
+
+#ifdef HAVE_RB_GC_MARK_MOVABLE
+static void static_gedcom_record_compact( void *ptr )
+{
+  static_gedcom_record_t *record = (static_gedcom_record_t*)ptr;
+
+  record->reader = rb_gc_location( record->reader );
+}
+#endif
+
+
+static size_t static_gedcom_record_memsize( const void *ptr )
+{
+#ifdef HAVE_CONST_RUBY_TYPED_EMBEDDABLE
+  return 0;
+#else
+  return sizeof( static_gedcom_record_t );
+#endif
+}
+
+
+static const rb_data_type_t static_gedcom_record_type = {
+  "GEDCOM::Record",
+  { static_gedcom_record_mark, RUBY_TYPED_DEFAULT_FREE, static_gedcom_record_memsize,
+#ifdef HAVE_RB_GC_MARK_MOVABLE
+    static_gedcom_record_compact,
+#endif
+  },
+  0, 0,
+  RUBY_TYPED_FREE_IMMEDIATELY | RUBY_TYPED_WB_PROTECTED | GEDCOM_TYPED_EMBEDDABLE
+};
+
+
+static VALUE static_gedcom_record_wrap( VALUE reader, ofUI32_t node )
+{
+  static_gedcom_record_t *record;
+  gedRECORDREADER_t      *records;
+  VALUE                   new_record;
+
+  TypedData_Get_Struct( reader, gedRECORDREADER_t, &static_gedcom_reader_type, records );
+
+  new_record = TypedData_Make_Struct( cRecord, static_gedcom_record_t, &static_gedcom_record_type, record );
+  RB_OBJ_WRITE( new_record, &record->reader, reader );
+  record->node = node;
+  record->generation = records->generation;
+
+  return new_record;
+}
+
+
+/* returns the node 'self' stands for, raising if its record is gone */
+
+static gedNODE_t* static_gedcom_record_node( VALUE self, gedRECORDREADER_t **reader )
+{
+  static_gedcom_record_t *record;
+
+  TypedData_Get_Struct( self, static_gedcom_record_t, &static_gedcom_record_type, record );
+  TypedData_Get_Struct( record->reader, gedRECORDREADER_t, &static_gedcom_reader_type, *reader );
+
+  if( record->generation != (*reader)->generation )
+    rb_raise( rb_eRuntimeError, "record used outside its each_record block" );
+
+  return &(*reader)->nodes[ record->node ];
+}
+
+
+static VALUE static_gedcom_record_str( gedRECORDREADER_t *reader, ofUI32_t offset, ofUI32_t length )
+{
+  char *text = (char*)reader->buffer + reader->start + offset;
+
+#ifdef HAVE_RUBY_ENCODING_H
+  return rb_enc_str_new( text, length, rb_default_external_encoding() );
+#else
+  return rb_str_new( text, length );
+#endif
+}
+
+
+static VALUE static_gedcom_record_level( VALUE self )
+{
+  gedRECORDREADER_t *reader;
+
+  return UINT2NUM( static_gedcom_record_node( self, &reader )->level );
+}
+
+
+static VALUE static_gedcom_record_xref( VALUE self )
+{
+  gedRECORDREADER_t *reader;
+  gedNODE_t         *node;
+
+  node = static_gedcom_record_node( self, &reader );
+  if( node->xrefLength == 0 )
+    return Qnil;
+
+  return static_gedcom_record_str( reader, node->xrefOffset, node->xrefLength );
+}
+
+
+static VALUE static_gedcom_record_tag( VALUE self )
+{
+  gedRECORDREADER_t *reader;
+  gedNODE_t         *node;
+
+  node = static_gedcom_record_node( self, &reader );
+
+  return static_gedcom_record_str( reader, node->tagOffset, node->tagLength );
+}
+
+
+static VALUE static_gedcom_record_value( VALUE self )
+{
+  gedRECORDREADER_t *reader;
+  gedNODE_t         *node;
+
+  node = static_gedcom_record_node( self, &reader );
+
+  return static_gedcom_record_str( reader, node->valueOffset, node->valueLength );
+}
+
+
+static VALUE static_gedcom_record_children( VALUE self )
+{
+  static_gedcom_record_t *record;
+  gedRECORDREADER_t      *reader;
+  VALUE                   children;
+  ofUI32_t                child;
+
+  child = static_gedcom_record_node( self, &reader )->firstChild;
+  TypedData_Get_Struct( self, static_gedcom_record_t, &static_gedcom_record_type, record );
+
+  children = rb_ary_new();
+  for( ; child != gcNONODE; child = reader->nodes[ child ].next )
+    rb_ary_push( children, static_gedcom_record_wrap( record->reader, child ) );
+
+  return children;
+}
+
+
+static VALUE static_gedcom_record_each( VALUE self )
+{
+  RETURN_ENUMERATOR( self, 0, 0 );
+
+  rb_ary_each( static_gedcom_record_children( self ) );
+
+  return self;
+}
+
+
+/* the first child tagged 'tag', or nil */
+
+static VALUE static_gedcom_record_child( VALUE self, VALUE tag )
+{
+  static_gedcom_record_t *record;
+  gedRECORDREADER_t      *reader;
+  gedNODE_t              *node;
+  ofUI32_t                child;
+
+  StringValue( tag );
+  child = static_gedcom_record_node( self, &reader )->firstChild;
+  TypedData_Get_Struct( self, static_gedcom_record_t, &static_gedcom_record_type, record );
+
+  for( ; child != gcNONODE; child = node->next )
+  {
+    node = &reader->nodes[ child ];
+    if( node->tagLength == RSTRING_LEN( tag ) &&
+        memcmp( reader->buffer + reader->start + node->tagOffset, RSTRING_PTR( tag ), node->tagLength ) == 0 )
+      return static_gedcom_record_wrap( record->reader, child );
+  }
+
+  return Qnil;
+}
+
+
+/* the lines of the record and everything under it, as they were read */
+
+static VALUE static_gedcom_record_to_s( VALUE self )
+{
+  gedRECORDREADER_t *reader;
+  gedNODE_t         *node;
+
+  node = static_gedcom_record_node( self, &reader );
+
+  return static_gedcom_record_str( reader, node->offset, node->end - node->offset );
+}
+
+
+typedef struct {
+  VALUE path;
+  VALUE reader;
+} static_gedcom_each_record_args_t;
+
+
+static VALUE static_gedcom_each_record_loop( VALUE data )
+{
+  static_gedcom_each_record_args_t *args = (static_gedcom_each_record_args_t*)data;
+  gedRECORDREADER_t                *reader;
+  int                               rc;
+
+  TypedData_Get_Struct( args->reader, gedRECORDREADER_t, &static_gedcom_reader_type, reader );
+
+  while( ( rc = readGEDCOMRecord( reader ) ) > 0 )
+    rb_yield( static_gedcom_record_wrap( args->reader, 0 ) );
+
+  if( rc == -1 )
+    rb_raise( rb_eNoMemError, "failed to read record" );
+  else if( rc < 0 )
+    rb_sys_fail_str( args->path );
+
+  return ULL2NUM( reader->records );
+}
+
+
+static VALUE static_gedcom_each_record_close( VALUE data )
+{
+  static_gedcom_each_record_args_t *args = (static_gedcom_each_record_args_t*)data;
+  gedRECORDREADER_t                *reader;
+
+  TypedData_Get_Struct( args->reader, gedRECORDREADER_t, &static_gedcom_reader_type, reader );
+  closeRecordReader( reader );
+
+  return Qnil;
+}
+
+
+/* yields each level 0 record of the file at 'path' as a GEDCOM::Record
+ * tree, and returns the number of records.  The records share one reader
+ * whose buffer and nodes are reused for the next record once the block
+ * returns, so a record cannot be kept beyond it. */
+
+static VALUE static_gedcom_each_record( VALUE self, VALUE path )
+{
+  static_gedcom_each_record_args_t args;
+  gedRECORDREADER_t               *reader;
+
+  rb_need_block();
+  FilePathValue( path );
+
+  args.path = path;
+  args.reader = TypedData_Make_Struct( 0, gedRECORDREADER_t, &static_gedcom_reader_type, reader );
+
+  if( openRecordReader( reader, StringValueCStr( path ) ) != 0 )
+    rb_sys_fail_str( path );
+
+  return rb_ensure( static_gedcom_each_record_loop, (VALUE)&args, static_gedcom_each_record_close, (VALUE)&args );
+}
+
+
+/* the batch each_event_batch yields: the pipeline batch it stands for
+ * while the block runs, 0 before and after */
+
+typedef struct {
+  gedPIPEBATCH_t *batch;
+} static_gedcom_eventbatch_t;
+
+
+static size_t static_gedcom_eventbatch_memsize( const void *ptr )
+{
+#ifdef HAVE_CONST_RUBY_TYPED_EMBEDDABLE
+  return 0;
+#else
+  return sizeof( static_gedcom_eventbatch_t );
+#endif
+}
+
+
+static const rb_data_type_t static_gedcom_eventbatch_type = {
+  "GEDCOM::EventBatch",
+  { 0, RUBY_TYPED_DEFAULT_FREE, static_gedcom_eventbatch_memsize, },
+  0, 0,
+  RUBY_TYPED_FREE_IMMEDIATELY | RUBY_TYPED_WB_PROTECTED | GEDCOM_TYPED_EMBEDDABLE
+};
+
+
+typedef struct {
+  gedPIPELINE_t   pipeline;
+  gedPIPEBATCH_t *batch;
+  VALUE           path;
+  VALUE           events;    /* the EventBatch to yield, or nil to yield each event */
+  int             rc;
+} static_gedcom_each_event_args_t;
+
+
+static void* static_gedcom_each_event_wait( void *data )
+{
+  static_gedcom_each_event_args_t *args = (static_gedcom_each_event_args_t*)data;
+
+  args->rc = nextPipelineBatch( &args->pipeline, &args->batch, 1 );
+
+  return 0;
+}
+
+
+static void static_gedcom_each_event_ubf( void *data )
+{
+  interruptPipeline( &( (static_gedcom_each_event_args_t*)data )->pipeline );
+}
+
+
+static VALUE static_gedcom_event_str( gedPIPEBATCH_t *batch, ofUI32_t offset, ofUI32_t length )
+{
+  if( length == gcNOFIELD )
+    return Qnil;
+
+#ifdef HAVE_RUBY_ENCODING_H
+  return rb_enc_str_new( (char*)batch->text + offset, length, rb_default_external_encoding() );
+#else
+  return rb_str_new( (char*)batch->text + offset, length );
+#endif
+}
+
+
+/* returns the pipeline batch 'self' stands for, raising outside its block */
+
+static gedPIPEBATCH_t* static_gedcom_eventbatch_get( VALUE self )
+{
+  static_gedcom_eventbatch_t *events;
+
+  TypedData_Get_Struct( self, static_gedcom_eventbatch_t, &static_gedcom_eventbatch_type, events );
+
+  if( events->batch == 0 )
+    rb_raise( rb_eRuntimeError, "event batch used outside its each_event_batch block" );
+
+  return events->batch;
+}
+
+
+/* the event at 'index' (negative ones count from the end), or 0 */
+
+static gedPIPEEVENT_t* static_gedcom_eventbatch_event( VALUE self, VALUE index, gedPIPEBATCH_t **batch )
+{
+  long i;
+
+  *batch = static_gedcom_eventbatch_get( self );
+  i = NUM2LONG( index );
+  if( i < 0 )
+    i += (long)(*batch)->count;
+
+  if( i < 0 || i >= (long)(*batch)->count )
+    return 0;
+
+  return &(*batch)->events[ i ];
+}
+
+
+static VALUE static_gedcom_eventbatch_length( VALUE self )
+{
+  return UINT2NUM( static_gedcom_eventbatch_get( self )->count );
+}
+
+
+static VALUE static_gedcom_eventbatch_level( VALUE self, VALUE index )
+{
+  gedPIPEBATCH_t *batch;
+  gedPIPEEVENT_t *event;
+
+  event = static_gedcom_eventbatch_event( self, index, &batch );
+
+  return event ? LONG2NUM( event->level ) : Qnil;
+}
+
+
+static VALUE static_gedcom_eventbatch_tag( VALUE self, VALUE index )
+{
+  gedPIPEBATCH_t *batch;
+  gedPIPEEVENT_t *event;
+
+  event = static_gedcom_eventbatch_event( self, index, &batch );
+
+  return event ? static_gedcom_event_str( batch, event->tagOffset, event->tagLength ) : Qnil;
+}
+
+
+static VALUE static_gedcom_eventbatch_value( VALUE self, VALUE index )
+{
+  gedPIPEBATCH_t *batch;
+  gedPIPEEVENT_t *event;
+
+  event = static_gedcom_eventbatch_event( self, index, &batch );
+
+  return event ? static_gedcom_event_str( batch, event->dataOffset, event->dataLength ) : Qnil;
+}
+
+
+static VALUE static_gedcom_eventbatch_levels( VALUE self )
+{
+  gedPIPEBATCH_t *batch;
+  VALUE           levels;
+  ofUI32_t        i;
+
+  batch = static_gedcom_eventbatch_get( self );
+  levels = rb_ary_new_capa( batch->count );
+  for( i = 0; i < batch->count; i++ )
+    rb_ary_push( levels, LONG2NUM( batch->events[ i ].level ) );
+
+  return levels;
+}
+
+
+static VALUE static_gedcom_eventbatch_tags( VALUE self )
+{
+  gedPIPEBATCH_t *batch;
+  VALUE           tags;
+  ofUI32_t        i;
+
+  batch = static_gedcom_eventbatch_get( self );
+  tags = rb_ary_new_capa( batch->count );
+  for( i = 0; i < batch->count; i++ )
+    rb_ary_push( tags, static_gedcom_event_str( batch, batch->events[ i ].tagOffset, batch->events[ i ].tagLength ) );
+
+  return tags;
+}
+
+
+static VALUE static_gedcom_eventbatch_values( VALUE self )
+{
+  gedPIPEBATCH_t *batch;
+  VALUE           values;
+  ofUI32_t        i;
+
+  batch = static_gedcom_eventbatch_get( self );
+  values = rb_ary_new_capa( batch->count );
+  for( i = 0; i < batch->count; i++ )
+    rb_ary_push( values, static_gedcom_event_str( batch, batch->events[ i ].dataOffset, batch->events[ i ].dataLength ) );
+
+  return values;
+}
+
+
+static void static_gedcom_yield_events( gedPIPEBATCH_t *batch )
+{
+  gedPIPEEVENT_t *event;
+  ofUI32_t        i;
+
+  for( i = 0; i < batch->count; i++ )
+  {
+    event = &batch->events[ i ];
+    gedPROBE3( event__dispatch, event->level, batch->text + event->tagOffset, event->tagLength );
+    rb_yield_values( 3, LONG2NUM( event->level ),
+                     static_gedcom_event_str( batch, event->tagOffset, event->tagLength ),
+                     static_gedcom_event_str( batch, event->dataOffset, event->dataLength ) );
+  }
+}
+
+
+static VALUE static_gedcom_eventbatch_each( VALUE self )
+{
+  RETURN_ENUMERATOR( self, 0, 0 );
+
+  static_gedcom_yield_events( static_gedcom_eventbatch_get( self ) );
+
+  return self;
+}
+
+
+static void static_gedcom_eventbatch_set( VALUE self, gedPIPEBATCH_t *batch )
+{
+  static_gedcom_eventbatch_t *events;
+
+  TypedData_Get_Struct( self, static_gedcom_eventbatch_t, &static_gedcom_eventbatch_type, events );
+  events->batch = batch;
+}
+
+
+/* yields the events of each batch the reader thread has filled (or the
+ * batch as an EventBatch), and only lets go of the GVL to wait when it has
+ * not filled one yet */
+
+static VALUE static_gedcom_each_event_loop( VALUE data )
+{
+  static_gedcom_each_event_args_t *args = (static_gedcom_each_event_args_t*)data;
+
+  for( ;; )
+  {
+    args->rc = nextPipelineBatch( &args->pipeline, &args->batch, 0 );
+    while( args->rc == 2 )
+    {
+#ifdef HAVE_RB_THREAD_CALL_WITHOUT_GVL
+      rb_thread_call_without_gvl( static_gedcom_each_event_wait, args, static_gedcom_each_event_ubf, args );
+#else
+      static_gedcom_each_event_wait( args );
+#endif
+      if( args->rc == 2 )
+        rb_thread_check_ints();
+    }
+
+    if( args->rc <= 0 )
+      break;
+
+    gedPROBE1( batch__start, args->batch->count );
+    if( NIL_P( args->events ) )
+      static_gedcom_yield_events( args->batch );
+    else
+    {
+      static_gedcom_eventbatch_set( args->events, args->batch );
+      rb_yield( args->events );
+      static_gedcom_eventbatch_set( args->events, 0 );
+    }
+    gedPROBE1( batch__end, args->batch->count );
+
+    releasePipelineBatch( &args->pipeline );
+  }
+
+  if( args->rc == -1 )
+    rb_raise( rb_eNoMemError, "failed to read events" );
+  else if( args->rc < 0 )
+  {
+    errno = args->pipeline.errnum;
+    rb_sys_fail_str( args->path );
+  }
+
+  return Qnil;
+}
+
+
+static VALUE static_gedcom_each_event_close( VALUE data )
+{
+  static_gedcom_each_event_args_t *args = (static_gedcom_each_event_args_t*)data;
+
+  if( !NIL_P( args->events ) )
+    static_gedcom_eventbatch_set( args->events, 0 );
+  closePipeline( &args->pipeline );
+
+  return Qnil;
+}
+
+
+/* runs the pipeline over the file at 'path' with a ring of 'slots'
+ * batches, yielding to the block as static_gedcom_each_event_loop does.
+ * Returns the pipeline's counters, stalls included, as a hash. */
+
+static VALUE static_gedcom_run_pipeline( int argc, VALUE *argv, VALUE events )
+{
+  static_gedcom_each_event_args_t args;
+  gedPIPELINESTATS_t             *stats;
+  VALUE                           path;
+  VALUE                           slots;
+  VALUE                           result;
+  int                             threaded;
+  int                             rc;
+
+  rb_scan_args( argc, argv, "11", &path, &slots );
+  rb_need_block();
+  FilePathValue( path );
+
+  if( !NIL_P( slots ) && NUM2INT( slots ) < 1 )
+    rb_raise( rb_eArgError, "slots must be at least 1" );
+
+  args.path = path;
+  args.events = events;
+  rc = openPipeline( &args.pipeline, StringValueCStr( path ), NIL_P( slots ) ? gcPIPELINESLOTS : NUM2UINT( slots ) );
+  if( rc != 0 )
+  {
+    errno = args.pipeline.errnum;
+    closePipeline( &args.pipeline );
+    if( rc == -1 )
+      rb_raise( rb_eNoMemError, "failed to read events" );
+    rb_sys_fail_str( path );
+  }
+
+  threaded = startPipeline( &args.pipeline );
+  rb_ensure( static_gedcom_each_event_loop, (VALUE)&args, static_gedcom_each_event_close, (VALUE)&args );
+
+  stats = &args.pipeline.stats;
+  result = rb_hash_new();
+  rb_hash_aset( result, ID2SYM( rb_intern( "events" ) ), ULL2NUM( stats->events ) );
+  rb_hash_aset( result, ID2SYM( rb_intern( "batches" ) ), ULL2NUM( stats->batches ) );
+  rb_hash_aset( result, ID2SYM( rb_intern( "bytes" ) ), ULL2NUM( stats->bytes ) );
+  rb_hash_aset( result, ID2SYM( rb_intern( "threaded" ) ), threaded ? Qtrue : Qfalse );
+  rb_hash_aset( result, ID2SYM( rb_intern( "reader_stalls" ) ), ULL2NUM( stats->readerStalls ) );
+  rb_hash_aset( result, ID2SYM( rb_intern( "reader_stall_seconds" ) ), rb_float_new( stats->readerStallNs / 1e9 ) );
+  rb_hash_aset( result, ID2SYM( rb_intern( "handler_stalls" ) ), ULL2NUM( stats->handlerStalls ) );
+  rb_hash_aset( result, ID2SYM( rb_intern( "handler_stall_seconds" ) ), rb_float_new( stats->handlerStallNs / 1e9 ) );
+
+  RB_GC_GUARD( events );
+
+  return result;
+}
+
+
+/* yields [ level, tag, data ] for each line of the file at 'path', split
+ * as Parser#parse_lines splits them, while a reader thread reads and splits
+ * the lines ahead */
+
+static VALUE static_gedcom_each_event( int argc, VALUE *argv, VALUE self )
+{
+  return static_gedcom_run_pipeline( argc, argv, Qnil );
+}
+
+
+/* the same, yielding each batch of events as one EventBatch, which is
+ * refilled for the next batch */
+
+static VALUE static_gedcom_each_event_batch( int argc, VALUE *argv, VALUE self )
+{
+  static_gedcom_eventbatch_t *events;
+
+  return static_gedcom_run_pipeline( argc, argv,
+           TypedData_Make_Struct( cEventBatch, static_gedcom_eventbatch_t, &static_gedcom_eventbatch_type, events ) );
+}
+
+
+/* the symbols of the validator's diagnostic codes, by code */
+
+static const char *static_gedcom_diagnostic_codes[] = {
+  "line_too_long", "malformed_line", "level_jump", "bad_xref", "duplicate_xref",
+  "unknown_tag", "bad_pointer", "dangling_pointer", "bad_date"
+};
+
+
+typedef struct {
+  gedVALIDATOR_t validator;
+  VALUE          path;
+  VALUE          tags;
+  int            rc;
+} static_gedcom_validate_args_t;
+
+
+static void* static_gedcom_validate_round( void *data )
+{
+  static_gedcom_validate_args_t *args = (static_gedcom_validate_args_t*)data;
+
+  args->rc = runValidatorRound( &args->validator );
+
+  return 0;
+}
+
+
+/* checks the file a round at a time without the GVL, then turns the
+ * diagnostics into [ offset, line, code, text ] arrays with it */
+
+static VALUE static_gedcom_validate_run( VALUE data )
+{
+  static_gedcom_validate_args_t *args = (static_gedcom_validate_args_t*)data;
+  gedDIAGNOSTIC_t               *diagnostic;
+  VALUE                          tag;
+  VALUE                          result;
+  ofUI32_t                       i;
+
+  for( i = 0; !NIL_P( args->tags ) && i < RARRAY_LEN( args->tags ); i++ )
+  {
+    tag = RARRAY_AREF( args->tags, i );
+    if( addValidatorTag( &args->validator, (ofCHAR_t*)RSTRING_PTR( tag ), RSTRING_LEN( tag ) ) != 0 )
+      rb_raise( rb_eNoMemError, "failed to add tag" );
+  }
+
+  do
+  {
+#ifdef HAVE_RB_THREAD_CALL_WITHOUT_GVL
+    rb_thread_call_without_gvl( static_gedcom_validate_round, args, RUBY_UBF_IO, 0 );
+#else
+    static_gedcom_validate_round( args );
+#endif
+    if( args->rc > 0 )
+      rb_thread_check_ints();
+  } while( args->rc > 0 );
+
+  if( args->rc == -1 )
+    rb_raise( rb_eNoMemError, "failed to validate file" );
+  else if( args->rc < 0 )
+  {
+    errno = args->validator.reader.errnum;
+    rb_sys_fail_str( args->path );
+  }
+
+  result = rb_ary_new2( args->validator.count );
+  for( i = 0; i < args->validator.count; i++ )
+  {
+    diagnostic = &args->validator.diagnostics[ i ];
+    rb_ary_push( result, rb_ary_new3( 4,
+      ULL2NUM( diagnostic->where.offset ),
+      ULL2NUM( diagnostic->where.line ),
+      ID2SYM( rb_intern( static_gedcom_diagnostic_codes[ diagnostic->code ] ) ),
+      diagnostic->textLength > 0 ?
+        rb_str_new( (char*)getDiagnosticText( &args->validator, diagnostic ), diagnostic->textLength ) : Qnil ) );
+  }
+
+  return result;
+}
+
+
+static VALUE static_gedcom_validate_close( VALUE data )
+{
+  closeValidator( &( (static_gedcom_validate_args_t*)data )->validator );
+
+  return Qnil;
+}
+
+
+/* checks the structure of the file at 'path' in one pass and returns its
+ * diagnostics as [ offset, line, code, text ] arrays, by offset.  The
+ * options are :threads, :max_line_length (the terminator included) and
+ * :tags, an array of tags to accept besides the standard ones. */
+
+static VALUE static_gedcom_validate( int argc, VALUE *argv, VALUE self )
+{
+  static_gedcom_validate_args_t args;
+  VALUE                         path;
+  VALUE                         options;
+  VALUE                         value;
+  int                           threads;
+  int                           maxLineLength;
+  long                          i;
+
+  rb_scan_args( argc, argv, "11", &path, &options );
+  FilePathValue( path );
+
+  threads = 1;
+  maxLineLength = gcMAXVALIDATELINE;
+  args.tags = Qnil;
+
+  if( !NIL_P( options ) )
+  {
+    Check_Type( options, T_HASH );
+
+    value = rb_hash_aref( options, ID2SYM( rb_intern( "threads" ) ) );
+    if( !NIL_P( value ) )
+      threads = NUM2INT( value );
+
+    value = rb_hash_aref( options, ID2SYM( rb_intern( "max_line_length" ) ) );
+    if( !NIL_P( value ) )
+    {
+      maxLineLength = NUM2INT( value );
+      if( maxLineLength < 1 )
+        rb_raise( rb_eArgError, "max line length must be at least 1" );
+    }
+
+    value = rb_hash_aref( options, ID2SYM( rb_intern( "tags" ) ) );
+    if( !NIL_P( value ) )
+    {
+      value = rb_Array( value );
+      args.tags = rb_ary_new();
+      for( i = 0; i < RARRAY_LEN( value ); i++ )
+      {
+        VALUE tag = RARRAY_AREF( value, i );
+
+        StringValue( tag );
+        if( RSTRING_LEN( tag ) < 1 || RSTRING_LEN( tag ) >= gcMAXEXTRATAGSIZE )
+          rb_raise( rb_eArgError, "tags must be 1 to %d bytes long", gcMAXEXTRATAGSIZE - 1 );
+        rb_ary_push( args.tags, rb_str_new_frozen( tag ) );
+      }
+    }
+  }
+
+  args.path = path;
+  switch( openValidator( &args.validator, StringValueCStr( path ), threads ) )
+  {
+    case -1:
+      rb_sys_fail_str( path );
+    case -2:
+      rb_raise( rb_eNoMemError, "failed to validate file" );
+  }
+  args.validator.maxLineLength = maxLineLength;
+
+  return rb_ensure( static_gedcom_validate_run, (VALUE)&args, static_gedcom_validate_close, (VALUE)&args );
+}
+
+
+typedef struct {
+  gedDIFF_t diff;
+  VALUE     oldPath;
+  VALUE     newPath;
+  int       rc;
+} static_gedcom_diff_args_t;
+
+
+static void* static_gedcom_diff_round( void *data )
+{
+  static_gedcom_diff_args_t *args = (static_gedcom_diff_args_t*)data;
+
+  args->rc = runDiffRound( &args->diff );
+
+  return 0;
+}
+
+
+static VALUE static_gedcom_diff_key( gedDIFF_t *diff, int file, ofUI32_t record )
+{
+  gedDIFFRECORD_t *r;
+
+  if( record == gcNORECORD )
+    return Qnil;
+
+  r = &diff->files[ file ].records[ record ];
+  return rb_str_new( (char*)diff->files[ file ].keys + r->keyOffset, r->keyLength );
+}
+
+
+static VALUE static_gedcom_diff_offset( gedDIFF_t *diff, int file, ofUI32_t record )
+{
+  return ( record == gcNORECORD ) ? Qnil : ULL2NUM( diff->files[ file ].records[ record ].offset );
+}
+
+
+static VALUE static_gedcom_diff_details( ofUI32_t *details, ofUI32_t count )
+{
+  VALUE    indexes = rb_ary_new2( count );
+  ofUI32_t i;
+
+  for( i = 0; i < count; i++ )
+    rb_ary_push( indexes, UINT2NUM( details[ i ] ) );
+
+  return indexes;
+}
+
+
+/* indexes both files a round of records at a time without the GVL, then
+ * turns the changes into arrays with it */
+
+static VALUE static_gedcom_diff_run( VALUE data )
+{
+  static_gedcom_diff_args_t *args = (static_gedcom_diff_args_t*)data;
+  static const char         *kinds[] = { "added", "removed", "changed", "renamed" };
+  gedDIFF_t                 *diff = &args->diff;
+  gedDIFFCHANGE_t           *change;
+  VALUE                      result;
+  VALUE                      removed;
+  VALUE                      added;
+  ofUI32_t                   i;
+
+  do
+  {
+#ifdef HAVE_RB_THREAD_CALL_WITHOUT_GVL
+    rb_thread_call_without_gvl( static_gedcom_diff_round, args, RUBY_UBF_IO, 0 );
+#else
+    static_gedcom_diff_round( args );
+#endif
+    if( args->rc > 0 )
+      rb_thread_check_ints();
+  } while( args->rc > 0 );
+
+  if( args->rc == -1 )
+    rb_raise( rb_eNoMemError, "failed to diff files" );
+  else if( args->rc < 0 )
+  {
+    errno = diff->errnum;
+    rb_sys_fail_str( diff->files[ 0 ].done ? args->newPath : args->oldPath );
+  }
+
+  result = rb_ary_new2( diff->count );
+  for( i = 0; i < diff->count; i++ )
+  {
+    change = &diff->changes[ i ];
+    removed = added = Qnil;
+    if( change->kind == gcdiffCHANGED && diff->subtrees )
+    {
+      removed = static_gedcom_diff_details( diff->details + change->firstDetail, change->removedCount );
+      added = static_gedcom_diff_details( diff->details + change->firstDetail + change->removedCount, change->addedCount );
+    }
+
+    rb_ary_push( result, rb_ary_new3( 7,
+      ID2SYM( rb_intern( kinds[ change->kind ] ) ),
+      static_gedcom_diff_key( diff, 0, change->oldRecord ),
+      static_gedcom_diff_key( diff, 1, change->newRecord ),
+      static_gedcom_diff_offset( diff, 0, change->oldRecord ),
+      static_gedcom_diff_offset( diff, 1, change->newRecord ),
+      removed, added ) );
+  }
+
+  return result;
+}
+
+
+static VALUE static_gedcom_diff_close( VALUE data )
+{
+  closeDiff( &( (static_gedcom_diff_args_t*)data )->diff );
+
+  return Qnil;
+}
+
+
+/* compares the records of the files at 'old_path' and 'new_path' and
+ * returns the changes as [ kind, old_key, new_key, old_offset, new_offset,
+ * removed, added ] arrays.  The only option is :subtrees (true by
+ * default), which tells the level 1 subtrees of changed records apart. */
+
+static VALUE static_gedcom_diff( int argc, VALUE *argv, VALUE self )
+{
+  static_gedcom_diff_args_t args;
+  VALUE                     options;
+  int                       subtrees;
+
+  rb_scan_args( argc, argv, "21", &args.oldPath, &args.newPath, &options );
+  FilePathValue( args.oldPath );
+  FilePathValue( args.newPath );
+
+  subtrees = 1;
+  if( !NIL_P( options ) )
+  {
+    Check_Type( options, T_HASH );
+    subtrees = RTEST( rb_hash_lookup2( options, ID2SYM( rb_intern( "subtrees" ) ), Qtrue ) );
+  }
+
+  switch( openDiff( &args.diff, StringValueCStr( args.oldPath ), StringValueCStr( args.newPath ), subtrees ) )
+  {
+    case 1:
+      rb_sys_fail_str( args.oldPath );
+    case 2:
+      rb_sys_fail_str( args.newPath );
+  }
+
+  return rb_ensure( static_gedcom_diff_run, (VALUE)&args, static_gedcom_diff_close, (VALUE)&args );
+}
+
+
+#ifdef HAVE_SQLITE3_H
+
+typedef struct {
+  gedSQLITELOADER_t loader;
+  VALUE             path;
+  int               rc;
+} static_gedcom_to_sqlite_args_t;
+
+
+static void* static_gedcom_to_sqlite_round( void *data )
+{
+  static_gedcom_to_sqlite_args_t *args = (static_gedcom_to_sqlite_args_t*)data;
+
+  args->rc = runSQLiteLoaderRound( &args->loader );
+
+  return 0;
+}
+
+
+/* loads a transaction of records at a time without the GVL */
+
+static VALUE static_gedcom_to_sqlite_run( VALUE data )
+{
+  static_gedcom_to_sqlite_args_t *args = (static_gedcom_to_sqlite_args_t*)data;
+  VALUE                           counts;
+  int                             i;
+
+  do
+  {
+#ifdef HAVE_RB_THREAD_CALL_WITHOUT_GVL
+    rb_thread_call_without_gvl( static_gedcom_to_sqlite_round, args, RUBY_UBF_IO, 0 );
+#else
+    static_gedcom_to_sqlite_round( args );
+#endif
+    if( args->rc > 0 )
+      rb_thread_check_ints();
+  } while( args->rc > 0 );
+
+  if( args->rc == -1 )
+    rb_raise( rb_eNoMemError, "failed to load the database" );
+  else if( args->rc == -2 )
+  {
+    errno = args->loader.errnum;
+    rb_sys_fail_str( args->path );
+  }
+  else if( args->rc < 0 )
+    rb_raise( rb_eRuntimeError, "sqlite: %s", args->loader.message );
+
+  counts = rb_hash_new();
+  for( i = 0; i < gstCOUNT; i++ )
+    rb_hash_aset( counts, ID2SYM( rb_intern( sqliteTableNames[ i ] ) ), ULL2NUM( args->loader.counts[ i ] ) );
+
+  return counts;
+}
+
+
+static VALUE static_gedcom_to_sqlite_close( VALUE data )
+{
+  closeSQLiteLoader( &( (static_gedcom_to_sqlite_args_t*)data )->loader );
+
+  return Qnil;
+}
+
+
+/* loads the people and families of the file at 'path' into the SQLite
+ * database at 'db_path' and returns the rows added to each table */
+
+static VALUE static_gedcom_to_sqlite( VALUE self, VALUE path, VALUE dbPath )
+{
+  static_gedcom_to_sqlite_args_t args;
+
+  FilePathValue( path );
+  FilePathValue( dbPath );
+  args.path = path;
+
+  switch( openSQLiteLoader( &args.loader, StringValueCStr( path ), StringValueCStr( dbPath ) ) )
+  {
+    case 1:
+      rb_sys_fail_str( path );
+    case 2:
+      rb_raise( rb_eRuntimeError, "sqlite: %s", args.loader.message );
+  }
+
+  return rb_ensure( static_gedcom_to_sqlite_run, (VALUE)&args, static_gedcom_to_sqlite_close, (VALUE)&args );
+}
+
+#endif
+
+
+typedef struct {
+  gedSTATSCOLLECTOR_t collector;
+  VALUE               path;
+  int                 rc;
+} static_gedcom_stats_args_t;
+
+
+static void* static_gedcom_stats_round( void *data )
+{
+  static_gedcom_stats_args_t *args = (static_gedcom_stats_args_t*)data;
+
+  args->rc = runStatsRound( &args->collector );
+
+  return 0;
+}
+
+
+static VALUE static_gedcom_stats_table( gedSTATSTABLE_t *table )
+{
+  VALUE    counts = rb_hash_new();
+  ofUI32_t i;
+
+  for( i = 0; i < table->count; i++ )
+    rb_hash_aset( counts, rb_str_new( (char*)table->entries[ i ].key, table->entries[ i ].length ),
+                  ULL2NUM( table->entries[ i ].count ) );
+
+  return counts;
+}
+
+
+/* the counts up to the last that is not 0 */
+
+static VALUE static_gedcom_stats_array( ofUI64_t *counts, int size )
+{
+  VALUE array;
+  int   i;
+
+  while( size > 0 && counts[ size - 1 ] == 0 )
+    size--;
+
+  array = rb_ary_new2( size );
+  for( i = 0; i < size; i++ )
+    rb_ary_push( array, ULL2NUM( counts[ i ] ) );
+
+  return array;
+}
+
+
+static VALUE static_gedcom_stats_symbols( ofUI64_t *counts, const char **names, int size )
+{
+  VALUE hash = rb_hash_new();
+  int   i;
+
+  for( i = 0; i < size; i++ )
+    if( counts[ i ] != 0 )
+      rb_hash_aset( hash, ID2SYM( rb_intern( names[ i ] ) ), ULL2NUM( counts[ i ] ) );
+
+  return hash;
+}
+
+
+/* reads a round of the file without the GVL at a time, then turns the
+ * totals into a Hash with it */
+
+static VALUE static_gedcom_stats_run( VALUE data )
+{
+  static_gedcom_stats_args_t *args = (static_gedcom_stats_args_t*)data;
+  static const char          *qualifiers[] = { "none", "about", "calculated", "estimated", "before", "after",
+                                               "between", "from", "to", "fromto", "interpreted", "child",
+                                               "cleared", "completed", "infant", "pre1970", "qualified",
+                                               "stillborn", "submitted", "uncleared", "bic", "dns", "dnscan",
+                                               "dead", "invalid" };
+  static const char          *calendars[] = { "gregorian", "julian", "hebrew", "french", "future", "unknown" };
+  gedSTATS_t                 *totals = &args->collector.totals;
+  VALUE                       result;
+  VALUE                       events;
+  VALUE                       decades;
+  int                         i;
+  int                         j;
+
+  do
+  {
+#ifdef HAVE_RB_THREAD_CALL_WITHOUT_GVL
+    rb_thread_call_without_gvl( static_gedcom_stats_round, args, RUBY_UBF_IO, 0 );
+#else
+    static_gedcom_stats_round( args );
+#endif
+    if( args->rc > 0 )
+      rb_thread_check_ints();
+  } while( args->rc > 0 );
+
+  if( args->rc == -1 )
+    rb_raise( rb_eNoMemError, "failed to collect statistics" );
+  else if( args->rc < 0 )
+  {
+    errno = args->collector.reader.errnum;
+    rb_sys_fail_str( args->path );
+  }
+
+  events = rb_hash_new();
+  for( i = 0; i < gcSTATSEVENTS; i++ )
+  {
+    if( totals->decades[ i ] == 0 )
+      continue;
+    decades = rb_hash_new();
+    for( j = 0; j < gcSTATSDECADES; j++ )
+      if( totals->decades[ i ][ j ] != 0 )
+        rb_hash_aset( decades, INT2FIX( j * 10 ), ULL2NUM( totals->decades[ i ][ j ] ) );
+    rb_hash_aset( events, rb_str_new_cstr( statsEventTags[ i ] ), decades );
+  }
+
+  result = rb_hash_new();
+  rb_hash_aset( result, ID2SYM( rb_intern( "lines" ) ), ULL2NUM( totals->lines ) );
+  rb_hash_aset( result, ID2SYM( rb_intern( "malformed" ) ), ULL2NUM( totals->malformed ) );
+  rb_hash_aset( result, ID2SYM( rb_intern( "records" ) ), static_gedcom_stats_table( &totals->tables[ gstsRECORDS ] ) );
+  rb_hash_aset( result, ID2SYM( rb_intern( "tags" ) ), static_gedcom_stats_table( &totals->tables[ gstsTAGS ] ) );
+  rb_hash_aset( result, ID2SYM( rb_intern( "levels" ) ), static_gedcom_stats_array( totals->levels, gcSTATSLEVELS ) );
+  rb_hash_aset( result, ID2SYM( rb_intern( "depths" ) ), static_gedcom_stats_array( totals->depths, gcSTATSLEVELS ) );
+  rb_hash_aset( result, ID2SYM( rb_intern( "surnames" ) ), static_gedcom_stats_table( &totals->tables[ gstsSURNAMES ] ) );
+  rb_hash_aset( result, ID2SYM( rb_intern( "events" ) ), events );
+  rb_hash_aset( result, ID2SYM( rb_intern( "dates" ) ), static_gedcom_stats_symbols( totals->qualifiers, qualifiers, gcSTATSQUALIFIERS ) );
+  rb_hash_aset( result, ID2SYM( rb_intern( "calendars" ) ), static_gedcom_stats_symbols( totals->calendars, calendars, gcSTATSCALENDARS ) );
+
+  return result;
+}
+
+
+static VALUE static_gedcom_stats_close( VALUE data )
+{
+  closeStatsCollector( &( (static_gedcom_stats_args_t*)data )->collector );
+
+  return Qnil;
+}
+
+
+/* counts tags, records, levels, surnames, events by decade and dates by
+ * qualifier and calendar in one pass over the file at 'path'.  The only
+ * option is :threads. */
+
+static VALUE static_gedcom_stats( int argc, VALUE *argv, VALUE self )
+{
+  static_gedcom_stats_args_t args;
+  VALUE                      path;
+  VALUE                      options;
+  VALUE                      value;
+  int                        threads;
+
+  rb_scan_args( argc, argv, "11", &path, &options );
+  FilePathValue( path );
+
+  threads = 1;
+  if( !NIL_P( options ) )
+  {
+    Check_Type( options, T_HASH );
+
+    value = rb_hash_aref( options, ID2SYM( rb_intern( "threads" ) ) );
+    if( !NIL_P( value ) )
+      threads = NUM2INT( value );
+  }
+
+  args.path = path;
+  if( openStatsCollector( &args.collector, StringValueCStr( path ), threads ) != 0 )
+    rb_sys_fail_str( path );
+
+  return rb_ensure( static_gedcom_stats_run, (VALUE)&args, static_gedcom_stats_close, (VALUE)&args );
+}
+
+
+/* the column with a flag that is set while load reads into it without the
+ * GVL, when other threads must keep their hands off it */
+
+typedef struct {
+  gedDATECOLUMN_t column;
+  int             loading;
+} static_gedcom_datecolumn_t;
+
+
+static void static_gedcom_datecolumn_free( void *ptr )
+{
+  freeDateColumn( &( (static_gedcom_datecolumn_t*)ptr )->column );
+  xfree( ptr );
+}
+
+
+static size_t static_gedcom_datecolumn_memsize( const void *ptr )
+{
+  return sizeof( static_gedcom_datecolumn_t ) +
+         (size_t)getDateColumnMemory( &( (static_gedcom_datecolumn_t*)ptr )->column );
+}
+
+
+static const rb_data_type_t static_gedcom_datecolumn_type = {
+  "GEDCOM::DateColumn",
+  { 0, static_gedcom_datecolumn_free, static_gedcom_datecolumn_memsize, },
+  0, 0,
+  RUBY_TYPED_FREE_IMMEDIATELY | RUBY_TYPED_WB_PROTECTED
+};
+
+
+static static_gedcom_datecolumn_t* static_gedcom_datecolumn_get( VALUE self )
+{
+  static_gedcom_datecolumn_t *column;
+
+  TypedData_Get_Struct( self, static_gedcom_datecolumn_t, &static_gedcom_datecolumn_type, column );
+  if( column->loading )
+    rb_raise( rb_eRuntimeError, "date column used while it loads" );
+
+  return column;
+}
+
+
+/* a key as [ year ], [ year, month ] or [ year, month, day ] */
+
+static VALUE static_gedcom_datecolumn_key( ofI32_t key )
+{
+  VALUE date = rb_ary_new2( 3 );
+
+  rb_ary_push( date, INT2NUM( getDateKeyYear( key ) ) );
+  if( getDateKeyMonth( key ) != 0 )
+  {
+    rb_ary_push( date, INT2FIX( getDateKeyMonth( key ) ) );
+    if( getDateKeyDay( key ) != 0 )
+      rb_ary_push( date, INT2FIX( getDateKeyDay( key ) ) );
+  }
+
+  return date;
+}
+
+
+/* the first ('upper' 0) or last key a bound takes in: nil for no bound, a
+ * year, or a key as static_gedcom_datecolumn_key makes them */
+
+static ofI32_t static_gedcom_datecolumn_bound( VALUE bound, int upper )
+{
+  long year;
+  int  month;
+  int  day;
+
+  if( NIL_P( bound ) )
+    return upper ? INT_MAX : INT_MIN;
+
+  month = upper ? 15 : 0;
+  day = upper ? 31 : 0;
+
+  if( RB_TYPE_P( bound, T_ARRAY ) )
+  {
+    if( RARRAY_LEN( bound ) < 1 || RARRAY_LEN( bound ) > 3 )
+      rb_raise( rb_eArgError, "date bound must be [ year ], [ year, month ] or [ year, month, day ]" );
+    year = NUM2LONG( rb_ary_entry( bound, 0 ) );
+    if( RARRAY_LEN( bound ) > 1 )
+      month = NUM2INT( rb_ary_entry( bound, 1 ) );
+    if( RARRAY_LEN( bound ) > 2 )
+      day = NUM2INT( rb_ary_entry( bound, 2 ) );
+  }
+  else
+    year = NUM2LONG( bound );
+
+  if( month < 0 || month > 15 || day < 0 || day > 31 )
+    rb_raise( rb_eArgError, "date bound out of range" );
+
+  /* no key lies beyond gcMAXDATECOLUMNYEAR either way */
+
+  if( year > gcMAXDATECOLUMNYEAR )
+    year = gcMAXDATECOLUMNYEAR + 1;
+  else if( year < -gcMAXDATECOLUMNYEAR )
+    year = -gcMAXDATECOLUMNYEAR - 1;
+
+  return makeDateKey( year, month, day );
+}
+
+
+static VALUE static_gedcom_datecolumn_new( VALUE klass )
+{
+  static_gedcom_datecolumn_t *column;
+  VALUE                       new_column;
+
+  new_column = TypedData_Make_Struct( klass, static_gedcom_datecolumn_t, &static_gedcom_datecolumn_type, column );
+  initDateColumn( &column->column );
+  column->loading = 0;
+
+  return new_column;
+}
+
+
+/* adds a GEDCOM::Date or the raw DATE text, which may start with a calendar
+ * escape, under 'tag' (or none).  Returns false for dates that have no
+ * gregorian or julian year. */
+
+static VALUE static_gedcom_datecolumn_add( int argc, VALUE *argv, VALUE self )
+{
+  static_gedcom_datecolumn_t *column;
+  gedDATEVALUE_t              parsed_date;
+  gedDATEVALUE_t             *value;
+  VALUE                       date;
+  VALUE                       tag;
+  int                         rc;
+
+  rb_scan_args( argc, argv, "11", &date, &tag );
+  column = static_gedcom_datecolumn_get( self );
+
+  if( rb_obj_is_kind_of( date, cDate ) )
+  {
+    TypedData_Get_Struct( date, gedDATEVALUE_t, &static_gedcom_date_type, value );
+    memcpy( &parsed_date, value, sizeof( parsed_date ) );
+  }
+  else
+  {
+    StringValue( date );
+    if( parseGEDCOMDateText( (ofCHAR_t*)RSTRING_PTR( date ), (ofUI32_t)RSTRING_LEN( date ), &parsed_date ) != 0 )
+      return Qfalse;
+  }
+
+  if( NIL_P( tag ) )
+    rc = addDateColumn( &column->column, &parsed_date, 0, 0 );
+  else
+  {
+    StringValue( tag );
+    rc = addDateColumn( &column->column, &parsed_date, (ofCHAR_t*)RSTRING_PTR( tag ), (ofUI32_t)RSTRING_LEN( tag ) );
+  }
+
+  if( rc == -1 )
+    rb_raise( rb_eNoMemError, "failed to grow date column" );
+  else if( rc == -2 )
+    rb_raise( rb_eArgError, "date column tag too long, holding a NUL or beyond TAG_LIMIT tags" );
+
+  return rc ? Qtrue : Qfalse;
+}
+
+
+typedef struct {
+  VALUE                       path;
+  static_gedcom_datecolumn_t *column;
+  gedRECORDREADER_t           reader;
+  ofUI64_t                    added;
+  int                         rc;
+  int                         errnum;
+} static_gedcom_datecolumn_load_args_t;
+
+
+static void* static_gedcom_datecolumn_load_round( void *data )
+{
+  static_gedcom_datecolumn_load_args_t *args = (static_gedcom_datecolumn_load_args_t*)data;
+
+  /* errno is kept here, where the read that failed set it */
+
+  args->rc = loadDateColumn( &args->column->column, &args->reader, &args->added );
+  args->errnum = errno;
+
+  return 0;
+}
+
+
+static VALUE static_gedcom_datecolumn_load_run( VALUE data )
+{
+  static_gedcom_datecolumn_load_args_t *args = (static_gedcom_datecolumn_load_args_t*)data;
+
+  do
+  {
+#ifdef HAVE_RB_THREAD_CALL_WITHOUT_GVL
+    rb_thread_call_without_gvl( static_gedcom_datecolumn_load_round, args, RUBY_UBF_IO, 0 );
+#else
+    static_gedcom_datecolumn_load_round( args );
+#endif
+    if( args->rc > 0 )
+      rb_thread_check_ints();
+  } while( args->rc > 0 );
+
+  if( args->rc == -1 )
+    rb_raise( rb_eNoMemError, "failed to grow date column" );
+  else if( args->rc < 0 )
+  {
+    errno = args->errnum;
+    rb_sys_fail_str( args->path );
+  }
+
+  return ULL2NUM( args->added );
+}
+
+
+static VALUE static_gedcom_datecolumn_load_close( VALUE data )
+{
+  static_gedcom_datecolumn_load_args_t *args = (static_gedcom_datecolumn_load_args_t*)data;
+
+  closeRecordReader( &args->reader );
+  args->column->loading = 0;
+
+  return Qnil;
+}
+
+
+/* adds the first DATE of each event of the INDI and FAM records of the
+ * file at 'path', under the event's tag, and returns how many it added */
+
+static VALUE static_gedcom_datecolumn_load( VALUE self, VALUE path )
+{
+  static_gedcom_datecolumn_load_args_t args;
+
+  FilePathValue( path );
+
+  args.path = path;
+  args.column = static_gedcom_datecolumn_get( self );
+  args.added = 0;
+  args.rc = 0;
+
+  if( openRecordReader( &args.reader, StringValueCStr( path ) ) != 0 )
+    rb_sys_fail_str( path );
+
+  args.column->loading = 1;
+
+  return rb_ensure( static_gedcom_datecolumn_load_run, (VALUE)&args, static_gedcom_datecolumn_load_close, (VALUE)&args );
+}
+
+
+static VALUE static_gedcom_datecolumn_length( VALUE self )
+{
+  return UINT2NUM( static_gedcom_datecolumn_get( self )->column.count );
+}
+
+
+static VALUE static_gedcom_datecolumn_tags( VALUE self )
+{
+  static_gedcom_datecolumn_t *column = static_gedcom_datecolumn_get( self );
+  VALUE                       tags;
+  int                         i;
+
+  tags = rb_ary_new2( column->column.tagCount );
+  for( i = 0; i < column->column.tagCount; i++ )
+    rb_ary_push( tags, rb_str_new_cstr( (char*)column->column.tagNames[ i ] ) );
+
+  return tags;
+}
+
+
+/* the earliest ('last' 0) or latest date within the bounds, or nil */
+
+static VALUE static_gedcom_datecolumn_extreme( int argc, VALUE *argv, VALUE self, int last )
+{
+  static_gedcom_datecolumn_t *column;
+  VALUE                       from;
+  VALUE                       to;
+  ofI32_t                     min;
+  ofI32_t                     max;
+
+  rb_scan_args( argc, argv, "02", &from, &to );
+  column = static_gedcom_datecolumn_get( self );
+
+  if( getDateColumnRange( &column->column, static_gedcom_datecolumn_bound( from, 0 ),
+                          static_gedcom_datecolumn_bound( to, 1 ), &min, &max ) != 0 )
+    return Qnil;
+
+  return static_gedcom_datecolumn_key( last ? max : min );
+}
+
+
+static VALUE static_gedcom_datecolumn_min( int argc, VALUE *argv, VALUE self )
+{
+  return static_gedcom_datecolumn_extreme( argc, argv, self, 0 );
+}
+
+
+static VALUE static_gedcom_datecolumn_max( int argc, VALUE *argv, VALUE self )
+{
+  return static_gedcom_datecolumn_extreme( argc, argv, self, 1 );
+}
+
+
+/* a String of a bit a date, the low bit of each byte first, set for the
+ * dates within the bounds */
+
+static VALUE static_gedcom_datecolumn_mask( int argc, VALUE *argv, VALUE self )
+{
+  static_gedcom_datecolumn_t *column;
+  VALUE                       from;
+  VALUE                       to;
+  VALUE                       mask;
+  ofI32_t                     first;
+  ofI32_t                     last;
+
+  rb_scan_args( argc, argv, "02", &from, &to );
+  column = static_gedcom_datecolumn_get( self );
+  first = static_gedcom_datecolumn_bound( from, 0 );
+  last = static_gedcom_datecolumn_bound( to, 1 );
+
+  mask = rb_str_new( 0, ( column->column.count + 7 ) / 8 );
+  maskDateColumn( &column->column, first, last, (ofUI8_t*)RSTRING_PTR( mask ) );
+
+  return mask;
+}
+
+
+/* the counts of one row as an ascending Hash of the buckets that are not
+ * empty: years, decades (year buckets folded by ten, rounding down) or
+ * [ year, month ] pairs */
+
+static VALUE static_gedcom_datecolumn_row( gedDATEHISTOGRAM_t *histogram, ofUI32_t row, int unit, int decades )
+{
+  ofUI32_t *counts = histogram->counts + (size_t)row * ( histogram->buckets + 1 );
+  VALUE     hash = rb_hash_new();
+  VALUE     bucket;
+  VALUE     total;
+  ofI32_t   value;
+  ofI32_t   year;
+  ofUI32_t  i;
+
+  for( i = 0; i < histogram->buckets; i++ )
+  {
+    if( counts[ i ] == 0 )
+      continue;
+
+    value = histogram->first + (ofI32_t)i;
+    if( unit == gcdcMONTH )
+    {
+      year = ( value >= 0 ) ? value / 12 : -( ( -value + 11 ) / 12 );
+      bucket = rb_assoc_new( INT2NUM( year ), INT2FIX( value - year * 12 + 1 ) );
+    }
+    else if( decades )
+      bucket = INT2NUM( ( ( value >= 0 ) ? value / 10 : -( ( -value + 9 ) / 10 ) ) * 10 );
+    else
+      bucket = INT2NUM( value );
+
+    total = rb_hash_aref( hash, bucket );
+    rb_hash_aset( hash, bucket, ULL2NUM( ( NIL_P( total ) ? 0 : NUM2ULL( total ) ) + counts[ i ] ) );
+  }
+
+  return hash;
+}
+
+
+static VALUE static_gedcom_datecolumn_count( VALUE data )
+{
+  static const char  *qualifiers[] = { "none", "about", "calculated", "estimated", "before", "after",
+                                       "between", "from", "to", "fromto", "interpreted" };
+  VALUE              *args = (VALUE*)data;
+  gedDATEHISTOGRAM_t *histogram = (gedDATEHISTOGRAM_t*)args[ 0 ];
+  gedDATECOLUMN_t    *column = (gedDATECOLUMN_t*)args[ 1 ];
+  int                 unit = (int)args[ 2 ];
+  int                 split = (int)args[ 3 ];
+  int                 decades = (int)args[ 4 ];
+  VALUE               result;
+  VALUE               row;
+  VALUE               name;
+  ofUI32_t            i;
+
+  if( split == gcdcALL )
+    return static_gedcom_datecolumn_row( histogram, 0, unit, decades );
+
+  result = rb_hash_new();
+  for( i = 0; i < histogram->rows; i++ )
+  {
+    row = static_gedcom_datecolumn_row( histogram, i, unit, decades );
+    if( RHASH_SIZE( row ) == 0 )
+      continue;
+
+    if( split == gcdcBYQUALIFIER )
+      name = ID2SYM( rb_intern( qualifiers[ i ] ) );
+    else if( i < (ofUI32_t)column->tagCount )
+      name = rb_str_new_cstr( (char*)column->tagNames[ i ] );
+    else
+      name = Qnil;
+    rb_hash_aset( result, name, row );
+  }
+
+  return result;
+}
+
+
+static VALUE static_gedcom_datecolumn_count_free( VALUE data )
+{
+  freeDateHistogram( (gedDATEHISTOGRAM_t*)( (VALUE*)data )[ 0 ] );
+
+  return Qnil;
+}
+
+
+/* counts the dates by :year (the default), :decade or :month.  Options:
+ * :by (:tag or :qualifier) splits the counts into a Hash of them by tag
+ * (nil for dates added without one) or qualifier, and :from and :to bound
+ * the dates counted as mask does. */
+
+static VALUE static_gedcom_datecolumn_histogram( int argc, VALUE *argv, VALUE self )
+{
+  static_gedcom_datecolumn_t *column;
+  gedDATEHISTOGRAM_t          histogram;
+  VALUE                       unit;
+  VALUE                       options;
+  VALUE                       value;
+  VALUE                       args[ 5 ];
+  ofI32_t                     from;
+  ofI32_t                     to;
+  int                         i_unit;
+  int                         split;
+  int                         rc;
+
+  rb_scan_args( argc, argv, "02", &unit, &options );
+  column = static_gedcom_datecolumn_get( self );
+
+  if( NIL_P( unit ) || unit == ID2SYM( rb_intern( "year" ) ) || unit == ID2SYM( rb_intern( "decade" ) ) )
+    i_unit = gcdcYEAR;
+  else if( unit == ID2SYM( rb_intern( "month" ) ) )
+    i_unit = gcdcMONTH;
+  else
+    rb_raise( rb_eArgError, "unknown histogram unit (expected :year, :decade or :month)" );
+
+  split = gcdcALL;
+  from = INT_MIN;
+  to = INT_MAX;
+  if( !NIL_P( options ) )
+  {
+    Check_Type( options, T_HASH );
+
+    value = rb_hash_aref( options, ID2SYM( rb_intern( "by" ) ) );
+    if( value == ID2SYM( rb_intern( "tag" ) ) )
+      split = gcdcBYTAG;
+    else if( value == ID2SYM( rb_intern( "qualifier" ) ) )
+      split = gcdcBYQUALIFIER;
+    else if( !NIL_P( value ) )
+      rb_raise( rb_eArgError, "unknown histogram split (expected :tag or :qualifier)" );
+
+    from = static_gedcom_datecolumn_bound( rb_hash_aref( options, ID2SYM( rb_intern( "from" ) ) ), 0 );
+    to = static_gedcom_datecolumn_bound( rb_hash_aref( options, ID2SYM( rb_intern( "to" ) ) ), 1 );
+  }
+
+  rc = countDateColumn( &column->column, i_unit, split, from, to, &histogram );
+  if( rc < 0 )
+    freeDateHistogram( &histogram );
+  if( rc == -1 )
+    rb_raise( rb_eNoMemError, "failed to allocate histogram" );
+  else if( rc == -2 )
+    rb_raise( rb_eArgError, "histogram too large (narrow it with :from and :to)" );
+
+  args[ 0 ] = (VALUE)&histogram;
+  args[ 1 ] = (VALUE)&column->column;
+  args[ 2 ] = (VALUE)i_unit;
+  args[ 3 ] = (VALUE)split;
+  args[ 4 ] = (VALUE)( unit == ID2SYM( rb_intern( "decade" ) ) );
+
+  return rb_ensure( static_gedcom_datecolumn_count, (VALUE)args, static_gedcom_datecolumn_count_free, (VALUE)args );
+}
+
+
+void Init__gedcom()
+{
+  VALUE cDateType;
+
+  /* the engine keeps no state outside the objects it is handed, and its
+   * tables are const, so the extension can be used from any Ractor */
+
+#ifdef HAVE_RB_EXT_RACTOR_SAFE
+  rb_ext_ractor_safe( true );
+#endif
+
+  mGEDCOM   = rb_define_module( "GEDCOM" );
+  cDate     = rb_define_class_under( mGEDCOM, "Date", rb_cObject );
+  cDatePart = rb_define_class_under( mGEDCOM, "DatePart", rb_cObject );
+  cDateError = rb_define_class_under( mGEDCOM, "DateError", rb_cObject );
+
+  eDateFormatException = rb_define_class_under( mGEDCOM, "DateFormatException", rb_eException );
+
+  rb_define_const( cDate, "NONE",  INT2FIX( gcNONE ) );
+
+  rb_define_const( cDate, "ABOUT",       INT2FIX( gcABOUT ) );
+  rb_define_const( cDate, "CALCULATED",  INT2FIX( gcCALCULATED ) );
+  rb_define_const( cDate, "ESTIMATED",   INT2FIX( gcESTIMATED ) );
+  rb_define_const( cDate, "BEFORE",      INT2FIX( gcBEFORE ) );
+  rb_define_const( cDate, "AFTER",       INT2FIX( gcAFTER ) );
+  rb_define_const( cDate, "BETWEEN",     INT2FIX( gcBETWEEN ) );
+  rb_define_const( cDate, "FROM",        INT2FIX( gcFROM ) );
+  rb_define_const( cDate, "TO",          INT2FIX( gcTO ) );
+  rb_define_const( cDate, "FROMTO",      INT2FIX( gcFROMTO ) );
+  rb_define_const( cDate, "INTERPRETED", INT2FIX( gcINTERPRETED ) );
+
+  rb_define_const( cDate, "CHILD",       INT2FIX( gcCHILD ) );
+  rb_define_const( cDate, "CLEARED",     INT2FIX( gcCLEARED ) );
+  rb_define_const( cDate, "COMPLETED",   INT2FIX( gcCOMPLETED ) );
+  rb_define_const( cDate, "INFANT",      INT2FIX( gcINFANT ) );
+  rb_define_const( cDate, "PRE1970",     INT2FIX( gcPRE1970 ) );
+  rb_define_const( cDate, "QUALIFIED",   INT2FIX( gcQUALIFIED ) );
+  rb_define_const( cDate, "STILLBORN",   INT2FIX( gcSTILLBORN ) );
+  rb_define_const( cDate, "SUBMITTED",   INT2FIX( gcSUBMITTED ) );
+  rb_define_const( cDate, "UNCLEARED",   INT2FIX( gcUNCLEARED ) );
+  rb_define_const( cDate, "BIC",         INT2FIX( gcBIC ) );
+  rb_define_const( cDate, "DNS",         INT2FIX( gcDNS ) );
+  rb_define_const( cDate, "DNSCAN",      INT2FIX( gcDNSCAN ) );
+  rb_define_const( cDate, "DEAD",        INT2FIX( gcDEAD ) );
+
+  rb_undef_alloc_func( cDate );
+  rb_undef_alloc_func( cDatePart );
+  rb_undef_alloc_func( cDateError );
+
+  rb_define_singleton_method( cDate, "new", static_gedcom_date_new, -1 );
+  rb_define_singleton_method( cDate, "valid?", static_gedcom_date_valid, -1 );
+  rb_define_singleton_method( cDate, "try_parse", static_gedcom_date_try_parse, -1 );
+  
+  rb_define_method( cDate, "format", static_gedcom_date_get_format, 0 );
+  rb_define_method( cDate, "first", static_gedcom_date_get_date1, 0 );
+  rb_define_method( cDate, "last", static_gedcom_date_get_date2, 0 );
+  rb_define_method( cDate, "to_s", static_gedcom_date_to_s, 0 );
+  rb_define_method( cDate, "is_date?", static_gedcom_date_is_date, 0 );
+  rb_define_method( cDate, "is_range?", static_gedcom_date_is_range, 0 );
+
+  rb_define_const( cDatePart, "NONE",        INT2FIX( gfNONE ) );
+  rb_define_const( cDatePart, "PHRASE",      INT2FIX( gfPHRASE ) );
+  rb_define_const( cDatePart, "NONSTANDARD", INT2FIX( gfNONSTANDARD ) );
+
+  rb_define_const( cDatePart, "NOFLAG",      INT2FIX( gfNOFLAG ) );
+  rb_define_const( cDatePart, "NODAY",       INT2FIX( gfNODAY ) );
+  rb_define_const( cDatePart, "NOMONTH",     INT2FIX( gfNOMONTH ) );
+  rb_define_const( cDatePart, "NOYEAR",      INT2FIX( gfNOYEAR ) );
+  rb_define_const( cDatePart, "YEARSPAN",    INT2FIX( gfYEARSPAN ) );
+
+  rb_define_method( cDatePart, "calendar",        static_gedcom_date_get_type, 0 );
+  rb_define_method( cDatePart, "compliance",      static_gedcom_date_get_flags, 0 );
+  rb_define_method( cDatePart, "phrase",          static_gedcom_date_get_phrase, 0 );
+  rb_define_method( cDatePart, "has_day?",        static_gedcom_date_has_day, 0 );
+  rb_define_method( cDatePart, "has_month?",      static_gedcom_date_has_month, 0 );
+  rb_define_method( cDatePart, "has_year?",       static_gedcom_date_has_year, 0 );
+  rb_define_method( cDatePart, "has_year_span?",  static_gedcom_date_has_year_span, 0 );
+  rb_define_method( cDatePart, "day",             static_gedcom_date_day, 0 );
+  rb_define_method( cDatePart, "month",           static_gedcom_date_month, 0 );
+  rb_define_method( cDatePart, "year",            static_gedcom_date_year, 0 );
+  rb_define_method( cDatePart, "to_year",         static_gedcom_date_to_year, 0 );
+  rb_define_method( cDatePart, "epoch",           static_gedcom_date_epoch, 0 );
+  rb_define_method( cDatePart, "to_s",            static_gedcom_datepart_to_s, 0 );
+
+  rb_define_method( cDateError, "message", static_gedcom_dateerror_message, 0 );
+  rb_define_method( cDateError, "to_s",    static_gedcom_dateerror_message, 0 );
+  rb_define_method( cDateError, "text",    static_gedcom_dateerror_text, 0 );
+  rb_define_method( cDateError, "date",    static_gedcom_dateerror_date, 0 );
+
+  cDateType = rb_define_class_under( mGEDCOM, "DateType", rb_cObject );
+
+  rb_define_const( cDateType, "GREGORIAN", INT2FIX( gctGREGORIAN ) );
+  rb_define_const( cDateType, "JULIAN",    INT2FIX( gctJULIAN ) );
+  rb_define_const( cDateType, "HEBREW",    INT2FIX( gctHEBREW ) );
+  rb_define_const( cDateType, "FRENCH",    INT2FIX( gctFRENCH ) );
+  rb_define_const( cDateType, "FUTURE",    INT2FIX( gctFUTURE ) );
+  rb_define_const( cDateType, "UNKNOWN",   INT2FIX( gctUNKNOWN ) );
+  rb_define_const( cDateType, "DEFAULT",   INT2FIX( gctDEFAULT ) );
+
+  cAnniversaryIndex = rb_define_class_under( mGEDCOM, "AnniversaryIndex", rb_cObject );
+
+  rb_undef_alloc_func( cAnniversaryIndex );
+  rb_define_singleton_method( cAnniversaryIndex, "new", static_gedcom_anniversary_new, 0 );
+
+  rb_define_method( cAnniversaryIndex, "add",       static_gedcom_anniversary_add, 3 );
+  rb_define_method( cAnniversaryIndex, "on",        static_gedcom_anniversary_on, 3 );
+  rb_define_method( cAnniversaryIndex, "in_month",  static_gedcom_anniversary_in_month, 2 );
+  rb_define_method( cAnniversaryIndex, "events",    static_gedcom_anniversary_events, 0 );
+  rb_define_method( cAnniversaryIndex, "remove",    static_gedcom_anniversary_remove, 1 );
+
+  mName = rb_define_module_under( mGEDCOM, "Name" );
+
+  rb_define_singleton_method( mName, "split",           static_gedcom_name_split, 1 );
+  rb_define_singleton_method( mName, "normalize",       static_gedcom_name_normalize, 1 );
+  rb_define_singleton_method( mName, "soundex",         static_gedcom_name_soundex, 1 );
+  rb_define_singleton_method( mName, "daitch_mokotoff", static_gedcom_name_dm_soundex, 1 );
+
+  cNameIndex = rb_define_class_under( mGEDCOM, "NameIndex", rb_cObject );
+
+  rb_undef_alloc_func( cNameIndex );
+  rb_define_singleton_method( cNameIndex, "new", static_gedcom_nameindex_new, 0 );
+
+  rb_define_method( cNameIndex, "add",             static_gedcom_nameindex_add, 2 );
+  rb_define_method( cNameIndex, "surname",         static_gedcom_nameindex_surname, 1 );
+  rb_define_method( cNameIndex, "given",           static_gedcom_nameindex_given, 1 );
+  rb_define_method( cNameIndex, "soundex",         static_gedcom_nameindex_soundex, 1 );
+  rb_define_method( cNameIndex, "daitch_mokotoff", static_gedcom_nameindex_dm_soundex, 1 );
+  rb_define_method( cNameIndex, "remove",          static_gedcom_nameindex_remove, 1 );
+
+  cDuplicateFinder = rb_define_class_under( mGEDCOM, "DuplicateFinder", rb_cObject );
+
+  rb_define_const( cDuplicateFinder, "MIN_SCORE", INT2FIX( gcDEDUPEMINSCORE ) );
+
+  rb_undef_alloc_func( cDuplicateFinder );
+  rb_define_singleton_method( cDuplicateFinder, "new", static_gedcom_dedupe_new, 0 );
+
+  rb_define_method( cDuplicateFinder, "add",        static_gedcom_dedupe_add, -1 );
+  rb_define_method( cDuplicateFinder, "candidates", static_gedcom_dedupe_candidates, -1 );
+  rb_define_method( cDuplicateFinder, "size",       static_gedcom_dedupe_size, 0 );
+
+  cWriter = rb_define_class_under( mGEDCOM, "Writer", rb_cObject );
+
+  rb_define_const( cWriter, "LINE_LIMIT", INT2FIX( gcMAXLINELENGTH ) );
+
+  rb_undef_alloc_func( cWriter );
+  rb_define_singleton_method( cWriter, "new", static_gedcom_writer_new, -1 );
+
+  rb_define_method( cWriter, "line",  static_gedcom_writer_line, -1 );
+  rb_define_method( cWriter, "date",  static_gedcom_writer_date, -1 );
+  rb_define_method( cWriter, "flush", static_gedcom_writer_flush, 0 );
+  rb_define_method( cWriter, "close", static_gedcom_writer_close, 0 );
+  rb_define_method( cWriter, "lines", static_gedcom_writer_lines, 0 );
+
+  rb_define_module_function( mGEDCOM, "scan_records", static_gedcom_scan_records, 1 );
+  rb_define_module_function( mGEDCOM, "export_events", static_gedcom_export_events, -1 );
+
+  cQuery = rb_define_class_under( mGEDCOM, "Query", rb_cObject );
+
+  rb_undef_alloc_func( cQuery );
+  rb_define_singleton_method( cQuery, "new", static_gedcom_query_new, 1 );
+
+  rb_define_method( cQuery, "each", static_gedcom_query_each, 1 );
+  rb_define_method( cQuery, "run",  static_gedcom_query_run, 1 );
+
+  cRecord = rb_define_class_under( mGEDCOM, "Record", rb_cObject );
+
+  rb_include_module( cRecord, rb_mEnumerable );
+  rb_undef_alloc_func( cRecord );
+
+  rb_define_method( cRecord, "level",    static_gedcom_record_level, 0 );
+  rb_define_method( cRecord, "xref",     static_gedcom_record_xref, 0 );
+  rb_define_method( cRecord, "tag",      static_gedcom_record_tag, 0 );
+  rb_define_method( cRecord, "value",    static_gedcom_record_value, 0 );
+  rb_define_method( cRecord, "children", static_gedcom_record_children, 0 );
+  rb_define_method( cRecord, "each",     static_gedcom_record_each, 0 );
+  rb_define_method( cRecord, "[]",       static_gedcom_record_child, 1 );
+  rb_define_method( cRecord, "to_s",     static_gedcom_record_to_s, 0 );
+
+  rb_define_module_function( mGEDCOM, "each_record", static_gedcom_each_record, 1 );
+
+  rb_define_const( mGEDCOM, "PIPELINE_SLOTS", INT2FIX( gcPIPELINESLOTS ) );
+  rb_define_module_function( mGEDCOM, "each_event", static_gedcom_each_event, -1 );
+  rb_define_module_function( mGEDCOM, "each_event_batch", static_gedcom_each_event_batch, -1 );
+
+  cEventBatch = rb_define_class_under( mGEDCOM, "EventBatch", rb_cObject );
+
+  rb_include_module( cEventBatch, rb_mEnumerable );
+  rb_undef_alloc_func( cEventBatch );
+
+  rb_define_method( cEventBatch, "length", static_gedcom_eventbatch_length, 0 );
+  rb_define_method( cEventBatch, "size",   static_gedcom_eventbatch_length, 0 );
+  rb_define_method( cEventBatch, "level",  static_gedcom_eventbatch_level, 1 );
+  rb_define_method( cEventBatch, "tag",    static_gedcom_eventbatch_tag, 1 );
+  rb_define_method( cEventBatch, "value",  static_gedcom_eventbatch_value, 1 );
+  rb_define_method( cEventBatch, "levels", static_gedcom_eventbatch_levels, 0 );
+  rb_define_method( cEventBatch, "tags",   static_gedcom_eventbatch_tags, 0 );
+  rb_define_method( cEventBatch, "values", static_gedcom_eventbatch_values, 0 );
+  rb_define_method( cEventBatch, "each",   static_gedcom_eventbatch_each, 0 );
+
+  rb_define_const( mGEDCOM, "VALIDATE_LINE_LIMIT", INT2FIX( gcMAXVALIDATELINE ) );
+  rb_define_module_function( mGEDCOM, "validate", static_gedcom_validate, -1 );
+
+  rb_define_module_function( mGEDCOM, "diff", static_gedcom_diff, -1 );
+
+#ifdef HAVE_SQLITE3_H
+  rb_define_module_function( mGEDCOM, "to_sqlite", static_gedcom_to_sqlite, 2 );
+#else
+  rb_define_module_function( mGEDCOM, "to_sqlite", rb_f_notimplement, -1 );
+#endif
+
+  rb_define_module_function( mGEDCOM, "stats", static_gedcom_stats, -1 );
+
+  cDateColumn = rb_define_class_under( mGEDCOM, "DateColumn", rb_cObject );
+
+  rb_define_const( cDateColumn, "TAG_LIMIT", INT2FIX( gcMAXDATECOLUMNTAGS ) );
+
+  rb_undef_alloc_func( cDateColumn );
+  rb_define_singleton_method( cDateColumn, "new", static_gedcom_datecolumn_new, 0 );
+
+  rb_define_method( cDateColumn, "add",       static_gedcom_datecolumn_add, -1 );
+  rb_define_method( cDateColumn, "load",      static_gedcom_datecolumn_load, 1 );
+  rb_define_method( cDateColumn, "length",    static_gedcom_datecolumn_length, 0 );
+  rb_define_method( cDateColumn, "size",      static_gedcom_datecolumn_length, 0 );
+  rb_define_method( cDateColumn, "tags",      static_gedcom_datecolumn_tags, 0 );
+  rb_define_method( cDateColumn, "min",       static_gedcom_datecolumn_min, -1 );
+  rb_define_method( cDateColumn, "max",       static_gedcom_datecolumn_max, -1 );
+  rb_define_method( cDateColumn, "mask",      static_gedcom_datecolumn_mask, -1 );
+  rb_define_method( cDateColumn, "histogram", static_gedcom_datecolumn_histogram, -1 );
 }
@@ -0,0 +1,239 @@
+/* -------------------------------------------------------------------------
+ * gedcom_anniversary.c -- Defines the month/day anniversary index.
+ * Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+ * -------------------------------------------------------------------------
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ------------------------------------------------------------------------- */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "gedcom_types.h"
+#include "gedcom_date.h"
+#include "gedcom_idlist.h"
+#include "gedcom_anniversary.h"
+
+
+/* the index buckets every event by its day within a leap year, so that
+ * 29 Feb gets a bucket of its own.  This table holds the number of days
+ * that precede the first of each month in such a year. */
+
+static const int monthStart[] = {   0,  31,  60,  91, 121, 152,
+                                  182, 213, 244, 274, 305, 335, 366 };
+
+
+int getAnniversaryDay( int month, int day )
+{
+  if( month < 1 || month > gcANNIVERSARYMONTHS ) {
+    return -1;
+  }
+
+  if( day < 1 || day > monthStart[ month ] - monthStart[ month-1 ] ) {
+    return -1;
+  }
+
+  return monthStart[ month-1 ] + day - 1;
+}
+
+
+static gedANNIVERSARYEVENT_t* findEvent( gedANNIVERSARYINDEX_t *index, ofCHAR_t *tag )
+{
+  int i;
+
+  for( i = 0; i < index->count; i++ ) {
+    if( strcmp( (char*)index->events[ i ]->tag, (char*)tag ) == 0 ) {
+      return index->events[ i ];
+    }
+  }
+
+  return 0;
+}
+
+
+static gedANNIVERSARYEVENT_t* addEvent( gedANNIVERSARYINDEX_t *index, ofCHAR_t *tag )
+{
+  gedANNIVERSARYEVENT_t **events;
+  gedANNIVERSARYEVENT_t  *event;
+
+  if( strlen( (char*)tag ) >= gcMAXEVENTTAGSIZE ) {
+    return 0;
+  }
+
+  event = (gedANNIVERSARYEVENT_t*)calloc( 1, sizeof( gedANNIVERSARYEVENT_t ) );
+  if( event == 0 ) {
+    return 0;
+  }
+
+  events = (gedANNIVERSARYEVENT_t**)realloc( index->events, ( index->count + 1 ) * sizeof( event ) );
+  if( events == 0 ) {
+    free( event );
+    return 0;
+  }
+
+  strcpy( (char*)event->tag, (char*)tag );
+  events[ index->count++ ] = event;
+  index->events = events;
+
+  return event;
+}
+
+
+void initAnniversaryIndex( gedANNIVERSARYINDEX_t *index )
+{
+  index->events = 0;
+  index->count = 0;
+}
+
+
+void freeAnniversaryIndex( gedANNIVERSARYINDEX_t *index )
+{
+  int i;
+  int j;
+
+  for( i = 0; i < index->count; i++ ) {
+    for( j = 0; j < gcANNIVERSARYDAYS; j++ ) {
+      freeIdList( &( index->events[ i ]->days[ j ] ) );
+    }
+    for( j = 0; j < gcANNIVERSARYMONTHS; j++ ) {
+      freeIdList( &( index->events[ i ]->months[ j ] ) );
+    }
+    free( index->events[ i ] );
+  }
+
+  free( index->events );
+  initAnniversaryIndex( index );
+}
+
+
+/* the bytes allocated by the index, not counting the index itself */
+
+ofUI64_t getAnniversaryIndexMemory( gedANNIVERSARYINDEX_t *index )
+{
+  ofUI64_t memory;
+  int      i;
+  int      j;
+
+  memory = (ofUI64_t)index->count * sizeof( gedANNIVERSARYEVENT_t* );
+
+  for( i = 0; i < index->count; i++ ) {
+    memory += sizeof( gedANNIVERSARYEVENT_t );
+    for( j = 0; j < gcANNIVERSARYDAYS; j++ ) {
+      memory += getIdListMemory( &( index->events[ i ]->days[ j ] ) );
+    }
+    for( j = 0; j < gcANNIVERSARYMONTHS; j++ ) {
+      memory += getIdListMemory( &( index->events[ i ]->months[ j ] ) );
+    }
+  }
+
+  return memory;
+}
+
+
+/* returns 1 if the date was indexed, 0 if it has no usable month (phrases,
+ * statuses, non-gregorian/julian calendars, ...) and -1 if memory ran out */
+
+int addAnniversary( gedANNIVERSARYINDEX_t *index, ofCHAR_t *tag, ofUI32_t id, gedDATEVALUE_t *date )
+{
+  gedANNIVERSARYEVENT_t *event;
+  gedDATE_t             *first;
+  int                    yday;
+
+  first = &( date->date1 );
+
+  if( date->flags > gcINTERPRETED || first->flags != gfNONE ) {
+    return 0;
+  }
+
+  if( first->type != gctGREGORIAN && first->type != gctJULIAN ) {
+    return 0;
+  }
+
+  if( ( first->data.dateOther.flags & gfNOMONTH ) != 0 ||
+      first->data.dateOther.month > gcANNIVERSARYMONTHS )
+  {
+    return 0;
+  }
+
+  event = findEvent( index, tag );
+  if( event == 0 ) {
+    event = addEvent( index, tag );
+    if( event == 0 ) {
+      return -1;
+    }
+  }
+
+  if( appendIdList( &( event->months[ first->data.dateOther.month-1 ] ), id ) != 0 ) {
+    return -1;
+  }
+
+  /* dates without a day (gfNODAY) only go into the month bucket */
+
+  if( ( first->data.dateOther.flags & gfNODAY ) == 0 ) {
+    yday = getAnniversaryDay( first->data.dateOther.month, first->data.dateOther.day );
+    if( yday >= 0 && appendIdList( &( event->days[ yday ] ), id ) != 0 ) {
+      return -1;
+    }
+  }
+
+  return 1;
+}
+
+
+/* drops every event of the ids in 'removed', a unique id list */
+
+void removeAnniversaries( gedANNIVERSARYINDEX_t *index, gedIDLIST_t *removed )
+{
+  int i;
+  int j;
+
+  for( i = 0; i < index->count; i++ ) {
+    for( j = 0; j < gcANNIVERSARYDAYS; j++ ) {
+      removeIdsFromList( &( index->events[ i ]->days[ j ] ), removed );
+    }
+    for( j = 0; j < gcANNIVERSARYMONTHS; j++ ) {
+      removeIdsFromList( &( index->events[ i ]->months[ j ] ), removed );
+    }
+  }
+}
+
+
+gedIDLIST_t* findAnniversariesOn( gedANNIVERSARYINDEX_t *index, ofCHAR_t *tag, int month, int day )
+{
+  gedANNIVERSARYEVENT_t *event;
+  int                    yday;
+
+  event = findEvent( index, tag );
+  yday = getAnniversaryDay( month, day );
+
+  if( event == 0 || yday < 0 ) {
+    return 0;
+  }
+
+  return &( event->days[ yday ] );
+}
+
+
+gedIDLIST_t* findAnniversariesIn( gedANNIVERSARYINDEX_t *index, ofCHAR_t *tag, int month )
+{
+  gedANNIVERSARYEVENT_t *event;
+
+  event = findEvent( index, tag );
+
+  if( event == 0 || month < 1 || month > gcANNIVERSARYMONTHS ) {
+    return 0;
+  }
+
+  return &( event->months[ month-1 ] );
+}
@@ -0,0 +1,72 @@
+/* -------------------------------------------------------------------------
+ * gedcom_anniversary.h -- Defines the interface for the anniversary index.
+ * Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+ * -------------------------------------------------------------------------
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ------------------------------------------------------------------------- */
+
+#ifndef __GEDANNIVERSARY_H__
+#define __GEDANNIVERSARY_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "gedcom_types.h"
+#include "gedcom_date.h"
+#include "gedcom_idlist.h"
+
+/* bucket constants */
+
+  #define gcANNIVERSARYDAYS    ( 366 )  /* day of a leap year, 29 Feb included */
+  #define gcANNIVERSARYMONTHS  ( 12 )
+
+  #define gcMAXEVENTTAGSIZE    ( 32 )
+
+/* types */
+
+typedef struct {
+  ofCHAR_t    tag[ gcMAXEVENTTAGSIZE ];
+  gedIDLIST_t days[ gcANNIVERSARYDAYS ];
+  gedIDLIST_t months[ gcANNIVERSARYMONTHS ];
+} gedANNIVERSARYEVENT_t;
+
+typedef struct {
+  gedANNIVERSARYEVENT_t **events;
+  int                     count;
+} gedANNIVERSARYINDEX_t;
+
+
+int getAnniversaryDay( int month, int day );
+
+void initAnniversaryIndex( gedANNIVERSARYINDEX_t *index );
+
+void freeAnniversaryIndex( gedANNIVERSARYINDEX_t *index );
+
+ofUI64_t getAnniversaryIndexMemory( gedANNIVERSARYINDEX_t *index );
+
+int addAnniversary( gedANNIVERSARYINDEX_t *index, ofCHAR_t *tag, ofUI32_t id, gedDATEVALUE_t *date );
+
+void removeAnniversaries( gedANNIVERSARYINDEX_t *index, gedIDLIST_t *removed );
+
+gedIDLIST_t* findAnniversariesOn( gedANNIVERSARYINDEX_t *index, ofCHAR_t *tag, int month, int day );
+
+gedIDLIST_t* findAnniversariesIn( gedANNIVERSARYINDEX_t *index, ofCHAR_t *tag, int month );
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // __GEDANNIVERSARY_H__
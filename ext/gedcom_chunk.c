@@ -0,0 +1,205 @@
+/* -------------------------------------------------------------------------
+ * gedcom_chunk.c -- Defines the reader of files in level 0 chunks.
+ * Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+ * -------------------------------------------------------------------------
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ------------------------------------------------------------------------- */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gedcom_types.h"
+#include "gedcom_ctype.h"
+#include "gedcom_chunk.h"
+#include "gedcom_probes.h"
+
+
+/* whether a level 0 line starts at 'line'.  A 0 at the end of what has
+ * been read so far may yet be the start of a longer level. */
+
+static int isRecordStart( ofCHAR_t *line, ofCHAR_t *end )
+{
+  ofCHAR_t *p = line + spanGEDCOMClass( line, end - line, gccBLANK );
+
+  return ( p + 1 < end && p[ 0 ] == '0' && !isGEDCOMClass( p[ 1 ], gccDIGIT ) );
+}
+
+
+/* the first level 0 line at or after 'from' in [text, end), or 'end' */
+
+static ofCHAR_t* nextRecordStart( ofCHAR_t *text, ofCHAR_t *from, ofCHAR_t *end )
+{
+  ofCHAR_t *line;
+
+  if( from >= end ) {
+    return end;
+  }
+
+  if( from > text && from[ -1 ] != '\n' ) {
+    from = (ofCHAR_t*)memchr( from, '\n', end - from );
+    if( from == 0 ) {
+      return end;
+    }
+    from++;
+  }
+
+  for( line = from; line < end; line++ ) {
+    if( isRecordStart( line, end ) ) {
+      return line;
+    }
+    line = (ofCHAR_t*)memchr( line, '\n', end - line );
+    if( line == 0 ) {
+      return end;
+    }
+  }
+
+  return end;
+}
+
+
+/* the last level 0 line of [text, end) after the first byte, or 0 */
+
+static ofCHAR_t* lastRecordStart( ofCHAR_t *text, ofCHAR_t *end )
+{
+  ofCHAR_t *p;
+
+  for( p = end - 1; p > text; p-- ) {
+    if( p[ -1 ] == '\n' && isRecordStart( p, end ) ) {
+      return p;
+    }
+  }
+
+  return 0;
+}
+
+
+/* reads at least 'want' more bytes, unless the file ends first.  Returns
+ * -1 if memory ran out and -2 if reading failed. */
+
+static int readMore( gedCHUNKREADER_t *reader, ofUI64_t want )
+{
+  size_t read;
+
+  if( reader->size - reader->length < want ) {
+    ofUI64_t  size = reader->length + want;
+    ofCHAR_t *buffer = (ofCHAR_t*)realloc( reader->buffer, size );
+
+    if( buffer == 0 ) {
+      return -1;
+    }
+    reader->buffer = buffer;
+    reader->size = size;
+  }
+
+  read = fread( reader->buffer + reader->length, 1, want, reader->file );
+  reader->length += read;
+  gedPROBE2( buffer__refill, read, reader->size );
+
+  if( read < want ) {
+    if( ferror( reader->file ) ) {
+      reader->errnum = errno;
+      return -2;
+    }
+    reader->eof = 1;
+  }
+
+  return 0;
+}
+
+
+/* returns -1 if the file cannot be opened (see errno) */
+
+int openChunkReader( gedCHUNKREADER_t *reader, const char *path )
+{
+  memset( reader, 0, sizeof( *reader ) );
+
+  reader->file = fopen( path, "rb" );
+
+  return ( reader->file != 0 ) ? 0 : -1;
+}
+
+
+/* reads the next round of about 'count' * 'chunkSize' bytes and cuts it
+ * into 'count' chunks, the i-th from starts[ i ] to starts[ i + 1 ]; some
+ * may be empty.  The bytes kept from the last round start with a level 0
+ * line, so the cut has to come after it, and a record larger than a
+ * round is read whole.  Returns -1 if memory ran out and -2 if reading
+ * failed. */
+
+int readChunks( gedCHUNKREADER_t *reader, ofUI64_t chunkSize, int count, ofCHAR_t **starts )
+{
+  ofCHAR_t *text;
+  ofCHAR_t *cut;
+  ofUI64_t  want;
+  int       rc;
+  int       i;
+
+  want = (ofUI64_t)count * chunkSize;
+
+  for( ;; ) {
+    if( !reader->eof && ( rc = readMore( reader, want ) ) != 0 ) {
+      return rc;
+    }
+
+    text = reader->buffer;
+    if( reader->eof ) {
+      cut = text + reader->length;
+      break;
+    }
+    cut = lastRecordStart( text, text + reader->length );
+    if( cut != 0 ) {
+      break;
+    }
+    want = reader->length;
+  }
+
+  starts[ 0 ] = text;
+  for( i = 1; i < count; i++ ) {
+    starts[ i ] = nextRecordStart( text, starts[ i - 1 ] + ( cut - text ) / count, cut );
+  }
+  starts[ count ] = cut;
+  reader->cut = cut - text;
+
+  return 0;
+}
+
+
+/* drops the bytes of the round read last.  Returns 1 if there is more to
+ * read and 0 at the end of the file. */
+
+int skipChunks( gedCHUNKREADER_t *reader )
+{
+  reader->length -= reader->cut;
+  reader->offset += reader->cut;
+  memmove( reader->buffer, reader->buffer + reader->cut, reader->length );
+  reader->cut = 0;
+
+  return !( reader->eof && reader->length == 0 );
+}
+
+
+void closeChunkReader( gedCHUNKREADER_t *reader )
+{
+  if( reader->file != 0 ) {
+    fclose( reader->file );
+    reader->file = 0;
+  }
+
+  free( reader->buffer );
+  reader->buffer = 0;
+  reader->length = reader->size = reader->cut = 0;
+}
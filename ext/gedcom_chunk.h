@@ -0,0 +1,61 @@
+/* -------------------------------------------------------------------------
+ * gedcom_chunk.h -- Defines the interface for the chunked file reader.
+ * Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+ * -------------------------------------------------------------------------
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ------------------------------------------------------------------------- */
+
+#ifndef __GEDCHUNK_H__
+#define __GEDCHUNK_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+
+#include "gedcom_types.h"
+
+/* types */
+
+/* reads a file in rounds that end before a level 0 line, and cuts each
+ * round into chunks that also start at level 0 lines, so that each can be
+ * read on a thread of its own without knowing the lines before it */
+
+typedef struct {
+  FILE     *file;
+  ofCHAR_t *buffer;
+  ofUI64_t  length;
+  ofUI64_t  size;
+  ofUI64_t  offset;   /* of the buffer in the file */
+  ofUI64_t  cut;      /* bytes of the buffer the last round took */
+  int       eof;
+  int       errnum;   /* errno of a read error */
+} gedCHUNKREADER_t;
+
+
+int openChunkReader( gedCHUNKREADER_t *reader, const char *path );
+
+int readChunks( gedCHUNKREADER_t *reader, ofUI64_t chunkSize, int count, ofCHAR_t **starts );
+
+int skipChunks( gedCHUNKREADER_t *reader );
+
+void closeChunkReader( gedCHUNKREADER_t *reader );
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // __GEDCHUNK_H__
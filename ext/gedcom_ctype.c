@@ -0,0 +1,134 @@
+/* -------------------------------------------------------------------------
+ * gedcom_ctype.c -- Defines the character classes of the lexers.
+ * Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+ * -------------------------------------------------------------------------
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ------------------------------------------------------------------------- */
+
+#include <stddef.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "gedcom_types.h"
+#include "gedcom_ctype.h"
+
+
+/* the date lexer and the record scanner used to go through isspace() and
+ * friends, which follow LC_CTYPE (set from the environment by Ruby) and
+ * take a table lookup and a call per byte; this table gives the same
+ * classes under every locale. */
+
+#define SP  ( gccSPACE )
+#define BL  ( gccSPACE | gccBLANK )
+#define LE  ( gccSPACE | gccLINEEND )
+#define DG  ( gccDIGIT )
+#define UP  ( gccUPPER )
+#define LO  ( gccLOWER )
+
+const ofUI8_t gedCharClasses[ 256 ] = {
+   0,  0,  0,  0,  0,  0,  0,  0,  0, BL, LE, SP, SP, LE,  0,  0,  /* 0x00 */
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  /* 0x10 */
+  BL,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  /* 0x20 */
+  DG, DG, DG, DG, DG, DG, DG, DG, DG, DG,  0,  0,  0,  0,  0,  0,  /* 0x30 */
+   0, UP, UP, UP, UP, UP, UP, UP, UP, UP, UP, UP, UP, UP, UP, UP,  /* 0x40 */
+  UP, UP, UP, UP, UP, UP, UP, UP, UP, UP, UP,  0,  0,  0,  0,  0,  /* 0x50 */
+   0, LO, LO, LO, LO, LO, LO, LO, LO, LO, LO, LO, LO, LO, LO, LO,  /* 0x60 */
+  LO, LO, LO, LO, LO, LO, LO, LO, LO, LO, LO,  0,  0,  0,  0,  0   /* 0x70 */
+};
+
+#undef SP
+#undef BL
+#undef LE
+#undef DG
+#undef UP
+#undef LO
+
+
+#ifdef __SSE2__
+
+/* the same classes, for 16 bytes at a time.  Bytes in [ low, high ] are
+ * moved to the bottom of the signed range so that one signed compare
+ * tells whether they are in it. */
+
+static __m128i inRange( __m128i bytes, int low, int high )
+{
+  bytes = _mm_add_epi8( bytes, _mm_set1_epi8( (char)( 0x80 - low ) ) );
+  return _mm_cmplt_epi8( bytes, _mm_set1_epi8( (char)( 0x80 + high - low + 1 ) ) );
+}
+
+
+static __m128i isByte( __m128i bytes, int c )
+{
+  return _mm_cmpeq_epi8( bytes, _mm_set1_epi8( (char)c ) );
+}
+
+
+static int classifyBlock( const ofCHAR_t *text, int classes )
+{
+  __m128i bytes;
+  __m128i found;
+
+  bytes = _mm_loadu_si128( (const __m128i*)text );
+  found = _mm_setzero_si128();
+
+  if( classes & gccSPACE ) {
+    found = _mm_or_si128( found, _mm_or_si128( isByte( bytes, ' ' ), inRange( bytes, '\t', '\r' ) ) );
+  }
+  if( classes & gccBLANK ) {
+    found = _mm_or_si128( found, _mm_or_si128( isByte( bytes, ' ' ), isByte( bytes, '\t' ) ) );
+  }
+  if( classes & gccLINEEND ) {
+    found = _mm_or_si128( found, _mm_or_si128( isByte( bytes, '\n' ), isByte( bytes, '\r' ) ) );
+  }
+  if( classes & gccDIGIT ) {
+    found = _mm_or_si128( found, inRange( bytes, '0', '9' ) );
+  }
+  if( classes & gccUPPER ) {
+    found = _mm_or_si128( found, inRange( bytes, 'A', 'Z' ) );
+  }
+  if( classes & gccLOWER ) {
+    found = _mm_or_si128( found, inRange( bytes, 'a', 'z' ) );
+  }
+
+  return _mm_movemask_epi8( found );
+}
+
+#endif
+
+
+/* the number of bytes at the start of 'text' (of 'length' bytes) that
+ * belong to one of 'classes' */
+
+size_t spanGEDCOMClass( const ofCHAR_t *text, size_t length, int classes )
+{
+  size_t span;
+
+  span = 0;
+
+#ifdef __SSE2__
+  while( span + 16 <= length && classifyBlock( text + span, classes ) == 0xFFFF ) {
+    span += 16;
+  }
+#endif
+
+  while( span < length && isGEDCOMClass( text[ span ], classes ) ) {
+    span++;
+  }
+
+  return span;
+}
+
@@ -0,0 +1,58 @@
+/* -------------------------------------------------------------------------
+ * gedcom_ctype.h -- Defines the character classes of the lexers.
+ * Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+ * -------------------------------------------------------------------------
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ------------------------------------------------------------------------- */
+
+#ifndef __GEDCTYPE_H__
+#define __GEDCTYPE_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+#include "gedcom_types.h"
+
+/* character classes.  These are the classes of the C locale whatever the
+ * locale is, and bytes above 0x7F belong to none of them.  gccLOWER is the
+ * bit that tells a lower case letter from an upper case one, so that
+ * toGEDCOMUpper needs no table of its own. */
+
+  #define gccSPACE    ( 0x01 )  /* space, \t, \n, \v, \f and \r */
+  #define gccBLANK    ( 0x02 )  /* space and \t */
+  #define gccLINEEND  ( 0x04 )  /* \n and \r */
+  #define gccDIGIT    ( 0x08 )
+  #define gccUPPER    ( 0x10 )
+  #define gccLOWER    ( 0x20 )
+
+  #define gccALPHA    ( gccUPPER | gccLOWER )
+  #define gccALNUM    ( gccALPHA | gccDIGIT )
+
+extern const ofUI8_t gedCharClasses[ 256 ];
+
+#define isGEDCOMClass( c, classes )  ( ( gedCharClasses[ (ofCHAR_t)( c ) ] & ( classes ) ) != 0 )
+#define toGEDCOMUpper( c )           ( (ofCHAR_t)( c ) ^ ( gedCharClasses[ (ofCHAR_t)( c ) ] & gccLOWER ) )
+
+
+size_t spanGEDCOMClass( const ofCHAR_t *text, size_t length, int classes );
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // __GEDCTYPE_H__
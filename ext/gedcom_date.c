@@ -17,11 +17,14 @@
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  * ------------------------------------------------------------------------- */
 
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
 
 #include "gedcom_types.h"
+#include "gedcom_ctype.h"
 #include "gedcom_date.h"
+#include "gedcom_probes.h"
 
 
 /* general token defines */
@@ -138,18 +141,30 @@
 
 /* make sure this array is ALWAYS sorted by lexeme, ascending */
 
-static char *default_months[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun",
-                                  "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+static const char *const default_months[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                              "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
 
-static char *hebrew_months[] = { "Tishri", "Cheshvan", "Kislev", "Tevet", "Shevat", "Adar",
-                                 "Adar Sheni", "Nisan", "Iyar", "Sivan", "Tammuz", "Av",
-                                 "Elul", "Sheni" };
+static const char *const hebrew_months[] = { "Tishri", "Cheshvan", "Kislev", "Tevet", "Shevat", "Adar",
+                                             "Adar Sheni", "Nisan", "Iyar", "Sivan", "Tammuz", "Av",
+                                             "Elul", "Sheni" };
 
-static char *french_months[] = { "Vend", "Brum", "Frim", "Niv", "Pluv", "Vent", "Germ", "Flor",
-                                 "Prair", "Mess", "Therm", "Fruct", "J. Comp", "Jour", "Comp" };
+static const char *const french_months[] = { "Vend", "Brum", "Frim", "Niv", "Pluv", "Vent", "Germ", "Flor",
+                                             "Prair", "Mess", "Therm", "Fruct", "J. Comp", "Jour", "Comp" };
 
-static struct {
-  char *lexeme;
+/* the month codes of the GEDCOM date grammar, which buildGEDCOMDateText
+ * writes */
+
+static const char *const default_codes[] = { "JAN", "FEB", "MAR", "APR", "MAY", "JUN",
+                                             "JUL", "AUG", "SEP", "OCT", "NOV", "DEC" };
+
+static const char *const hebrew_codes[] = { "TSH", "CSH", "KSL", "TVT", "SHV", "ADR", "ADS",
+                                            "NSN", "IYR", "SVN", "TMZ", "AAV", "ELL" };
+
+static const char *const french_codes[] = { "VEND", "BRUM", "FRIM", "NIVO", "PLUV", "VENT", "GERM",
+                                             "FLOR", "PRAI", "MESS", "THER", "FRUC", "COMP" };
+
+static const struct {
+  const char *lexeme;
   int   general;
   int   specific;
 } tokenTable[] = {
@@ -162,6 +177,7 @@ static struct {
   { "ABT",             tkAPPROXIMATED,    tkABOUT },
   { "ADAR",            tkMONTH,           tkADAR },
   { "ADR",             tkMONTH,           tkADAR },
+  { "ADS",             tkMONTH,           tkADAR_SHENI },
   { "AFTER",           tkRANGE,           tkAFTER },
   { "AND",             tkAND,             0 },
   { "APRIL",           tkMONTH,           tkAPRIL },
@@ -176,6 +192,7 @@ static struct {
   { "CHESHVAN",        tkMONTH,           tkCHESHVAN },
   { "CHILD",           tkSTATUS,          tkCHILD },
   { "CLEARED",         tkSTATUS,          tkCLEARED },
+  { "COMP",            tkMONTH,           tkCOMP },
   { "COMPLETED",       tkSTATUS,          tkCOMPLETED },
   { "COMPLIMENTAIRS",  tkMONTH,           tkCOMP },
   { "CSH",             tkMONTH,           tkCHESHVAN },
@@ -267,12 +284,13 @@ typedef struct {
 
 typedef struct {
   char *buffer;
+  int   length;
   int   lastGeneralToken;
   int   lastSpecificToken;
   int   pos;
 } gedPARSER_STATE_t;
 
-static gedSTATE_ENTRY_t dateValueStateTable[] = {
+static const gedSTATE_ENTRY_t dateValueStateTable[] = {
   { ST_DV_START,        tkNUMBER,         ST_DV_DATE,          0 },  /* 0: inc dates read, parse a date */
   { ST_DV_START,        tkMONTH,          ST_DV_DATE,          0 },  /* 0: inc dates read, parse a date */
   { ST_DV_START,        tkAPPROXIMATED,   ST_DV_DATE_APPROX,   1 },  /* 1: set the approx type */
@@ -318,7 +336,7 @@ static gedSTATE_ENTRY_t dateValueStateTable[] = {
 };
 
 
-static gedSTATE_ENTRY_t dateStateTable[] = {
+static const gedSTATE_ENTRY_t dateStateTable[] = {
   { ST_DT_START,        tkNUMBER,        ST_DT_NUMBER,         0 }, /* 0: store number, set NUMBER */
   { ST_DT_START,        tkMONTH,         ST_DT_MONTH,          1 }, /* 1: if MONTH, then error, else set number to be day, set month, set MONTH */
 
@@ -340,10 +358,51 @@ static gedSTATE_ENTRY_t dateStateTable[] = {
 
 static void appendDateText( gedDATE_t *date, ofCHAR_t *buffer );
 
+static void appendDateCodes( gedDATE_t *date, ofCHAR_t *buffer );
+
+
+/* tokenTable is sorted, so the lexer finds the next token that could still
+ * match the lexeme read so far by galloping ahead from the current one
+ * (it is usually close) and searching the last stride it jumped.  Returns
+ * the index of the first token from 'first' on whose first 'length'
+ * characters do not sort before the lexeme's, or of the closing entry. */
+
+#define gcTOKENCOUNT  ( (int)( sizeof( tokenTable ) / sizeof( tokenTable[ 0 ] ) ) - 1 )
+
+static int findToken( int first, const char *lexeme, int length )
+{
+  int last;
+  int middle;
+  int step;
+
+  last = first;
+  step = 1;
+  while( last < gcTOKENCOUNT && strncmp( tokenTable[ last ].lexeme, lexeme, length ) < 0 ) {
+    first = last + 1;
+    last += step;
+    step *= 2;
+  }
+  if( last > gcTOKENCOUNT ) {
+    last = gcTOKENCOUNT;
+  }
+
+  while( first < last ) {
+    middle = first + ( last - first ) / 2;
+    if( strncmp( tokenTable[ middle ].lexeme, lexeme, length ) < 0 ) {
+      first = middle + 1;
+    } else {
+      last = middle;
+    }
+  }
+
+  return first;
+}
+
 
 static int getToken( gedPARSER_STATE_t* parser, int* specific ) {
   char lexeme[ 256 ];
   int  lexPos;
+  int  digits;
   int  currentToken;
   int  startPos;
 
@@ -359,8 +418,9 @@ static int getToken( gedPARSER_STATE_t* parser, int* specific ) {
   }
 
   /* eat leading white-space */
-  while( isspace( parser->buffer[ parser->pos ] ) ) {
-    parser->pos++;
+  if( isGEDCOMClass( parser->buffer[ parser->pos ], gccSPACE ) ) {
+    parser->pos += (int)spanGEDCOMClass( (ofCHAR_t*)parser->buffer + parser->pos,
+                                         parser->length - parser->pos, gccSPACE );
   }
 
   /* if the buffer is empty, return tkEOF */
@@ -369,34 +429,31 @@ static int getToken( gedPARSER_STATE_t* parser, int* specific ) {
     return tkEOF;
   }
 
-  lexPos = 0;
-
-  /* if it's a number, parse it out and return it */
+  /* if it's a number, parse it out and return it (digits that do not fit
+   * the lexeme are skipped) */
 
-  if( isdigit( parser->buffer[ parser->pos ] ) ) {
-    while( isdigit( parser->buffer[ parser->pos ] ) ) {
-      lexeme[ lexPos ] = parser->buffer[ parser->pos ];
-      parser->pos++;
-      lexPos++;
-    }
+  if( isGEDCOMClass( parser->buffer[ parser->pos ], gccDIGIT ) ) {
+    digits = (int)spanGEDCOMClass( (ofCHAR_t*)parser->buffer + parser->pos,
+                                   parser->length - parser->pos, gccDIGIT );
+    lexPos = ( digits < (int)sizeof( lexeme ) ) ? digits : (int)sizeof( lexeme ) - 1;
+    memcpy( lexeme, parser->buffer + parser->pos, lexPos );
     lexeme[ lexPos ] = 0;
+    parser->pos += digits;
     *specific = atoi( lexeme );
     return tkNUMBER;
   }
 
+  lexPos = 0;
   currentToken = 0;
 
   /* if it is not a number, incrementally look at each token in the table */
   while( tokenTable[ currentToken ].lexeme != 0 ) {
-    lexeme[ lexPos++ ] = toupper( parser->buffer[ parser->pos++ ] );
+    lexeme[ lexPos++ ] = toGEDCOMUpper( parser->buffer[ parser->pos ] );
+    parser->pos++;
     lexeme[ lexPos ] = 0;
 
     if( lexeme[ lexPos-1 ] != tokenTable[ currentToken ].lexeme[ lexPos-1 ] ) {
-      while( ( tokenTable[ currentToken ].lexeme != 0 ) && 
-             ( strncmp( tokenTable[ currentToken ].lexeme, lexeme, lexPos ) < 0 ) )
-      {
-        currentToken++;
-      }
+      currentToken = findToken( currentToken, lexeme, lexPos );
 
       /* if the lexeme does not appear in the table, exit with an error */
       if( tokenTable[ currentToken ].lexeme == 0 ||
@@ -407,17 +464,15 @@ static int getToken( gedPARSER_STATE_t* parser, int* specific ) {
     }
 
     /* if the lexeme terminates, return the value of the current token */
-    if( ( isalpha( lexeme[0] ) && !isalnum( parser->buffer[ parser->pos ] ) ) ||
-        ( !isalpha( lexeme[0] ) && ( tokenTable[ currentToken ].lexeme[ lexPos ] == 0 ) ) ) 
+    if( ( isGEDCOMClass( lexeme[0], gccALPHA ) && !isGEDCOMClass( parser->buffer[ parser->pos ], gccALNUM ) ) ||
+        ( !isGEDCOMClass( lexeme[0], gccALPHA ) && ( tokenTable[ currentToken ].lexeme[ lexPos ] == 0 ) ) ) 
     {
       *specific = tokenTable[ currentToken ].specific;
       return tokenTable[ currentToken ].general;
     }
 
-    if( tokenTable[ currentToken ].lexeme[ lexPos ] == '\0' ) {
-      /* if the current token terminates before the lexeme, then we have an error */
-      break;
-    }
+    /* if the current token terminates before the lexeme, a longer one that
+     * shares its prefix (DNS, DNSCAN) may still match on the next pass */
   }
 
   parser->pos = startPos;
@@ -689,6 +744,8 @@ int parseGEDCOMDate( ofCHAR_t* dateString, gedDATEVALUE_t* date, int type )
   memset( date, 0, sizeof( *date ) );
 
   parser.buffer = dateString;
+  parser.length = strlen( (char*)dateString );
+  gedPROBE2( date__parse__start, dateString, type );
 
   state = ST_DV_START;
   flags = gedfNONE;
@@ -778,19 +835,20 @@ int parseGEDCOMDate( ofCHAR_t* dateString, gedDATEVALUE_t* date, int type )
 
           /* 5: get remaining buffer as phrase */                             
           case 5:
-            strcpy( buffer, &(parser.buffer[ parser.pos ]) );
+            strncpy( buffer, &(parser.buffer[ parser.pos ]), sizeof( buffer ) - 1 );
+            buffer[ sizeof( buffer ) - 1 ] = '\0';
             i = strlen( buffer ) - 1;
-            while( ( i >= 0 ) && ( isspace( buffer[ i ] ) ) ) {
+            while( ( i >= 0 ) && isGEDCOMClass( buffer[ i ], gccSPACE ) ) {
               buffer[ i ] = '\0';
               i--;
             }
-            if( buffer[ i ] == ')' ) {
+            if( ( i >= 0 ) && ( buffer[ i ] == ')' ) ) {
               buffer[ i ] = '\0';
             }
-            strncpy( datePart->data.phrase, buffer, gcMAXPHRASEBUFFERSIZE );
-            datePart->data.phrase[ gcMAXPHRASEBUFFERSIZE ] = '\0';
+            strncpy( datePart->data.phrase, buffer, gcMAXPHRASEBUFFERSIZE - 1 );
+            datePart->data.phrase[ gcMAXPHRASEBUFFERSIZE - 1 ] = '\0';
             datePart->flags = gfPHRASE;
-            parser.pos = strlen( parser.buffer );
+            parser.pos = parser.length;
             break;
 
           /* 6: if 'between' and not second date read, error, else terminate */
@@ -876,10 +934,13 @@ int parseGEDCOMDate( ofCHAR_t* dateString, gedDATEVALUE_t* date, int type )
   if( state == ST_DV_ERROR ) {
     parser.pos = savePos;
     datePart->flags = gfNONSTANDARD;
-    strncpy( datePart->data.phrase, &( parser.buffer[ parser.pos ] ), gcMAXPHRASEBUFFERSIZE );
+    strncpy( datePart->data.phrase, &( parser.buffer[ parser.pos ] ), gcMAXPHRASEBUFFERSIZE - 1 );
+    datePart->data.phrase[ gcMAXPHRASEBUFFERSIZE - 1 ] = '\0';
+    gedPROBE2( date__parse__done, -1, date->flags );
     return -1;
   }
 
+  gedPROBE2( date__parse__done, 0, date->flags );
   return 0;
 }
 
@@ -936,9 +997,324 @@ void buildGEDCOMDatePartString( gedDATE_t *date, ofCHAR_t *buffer )
 }
 
 
+/* packs a gregorian (AD) or julian date into a single integer that sorts
+ * the way the dates do: year << 9 | month << 5 | day, with a missing month
+ * or day packed as zero.  Returns zero if the date has no usable year. */
+
+ofUI32_t packGEDCOMDate( gedDATE_t *date )
+{
+  ofUI32_t packed;
+
+  if( date->flags != gfNONE )
+    return 0;
+
+  if( date->type != gctGREGORIAN && date->type != gctJULIAN )
+    return 0;
+
+  if( date->type == gctGREGORIAN && date->data.dateGregorian.adbc != gedadbcAD )
+    return 0;
+
+  if( ( date->data.dateOther.flags & gfNOYEAR ) != 0 || date->data.dateOther.year == 0 )
+    return 0;
+
+  packed = (ofUI32_t)date->data.dateOther.year << 9;
+
+  if( ( date->data.dateOther.flags & gfNOMONTH ) == 0 )
+  {
+    packed |= date->data.dateOther.month << 5;
+    if( ( date->data.dateOther.flags & gfNODAY ) == 0 )
+      packed |= date->data.dateOther.day;
+  }
+
+  return packed;
+}
+
+
+/* day numbers of the gregorian and julian calendars.  Years are
+ * astronomical (1 BC is year 0) and both count from 1 March, so that the
+ * leap day falls at the end of the year; the divisions are arranged to
+ * round down for negative years as well. */
+
+static ofI32_t gregorianDay( ofI32_t year, int month, int day )
+{
+  ofI32_t era;
+  ofI32_t yearOfEra;
+  ofI32_t dayOfYear;
+
+  year -= ( month <= 2 );
+  era = ( year >= 0 ? year : year - 399 ) / 400;
+  yearOfEra = year - era * 400;
+  dayOfYear = ( 153 * ( month > 2 ? month - 3 : month + 9 ) + 2 ) / 5 + day - 1;
+
+  return era * 146097 + yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear + 1721120;
+}
+
+
+static ofI32_t julianDay( ofI32_t year, int month, int day )
+{
+  ofI32_t cycle;
+  ofI32_t yearOfCycle;
+  ofI32_t dayOfYear;
+
+  year -= ( month <= 2 );
+  cycle = ( year >= 0 ? year : year - 3 ) / 4;
+  yearOfCycle = year - cycle * 4;
+  dayOfYear = ( 153 * ( month > 2 ? month - 3 : month + 9 ) + 2 ) / 5 + day - 1;
+
+  return cycle * 1461 + yearOfCycle * 365 + dayOfYear + 1721118;
+}
+
+
+/* the julian day numbers of the first and last days a gregorian or julian
+ * date covers: a date without a month covers its whole year, one without a
+ * day its whole month.  Returns -1 if the date has no usable year. */
+
+int getGEDCOMDateDays( gedDATE_t *date, ofI32_t *first, ofI32_t *last )
+{
+  static const int monthDays[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+  ofI32_t    year;
+  int        month1;
+  int        month2;
+  int        day1;
+  int        day2;
+  int        leap;
+
+  if( date->flags != gfNONE )
+    return -1;
+
+  if( date->type != gctGREGORIAN && date->type != gctJULIAN )
+    return -1;
+
+  if( ( date->data.dateOther.flags & gfNOYEAR ) != 0 || date->data.dateOther.year == 0 )
+    return -1;
+
+  year = date->data.dateOther.year;
+  if( date->type == gctGREGORIAN && date->data.dateGregorian.adbc == gedadbcBC )
+    year = 1 - year;
+
+  if( ( date->data.dateOther.flags & gfNOMONTH ) != 0 )
+  {
+    month1 = 1;
+    month2 = 12;
+  }
+  else if( date->data.dateOther.month < 1 || date->data.dateOther.month > 12 )
+    return -1;
+  else
+    month1 = month2 = date->data.dateOther.month;
+
+  if( date->type == gctGREGORIAN )
+    leap = ( year % 4 == 0 && year % 100 != 0 ) || year % 400 == 0;
+  else
+    leap = ( year % 4 == 0 );
+
+  if( ( date->data.dateOther.flags & ( gfNOMONTH | gfNODAY ) ) != 0 )
+  {
+    day1 = 1;
+    day2 = monthDays[ month2-1 ] + ( month2 == 2 && leap );
+  }
+  else
+    day1 = day2 = date->data.dateOther.day;
+
+  if( date->type == gctGREGORIAN )
+  {
+    *first = gregorianDay( year, month1, day1 );
+    *last = gregorianDay( year, month2, day2 );
+  }
+  else
+  {
+    *first = julianDay( year, month1, day1 );
+    *last = julianDay( year, month2, day2 );
+  }
+
+  return 0;
+}
+
+
+/* the days a whole date value can fall on: open ended for BEF, AFT, FROM
+ * and TO, from the start of the first date to the end of the second for
+ * BET and FROM/TO.  Days that are not known are 0. */
+
+void getGEDCOMDateValueDays( gedDATEVALUE_t *date, ofI32_t *first, ofI32_t *last )
+{
+  ofI32_t unused;
+
+  *first = *last = 0;
+
+  switch( date->flags )
+  {
+    case gcBEFORE:
+    case gcTO:
+      getGEDCOMDateDays( &date->date1, &unused, last );
+      break;
+
+    case gcAFTER:
+    case gcFROM:
+      getGEDCOMDateDays( &date->date1, first, &unused );
+      break;
+
+    case gcBETWEEN:
+    case gcFROMTO:
+      if( getGEDCOMDateDays( &date->date1, first, &unused ) != 0 ||
+          getGEDCOMDateDays( &date->date2, &unused, last ) != 0 )
+      {
+        *first = *last = 0;
+      }
+      break;
+
+    case gcNONE:
+    case gcABOUT:
+    case gcCALCULATED:
+    case gcESTIMATED:
+    case gcINTERPRETED:
+      getGEDCOMDateDays( &date->date1, first, last );
+      break;
+  }
+}
+
+
+/* the gregorian date of a julian day number, the reverse of gregorianDay:
+ * years are astronomical, as there */
+
+void getGEDCOMCivilDate( ofI32_t jdn, ofI32_t *year, int *month, int *day )
+{
+  ofI64_t days;
+  ofI64_t era;
+  ofI64_t dayOfEra;
+  ofI64_t yearOfEra;
+  ofI64_t dayOfYear;
+  int     shifted;
+
+  days = (ofI64_t)jdn - 1721120;
+  era = ( days >= 0 ? days : days - 146096 ) / 146097;
+  dayOfEra = days - era * 146097;
+  yearOfEra = ( dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096 ) / 365;
+  dayOfYear = dayOfEra - ( 365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100 );
+  shifted = (int)( ( 5 * dayOfYear + 2 ) / 153 );
+
+  *day = (int)( dayOfYear - ( 153 * shifted + 2 ) / 5 + 1 );
+  *month = ( shifted < 10 ) ? shifted + 3 : shifted - 9;
+  *year = (ofI32_t)( yearOfEra + era * 400 + ( *month <= 2 ) );
+}
+
+
+/* writes 'date' as the value of a DATE line in the GEDCOM date grammar
+ * (upper case keywords and month codes, phrases in parentheses and the
+ * calendar escape of a date that is not gregorian), which parses back to
+ * the same date.  'buffer' must hold gcMAXDATETEXTSIZE bytes. */
+
+void buildGEDCOMDateText( gedDATEVALUE_t *date, ofCHAR_t *buffer )
+{
+  *buffer = '\0';
+
+  switch( date->flags )
+  {
+    case gcCHILD:       strcat( buffer, "CHILD" ); return;
+    case gcCLEARED:     strcat( buffer, "CLEARED" ); return;
+    case gcCOMPLETED:   strcat( buffer, "COMPLETED" ); return;
+    case gcINFANT:      strcat( buffer, "INFANT" ); return;
+    case gcPRE1970:     strcat( buffer, "PRE1970" ); return;
+    case gcQUALIFIED:   strcat( buffer, "QUALIFIED" ); return;
+    case gcSTILLBORN:   strcat( buffer, "STILLBORN" ); return;
+    case gcSUBMITTED:   strcat( buffer, "SUBMITTED" ); return;
+    case gcUNCLEARED:   strcat( buffer, "UNCLEARED" ); return;
+    case gcBIC:         strcat( buffer, "BIC" ); return;
+    case gcDNS:         strcat( buffer, "DNS" ); return;
+    case gcDNSCAN:      strcat( buffer, "DNSCAN" ); return;
+    case gcDEAD:        strcat( buffer, "DEAD" ); return;
+  }
+
+  if( date->date1.flags == gfNONE )
+  {
+    switch( date->date1.type )
+    {
+      case gctJULIAN:  strcat( buffer, "@#DJULIAN@ " ); break;
+      case gctHEBREW:  strcat( buffer, "@#DHEBREW@ " ); break;
+      case gctFRENCH:  strcat( buffer, "@#DFRENCH R@ " ); break;
+      case gctUNKNOWN: strcat( buffer, "@#DUNKNOWN@ " ); break;
+    }
+  }
+
+  switch( date->flags )
+  {
+    case gcABOUT:       strcat( buffer, "ABT " ); break;
+    case gcCALCULATED:  strcat( buffer, "CAL " ); break;
+    case gcESTIMATED:   strcat( buffer, "EST " ); break;
+    case gcBEFORE:      strcat( buffer, "BEF " ); break;
+    case gcAFTER:       strcat( buffer, "AFT " ); break;
+    case gcBETWEEN:     strcat( buffer, "BET " ); break;
+    case gcFROM:
+    case gcFROMTO:      strcat( buffer, "FROM " ); break;
+    case gcTO:          strcat( buffer, "TO " ); break;
+    case gcINTERPRETED: strcat( buffer, "INT " ); break;
+  }
+
+  appendDateCodes( &date->date1, buffer );
+
+  switch( date->flags )
+  {
+    case gcBETWEEN:     strcat( buffer, " AND " ); break;
+    case gcFROMTO:      strcat( buffer, " TO " ); break;
+    case gcINTERPRETED:
+      if( date->date2.flags != gfPHRASE )
+        return;
+      strcat( buffer, " " );
+      break;
+    default: return;
+  }
+
+  appendDateCodes( &date->date2, buffer );
+}
+
+
+/* parses the value of a DATE line, 'length' bytes that need not be
+ * terminated and may start with a calendar escape ("@#DJULIAN@ ...").
+ * Returns -1 if the escape is unknown or the date does not parse. */
+
+int parseGEDCOMDateText( ofCHAR_t *text, ofUI32_t length, gedDATEVALUE_t *date )
+{
+  static const char *calendars[] = { "DGREGORIAN", "DJULIAN", "DHEBREW", "DFRENCH R", "DUNKNOWN", 0 };
+  static const int   types[] = { gctGREGORIAN, gctJULIAN, gctHEBREW, gctFRENCH, gctUNKNOWN };
+  ofCHAR_t           buffer[ gcMAXDATETEXTSIZE ];
+  ofCHAR_t          *end = text + length;
+  ofCHAR_t          *close;
+  int                type;
+  int                i;
+
+  type = gctDEFAULT;
+
+  if( length >= 2 && text[ 0 ] == '@' && text[ 1 ] == '#' )
+  {
+    close = (ofCHAR_t*)memchr( text + 2, '@', length - 2 );
+    if( close == 0 )
+      return -1;
+
+    for( i = 0; calendars[ i ] != 0; i++ )
+    {
+      if( strlen( calendars[ i ] ) == (size_t)( close - text - 2 ) &&
+          memcmp( calendars[ i ], text + 2, close - text - 2 ) == 0 )
+        break;
+    }
+    if( calendars[ i ] == 0 )
+      return -1;
+    type = types[ i ];
+
+    for( text = close + 1; text < end && isGEDCOMClass( *text, gccBLANK ); text++ )
+      ;
+  }
+
+  if( end - text >= gcMAXDATETEXTSIZE || memchr( text, '\0', end - text ) != 0 )
+    return -1;
+
+  memcpy( buffer, text, end - text );
+  buffer[ end - text ] = '\0';
+
+  return parseGEDCOMDate( buffer, date, type );
+}
+
+
 static void appendDateText( gedDATE_t *date, ofCHAR_t *buffer )
 {
-  char **months;
+  const char *const *months;
   char   temp[20];
 
   switch( date->flags )
@@ -949,6 +1325,12 @@ static void appendDateText( gedDATE_t *date, ofCHAR_t *buffer )
       return;
   }
 
+  /* a part that was never parsed (an empty date, the second part of a
+   * single date) has no fields at all, not even the "no ..." flags */
+
+  if( date->data.dateOther.flags == 0 && date->data.dateOther.month == 0 )
+    return;
+
   switch( date->type )
   {
     case gctHEBREW:
@@ -995,3 +1377,71 @@ static void appendDateText( gedDATE_t *date, ofCHAR_t *buffer )
     strcat( buffer, " BC" );
   }
 }
+
+
+/* as appendDateText, in the GEDCOM date grammar */
+
+static void appendDateCodes( gedDATE_t *date, ofCHAR_t *buffer )
+{
+  const char *const *codes;
+  char   temp[20];
+
+  switch( date->flags )
+  {
+    case gfPHRASE:
+      strcat( buffer, "(" );
+      strcat( buffer, date->data.phrase );
+      strcat( buffer, ")" );
+      return;
+
+    case gfNONSTANDARD:
+      strcat( buffer, date->data.phrase );
+      return;
+  }
+
+  if( date->data.dateOther.flags == 0 && date->data.dateOther.month == 0 )
+    return;
+
+  switch( date->type )
+  {
+    case gctHEBREW:
+      codes = hebrew_codes;
+      break;
+
+    case gctFRENCH:
+      codes = french_codes;
+      break;
+
+    default:
+      codes = default_codes;
+  }
+
+  if( ( date->data.dateOther.flags & gfNODAY ) == 0 )
+  {
+    sprintf( temp, "%d ", date->data.dateOther.day );
+    strcat( buffer, temp );
+  }
+
+  if( ( date->data.dateOther.flags & gfNOMONTH ) == 0 )
+  {
+    strcat( buffer, codes[ date->data.dateOther.month-1 ] );
+    if( ( date->data.dateOther.flags & gfNOYEAR ) == 0 )
+      strcat( buffer, " " );
+  }
+
+  if( ( date->data.dateOther.flags & gfNOYEAR ) == 0 )
+  {
+    sprintf( temp, "%d", date->data.dateOther.year );
+    strcat( buffer, temp );
+    if( date->type == gctGREGORIAN && ( date->data.dateGregorian.flags & gfYEARSPAN ) != 0 )
+    {
+      sprintf( temp, "/%02d", date->data.dateGregorian.year2 );
+      strcat( buffer, temp );
+    }
+  }
+
+  if( date->type == gctGREGORIAN && date->data.dateGregorian.adbc != gedadbcAD )
+  {
+    strcat( buffer, " BC" );
+  }
+}
@@ -96,6 +96,7 @@ extern "C" {
 /* data type constants */
 
   #define gcMAXPHRASEBUFFERSIZE  ( 35 )
+  #define gcMAXDATETEXTSIZE      ( 256 )  /* DATE values parseGEDCOMDateText takes */
 
 /* types */
 
@@ -145,6 +146,18 @@ void buildGEDCOMDateString( gedDATEVALUE_t *date, ofCHAR_t *buffer );
 
 void buildGEDCOMDatePartString( gedDATE_t *date, ofCHAR_t *buffer );
 
+void buildGEDCOMDateText( gedDATEVALUE_t *date, ofCHAR_t *buffer );
+
+ofUI32_t packGEDCOMDate( gedDATE_t *date );
+
+int getGEDCOMDateDays( gedDATE_t *date, ofI32_t *first, ofI32_t *last );
+
+void getGEDCOMDateValueDays( gedDATEVALUE_t *date, ofI32_t *first, ofI32_t *last );
+
+void getGEDCOMCivilDate( ofI32_t jdn, ofI32_t *year, int *month, int *day );
+
+int parseGEDCOMDateText( ofCHAR_t *text, ofUI32_t length, gedDATEVALUE_t *date );
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
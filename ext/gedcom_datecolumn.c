@@ -0,0 +1,536 @@
+/* -------------------------------------------------------------------------
+ * gedcom_datecolumn.c -- Defines the date column and its histogram kernels.
+ * Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+ * -------------------------------------------------------------------------
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ------------------------------------------------------------------------- */
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "gedcom_types.h"
+#include "gedcom_date.h"
+#include "gedcom_stream.h"
+#include "gedcom_datecolumn.h"
+
+
+/* The column keeps the dates it is given as three arrays side by side:
+ * the key of each date, its qualifier and its tag.  Charts only ever need
+ * those, and scanning a few bytes a date in order is what keeps them quick
+ * on whole trees.  The kernels below go through the keys four at a time
+ * with SSE2 where the compiler has it (as gedcom_ctype.c does) and one at
+ * a time otherwise, giving the same results. */
+
+
+void initDateColumn( gedDATECOLUMN_t *column )
+{
+  memset( column, 0, sizeof( *column ) );
+}
+
+
+void freeDateColumn( gedDATECOLUMN_t *column )
+{
+  free( column->keys );
+  free( column->qualifiers );
+  free( column->tags );
+  initDateColumn( column );
+}
+
+
+/* the bytes allocated by the column, not counting the column itself */
+
+ofUI64_t getDateColumnMemory( gedDATECOLUMN_t *column )
+{
+  return (ofUI64_t)column->size * ( sizeof( ofI32_t ) + 2 * sizeof( ofUI8_t ) );
+}
+
+
+/* the key of a date value: that of its first date, at the day in the middle
+ * of the days that date covers, so that a julian month or year keeps its
+ * own month or year in the gregorian calendar.  Returns -1 for dates that
+ * have no gregorian or julian year, and for statuses (gcCHILD, ...). */
+
+int getDateColumnKey( gedDATEVALUE_t *date, ofI32_t *key )
+{
+  ofI32_t first;
+  ofI32_t last;
+  ofI32_t year;
+  int     month;
+  int     day;
+
+  if( date->flags > gcINTERPRETED ) {
+    return -1;
+  }
+
+  if( getGEDCOMDateDays( &date->date1, &first, &last ) != 0 ) {
+    return -1;
+  }
+
+  getGEDCOMCivilDate( first + ( last - first ) / 2, &year, &month, &day );
+  if( year > gcMAXDATECOLUMNYEAR || year < -gcMAXDATECOLUMNYEAR ) {
+    return -1;
+  }
+
+  if( ( date->date1.data.dateOther.flags & gfNOMONTH ) != 0 ) {
+    month = day = 0;
+  } else if( ( date->date1.data.dateOther.flags & gfNODAY ) != 0 ) {
+    day = 0;
+  }
+
+  *key = makeDateKey( year, month, day );
+
+  return 0;
+}
+
+
+/* the index of 'tag' in the column's tags, adding it if it is new.
+ * Returns -1 if it is too long, holds a NUL or there are too many tags. */
+
+static int findTag( gedDATECOLUMN_t *column, ofCHAR_t *tag, ofUI32_t length )
+{
+  int i;
+
+  if( length >= gcMAXDATECOLUMNTAG || memchr( tag, 0, length ) != 0 ) {
+    return -1;
+  }
+
+  i = column->lastTag;
+  if( i < column->tagCount && memcmp( column->tagNames[ i ], tag, length ) == 0 &&
+      column->tagNames[ i ][ length ] == 0 )
+  {
+    return i;
+  }
+
+  for( i = 0; i < column->tagCount; i++ ) {
+    if( memcmp( column->tagNames[ i ], tag, length ) == 0 && column->tagNames[ i ][ length ] == 0 ) {
+      return column->lastTag = i;
+    }
+  }
+
+  if( column->tagCount == gcMAXDATECOLUMNTAGS ) {
+    return -1;
+  }
+
+  memcpy( column->tagNames[ i ], tag, length );
+  column->tagNames[ i ][ length ] = 0;
+
+  return column->lastTag = column->tagCount++;
+}
+
+
+static int growDateColumn( gedDATECOLUMN_t *column )
+{
+  ofUI32_t  size = ( column->size == 0 ) ? 1024 : column->size * 2;
+  ofI32_t  *keys;
+  ofUI8_t  *qualifiers;
+  ofUI8_t  *tags;
+
+  if( size <= column->size ) {
+    return -1;
+  }
+
+  keys = (ofI32_t*)realloc( column->keys, size * sizeof( ofI32_t ) );
+  if( keys == 0 ) {
+    return -1;
+  }
+  column->keys = keys;
+
+  qualifiers = (ofUI8_t*)realloc( column->qualifiers, size );
+  if( qualifiers == 0 ) {
+    return -1;
+  }
+  column->qualifiers = qualifiers;
+
+  tags = (ofUI8_t*)realloc( column->tags, size );
+  if( tags == 0 ) {
+    return -1;
+  }
+  column->tags = tags;
+  column->size = size;
+
+  return 0;
+}
+
+
+/* adds 'date' under 'tag' ('tagLength' bytes, or none if 'tag' is 0).
+ * Returns 1 if it was added, 0 if it has no key, -1 if memory ran out and
+ * -2 if the tag cannot be kept (see findTag). */
+
+int addDateColumn( gedDATECOLUMN_t *column, gedDATEVALUE_t *date, ofCHAR_t *tag, ofUI32_t tagLength )
+{
+  ofI32_t key;
+  int     index;
+
+  if( getDateColumnKey( date, &key ) != 0 ) {
+    return 0;
+  }
+
+  index = gcNODATECOLUMNTAG;
+  if( tag != 0 ) {
+    index = findTag( column, tag, tagLength );
+    if( index < 0 ) {
+      return -2;
+    }
+  }
+
+  if( column->count == column->size && growDateColumn( column ) != 0 ) {
+    return -1;
+  }
+
+  column->keys[ column->count ] = key;
+  column->qualifiers[ column->count ] = date->flags;
+  column->tags[ column->count ] = (ofUI8_t)index;
+  column->count++;
+
+  return 1;
+}
+
+
+static int isNodeTag( ofCHAR_t *base, gedNODE_t *node, const char *tag )
+{
+  return node->tagLength == strlen( tag ) && memcmp( base + node->tagOffset, tag, node->tagLength ) == 0;
+}
+
+
+/* adds the first DATE under each level 1 line (but CHAN) of the reader's
+ * record if it is an INDI or FAM, under the level 1 tag.  A date whose tag
+ * cannot be kept is added without one. */
+
+static int addRecordDates( gedDATECOLUMN_t *column, gedRECORDREADER_t *reader, ofUI64_t *added )
+{
+  ofCHAR_t      *base = reader->buffer + reader->start;
+  gedNODE_t     *nodes = reader->nodes;
+  gedDATEVALUE_t date;
+  ofUI32_t       event;
+  ofUI32_t       child;
+  int            rc;
+
+  if( reader->count == 0 || ( !isNodeTag( base, &nodes[ 0 ], "INDI" ) && !isNodeTag( base, &nodes[ 0 ], "FAM" ) ) ) {
+    return 0;
+  }
+
+  for( event = nodes[ 0 ].firstChild; event != gcNONODE; event = nodes[ event ].next ) {
+    if( isNodeTag( base, &nodes[ event ], "CHAN" ) ) {
+      continue;
+    }
+
+    for( child = nodes[ event ].firstChild; child != gcNONODE && !isNodeTag( base, &nodes[ child ], "DATE" ); ) {
+      child = nodes[ child ].next;
+    }
+    if( child == gcNONODE ||
+        parseGEDCOMDateText( base + nodes[ child ].valueOffset, nodes[ child ].valueLength, &date ) != 0 )
+    {
+      continue;
+    }
+
+    rc = addDateColumn( column, &date, base + nodes[ event ].tagOffset, nodes[ event ].tagLength );
+    if( rc == -2 ) {
+      rc = addDateColumn( column, &date, 0, 0 );
+    }
+    if( rc < 0 ) {
+      return rc;
+    }
+    *added += rc;
+  }
+
+  return 0;
+}
+
+
+/* adds the event dates of up to gcDATECOLUMNROUND records of 'reader',
+ * counting them in 'added'.  Returns 1 while there are more records, 0
+ * once the file is read, -1 if memory ran out and -2 if reading failed. */
+
+int loadDateColumn( gedDATECOLUMN_t *column, gedRECORDREADER_t *reader, ofUI64_t *added )
+{
+  int i;
+  int rc;
+
+  for( i = 0; i < gcDATECOLUMNROUND; i++ ) {
+    rc = readGEDCOMRecord( reader );
+    if( rc <= 0 ) {
+      return rc;
+    }
+
+    if( addRecordDates( column, reader, added ) != 0 ) {
+      return -1;
+    }
+  }
+
+  return 1;
+}
+
+
+#ifdef __SSE2__
+
+/* all ones in the lanes whose key is outside [ from, to ] */
+
+static __m128i outsideRange( __m128i keys, __m128i from, __m128i to )
+{
+  return _mm_or_si128( _mm_cmplt_epi32( keys, from ), _mm_cmpgt_epi32( keys, to ) );
+}
+
+
+static __m128i selectLanes( __m128i mask, __m128i a, __m128i b )
+{
+  return _mm_or_si128( _mm_and_si128( mask, a ), _mm_andnot_si128( mask, b ) );
+}
+
+#endif
+
+
+/* the smallest and largest keys in [ from, to ].  Returns -1 if there are
+ * none. */
+
+int getDateColumnRange( gedDATECOLUMN_t *column, ofI32_t from, ofI32_t to, ofI32_t *min, ofI32_t *max )
+{
+  const ofI32_t *keys = column->keys;
+  ofUI32_t       i;
+  ofI32_t        low;
+  ofI32_t        high;
+
+  low = INT_MAX;
+  high = INT_MIN;
+  i = 0;
+
+#ifdef __SSE2__
+  {
+    __m128i vfrom = _mm_set1_epi32( from );
+    __m128i vto = _mm_set1_epi32( to );
+    __m128i vlow = _mm_set1_epi32( INT_MAX );
+    __m128i vhigh = _mm_set1_epi32( INT_MIN );
+    __m128i k;
+    __m128i out;
+    ofI32_t lanes[ 8 ];
+    int     j;
+
+    for( ; i + 4 <= column->count; i += 4 ) {
+      k = _mm_loadu_si128( (const __m128i*)( keys + i ) );
+      out = outsideRange( k, vfrom, vto );
+      vlow = selectLanes( _mm_or_si128( out, _mm_cmpgt_epi32( k, vlow ) ), vlow, k );
+      vhigh = selectLanes( _mm_or_si128( out, _mm_cmplt_epi32( k, vhigh ) ), vhigh, k );
+    }
+
+    _mm_storeu_si128( (__m128i*)lanes, vlow );
+    _mm_storeu_si128( (__m128i*)( lanes + 4 ), vhigh );
+    for( j = 0; j < 4; j++ ) {
+      low = ( lanes[ j ] < low ) ? lanes[ j ] : low;
+      high = ( lanes[ j + 4 ] > high ) ? lanes[ j + 4 ] : high;
+    }
+  }
+#endif
+
+  for( ; i < column->count; i++ ) {
+    if( keys[ i ] >= from && keys[ i ] <= to ) {
+      low = ( keys[ i ] < low ) ? keys[ i ] : low;
+      high = ( keys[ i ] > high ) ? keys[ i ] : high;
+    }
+  }
+
+  if( low > high ) {
+    return -1;
+  }
+
+  *min = low;
+  *max = high;
+
+  return 0;
+}
+
+
+/* sets bit i of 'mask' ((count + 7) / 8 bytes, the low bit of each byte
+ * first) when key i is in [ from, to ] and clears it otherwise */
+
+void maskDateColumn( gedDATECOLUMN_t *column, ofI32_t from, ofI32_t to, ofUI8_t *mask )
+{
+  const ofI32_t *keys = column->keys;
+  ofUI32_t       i;
+
+  memset( mask, 0, ( column->count + 7 ) / 8 );
+  i = 0;
+
+#ifdef __SSE2__
+  {
+    __m128i vfrom = _mm_set1_epi32( from );
+    __m128i vto = _mm_set1_epi32( to );
+    __m128i low;
+    __m128i high;
+
+    /* eight keys to a byte: the two halves' lanes packed down to bytes */
+
+    for( ; i + 8 <= column->count; i += 8 ) {
+      low = outsideRange( _mm_loadu_si128( (const __m128i*)( keys + i ) ), vfrom, vto );
+      high = outsideRange( _mm_loadu_si128( (const __m128i*)( keys + i + 4 ) ), vfrom, vto );
+      mask[ i / 8 ] = (ofUI8_t)~_mm_movemask_epi8( _mm_packs_epi16( _mm_packs_epi32( low, high ), _mm_setzero_si128() ) );
+    }
+  }
+#endif
+
+  for( ; i < column->count; i++ ) {
+    if( keys[ i ] >= from && keys[ i ] <= to ) {
+      mask[ i / 8 ] |= (ofUI8_t)( 1 << ( i % 8 ) );
+    }
+  }
+}
+
+
+/* the bucket of each of 'count' keys, or 'buckets' for those outside
+ * [ from, to ] or the buckets (and, by month, those without a month) */
+
+static void bucketKeys( const ofI32_t *keys, ofUI32_t count, int unit, ofI32_t first, ofUI32_t buckets,
+                        ofI32_t from, ofI32_t to, ofUI32_t *out )
+{
+  ofUI32_t i;
+  ofI32_t  bucket;
+
+  i = 0;
+
+#ifdef __SSE2__
+  {
+    __m128i vfrom = _mm_set1_epi32( from );
+    __m128i vto = _mm_set1_epi32( to );
+    __m128i vfirst = _mm_set1_epi32( unit == gcdcYEAR ? first : first + 1 );
+    __m128i vbuckets = _mm_set1_epi32( (int)buckets );
+    __m128i sign = _mm_set1_epi32( INT_MIN );
+    __m128i k;
+    __m128i years;
+    __m128i months;
+    __m128i b;
+    __m128i skip;
+
+    for( ; i + 4 <= count; i += 4 ) {
+      k = _mm_loadu_si128( (const __m128i*)( keys + i ) );
+      skip = outsideRange( k, vfrom, vto );
+      years = _mm_srai_epi32( k, 9 );
+
+      if( unit == gcdcYEAR ) {
+        b = _mm_sub_epi32( years, vfirst );
+      } else {
+        months = _mm_and_si128( _mm_srli_epi32( k, 5 ), _mm_set1_epi32( 15 ) );
+        skip = _mm_or_si128( skip, _mm_cmpeq_epi32( months, _mm_setzero_si128() ) );
+        b = _mm_add_epi32( _mm_add_epi32( _mm_slli_epi32( years, 3 ), _mm_slli_epi32( years, 2 ) ), months );
+        b = _mm_sub_epi32( b, vfirst );
+      }
+
+      /* an unsigned compare, by flipping the sign bits */
+
+      skip = _mm_or_si128( skip, _mm_cmpeq_epi32(
+               _mm_cmplt_epi32( _mm_xor_si128( b, sign ), _mm_xor_si128( vbuckets, sign ) ), _mm_setzero_si128() ) );
+      _mm_storeu_si128( (__m128i*)( out + i ), selectLanes( skip, vbuckets, b ) );
+    }
+  }
+#endif
+
+  for( ; i < count; i++ ) {
+    if( keys[ i ] < from || keys[ i ] > to ) {
+      out[ i ] = buckets;
+      continue;
+    }
+
+    if( unit == gcdcYEAR ) {
+      bucket = getDateKeyYear( keys[ i ] ) - first;
+    } else if( getDateKeyMonth( keys[ i ] ) == 0 ) {
+      out[ i ] = buckets;
+      continue;
+    } else {
+      bucket = getDateKeyYear( keys[ i ] ) * 12 + getDateKeyMonth( keys[ i ] ) - 1 - first;
+    }
+
+    out[ i ] = ( (ofUI32_t)bucket < buckets ) ? (ofUI32_t)bucket : buckets;
+  }
+}
+
+
+/* counts the dates with keys in [ from, to ] by year or month (the
+ * buckets running from the earliest such date to the latest), in one row
+ * or split by tag or qualifier.  Returns -1 if memory ran out and -2 if the
+ * histogram would be too large; the caller frees it with
+ * freeDateHistogram either way. */
+
+int countDateColumn( gedDATECOLUMN_t *column, int unit, int split, ofI32_t from, ofI32_t to,
+                     gedDATEHISTOGRAM_t *histogram )
+{
+  ofUI32_t buckets[ 256 ];
+  ofUI32_t stride;
+  ofUI32_t row;
+  ofUI32_t done;
+  ofUI32_t block;
+  ofUI32_t i;
+  ofI32_t  min;
+  ofI32_t  max;
+  ofI32_t  last;
+
+  memset( histogram, 0, sizeof( *histogram ) );
+
+  histogram->rows = ( split == gcdcBYTAG ) ? column->tagCount + 1 : ( split == gcdcBYQUALIFIER ) ? gcINTERPRETED + 1 : 1;
+
+  if( getDateColumnRange( column, from, to, &min, &max ) != 0 ) {
+    return 0;
+  }
+
+  if( unit == gcdcYEAR ) {
+    histogram->first = getDateKeyYear( min );
+    last = getDateKeyYear( max );
+  } else {
+    histogram->first = getDateKeyYear( min ) * 12;
+    last = getDateKeyYear( max ) * 12 + 11;
+  }
+
+  histogram->buckets = (ofUI32_t)( last - histogram->first + 1 );
+  stride = histogram->buckets + 1;
+  if( (ofUI64_t)stride * histogram->rows > gcMAXDATEHISTOGRAMSIZE ) {
+    histogram->buckets = 0;
+    return -2;
+  }
+
+  histogram->counts = (ofUI32_t*)calloc( (size_t)stride * histogram->rows, sizeof( ofUI32_t ) );
+  if( histogram->counts == 0 ) {
+    histogram->buckets = 0;
+    return -1;
+  }
+
+  /* the buckets of a block of keys at a time, then one add a key */
+
+  for( done = 0; done < column->count; done += block ) {
+    block = ( column->count - done < 256 ) ? column->count - done : 256;
+    bucketKeys( column->keys + done, block, unit, histogram->first, histogram->buckets, from, to, buckets );
+
+    for( i = 0; i < block; i++ ) {
+      if( split == gcdcBYTAG ) {
+        row = column->tags[ done + i ];
+        row = ( row == gcNODATECOLUMNTAG ) ? (ofUI32_t)column->tagCount : row;
+      } else if( split == gcdcBYQUALIFIER ) {
+        row = column->qualifiers[ done + i ];
+      } else {
+        row = 0;
+      }
+      histogram->counts[ row * stride + buckets[ i ] ]++;
+    }
+  }
+
+  return 0;
+}
+
+
+void freeDateHistogram( gedDATEHISTOGRAM_t *histogram )
+{
+  free( histogram->counts );
+  histogram->counts = 0;
+}
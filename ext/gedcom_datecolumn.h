@@ -0,0 +1,112 @@
+/* -------------------------------------------------------------------------
+ * gedcom_datecolumn.h -- Defines the interface for the date column.
+ * Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+ * -------------------------------------------------------------------------
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ------------------------------------------------------------------------- */
+
+#ifndef __GEDDATECOLUMN_H__
+#define __GEDDATECOLUMN_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "gedcom_types.h"
+#include "gedcom_date.h"
+#include "gedcom_stream.h"
+
+/* column constants */
+
+  #define gcMAXDATECOLUMNTAGS   ( 255 )
+  #define gcNODATECOLUMNTAG     ( 255 )   /* the tag of dates added without one */
+  #define gcMAXDATECOLUMNTAG    ( 32 )    /* bytes of a tag, the terminator included */
+  #define gcDATECOLUMNROUND     ( 4096 )  /* records loadDateColumn reads a round */
+
+/* histogram units */
+
+  #define gcdcYEAR         ( 0 )
+  #define gcdcMONTH        ( 1 )
+
+/* histogram splits */
+
+  #define gcdcALL          ( 0 )
+  #define gcdcBYTAG        ( 1 )   /* a row a tag, and one for no tag */
+  #define gcdcBYQUALIFIER  ( 2 )   /* a row a qualifier, gcNONE to gcINTERPRETED */
+
+  #define gcMAXDATECOLUMNYEAR     ( 1000000 )
+  #define gcMAXDATEHISTOGRAMSIZE  ( 1 << 26 )  /* counts in a histogram */
+
+/* a date's key packs its gregorian year, month and day as year << 9 |
+ * month << 5 | day, the year signed and astronomical (1 BC is year 0) and
+ * the month or day 0 where the date does not give them, so that keys sort
+ * as dates do.  Julian dates are moved to the gregorian calendar through
+ * their julian day number. */
+
+  #define getDateKeyYear( key )   ( ( key ) >> 9 )
+  #define getDateKeyMonth( key )  ( ( ( key ) >> 5 ) & 15 )
+  #define getDateKeyDay( key )    ( ( key ) & 31 )
+  #define makeDateKey( year, month, day )  ( (ofI32_t)( year ) * 512 + ( month ) * 32 + ( day ) )
+
+/* types */
+
+typedef struct {
+  ofI32_t  *keys;
+  ofUI8_t  *qualifiers;   /* the date value's flags, gcNONE to gcINTERPRETED */
+  ofUI8_t  *tags;         /* indexes into tagNames, or gcNODATECOLUMNTAG */
+  ofUI32_t  count;
+  ofUI32_t  size;
+  ofCHAR_t  tagNames[ gcMAXDATECOLUMNTAGS ][ gcMAXDATECOLUMNTAG ];
+  int       tagCount;
+  int       lastTag;      /* where the last tag looked up was found */
+} gedDATECOLUMN_t;
+
+/* a histogram has 'rows' rows of 'buckets' + 1 counts, the last of which
+ * takes the dates that fall in none of the buckets */
+
+typedef struct {
+  ofUI32_t *counts;
+  ofUI32_t  rows;
+  ofUI32_t  buckets;
+  ofI32_t   first;        /* the year, or year * 12 + month - 1, of bucket 0 */
+} gedDATEHISTOGRAM_t;
+
+
+void initDateColumn( gedDATECOLUMN_t *column );
+
+void freeDateColumn( gedDATECOLUMN_t *column );
+
+ofUI64_t getDateColumnMemory( gedDATECOLUMN_t *column );
+
+int getDateColumnKey( gedDATEVALUE_t *date, ofI32_t *key );
+
+int addDateColumn( gedDATECOLUMN_t *column, gedDATEVALUE_t *date, ofCHAR_t *tag, ofUI32_t tagLength );
+
+int loadDateColumn( gedDATECOLUMN_t *column, gedRECORDREADER_t *reader, ofUI64_t *added );
+
+int getDateColumnRange( gedDATECOLUMN_t *column, ofI32_t from, ofI32_t to, ofI32_t *min, ofI32_t *max );
+
+void maskDateColumn( gedDATECOLUMN_t *column, ofI32_t from, ofI32_t to, ofUI8_t *mask );
+
+int countDateColumn( gedDATECOLUMN_t *column, int unit, int split, ofI32_t from, ofI32_t to,
+                     gedDATEHISTOGRAM_t *histogram );
+
+void freeDateHistogram( gedDATEHISTOGRAM_t *histogram );
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // __GEDDATECOLUMN_H__
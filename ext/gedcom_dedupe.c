@@ -0,0 +1,497 @@
+/* -------------------------------------------------------------------------
+ * gedcom_dedupe.c -- Defines duplicate individual detection.
+ * Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+ * -------------------------------------------------------------------------
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ------------------------------------------------------------------------- */
+
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+#include "gedcom_types.h"
+#include "gedcom_date.h"
+#include "gedcom_name.h"
+#include "gedcom_dedupe.h"
+
+
+/* people are blocked on the soundex of their surname plus their birth
+ * year: the set is sorted on those keys, and each person is only compared
+ * with the next gcDEDUPEWINDOW people of the same block whose birth years
+ * are within gcDEDUPEYEARSLACK.  That keeps the work linear in the number
+ * of people, and the scans are split between worker threads. */
+
+/* 32-bit FNV-1a */
+
+static ofUI32_t hashName( ofCHAR_t *text, int length )
+{
+  ofUI32_t hash = 2166136261U;
+  int      i;
+
+  for( i = 0; i < length; i++ ) {
+    hash ^= text[ i ];
+    hash *= 16777619U;
+  }
+
+  return hash;
+}
+
+
+static ofUI32_t packDateValue( gedDATEVALUE_t *date )
+{
+  if( date == 0 ) {
+    return 0;
+  }
+
+  switch( date->flags ) {
+    case gcNONE:
+    case gcABOUT:
+    case gcCALCULATED:
+    case gcESTIMATED:
+    case gcINTERPRETED:
+      return packGEDCOMDate( &date->date1 );
+  }
+
+  return 0;
+}
+
+
+void initDedupeSet( gedDEDUPESET_t *set )
+{
+  set->people = 0;
+  set->count = 0;
+  set->size = 0;
+}
+
+
+void freeDedupeSet( gedDEDUPESET_t *set )
+{
+  free( set->people );
+  initDedupeSet( set );
+}
+
+
+/* the bytes allocated by the set, not counting the set itself */
+
+ofUI64_t getDedupeSetMemory( gedDEDUPESET_t *set )
+{
+  return (ofUI64_t)set->size * sizeof( gedDEDUPEPERSON_t );
+}
+
+
+/* returns 1 if the person was added, 0 if their name has no surname to
+ * block on and -1 if memory ran out */
+
+int addDedupePerson( gedDEDUPESET_t *set, ofUI32_t id, ofCHAR_t *name, ofCHAR_t *sex,
+                     gedDATEVALUE_t *birth, gedDATEVALUE_t *death,
+                     ofCHAR_t **relatives, int relativeCount )
+{
+  gedDEDUPEPERSON_t *person;
+  gedNAME_t          parts;
+  ofCHAR_t           normalized[ gcMAXNAMESIZE ];
+  int                length;
+  int                i;
+
+  splitGEDCOMName( name, &parts );
+
+  length = normalizeGEDCOMName( name + parts.surnameStart, parts.surnameLength, normalized, sizeof( normalized ) );
+  if( length == 0 ) {
+    return 0;
+  }
+
+  if( set->count == set->size ) {
+    ofUI32_t           size = ( set->size == 0 ) ? 256 : set->size * 2;
+    gedDEDUPEPERSON_t *people = (gedDEDUPEPERSON_t*)realloc( set->people, size * sizeof( gedDEDUPEPERSON_t ) );
+
+    if( people == 0 ) {
+      return -1;
+    }
+    set->people = people;
+    set->size = size;
+  }
+
+  person = &set->people[ set->count++ ];
+  memset( person, 0, sizeof( *person ) );
+
+  person->id = id;
+  person->surname = hashName( normalized, length );
+  soundexGEDCOMName( normalized, person->soundex );
+
+  /* only the first given name takes part */
+
+  length = normalizeGEDCOMName( name + parts.givenStart, parts.givenLength, normalized, sizeof( normalized ) );
+  for( i = 0; i < length && normalized[ i ] != ' '; i++ )
+    ;
+  if( i > 0 ) {
+    person->given = hashName( normalized, i );
+    person->initial = normalized[ 0 ];
+  }
+
+  if( sex != 0 && ( sex[ 0 ] == 'M' || sex[ 0 ] == 'F' ) ) {
+    person->sex = sex[ 0 ];
+  }
+
+  person->birth = packDateValue( birth );
+  person->death = packDateValue( death );
+
+  for( i = 0; i < relativeCount && person->relativeCount < gcMAXRELATIVES; i++ ) {
+    length = normalizeGEDCOMName( relatives[ i ], strlen( (char*)relatives[ i ] ), normalized, sizeof( normalized ) );
+    if( length > 0 ) {
+      person->relatives[ person->relativeCount++ ] = hashName( normalized, length );
+    }
+  }
+
+  return 1;
+}
+
+
+static int compareBlockKeys( const void *a, const void *b )
+{
+  const gedDEDUPEPERSON_t *x = (const gedDEDUPEPERSON_t*)a;
+  const gedDEDUPEPERSON_t *y = (const gedDEDUPEPERSON_t*)b;
+  int                      rc;
+
+  rc = strcmp( (char*)x->soundex, (char*)y->soundex );
+  if( rc != 0 ) {
+    return rc;
+  }
+
+  if( ( x->birth >> 9 ) != ( y->birth >> 9 ) ) {
+    return ( ( x->birth >> 9 ) < ( y->birth >> 9 ) ) ? -1 : 1;
+  }
+
+  if( x->given != y->given ) {
+    return ( x->given < y->given ) ? -1 : 1;
+  }
+
+  return ( x->id < y->id ) ? -1 : ( x->id > y->id );
+}
+
+
+/* scores two packed dates out of 'full': the same day scores full marks,
+ * the same month three fifths, the same year two fifths and a year within
+ * the slack one fifth.  Dates further apart than that count against. */
+
+static int scoreDates( ofUI32_t x, ofUI32_t y, int full )
+{
+  ofUI32_t difference;
+
+  if( x == 0 || y == 0 ) {
+    return 0;
+  }
+
+  if( x == y && ( x & 0x1F ) != 0 ) {
+    return full;
+  }
+
+  difference = ( x >> 9 > y >> 9 ) ? ( x >> 9 ) - ( y >> 9 ) : ( y >> 9 ) - ( x >> 9 );
+
+  if( difference == 0 ) {
+    if( ( x >> 5 ) == ( y >> 5 ) && ( x & 0x1E0 ) != 0 ) {
+      return full * 3 / 5;
+    }
+    return full * 2 / 5;
+  }
+
+  if( difference <= gcDEDUPEYEARSLACK ) {
+    return full / 5;
+  }
+
+  return -full;
+}
+
+
+/* returns the score of a pair out of 110, or -1 if they cannot be the same
+ * person */
+
+static int scorePair( gedDEDUPEPERSON_t *a, gedDEDUPEPERSON_t *b )
+{
+  int score;
+  int shared;
+  int i;
+  int j;
+
+  if( a->sex != 0 && b->sex != 0 && a->sex != b->sex ) {
+    return -1;
+  }
+
+  score = ( a->surname == b->surname ) ? 20 : 10;
+
+  if( a->given != 0 && a->given == b->given ) {
+    score += 30;
+  } else if( a->initial != 0 && a->initial == b->initial ) {
+    score += 10;
+  }
+
+  score += scoreDates( a->birth, b->birth, 25 );
+  score += scoreDates( a->death, b->death, 15 );
+
+  /* family links: shared parent or spouse names */
+
+  shared = 0;
+  for( i = 0; i < a->relativeCount; i++ ) {
+    for( j = 0; j < b->relativeCount; j++ ) {
+      if( a->relatives[ i ] == b->relatives[ j ] ) {
+        shared++;
+        break;
+      }
+    }
+  }
+  score += ( shared > 2 ? 2 : shared ) * 10;
+
+  return score;
+}
+
+
+static int addPair( gedDEDUPEWORK_t *work, gedDEDUPEPERSON_t *a, gedDEDUPEPERSON_t *b, int score )
+{
+  if( work->count == work->size ) {
+    ofUI32_t         size = ( work->size == 0 ) ? 64 : work->size * 2;
+    gedDEDUPEPAIR_t *pairs = (gedDEDUPEPAIR_t*)realloc( work->pairs, size * sizeof( gedDEDUPEPAIR_t ) );
+
+    if( pairs == 0 ) {
+      return -1;
+    }
+    work->pairs = pairs;
+    work->size = size;
+  }
+
+  work->pairs[ work->count ].id1 = ( a->id < b->id ) ? a->id : b->id;
+  work->pairs[ work->count ].id2 = ( a->id < b->id ) ? b->id : a->id;
+  work->pairs[ work->count ].score = score;
+  work->count++;
+
+  return 0;
+}
+
+
+static void* scanBlocks( void *arg )
+{
+  gedDEDUPEWORK_t *work = (gedDEDUPEWORK_t*)arg;
+  gedDEDUPESET_t  *set = work->set;
+  ofUI32_t         i;
+  ofUI32_t         j;
+
+  for( i = work->first; i < work->end && !work->failed; i += work->step ) {
+    gedDEDUPEPERSON_t *a = &set->people[ i ];
+
+    for( j = i + 1; j < set->count && j <= i + gcDEDUPEWINDOW; j++ ) {
+      gedDEDUPEPERSON_t *b = &set->people[ j ];
+      int                score;
+
+      if( strcmp( (char*)a->soundex, (char*)b->soundex ) != 0 ) {
+        break;
+      }
+
+      if( a->birth != 0 && ( b->birth >> 9 ) - ( a->birth >> 9 ) > gcDEDUPEYEARSLACK ) {
+        break;
+      }
+
+      score = scorePair( a, b );
+      if( score >= work->minScore && addPair( work, a, b, score ) != 0 ) {
+        work->failed = 1;
+        break;
+      }
+    }
+  }
+
+  return 0;
+}
+
+
+static int comparePairs( const void *a, const void *b )
+{
+  const gedDEDUPEPAIR_t *x = (const gedDEDUPEPAIR_t*)a;
+  const gedDEDUPEPAIR_t *y = (const gedDEDUPEPAIR_t*)b;
+
+  if( x->score != y->score ) {
+    return ( x->score > y->score ) ? -1 : 1;
+  }
+
+  if( x->id1 != y->id1 ) {
+    return ( x->id1 < y->id1 ) ? -1 : 1;
+  }
+
+  return ( x->id2 < y->id2 ) ? -1 : ( x->id2 > y->id2 );
+}
+
+
+/* sorts the set into its blocks and gets ready to score it on up to
+ * 'threads' threads, keeping the pairs scoring at least 'minScore'.  The
+ * set must not change until the search is closed. */
+
+void startDuplicateSearch( gedDEDUPESEARCH_t *search, gedDEDUPESET_t *set, int minScore, int threads )
+{
+  int t;
+
+#ifdef HAVE_PTHREAD_H
+  if( threads > gcMAXDEDUPETHREADS ) {
+    threads = gcMAXDEDUPETHREADS;
+  }
+#else
+  threads = 1;
+#endif
+  if( threads < 1 ) {
+    threads = 1;
+  }
+
+  qsort( set->people, set->count, sizeof( gedDEDUPEPERSON_t ), compareBlockKeys );
+
+  search->set = set;
+  search->threads = threads;
+  search->next = 0;
+
+  for( t = 0; t < threads; t++ ) {
+    memset( &search->work[ t ], 0, sizeof( search->work[ t ] ) );
+    search->work[ t ].set = set;
+    search->work[ t ].step = threads;
+    search->work[ t ].minScore = minScore;
+  }
+}
+
+
+/* scores the next gcDEDUPEROUND people against those after them, split
+ * between the threads.  Returns 1 while there are more, 0 once every
+ * person has been scored and -1 if memory ran out. */
+
+int runDuplicateRound( gedDEDUPESEARCH_t *search )
+{
+  gedDEDUPEWORK_t *work = search->work;
+#ifdef HAVE_PTHREAD_H
+  pthread_t        workers[ gcMAXDEDUPETHREADS ];
+  int              started[ gcMAXDEDUPETHREADS ];
+#endif
+  ofUI32_t         end;
+  int              t;
+
+  end = ( search->set->count - search->next > gcDEDUPEROUND ) ? search->next + gcDEDUPEROUND : search->set->count;
+
+  for( t = 0; t < search->threads; t++ ) {
+    work[ t ].first = search->next + t;
+    work[ t ].end = end;
+  }
+
+#ifdef HAVE_PTHREAD_H
+  for( t = 1; t < search->threads; t++ ) {
+    started[ t ] = ( pthread_create( &workers[ t ], 0, scanBlocks, &work[ t ] ) == 0 );
+  }
+  scanBlocks( &work[ 0 ] );
+  for( t = 1; t < search->threads; t++ ) {
+    if( started[ t ] ) {
+      pthread_join( workers[ t ], 0 );
+    } else {
+      scanBlocks( &work[ t ] );
+    }
+  }
+#else
+  scanBlocks( &work[ 0 ] );
+#endif
+
+  for( t = 0; t < search->threads; t++ ) {
+    if( work[ t ].failed ) {
+      return -1;
+    }
+  }
+
+  search->next = end;
+
+  return ( end < search->set->count ) ? 1 : 0;
+}
+
+
+/* returns the pairs found in '*pairs' (to be freed by the caller), best
+ * first.  The result does not depend on the number of threads.  Returns
+ * -1 if memory ran out. */
+
+int finishDuplicateSearch( gedDEDUPESEARCH_t *search, gedDEDUPEPAIR_t **pairs, ofUI32_t *count )
+{
+  gedDEDUPEPAIR_t *result;
+  ofUI32_t         total;
+  int              t;
+
+  *pairs = 0;
+  *count = 0;
+
+  total = 0;
+  for( t = 0; t < search->threads; t++ ) {
+    total += search->work[ t ].count;
+  }
+
+  if( total == 0 ) {
+    return 0;
+  }
+
+  result = (gedDEDUPEPAIR_t*)malloc( total * sizeof( gedDEDUPEPAIR_t ) );
+  if( result == 0 ) {
+    return -1;
+  }
+
+  total = 0;
+  for( t = 0; t < search->threads; t++ ) {
+    if( search->work[ t ].count > 0 ) {
+      memcpy( result + total, search->work[ t ].pairs, search->work[ t ].count * sizeof( gedDEDUPEPAIR_t ) );
+      total += search->work[ t ].count;
+    }
+  }
+
+  qsort( result, total, sizeof( gedDEDUPEPAIR_t ), comparePairs );
+
+  *pairs = result;
+  *count = total;
+
+  return 0;
+}
+
+
+void closeDuplicateSearch( gedDEDUPESEARCH_t *search )
+{
+  int t;
+
+  for( t = 0; t < search->threads; t++ ) {
+    free( search->work[ t ].pairs );
+    search->work[ t ].pairs = 0;
+    search->work[ t ].count = 0;
+  }
+}
+
+
+/* scores the candidate pairs on up to 'threads' threads and returns those
+ * scoring at least 'minScore' in '*pairs' (to be freed by the caller),
+ * best first, in one go.  Returns -1 if memory ran out. */
+
+int findDuplicates( gedDEDUPESET_t *set, int minScore, int threads,
+                    gedDEDUPEPAIR_t **pairs, ofUI32_t *count )
+{
+  gedDEDUPESEARCH_t search;
+  int               rc;
+
+  *pairs = 0;
+  *count = 0;
+
+  startDuplicateSearch( &search, set, minScore, threads );
+
+  while( ( rc = runDuplicateRound( &search ) ) > 0 ) {
+  }
+
+  if( rc == 0 ) {
+    rc = finishDuplicateSearch( &search, pairs, count );
+  }
+
+  closeDuplicateSearch( &search );
+
+  return rc;
+}
@@ -0,0 +1,118 @@
+/* -------------------------------------------------------------------------
+ * gedcom_dedupe.h -- Defines the interface for duplicate individual detection.
+ * Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+ * -------------------------------------------------------------------------
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ------------------------------------------------------------------------- */
+
+#ifndef __GEDDEDUPE_H__
+#define __GEDDEDUPE_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "gedcom_types.h"
+#include "gedcom_date.h"
+#include "gedcom_name.h"
+
+/* dedupe constants */
+
+  #define gcMAXRELATIVES       ( 4 )   /* parent and spouse names kept per person */
+  #define gcMAXDEDUPETHREADS   ( 16 )
+
+  #define gcDEDUPEYEARSLACK    ( 2 )   /* birth years further apart than this never match */
+  #define gcDEDUPEWINDOW       ( 32 )  /* people compared after each one within a block */
+
+  #define gcDEDUPEMINSCORE     ( 60 )
+
+  #define gcDEDUPEROUND        ( 65536 )  /* people runDuplicateRound scores */
+
+/* types */
+
+typedef struct {
+  ofUI32_t id;
+  ofCHAR_t soundex[ gcSOUNDEXSIZE ];  /* blocking key, with the birth year */
+  ofUI32_t surname;                   /* hashes of the normalized names */
+  ofUI32_t given;
+  ofCHAR_t initial;
+  ofCHAR_t sex;                       /* 'M', 'F' or 0 if unknown */
+  ofUI32_t birth;                     /* packed dates, 0 if unknown */
+  ofUI32_t death;
+  ofUI32_t relatives[ gcMAXRELATIVES ];
+  int      relativeCount;
+} gedDEDUPEPERSON_t;
+
+typedef struct {
+  gedDEDUPEPERSON_t *people;
+  ofUI32_t           count;
+  ofUI32_t           size;
+} gedDEDUPESET_t;
+
+typedef struct {
+  ofUI32_t id1;
+  ofUI32_t id2;
+  int      score;
+} gedDEDUPEPAIR_t;
+
+/* what one thread of a search scores: every 'step'th person from 'first'
+ * up to 'end', and the pairs it kept so far */
+
+typedef struct {
+  gedDEDUPESET_t  *set;
+  ofUI32_t         first;
+  ofUI32_t         end;
+  ofUI32_t         step;
+  int              minScore;
+  gedDEDUPEPAIR_t *pairs;
+  ofUI32_t         count;
+  ofUI32_t         size;
+  int              failed;
+} gedDEDUPEWORK_t;
+
+typedef struct {
+  gedDEDUPESET_t  *set;
+  gedDEDUPEWORK_t  work[ gcMAXDEDUPETHREADS ];
+  int              threads;
+  ofUI32_t         next;     /* the first person of the next round */
+} gedDEDUPESEARCH_t;
+
+
+void initDedupeSet( gedDEDUPESET_t *set );
+
+void freeDedupeSet( gedDEDUPESET_t *set );
+
+ofUI64_t getDedupeSetMemory( gedDEDUPESET_t *set );
+
+int addDedupePerson( gedDEDUPESET_t *set, ofUI32_t id, ofCHAR_t *name, ofCHAR_t *sex,
+                     gedDATEVALUE_t *birth, gedDATEVALUE_t *death,
+                     ofCHAR_t **relatives, int relativeCount );
+
+void startDuplicateSearch( gedDEDUPESEARCH_t *search, gedDEDUPESET_t *set, int minScore, int threads );
+
+int runDuplicateRound( gedDEDUPESEARCH_t *search );
+
+int finishDuplicateSearch( gedDEDUPESEARCH_t *search, gedDEDUPEPAIR_t **pairs, ofUI32_t *count );
+
+void closeDuplicateSearch( gedDEDUPESEARCH_t *search );
+
+int findDuplicates( gedDEDUPESET_t *set, int minScore, int threads,
+                    gedDEDUPEPAIR_t **pairs, ofUI32_t *count );
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // __GEDDEDUPE_H__
@@ -0,0 +1,647 @@
+/* -------------------------------------------------------------------------
+ * gedcom_diff.c -- Defines the record hash diff of two files.
+ * Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+ * -------------------------------------------------------------------------
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ------------------------------------------------------------------------- */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gedcom_types.h"
+#include "gedcom_record.h"
+#include "gedcom_stream.h"
+#include "gedcom_diff.h"
+
+
+/* The diff reads both files a record at a time with the record reader and
+ * keeps, for each record, its key, its offset and a hash of its tree (and
+ * the hashes of its level 1 subtrees if asked to), so memory grows with
+ * the number of records and not with the size of the files.
+ *
+ * Each line is hashed from its tag and value; a subtree's hash folds the
+ * hashes of its children, in order, into its line's.  Once both files are
+ * indexed, the records of the new file are matched by key with those of
+ * the old one: a different hash makes the record changed, and the level 1
+ * subtrees of the two are matched by hash (as multisets, in order among
+ * equal ones) to tell which were removed and which added.  Of the records
+ * left, an added one with the same hash as a removed one is taken to be
+ * the same record under a new key.
+ *
+ * The changes come in the order of the new file (added, changed and
+ * renamed records), then the removed records in the order of the old. */
+
+
+static ofUI64_t mixHashes( ofUI64_t hash, ofUI64_t child )
+{
+  ofUI64_t pair[ 2 ];
+
+  pair[ 0 ] = hash;
+  pair[ 1 ] = child;
+
+  return hashGEDCOMBytes( (ofCHAR_t*)pair, sizeof( pair ), 0 );
+}
+
+
+static ofUI32_t hashKey( ofCHAR_t *key, ofUI32_t length )
+{
+  return (ofUI32_t)hashGEDCOMBytes( key, length, 0 );
+}
+
+
+static void freeIndex( gedDIFFINDEX_t *index )
+{
+  closeRecordReader( &index->reader );
+  free( index->records );
+  free( index->keys );
+  free( index->children );
+  free( index->slots );
+  index->records = 0;
+  index->keys = 0;
+  index->children = 0;
+  index->slots = 0;
+  index->count = index->size = index->childCount = index->childSize = index->slotCount = 0;
+  index->keyLength = index->keySize = 0;
+}
+
+
+static int growSlots( gedDIFFINDEX_t *index )
+{
+  ofUI32_t         count = ( index->slotCount == 0 ) ? 1024 : index->slotCount * 2;
+  ofUI32_t        *slots;
+  gedDIFFRECORD_t *record;
+  ofUI32_t         slot;
+  ofUI32_t         i;
+
+  slots = (ofUI32_t*)calloc( count, sizeof( ofUI32_t ) );
+  if( slots == 0 ) {
+    return -1;
+  }
+
+  for( i = 0; i < index->count; i++ ) {
+    record = &index->records[ i ];
+    slot = hashKey( index->keys + record->keyOffset, record->keyLength ) & ( count - 1 );
+    while( slots[ slot ] != 0 ) {
+      slot = ( slot + 1 ) & ( count - 1 );
+    }
+    slots[ slot ] = i + 1;
+  }
+
+  free( index->slots );
+  index->slots = slots;
+  index->slotCount = count;
+
+  return 0;
+}
+
+
+/* the record with the given key, or gcNORECORD; '*slot' is left at the
+ * slot it would go into */
+
+static ofUI32_t findRecord( gedDIFFINDEX_t *index, ofCHAR_t *key, ofUI32_t length, ofUI32_t *slot )
+{
+  gedDIFFRECORD_t *record;
+  ofUI32_t         i;
+
+  if( index->slotCount == 0 ) {
+    return gcNORECORD;
+  }
+
+  for( i = hashKey( key, length ) & ( index->slotCount - 1 ); index->slots[ i ] != 0; i = ( i + 1 ) & ( index->slotCount - 1 ) ) {
+    record = &index->records[ index->slots[ i ] - 1 ];
+    if( record->keyLength == length && memcmp( index->keys + record->keyOffset, key, length ) == 0 ) {
+      *slot = i;
+      return index->slots[ i ] - 1;
+    }
+  }
+
+  *slot = i;
+  return gcNORECORD;
+}
+
+
+static int addKey( gedDIFFINDEX_t *index, ofCHAR_t *key, ofUI32_t length )
+{
+  if( index->keyLength + length > index->keySize ) {
+    ofUI64_t  size = ( index->keySize == 0 ) ? 16384 : index->keySize * 2;
+    ofCHAR_t *keys;
+
+    while( size < index->keyLength + length ) {
+      size *= 2;
+    }
+    keys = (ofCHAR_t*)realloc( index->keys, size );
+    if( keys == 0 ) {
+      return -1;
+    }
+    index->keys = keys;
+    index->keySize = size;
+  }
+
+  memcpy( index->keys + index->keyLength, key, length );
+  index->keyLength += length;
+
+  return 0;
+}
+
+
+/* adds the record the reader is on, whose subtree hashes are in
+ * 'hashes'.  Returns -1 if memory ran out. */
+
+static int addRecord( gedDIFF_t *diff, gedDIFFINDEX_t *index, ofUI64_t *hashes )
+{
+  gedRECORDREADER_t *reader = &index->reader;
+  gedNODE_t         *root = &reader->nodes[ 0 ];
+  gedDIFFRECORD_t   *record;
+  ofCHAR_t          *base = reader->buffer + reader->start;
+  ofCHAR_t          *key;
+  ofCHAR_t           suffix[ 16 ];
+  ofUI32_t           length;
+  ofUI32_t           first;
+  ofUI32_t           slot;
+  ofUI32_t           child;
+  int                n;
+
+  if( index->count == index->size ) {
+    ofUI32_t         size = ( index->size == 0 ) ? 1024 : index->size * 2;
+    gedDIFFRECORD_t *records = (gedDIFFRECORD_t*)realloc( index->records, size * sizeof( gedDIFFRECORD_t ) );
+
+    if( records == 0 ) {
+      return -1;
+    }
+    index->records = records;
+    index->size = size;
+  }
+
+  if( ( index->count + 1 ) * 2 > index->slotCount && growSlots( index ) != 0 ) {
+    return -1;
+  }
+
+  if( root->xrefLength > 0 ) {
+    key = base + root->xrefOffset;
+    length = root->xrefLength;
+  } else {
+    key = base + root->tagOffset;
+    length = root->tagLength;
+  }
+
+  record = &index->records[ index->count ];
+  record->offset = index->offset + root->offset;
+  record->hash = hashes[ 0 ];
+  record->keyOffset = index->keyLength;
+  record->keyLength = length;
+  record->firstChild = index->childCount;
+  record->childCount = 0;
+  record->duplicates = 0;
+  record->match = gcNORECORD;
+
+  if( addKey( index, key, length ) != 0 ) {
+    return -1;
+  }
+
+  first = findRecord( index, key, length, &slot );
+  if( first != gcNORECORD ) {
+    n = sprintf( (char*)suffix, ":%u", ++index->records[ first ].duplicates + 1 );
+    if( addKey( index, suffix, n ) != 0 ) {
+      return -1;
+    }
+    record->keyLength += n;
+    findRecord( index, index->keys + record->keyOffset, record->keyLength, &slot );
+  }
+  index->slots[ slot ] = index->count + 1;
+
+  if( diff->subtrees ) {
+    for( child = root->firstChild; child != gcNONODE; child = reader->nodes[ child ].next ) {
+      if( index->childCount == index->childSize ) {
+        ofUI32_t  size = ( index->childSize == 0 ) ? 4096 : index->childSize * 2;
+        ofUI64_t *children = (ofUI64_t*)realloc( index->children, size * sizeof( ofUI64_t ) );
+
+        if( children == 0 ) {
+          return -1;
+        }
+        index->children = children;
+        index->childSize = size;
+      }
+      index->children[ index->childCount++ ] = hashes[ child ];
+      record->childCount++;
+    }
+  }
+
+  index->count++;
+
+  return 0;
+}
+
+
+/* hashes every subtree of the record the reader is on into diff->hashes,
+ * by node.  Children come after their parent, so going backwards finds
+ * them done. */
+
+static int hashRecord( gedDIFF_t *diff, gedRECORDREADER_t *reader )
+{
+  ofCHAR_t  *base = reader->buffer + reader->start;
+  gedNODE_t *node;
+  ofUI64_t   hash;
+  ofUI32_t   child;
+  ofUI32_t   i;
+
+  if( reader->count > diff->hashSize ) {
+    ofUI64_t *hashes = (ofUI64_t*)realloc( diff->hashes, reader->count * sizeof( ofUI64_t ) );
+
+    if( hashes == 0 ) {
+      return -1;
+    }
+    diff->hashes = hashes;
+    diff->hashSize = reader->count;
+  }
+
+  for( i = reader->count; i-- > 0; ) {
+    node = &reader->nodes[ i ];
+    hash = hashGEDCOMBytes( base + node->tagOffset, node->tagLength, 0 );
+    hash = hashGEDCOMBytes( base + node->valueOffset, node->valueLength, hash );
+    for( child = node->firstChild; child != gcNONODE; child = reader->nodes[ child ].next ) {
+      hash = mixHashes( hash, diff->hashes[ child ] );
+    }
+    diff->hashes[ i ] = hash;
+  }
+
+  return 0;
+}
+
+
+/* indexes up to gcDIFFROUND more records of a file.  Returns 1 if there
+ * are more, 0 at the end, -1 if memory ran out and -2 if reading failed. */
+
+static int indexRecords( gedDIFF_t *diff, gedDIFFINDEX_t *index )
+{
+  gedRECORDREADER_t *reader = &index->reader;
+  int                rc;
+  int                n;
+
+  for( n = 0; n < gcDIFFROUND; n++ ) {
+    rc = readGEDCOMRecord( reader );
+    if( rc <= 0 ) {
+      if( rc == -2 ) {
+        diff->errnum = errno;
+      }
+      index->done = ( rc == 0 );
+      return rc;
+    }
+
+    if( reader->count > 0 &&
+        ( hashRecord( diff, reader ) != 0 || addRecord( diff, index, diff->hashes ) != 0 ) ) {
+      return -1;
+    }
+    index->offset += reader->next - reader->start;
+  }
+
+  return 1;
+}
+
+
+static gedDIFFCHANGE_t* addChange( gedDIFF_t *diff, int kind, ofUI32_t oldRecord, ofUI32_t newRecord )
+{
+  gedDIFFCHANGE_t *change;
+
+  if( diff->count == diff->size ) {
+    ofUI32_t         size = ( diff->size == 0 ) ? 256 : diff->size * 2;
+    gedDIFFCHANGE_t *changes = (gedDIFFCHANGE_t*)realloc( diff->changes, size * sizeof( gedDIFFCHANGE_t ) );
+
+    if( changes == 0 ) {
+      return 0;
+    }
+    diff->changes = changes;
+    diff->size = size;
+  }
+
+  change = &diff->changes[ diff->count++ ];
+  change->kind = kind;
+  change->oldRecord = oldRecord;
+  change->newRecord = newRecord;
+  change->firstDetail = diff->detailCount;
+  change->removedCount = change->addedCount = 0;
+
+  return change;
+}
+
+
+static int addDetail( gedDIFF_t *diff, ofUI32_t detail )
+{
+  if( diff->detailCount == diff->detailSize ) {
+    ofUI32_t  size = ( diff->detailSize == 0 ) ? 256 : diff->detailSize * 2;
+    ofUI32_t *details = (ofUI32_t*)realloc( diff->details, size * sizeof( ofUI32_t ) );
+
+    if( details == 0 ) {
+      return -1;
+    }
+    diff->details = details;
+    diff->detailSize = size;
+  }
+
+  diff->details[ diff->detailCount++ ] = detail;
+
+  return 0;
+}
+
+
+/* subtrees are sorted by hash, and by index among equal hashes, to be
+ * matched */
+
+typedef struct {
+  ofUI64_t hash;
+  ofUI32_t index;
+  ofUI32_t matched;
+} gedDIFFSUBTREE_t;
+
+
+static int compareSubtrees( const void *a, const void *b )
+{
+  const gedDIFFSUBTREE_t *s1 = (const gedDIFFSUBTREE_t*)a;
+  const gedDIFFSUBTREE_t *s2 = (const gedDIFFSUBTREE_t*)b;
+
+  if( s1->hash != s2->hash ) {
+    return ( s1->hash < s2->hash ) ? -1 : 1;
+  }
+
+  return ( s1->index < s2->index ) ? -1 : ( s1->index > s2->index );
+}
+
+
+static gedDIFFSUBTREE_t* sortSubtrees( ofUI64_t *hashes, ofUI32_t count )
+{
+  gedDIFFSUBTREE_t *subtrees;
+  ofUI32_t          i;
+
+  subtrees = (gedDIFFSUBTREE_t*)malloc( ( count > 0 ? count : 1 ) * sizeof( gedDIFFSUBTREE_t ) );
+  if( subtrees == 0 ) {
+    return 0;
+  }
+
+  for( i = 0; i < count; i++ ) {
+    subtrees[ i ].hash = hashes[ i ];
+    subtrees[ i ].index = i;
+    subtrees[ i ].matched = 0;
+  }
+  qsort( subtrees, count, sizeof( gedDIFFSUBTREE_t ), compareSubtrees );
+
+  return subtrees;
+}
+
+
+static int compareDetails( const void *a, const void *b )
+{
+  ofUI32_t d1 = *(const ofUI32_t*)a;
+  ofUI32_t d2 = *(const ofUI32_t*)b;
+
+  return ( d1 < d2 ) ? -1 : ( d1 > d2 );
+}
+
+
+/* adds the indexes of the subtrees left unmatched, in the order of the
+ * record */
+
+static int addUnmatched( gedDIFF_t *diff, gedDIFFSUBTREE_t *subtrees, ofUI32_t count, ofUI32_t *added )
+{
+  ofUI32_t first = diff->detailCount;
+  ofUI32_t i;
+
+  for( i = 0; i < count; i++ ) {
+    if( !subtrees[ i ].matched && addDetail( diff, subtrees[ i ].index ) != 0 ) {
+      return -1;
+    }
+  }
+
+  *added = diff->detailCount - first;
+  qsort( diff->details + first, *added, sizeof( ofUI32_t ), compareDetails );
+
+  return 0;
+}
+
+
+/* works out which level 1 subtrees of a changed record were removed and
+ * which added */
+
+static int compareChildren( gedDIFF_t *diff, gedDIFFCHANGE_t *change )
+{
+  gedDIFFRECORD_t  *oldRecord = &diff->files[ 0 ].records[ change->oldRecord ];
+  gedDIFFRECORD_t  *newRecord = &diff->files[ 1 ].records[ change->newRecord ];
+  gedDIFFSUBTREE_t *oldTrees;
+  gedDIFFSUBTREE_t *newTrees;
+  ofUI32_t          i;
+  ofUI32_t          j;
+  int               rc;
+
+  oldTrees = sortSubtrees( diff->files[ 0 ].children + oldRecord->firstChild, oldRecord->childCount );
+  newTrees = sortSubtrees( diff->files[ 1 ].children + newRecord->firstChild, newRecord->childCount );
+
+  if( oldTrees == 0 || newTrees == 0 ) {
+    free( oldTrees );
+    free( newTrees );
+    return -1;
+  }
+
+  for( i = j = 0; i < oldRecord->childCount && j < newRecord->childCount; ) {
+    if( oldTrees[ i ].hash < newTrees[ j ].hash ) {
+      i++;
+    } else if( oldTrees[ i ].hash > newTrees[ j ].hash ) {
+      j++;
+    } else {
+      oldTrees[ i++ ].matched = newTrees[ j++ ].matched = 1;
+    }
+  }
+
+  change->firstDetail = diff->detailCount;
+  rc = addUnmatched( diff, oldTrees, oldRecord->childCount, &change->removedCount );
+  if( rc == 0 ) {
+    rc = addUnmatched( diff, newTrees, newRecord->childCount, &change->addedCount );
+  }
+
+  free( oldTrees );
+  free( newTrees );
+
+  return rc;
+}
+
+
+/* records left unmatched in the old file, by hash, for the added records
+ * to look for one with the same tree */
+
+static int findRenames( gedDIFF_t *diff )
+{
+  gedDIFFINDEX_t  *old = &diff->files[ 0 ];
+  gedDIFFCHANGE_t *change;
+  ofUI32_t        *slots;
+  ofUI32_t        *next;
+  ofUI32_t        *link;
+  ofUI32_t         count;
+  ofUI32_t         slot;
+  ofUI32_t         i;
+
+  for( count = 1024; count < old->count * 2; count *= 2 )
+    ;
+
+  slots = (ofUI32_t*)calloc( count, sizeof( ofUI32_t ) );
+  next = (ofUI32_t*)malloc( ( old->count > 0 ? old->count : 1 ) * sizeof( ofUI32_t ) );
+  if( slots == 0 || next == 0 ) {
+    free( slots );
+    free( next );
+    return -1;
+  }
+
+  /* each slot chains the records with its hash bits, first one first */
+
+  for( i = old->count; i-- > 0; ) {
+    if( old->records[ i ].match == gcNORECORD ) {
+      slot = old->records[ i ].hash & ( count - 1 );
+      next[ i ] = slots[ slot ];
+      slots[ slot ] = i + 1;
+    }
+  }
+
+  for( i = 0; i < diff->count; i++ ) {
+    change = &diff->changes[ i ];
+    if( change->kind != gcdiffADDED ) {
+      continue;
+    }
+
+    slot = diff->files[ 1 ].records[ change->newRecord ].hash & ( count - 1 );
+    for( link = &slots[ slot ]; *link != 0; link = &next[ *link - 1 ] ) {
+      if( old->records[ *link - 1 ].hash == diff->files[ 1 ].records[ change->newRecord ].hash ) {
+        change->kind = gcdiffRENAMED;
+        change->oldRecord = *link - 1;
+        old->records[ change->oldRecord ].match = change->newRecord;
+        *link = next[ *link - 1 ];
+        break;
+      }
+    }
+  }
+
+  free( slots );
+  free( next );
+
+  return 0;
+}
+
+
+static int compareFiles( gedDIFF_t *diff )
+{
+  gedDIFFINDEX_t  *old = &diff->files[ 0 ];
+  gedDIFFINDEX_t  *updated = &diff->files[ 1 ];
+  gedDIFFRECORD_t *record;
+  gedDIFFCHANGE_t *change;
+  ofUI32_t         match;
+  ofUI32_t         slot;
+  ofUI32_t         i;
+
+  for( i = 0; i < updated->count; i++ ) {
+    record = &updated->records[ i ];
+    match = findRecord( old, updated->keys + record->keyOffset, record->keyLength, &slot );
+
+    if( match == gcNORECORD ) {
+      if( addChange( diff, gcdiffADDED, gcNORECORD, i ) == 0 ) {
+        return -1;
+      }
+      continue;
+    }
+
+    old->records[ match ].match = i;
+    record->match = match;
+
+    if( old->records[ match ].hash != record->hash ) {
+      change = addChange( diff, gcdiffCHANGED, match, i );
+      if( change == 0 || ( diff->subtrees && compareChildren( diff, change ) != 0 ) ) {
+        return -1;
+      }
+    }
+  }
+
+  if( findRenames( diff ) != 0 ) {
+    return -1;
+  }
+
+  for( i = 0; i < old->count; i++ ) {
+    if( old->records[ i ].match == gcNORECORD && addChange( diff, gcdiffREMOVED, i, gcNORECORD ) == 0 ) {
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+
+/* opens both files.  Returns 0, or 1 or 2 for the file that cannot be
+ * opened (see errno).  'subtrees' keeps the hashes of the level 1
+ * subtrees to tell what changed in a record. */
+
+int openDiff( gedDIFF_t *diff, const char *oldPath, const char *newPath, int subtrees )
+{
+  memset( diff, 0, sizeof( *diff ) );
+  diff->subtrees = subtrees;
+
+  if( openRecordReader( &diff->files[ 0 ].reader, oldPath ) != 0 ) {
+    return 1;
+  }
+  if( openRecordReader( &diff->files[ 1 ].reader, newPath ) != 0 ) {
+    int errnum = errno;
+
+    closeRecordReader( &diff->files[ 0 ].reader );
+    errno = errnum;
+    return 2;
+  }
+
+  return 0;
+}
+
+
+/* indexes the next gcDIFFROUND records of the old file, then of the new,
+ * and compares them once both are read.  Returns 1 if there is more to
+ * do, 0 once the changes are ready, -1 if memory ran out and -2 if reading
+ * failed (see errnum). */
+
+int runDiffRound( gedDIFF_t *diff )
+{
+  gedDIFFINDEX_t *index;
+  int             rc;
+
+  index = !diff->files[ 0 ].done ? &diff->files[ 0 ] : &diff->files[ 1 ];
+
+  rc = indexRecords( diff, index );
+  if( rc < 0 ) {
+    return rc;
+  }
+
+  if( rc == 0 && index == &diff->files[ 1 ] ) {
+    closeRecordReader( &diff->files[ 0 ].reader );
+    closeRecordReader( &diff->files[ 1 ].reader );
+    return ( compareFiles( diff ) != 0 ) ? -1 : 0;
+  }
+
+  return 1;
+}
+
+
+void closeDiff( gedDIFF_t *diff )
+{
+  freeIndex( &diff->files[ 0 ] );
+  freeIndex( &diff->files[ 1 ] );
+  free( diff->hashes );
+  free( diff->changes );
+  free( diff->details );
+  diff->hashes = 0;
+  diff->changes = 0;
+  diff->details = 0;
+  diff->hashSize = diff->count = diff->size = diff->detailCount = diff->detailSize = 0;
+}
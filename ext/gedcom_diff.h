@@ -0,0 +1,109 @@
+/* -------------------------------------------------------------------------
+ * gedcom_diff.h -- Defines the interface for the record hash diff.
+ * Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+ * -------------------------------------------------------------------------
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ------------------------------------------------------------------------- */
+
+#ifndef __GEDDIFF_H__
+#define __GEDDIFF_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "gedcom_types.h"
+#include "gedcom_stream.h"
+
+/* diff constants */
+
+  #define gcDIFFROUND          ( 4096 )  /* records read per round */
+  #define gcNORECORD           ( 0xFFFFFFFFu )
+
+  #define gcdiffADDED          ( 0 )
+  #define gcdiffREMOVED        ( 1 )
+  #define gcdiffCHANGED        ( 2 )
+  #define gcdiffRENAMED        ( 3 )
+
+/* types */
+
+/* a record of one of the files.  Its key is its xref, or its tag if it
+ * has none, with ":n" added for the n-th record (from 2) with the same
+ * key.  The hash covers the record's lines but not the xref of its level
+ * 0 line, so that a record that only changed its xref keeps it. */
+
+typedef struct {
+  ofUI64_t offset;        /* of the level 0 line in the file */
+  ofUI64_t hash;
+  ofUI64_t keyOffset;     /* into the key pool */
+  ofUI32_t keyLength;
+  ofUI32_t firstChild;    /* hashes of the level 1 subtrees, in order */
+  ofUI32_t childCount;
+  ofUI32_t duplicates;    /* later records with the same key */
+  ofUI32_t match;         /* the record of the other file, or gcNORECORD */
+} gedDIFFRECORD_t;
+
+typedef struct {
+  gedRECORDREADER_t  reader;
+  ofUI64_t           offset;      /* of the reader's current record */
+  gedDIFFRECORD_t   *records;
+  ofUI32_t           count;
+  ofUI32_t           size;
+  ofCHAR_t          *keys;
+  ofUI64_t           keyLength;
+  ofUI64_t           keySize;
+  ofUI64_t          *children;
+  ofUI32_t           childCount;
+  ofUI32_t           childSize;
+  ofUI32_t          *slots;       /* open addressing by key, index + 1 or 0 */
+  ofUI32_t           slotCount;
+  int                done;
+} gedDIFFINDEX_t;
+
+typedef struct {
+  int      kind;
+  ofUI32_t oldRecord;     /* gcNORECORD for added records */
+  ofUI32_t newRecord;     /* gcNORECORD for removed ones */
+  ofUI32_t firstDetail;   /* changed records: the indexes of the old */
+  ofUI32_t removedCount;  /* subtrees not in the new record, then of the */
+  ofUI32_t addedCount;    /* new subtrees not in the old one */
+} gedDIFFCHANGE_t;
+
+typedef struct {
+  gedDIFFINDEX_t   files[ 2 ];    /* old, new */
+  int              subtrees;
+  ofUI64_t        *hashes;        /* of the current record's subtrees */
+  ofUI32_t         hashSize;
+  gedDIFFCHANGE_t *changes;
+  ofUI32_t         count;
+  ofUI32_t         size;
+  ofUI32_t        *details;
+  ofUI32_t         detailCount;
+  ofUI32_t         detailSize;
+  int              errnum;        /* errno of a read error */
+} gedDIFF_t;
+
+
+int openDiff( gedDIFF_t *diff, const char *oldPath, const char *newPath, int subtrees );
+
+int runDiffRound( gedDIFF_t *diff );
+
+void closeDiff( gedDIFF_t *diff );
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // __GEDDIFF_H__
@@ -0,0 +1,861 @@
+/* -------------------------------------------------------------------------
+ * gedcom_export.c -- Defines the event table exporter.
+ * Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+ * -------------------------------------------------------------------------
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ------------------------------------------------------------------------- */
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+#include "gedcom_types.h"
+#include "gedcom_date.h"
+#include "gedcom_record.h"
+#include "gedcom_export.h"
+
+
+/* The exporter flattens each INDI record into one row per event, or a
+ * single row without an event for people who have none:
+ *
+ *   id, xref, sex, name, event, date, sort_key, start, end, place
+ *
+ * 'id' counts the INDI records in file order.  The first NAME and SEX of
+ * the person and the first DATE and PLAC of each event are used, as they
+ * appear in the file.  'sort_key' is the packed first date, and 'start'
+ * and 'end' the first and last day the whole date can fall on, as julian
+ * day numbers (0 if not known).
+ *
+ * People are encoded in batches of gcEXPORTBATCHSIZE, each into a buffer
+ * of its own, so that batches can be encoded in parallel and still be
+ * written in order.  CSV batches are plain lines.  Column batches start
+ * with a row count, a reserved word and the byte length of the rest; each
+ * column follows as little-endian int32 values or, for text, rows + 1
+ * uint32 offsets and the bytes they point into, every part padded to 8
+ * bytes.  The first batch is preceded by the header (CSV column names, or
+ * the magic, column count and each column's type and name) and the last
+ * followed by an empty batch. */
+
+#define geCOLINT32   ( 1 )
+#define geCOLTEXT    ( 2 )
+
+typedef struct {
+  ofCHAR_t *text;       /* 0 if the line was not there */
+  ofUI32_t  length;
+} gedEXPORTFIELD_t;
+
+typedef struct {
+  ofUI32_t         id;
+  gedEXPORTFIELD_t xref;
+  gedEXPORTFIELD_t sex;
+  gedEXPORTFIELD_t name;
+  gedEXPORTFIELD_t event;
+  gedEXPORTFIELD_t date;
+  gedEXPORTFIELD_t place;
+  ofUI32_t         sortKey;
+  ofI32_t          start;
+  ofI32_t          end;
+} gedEXPORTROW_t;
+
+typedef struct {
+  gedEXPORTER_t  *exporter;
+  ofUI32_t        first;
+  ofUI32_t        count;
+  int             offset;
+  int             step;
+  gedEXPORTROW_t *rows;
+  ofUI32_t        rowCount;
+  ofUI32_t        rowSize;
+  ofUI64_t        encoded;
+  int             failed;
+} gedEXPORTWORK_t;
+
+typedef struct {
+  const char *name;
+  int         type;
+  size_t      field;    /* of gedEXPORTROW_t */
+} gedEXPORTCOLUMN_t;
+
+static const gedEXPORTCOLUMN_t columns[] = {
+  { "id",       geCOLINT32, offsetof( gedEXPORTROW_t, id ) },
+  { "xref",     geCOLTEXT,  offsetof( gedEXPORTROW_t, xref ) },
+  { "sex",      geCOLTEXT,  offsetof( gedEXPORTROW_t, sex ) },
+  { "name",     geCOLTEXT,  offsetof( gedEXPORTROW_t, name ) },
+  { "event",    geCOLTEXT,  offsetof( gedEXPORTROW_t, event ) },
+  { "date",     geCOLTEXT,  offsetof( gedEXPORTROW_t, date ) },
+  { "sort_key", geCOLINT32, offsetof( gedEXPORTROW_t, sortKey ) },
+  { "start",    geCOLINT32, offsetof( gedEXPORTROW_t, start ) },
+  { "end",      geCOLINT32, offsetof( gedEXPORTROW_t, end ) },
+  { "place",    geCOLTEXT,  offsetof( gedEXPORTROW_t, place ) }
+};
+
+#define geCOLUMNCOUNT  ( (int)( sizeof( columns ) / sizeof( columns[ 0 ] ) ) )
+
+/* the individual event tags of GEDCOM 5.5 */
+
+static const char *eventTags[] = { "ADOP", "BAPM", "BARM", "BASM", "BIRT", "BLES", "BURI", "CENS",
+                                   "CHR", "CHRA", "CONF", "CREM", "DEAT", "EMIG", "EVEN", "FCOM",
+                                   "GRAD", "IMMI", "NATU", "ORDN", "PROB", "RESI", "RETI", "WILL", 0 };
+
+
+/* buffers */
+
+static int reserve( gedEXPORTBUFFER_t *buffer, ofUI64_t length )
+{
+  ofUI64_t  size;
+  ofCHAR_t *data;
+
+  if( buffer->length + length <= buffer->size ) {
+    return 0;
+  }
+
+  for( size = ( buffer->size == 0 ) ? 65536 : buffer->size; size < buffer->length + length; size *= 2 )
+    ;
+
+  data = (ofCHAR_t*)realloc( buffer->data, size );
+  if( data == 0 ) {
+    return -1;
+  }
+
+  buffer->data = data;
+  buffer->size = size;
+
+  return 0;
+}
+
+
+static int appendBytes( gedEXPORTBUFFER_t *buffer, const void *data, ofUI64_t length )
+{
+  if( length == 0 ) {
+    return 0;
+  }
+
+  if( reserve( buffer, length ) != 0 ) {
+    return -1;
+  }
+
+  memcpy( buffer->data + buffer->length, data, length );
+  buffer->length += length;
+
+  return 0;
+}
+
+
+static void putUI32( ofCHAR_t *p, ofUI32_t value )
+{
+  p[ 0 ] = (ofCHAR_t)value;
+  p[ 1 ] = (ofCHAR_t)( value >> 8 );
+  p[ 2 ] = (ofCHAR_t)( value >> 16 );
+  p[ 3 ] = (ofCHAR_t)( value >> 24 );
+}
+
+
+static int appendUI32( gedEXPORTBUFFER_t *buffer, ofUI32_t value )
+{
+  if( reserve( buffer, 4 ) != 0 ) {
+    return -1;
+  }
+
+  putUI32( buffer->data + buffer->length, value );
+  buffer->length += 4;
+
+  return 0;
+}
+
+
+static int appendPadding( gedEXPORTBUFFER_t *buffer, ofUI64_t start )
+{
+  static const ofCHAR_t zeroes[ 8 ] = { 0 };
+
+  return appendBytes( buffer, zeroes, ( 8 - ( buffer->length - start ) % 8 ) % 8 );
+}
+
+
+/* formats 'value' in decimal; returns the number of characters */
+
+static int formatNumber( ofI64_t value, ofCHAR_t *text )
+{
+  ofCHAR_t digits[ 24 ];
+  ofUI64_t magnitude;
+  int      count;
+  int      length;
+
+  length = 0;
+  magnitude = ( value < 0 ) ? (ofUI64_t)( -value ) : (ofUI64_t)value;
+  if( value < 0 ) {
+    text[ length++ ] = '-';
+  }
+
+  count = 0;
+  do {
+    digits[ count++ ] = '0' + magnitude % 10;
+    magnitude /= 10;
+  } while( magnitude > 0 );
+
+  while( count > 0 ) {
+    text[ length++ ] = digits[ --count ];
+  }
+
+  return length;
+}
+
+
+/* the gregorian yyyy-mm-dd of a julian day number */
+
+static int formatISODate( ofI32_t jdn, ofCHAR_t *text )
+{
+  ofI32_t year;
+  int     month;
+  int     day;
+  int     length;
+
+  getGEDCOMCivilDate( jdn, &year, &month, &day );
+
+  length = 0;
+  if( year < 0 ) {
+    text[ length++ ] = '-';
+    year = -year;
+  }
+
+  if( year < 10000 ) {
+    text[ length++ ] = '0' + (int)( year / 1000 );
+    text[ length++ ] = '0' + (int)( year / 100 % 10 );
+    text[ length++ ] = '0' + (int)( year / 10 % 10 );
+    text[ length++ ] = '0' + (int)( year % 10 );
+  } else {
+    length += formatNumber( year, text + length );
+  }
+
+  text[ length++ ] = '-';
+  text[ length++ ] = '0' + month / 10;
+  text[ length++ ] = '0' + month % 10;
+  text[ length++ ] = '-';
+  text[ length++ ] = '0' + day / 10;
+  text[ length++ ] = '0' + day % 10;
+
+  return length;
+}
+
+
+/* reading records */
+
+static int isBlank( ofCHAR_t c )
+{
+  return ( c == ' ' || c == '\t' );
+}
+
+
+static int isLineEnd( ofCHAR_t c )
+{
+  return ( c == '\n' || c == '\r' );
+}
+
+
+/* splits the line [line, end) into its level, tag and value, skipping any
+ * xref.  Returns -1 if it does not start with a level. */
+
+static int readLine( ofCHAR_t *line, ofCHAR_t *end, gedEXPORTFIELD_t *tag, gedEXPORTFIELD_t *value )
+{
+  ofCHAR_t *p = line;
+  ofCHAR_t *token;
+  int       level;
+
+  while( p < end && isBlank( *p ) ) {
+    p++;
+  }
+
+  if( p >= end || *p < '0' || *p > '9' ) {
+    return -1;
+  }
+
+  for( level = 0; p < end && *p >= '0' && *p <= '9'; p++ ) {
+    if( level < 1000 ) {
+      level = level * 10 + ( *p - '0' );
+    }
+  }
+
+  for( ; p < end && isBlank( *p ); p++ )
+    ;
+
+  if( p < end && *p == '@' ) {
+    for( ; p < end && !isBlank( *p ) && !isLineEnd( *p ); p++ )
+      ;
+    for( ; p < end && isBlank( *p ); p++ )
+      ;
+  }
+
+  for( token = p; p < end && !isBlank( *p ) && !isLineEnd( *p ); p++ )
+    ;
+  tag->text = token;
+  tag->length = p - token;
+
+  for( ; p < end && isBlank( *p ); p++ )
+    ;
+
+  while( end > p && isLineEnd( end[ -1 ] ) ) {
+    end--;
+  }
+  value->text = p;
+  value->length = end - p;
+
+  return level;
+}
+
+
+static int isTag( gedEXPORTFIELD_t *tag, const char *name )
+{
+  return ( tag->length == strlen( name ) && memcmp( tag->text, name, tag->length ) == 0 );
+}
+
+
+static int isEventTag( gedEXPORTFIELD_t *tag )
+{
+  int i;
+
+  for( i = 0; eventTags[ i ] != 0; i++ ) {
+    if( isTag( tag, eventTags[ i ] ) ) {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+
+static gedEXPORTROW_t* addRow( gedEXPORTWORK_t *work )
+{
+  gedEXPORTROW_t *row;
+
+  if( work->rowCount == work->rowSize ) {
+    ofUI32_t        size = ( work->rowSize == 0 ) ? 4096 : work->rowSize * 2;
+    gedEXPORTROW_t *rows = (gedEXPORTROW_t*)realloc( work->rows, size * sizeof( gedEXPORTROW_t ) );
+
+    if( rows == 0 ) {
+      return 0;
+    }
+    work->rows = rows;
+    work->rowSize = size;
+  }
+
+  row = &work->rows[ work->rowCount++ ];
+  memset( row, 0, sizeof( *row ) );
+
+  return row;
+}
+
+
+/* fills in the sort key and day range of a row from its DATE */
+
+static void readDate( gedEXPORTROW_t *row )
+{
+  gedDATEVALUE_t date;
+
+  if( parseGEDCOMDateText( row->date.text, row->date.length, &date ) != 0 || date.flags > gcINTERPRETED ) {
+    return;
+  }
+
+  row->sortKey = packGEDCOMDate( &date.date1 );
+  getGEDCOMDateValueDays( &date, &row->start, &row->end );
+}
+
+
+/* adds the rows of one INDI record */
+
+static int readPerson( gedEXPORTWORK_t *work, gedRECORD_t *record, ofUI32_t id )
+{
+  gedEXPORTER_t   *exporter = work->exporter;
+  ofCHAR_t        *line;
+  ofCHAR_t        *next;
+  ofCHAR_t        *end;
+  gedEXPORTFIELD_t tag;
+  gedEXPORTFIELD_t value;
+  gedEXPORTFIELD_t name;
+  gedEXPORTFIELD_t sex;
+  gedEXPORTROW_t  *row;
+  ofUI32_t         first;
+  ofUI32_t         i;
+  int              level;
+  int              event;
+
+  line = exporter->text + record->offset;
+  end = line + record->length;
+  first = work->rowCount;
+  event = -1;
+  name.text = sex.text = 0;
+  name.length = sex.length = 0;
+
+  for( ; line < end; line = next ) {
+    next = (ofCHAR_t*)memchr( line, '\n', end - line );
+    next = ( next != 0 ) ? next + 1 : end;
+
+    level = readLine( line, next, &tag, &value );
+
+    if( level == 1 ) {
+      event = -1;
+      if( isTag( &tag, "NAME" ) ) {
+        if( name.text == 0 ) {
+          name = value;
+        }
+      } else if( isTag( &tag, "SEX" ) ) {
+        if( sex.text == 0 ) {
+          sex = value;
+        }
+      } else if( isEventTag( &tag ) ) {
+        row = addRow( work );
+        if( row == 0 ) {
+          return -1;
+        }
+        row->event = tag;
+        event = work->rowCount - 1;
+      }
+    } else if( level == 2 && event >= 0 ) {
+      row = &work->rows[ event ];
+      if( isTag( &tag, "DATE" ) && row->date.text == 0 ) {
+        row->date = value;
+      } else if( isTag( &tag, "PLAC" ) && row->place.text == 0 ) {
+        row->place = value;
+      }
+    }
+  }
+
+  if( work->rowCount == first && addRow( work ) == 0 ) {
+    return -1;
+  }
+
+  for( i = first; i < work->rowCount; i++ ) {
+    row = &work->rows[ i ];
+    row->id = id;
+    row->xref.text = exporter->text + record->offset + record->xrefOffset;
+    row->xref.length = record->xrefLength;
+    row->name = name;
+    row->sex = sex;
+    if( row->date.text != 0 ) {
+      readDate( row );
+    }
+  }
+
+  return 0;
+}
+
+
+/* encoding */
+
+static int appendCSVField( gedEXPORTBUFFER_t *buffer, gedEXPORTFIELD_t *field )
+{
+  ofUI32_t i;
+  ofUI32_t quotes;
+  int      quoted;
+
+  quoted = 0;
+  quotes = 0;
+  for( i = 0; i < field->length; i++ ) {
+    ofCHAR_t c = field->text[ i ];
+    if( c == ',' || c == '"' || c == '\r' || c == '\n' ) {
+      quoted = 1;
+      quotes += ( c == '"' );
+    }
+  }
+
+  if( !quoted ) {
+    return appendBytes( buffer, field->text, field->length );
+  }
+
+  if( reserve( buffer, field->length + quotes + 2 ) != 0 ) {
+    return -1;
+  }
+
+  buffer->data[ buffer->length++ ] = '"';
+  for( i = 0; i < field->length; i++ ) {
+    if( field->text[ i ] == '"' ) {
+      buffer->data[ buffer->length++ ] = '"';
+    }
+    buffer->data[ buffer->length++ ] = field->text[ i ];
+  }
+  buffer->data[ buffer->length++ ] = '"';
+
+  return 0;
+}
+
+
+static int encodeCSV( gedEXPORTWORK_t *work, gedEXPORTBUFFER_t *buffer )
+{
+  gedEXPORTROW_t *row;
+  ofCHAR_t        text[ 64 ];
+  ofUI32_t        i;
+  int             length;
+  int             rc;
+
+  for( i = 0; i < work->rowCount; i++ ) {
+    row = &work->rows[ i ];
+
+    length = formatNumber( row->id, text );
+    text[ length++ ] = ',';
+    rc = appendBytes( buffer, text, length );
+    rc |= appendCSVField( buffer, &row->xref );
+    rc |= appendBytes( buffer, ",", 1 );
+    rc |= appendCSVField( buffer, &row->sex );
+    rc |= appendBytes( buffer, ",", 1 );
+    rc |= appendCSVField( buffer, &row->name );
+    rc |= appendBytes( buffer, ",", 1 );
+    rc |= appendCSVField( buffer, &row->event );
+    rc |= appendBytes( buffer, ",", 1 );
+    rc |= appendCSVField( buffer, &row->date );
+
+    length = 0;
+    text[ length++ ] = ',';
+    length += formatNumber( row->sortKey, text + length );
+    text[ length++ ] = ',';
+    if( row->start != 0 ) {
+      length += formatISODate( row->start, text + length );
+    }
+    text[ length++ ] = ',';
+    if( row->end != 0 ) {
+      length += formatISODate( row->end, text + length );
+    }
+    text[ length++ ] = ',';
+    rc |= appendBytes( buffer, text, length );
+    rc |= appendCSVField( buffer, &row->place );
+    rc |= appendBytes( buffer, "\n", 1 );
+
+    if( rc != 0 ) {
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+
+static int encodeTextColumn( gedEXPORTWORK_t *work, gedEXPORTBUFFER_t *buffer, size_t field )
+{
+  gedEXPORTFIELD_t *value;
+  ofUI64_t          start;
+  ofUI32_t          offset;
+  ofUI32_t          i;
+
+  start = buffer->length;
+  if( reserve( buffer, ( work->rowCount + 1 ) * 4 ) != 0 ) {
+    return -1;
+  }
+
+  offset = 0;
+  putUI32( buffer->data + buffer->length, 0 );
+  buffer->length += 4;
+  for( i = 0; i < work->rowCount; i++ ) {
+    value = (gedEXPORTFIELD_t*)( (char*)&work->rows[ i ] + field );
+    offset += value->length;
+    putUI32( buffer->data + buffer->length, offset );
+    buffer->length += 4;
+  }
+
+  if( appendPadding( buffer, start ) != 0 ) {
+    return -1;
+  }
+
+  start = buffer->length;
+  for( i = 0; i < work->rowCount; i++ ) {
+    value = (gedEXPORTFIELD_t*)( (char*)&work->rows[ i ] + field );
+    if( appendBytes( buffer, value->text, value->length ) != 0 ) {
+      return -1;
+    }
+  }
+
+  return appendPadding( buffer, start );
+}
+
+
+static int encodeIntColumn( gedEXPORTWORK_t *work, gedEXPORTBUFFER_t *buffer, size_t field )
+{
+  ofUI64_t start;
+  ofUI32_t value;
+  ofUI32_t i;
+
+  start = buffer->length;
+  if( reserve( buffer, work->rowCount * 4 ) != 0 ) {
+    return -1;
+  }
+
+  for( i = 0; i < work->rowCount; i++ ) {
+    memcpy( &value, (char*)&work->rows[ i ] + field, sizeof( value ) );
+    putUI32( buffer->data + buffer->length, value );
+    buffer->length += 4;
+  }
+
+  return appendPadding( buffer, start );
+}
+
+
+static int encodeColumns( gedEXPORTWORK_t *work, gedEXPORTBUFFER_t *buffer )
+{
+  ofUI64_t start;
+  ofUI64_t body;
+  int      column;
+  int      rc;
+
+  if( work->rowCount == 0 ) {
+    return 0;
+  }
+
+  start = buffer->length;
+  rc = appendUI32( buffer, work->rowCount );
+  rc |= appendUI32( buffer, 0 );
+  rc |= appendUI32( buffer, 0 );
+  rc |= appendUI32( buffer, 0 );
+  body = buffer->length;
+
+  for( column = 0; rc == 0 && column < geCOLUMNCOUNT; column++ ) {
+    if( columns[ column ].type == geCOLTEXT ) {
+      rc = encodeTextColumn( work, buffer, columns[ column ].field );
+    } else {
+      rc = encodeIntColumn( work, buffer, columns[ column ].field );
+    }
+  }
+
+  if( rc != 0 ) {
+    return -1;
+  }
+
+  body = buffer->length - body;
+  putUI32( buffer->data + start + 8, (ofUI32_t)body );
+  putUI32( buffer->data + start + 12, (ofUI32_t)( body >> 32 ) );
+
+  return 0;
+}
+
+
+static int encodeHeader( gedEXPORTER_t *exporter, gedEXPORTBUFFER_t *buffer )
+{
+  ofCHAR_t type[ 2 ];
+  int      column;
+  int      rc;
+
+  if( exporter->format == gcEXPORTCSV ) {
+    for( rc = 0, column = 0; column < geCOLUMNCOUNT; column++ ) {
+      rc |= appendBytes( buffer, columns[ column ].name, strlen( columns[ column ].name ) );
+      rc |= appendBytes( buffer, ( column + 1 < geCOLUMNCOUNT ) ? "," : "\n", 1 );
+    }
+    return rc;
+  }
+
+  rc = appendBytes( buffer, "GEDCOLS1", 8 );
+  rc |= appendUI32( buffer, (ofUI32_t)geCOLUMNCOUNT );
+  rc |= appendUI32( buffer, 0 );
+  for( column = 0; column < geCOLUMNCOUNT; column++ ) {
+    type[ 0 ] = (ofCHAR_t)columns[ column ].type;
+    type[ 1 ] = (ofCHAR_t)strlen( columns[ column ].name );
+    rc |= appendBytes( buffer, type, 2 );
+    rc |= appendBytes( buffer, columns[ column ].name, type[ 1 ] );
+  }
+  rc |= appendPadding( buffer, 0 );
+
+  return rc;
+}
+
+
+static int encodeTrailer( gedEXPORTER_t *exporter, gedEXPORTBUFFER_t *buffer )
+{
+  static const ofCHAR_t zeroes[ 16 ] = { 0 };
+
+  if( exporter->format == gcEXPORTCSV ) {
+    return 0;
+  }
+
+  return appendBytes( buffer, zeroes, sizeof( zeroes ) );
+}
+
+
+static int encodeBatch( gedEXPORTWORK_t *work, ofUI32_t batch, gedEXPORTBUFFER_t *buffer )
+{
+  gedEXPORTER_t *exporter = work->exporter;
+  ofUI32_t       person;
+  ofUI32_t       last;
+  int            rc;
+
+  buffer->length = 0;
+  work->rowCount = 0;
+
+  if( batch == 0 && encodeHeader( exporter, buffer ) != 0 ) {
+    return -1;
+  }
+
+  last = ( batch + 1 ) * gcEXPORTBATCHSIZE;
+  if( last > exporter->count ) {
+    last = exporter->count;
+  }
+
+  for( person = batch * gcEXPORTBATCHSIZE; person < last; person++ ) {
+    if( readPerson( work, &exporter->records.records[ exporter->people[ person ] ], person ) != 0 ) {
+      return -1;
+    }
+  }
+
+  if( exporter->format == gcEXPORTCSV ) {
+    rc = encodeCSV( work, buffer );
+  } else {
+    rc = encodeColumns( work, buffer );
+  }
+
+  if( rc == 0 && batch + 1 == exporter->batchCount ) {
+    rc = encodeTrailer( exporter, buffer );
+  }
+
+  work->encoded += work->rowCount;
+
+  return rc;
+}
+
+
+static void* encodeBatches( void *data )
+{
+  gedEXPORTWORK_t *work = (gedEXPORTWORK_t*)data;
+  ofUI32_t         i;
+
+  for( i = work->offset; i < work->count && !work->failed; i += work->step ) {
+    work->failed = ( encodeBatch( work, work->first + i, &work->exporter->batches[ i ] ) != 0 );
+  }
+
+  free( work->rows );
+  work->rows = 0;
+
+  return 0;
+}
+
+
+/* scans 'text' for its INDI records.  The text is not copied and must
+ * stay unchanged until the exporter is freed.  Returns -1 if memory ran
+ * out. */
+
+int initExporter( gedEXPORTER_t *exporter, ofCHAR_t *text, ofUI64_t length, int format )
+{
+  gedRECORD_t *record;
+  ofUI32_t     i;
+
+  memset( exporter, 0, sizeof( *exporter ) );
+  exporter->text = text;
+  exporter->length = length;
+  exporter->format = format;
+
+  initRecordList( &exporter->records );
+  if( scanGEDCOMRecords( text, length, &exporter->records ) != 0 ) {
+    return -1;
+  }
+
+  if( exporter->records.count > 0 ) {
+    exporter->people = (ofUI32_t*)malloc( exporter->records.count * sizeof( ofUI32_t ) );
+    if( exporter->people == 0 ) {
+      return -1;
+    }
+  }
+
+  for( i = 0; i < exporter->records.count; i++ ) {
+    record = &exporter->records.records[ i ];
+    if( record->tagLength == 4 && memcmp( text + record->offset + record->tagOffset, "INDI", 4 ) == 0 ) {
+      exporter->people[ exporter->count++ ] = i;
+    }
+  }
+
+  /* the header and trailer go with the first and last batch, so there is
+   * always at least one */
+
+  exporter->batchCount = ( exporter->count + gcEXPORTBATCHSIZE - 1 ) / gcEXPORTBATCHSIZE;
+  if( exporter->batchCount == 0 ) {
+    exporter->batchCount = 1;
+  }
+
+  return 0;
+}
+
+
+void freeExporter( gedEXPORTER_t *exporter )
+{
+  int i;
+
+  for( i = 0; i < gcMAXEXPORTROUND; i++ ) {
+    free( exporter->batches[ i ].data );
+    exporter->batches[ i ].data = 0;
+    exporter->batches[ i ].length = exporter->batches[ i ].size = 0;
+  }
+
+  freeRecordList( &exporter->records );
+  free( exporter->people );
+  exporter->people = 0;
+  exporter->count = 0;
+}
+
+
+/* encodes batches first .. first + count - 1 (count at most
+ * gcMAXEXPORTROUND) into exporter->batches[ 0 .. count - 1 ], spread over
+ * up to 'threads' threads.  Returns -1 if memory ran out. */
+
+int encodeExportBatches( gedEXPORTER_t *exporter, ofUI32_t first, ofUI32_t count, int threads )
+{
+  gedEXPORTWORK_t work[ gcMAXEXPORTTHREADS ];
+#ifdef HAVE_PTHREAD_H
+  pthread_t       workers[ gcMAXEXPORTTHREADS ];
+  int             started[ gcMAXEXPORTTHREADS ];
+#endif
+  int             failed;
+  int             t;
+
+#ifdef HAVE_PTHREAD_H
+  if( threads > gcMAXEXPORTTHREADS ) {
+    threads = gcMAXEXPORTTHREADS;
+  }
+#else
+  threads = 1;
+#endif
+  if( threads > (int)count ) {
+    threads = count;
+  }
+  if( threads < 1 ) {
+    threads = 1;
+  }
+
+  for( t = 0; t < threads; t++ ) {
+    memset( &work[ t ], 0, sizeof( work[ t ] ) );
+    work[ t ].exporter = exporter;
+    work[ t ].first = first;
+    work[ t ].count = count;
+    work[ t ].offset = t;
+    work[ t ].step = threads;
+  }
+
+#ifdef HAVE_PTHREAD_H
+  for( t = 1; t < threads; t++ ) {
+    started[ t ] = ( pthread_create( &workers[ t ], 0, encodeBatches, &work[ t ] ) == 0 );
+  }
+  encodeBatches( &work[ 0 ] );
+  for( t = 1; t < threads; t++ ) {
+    if( started[ t ] ) {
+      pthread_join( workers[ t ], 0 );
+    } else {
+      encodeBatches( &work[ t ] );
+    }
+  }
+#else
+  encodeBatches( &work[ 0 ] );
+#endif
+
+  failed = 0;
+  for( t = 0; t < threads; t++ ) {
+    failed |= work[ t ].failed;
+    exporter->rows += work[ t ].encoded;
+  }
+
+  return failed ? -1 : 0;
+}
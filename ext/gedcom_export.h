@@ -0,0 +1,70 @@
+/* -------------------------------------------------------------------------
+ * gedcom_export.h -- Defines the interface for the event table exporter.
+ * Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+ * -------------------------------------------------------------------------
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ------------------------------------------------------------------------- */
+
+#ifndef __GEDEXPORT_H__
+#define __GEDEXPORT_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "gedcom_types.h"
+#include "gedcom_record.h"
+
+/* export constants */
+
+  #define gcEXPORTCSV          ( 0 )
+  #define gcEXPORTCOLUMNS      ( 1 )
+
+  #define gcEXPORTBATCHSIZE    ( 1024 )  /* INDI records per batch */
+  #define gcMAXEXPORTTHREADS   ( 16 )
+  #define gcMAXEXPORTROUND     ( 4 * gcMAXEXPORTTHREADS )  /* batches encoded at once */
+
+/* types */
+
+typedef struct {
+  ofCHAR_t *data;
+  ofUI64_t  length;
+  ofUI64_t  size;
+} gedEXPORTBUFFER_t;
+
+typedef struct {
+  ofCHAR_t          *text;
+  ofUI64_t           length;
+  int                format;
+  gedRECORDLIST_t    records;
+  ofUI32_t          *people;     /* indexes of the INDI records */
+  ofUI32_t           count;
+  ofUI32_t           batchCount;
+  gedEXPORTBUFFER_t  batches[ gcMAXEXPORTROUND ];
+  ofUI64_t           rows;
+} gedEXPORTER_t;
+
+
+int initExporter( gedEXPORTER_t *exporter, ofCHAR_t *text, ofUI64_t length, int format );
+
+void freeExporter( gedEXPORTER_t *exporter );
+
+int encodeExportBatches( gedEXPORTER_t *exporter, ofUI32_t first, ofUI32_t count, int threads );
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // __GEDEXPORT_H__
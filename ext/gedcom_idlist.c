@@ -0,0 +1,168 @@
+/* -------------------------------------------------------------------------
+ * gedcom_idlist.c -- Defines the growable id lists shared by the indexes.
+ * Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+ * -------------------------------------------------------------------------
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ------------------------------------------------------------------------- */
+
+#include <stdlib.h>
+
+#include "gedcom_types.h"
+#include "gedcom_idlist.h"
+
+
+void initIdList( gedIDLIST_t *list )
+{
+  list->ids = 0;
+  list->count = 0;
+  list->size = 0;
+}
+
+
+void freeIdList( gedIDLIST_t *list )
+{
+  free( list->ids );
+  initIdList( list );
+}
+
+
+/* the bytes allocated for the ids, not counting the list itself */
+
+ofUI64_t getIdListMemory( gedIDLIST_t *list )
+{
+  return (ofUI64_t)list->size * sizeof( ofUI32_t );
+}
+
+
+static int growIdList( gedIDLIST_t *list, ofUI32_t count )
+{
+  ofUI32_t *ids;
+  ofUI32_t  size;
+
+  if( list->count + count <= list->size ) {
+    return 0;
+  }
+
+  size = ( list->size == 0 ) ? 4 : list->size;
+  while( size < list->count + count ) {
+    size *= 2;
+  }
+
+  ids = (ofUI32_t*)realloc( list->ids, size * sizeof( ofUI32_t ) );
+  if( ids == 0 ) {
+    return -1;
+  }
+
+  list->ids = ids;
+  list->size = size;
+  return 0;
+}
+
+
+int appendIdList( gedIDLIST_t *list, ofUI32_t id )
+{
+  if( growIdList( list, 1 ) != 0 ) {
+    return -1;
+  }
+
+  list->ids[ list->count++ ] = id;
+  return 0;
+}
+
+
+int appendIdsToList( gedIDLIST_t *list, ofUI32_t *ids, ofUI32_t count )
+{
+  ofUI32_t i;
+
+  if( growIdList( list, count ) != 0 ) {
+    return -1;
+  }
+
+  for( i = 0; i < count; i++ ) {
+    list->ids[ list->count++ ] = ids[ i ];
+  }
+  return 0;
+}
+
+
+static int compareIds( const void *a, const void *b )
+{
+  ofUI32_t x = *(const ofUI32_t*)a;
+  ofUI32_t y = *(const ofUI32_t*)b;
+
+  return ( x < y ) ? -1 : ( x > y );
+}
+
+
+/* sorts the list and drops duplicate ids */
+
+void uniqueIdList( gedIDLIST_t *list )
+{
+  ofUI32_t i;
+  ofUI32_t n;
+
+  if( list->count < 2 ) {
+    return;
+  }
+
+  qsort( list->ids, list->count, sizeof( ofUI32_t ), compareIds );
+
+  for( i = 1, n = 1; i < list->count; i++ ) {
+    if( list->ids[ i ] != list->ids[ n-1 ] ) {
+      list->ids[ n++ ] = list->ids[ i ];
+    }
+  }
+  list->count = n;
+}
+
+
+/* binary search of a list that has been through uniqueIdList */
+
+int containsId( gedIDLIST_t *list, ofUI32_t id )
+{
+  ofUI32_t low;
+  ofUI32_t high;
+
+  low = 0;
+  high = list->count;
+  while( low < high ) {
+    ofUI32_t middle = ( low + high ) / 2;
+
+    if( list->ids[ middle ] < id ) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+
+  return ( low < list->count && list->ids[ low ] == id );
+}
+
+
+/* drops the ids found in 'removed' (a unique list), keeping the order of
+ * the rest */
+
+void removeIdsFromList( gedIDLIST_t *list, gedIDLIST_t *removed )
+{
+  ofUI32_t i;
+  ofUI32_t n;
+
+  for( i = 0, n = 0; i < list->count; i++ ) {
+    if( !containsId( removed, list->ids[ i ] ) ) {
+      list->ids[ n++ ] = list->ids[ i ];
+    }
+  }
+  list->count = n;
+}
@@ -0,0 +1,58 @@
+/* -------------------------------------------------------------------------
+ * gedcom_idlist.h -- Defines the growable id lists shared by the indexes.
+ * Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+ * -------------------------------------------------------------------------
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ------------------------------------------------------------------------- */
+
+#ifndef __GEDIDLIST_H__
+#define __GEDIDLIST_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "gedcom_types.h"
+
+/* types */
+
+typedef struct {
+  ofUI32_t *ids;
+  ofUI32_t  count;
+  ofUI32_t  size;
+} gedIDLIST_t;
+
+
+void initIdList( gedIDLIST_t *list );
+
+void freeIdList( gedIDLIST_t *list );
+
+ofUI64_t getIdListMemory( gedIDLIST_t *list );
+
+int appendIdList( gedIDLIST_t *list, ofUI32_t id );
+
+int appendIdsToList( gedIDLIST_t *list, ofUI32_t *ids, ofUI32_t count );
+
+void uniqueIdList( gedIDLIST_t *list );
+
+int containsId( gedIDLIST_t *list, ofUI32_t id );
+
+void removeIdsFromList( gedIDLIST_t *list, gedIDLIST_t *removed );
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // __GEDIDLIST_H__
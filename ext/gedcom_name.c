@@ -0,0 +1,858 @@
+/* -------------------------------------------------------------------------
+ * gedcom_name.c -- Defines NAME value splitting, phonetic codes and the name index.
+ * Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+ * -------------------------------------------------------------------------
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ------------------------------------------------------------------------- */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "gedcom_types.h"
+#include "gedcom_idlist.h"
+#include "gedcom_name.h"
+
+
+/* ASCII folding of U+00C0 through U+017F (Latin-1 Supplement and Latin
+ * Extended-A).  A space means the character is not a letter, and the lower
+ * case letters stand for the two-letter foldings expanded by foldLetter. */
+
+static const char foldTable[] =
+  "AAAAAAaCEEEEIIIIDNOOOOO OUUUUYts"   /* U+00C0 */
+  "AAAAAAaCEEEEIIIIDNOOOOO OUUUUYtY"   /* U+00E0 */
+  "AAAAAACCCCCCCCDDDDEEEEEEEEEEGGGG"   /* U+0100 */
+  "GGGGHHHHIIIIIIIIIIiiJJKKKLLLLLLL"   /* U+0120 */
+  "LLLNNNNNNNNNOOOOOOooRRRRRRSSSSSS"   /* U+0140 */
+  "SSTTTTTTUUUUUUUUUUUUWWYYYZZZZZZS";  /* U+0160 */
+
+
+static const char* foldLetter( int codePoint, char *letter )
+{
+  if( codePoint < 0xC0 || codePoint > 0x17F ) {
+    return 0;
+  }
+
+  switch( foldTable[ codePoint - 0xC0 ] ) {
+    case ' ': return 0;
+    case 'a': return "AE";
+    case 'i': return "IJ";
+    case 'o': return "OE";
+    case 's': return "SS";
+    case 't': return "TH";
+  }
+
+  letter[ 0 ] = foldTable[ codePoint - 0xC0 ];
+  letter[ 1 ] = '\0';
+  return letter;
+}
+
+
+static int isContinuation( ofCHAR_t c )
+{
+  return ( c & 0xC0 ) == 0x80;
+}
+
+
+/* splits "given /surname/ suffix" into its three parts (offsets into
+ * 'value', with surrounding blanks trimmed).  A value with no slashes is
+ * all given name. */
+
+static void trimPart( ofCHAR_t *value, int start, int end, int *partStart, int *partLength )
+{
+  while( start < end && ( value[ start ] == ' ' || value[ start ] == '\t' ) ) {
+    start++;
+  }
+  while( end > start && ( value[ end-1 ] == ' ' || value[ end-1 ] == '\t' ) ) {
+    end--;
+  }
+
+  *partStart = start;
+  *partLength = end - start;
+}
+
+
+void splitGEDCOMName( ofCHAR_t *value, gedNAME_t *name )
+{
+  ofCHAR_t *slash1;
+  ofCHAR_t *slash2;
+  int       length;
+
+  length = strlen( (char*)value );
+  slash1 = (ofCHAR_t*)strchr( (char*)value, '/' );
+  slash2 = ( slash1 != 0 ) ? (ofCHAR_t*)strchr( (char*)slash1 + 1, '/' ) : 0;
+
+  if( slash1 == 0 ) {
+    trimPart( value, 0, length, &name->givenStart, &name->givenLength );
+    name->surnameStart = name->suffixStart = length;
+    name->surnameLength = name->suffixLength = 0;
+    return;
+  }
+
+  if( slash2 == 0 ) {
+    slash2 = value + length;
+  }
+
+  trimPart( value, 0, slash1 - value, &name->givenStart, &name->givenLength );
+  trimPart( value, slash1 - value + 1, slash2 - value, &name->surnameStart, &name->surnameLength );
+
+  if( *slash2 == '\0' ) {
+    name->suffixStart = length;
+    name->suffixLength = 0;
+  } else {
+    trimPart( value, slash2 - value + 1, length, &name->suffixStart, &name->suffixLength );
+  }
+}
+
+
+/* copies 'text' into 'buffer' as upper case ASCII with the diacritics
+ * stripped.  Runs of anything that is not a letter become a single space.
+ * Letters beyond Latin Extended-A are copied through unchanged, and bytes
+ * that are not valid UTF-8 are read as Latin-1.  Returns the length of the
+ * normalized text. */
+
+int normalizeGEDCOMName( ofCHAR_t *text, int length, ofCHAR_t *buffer, int size )
+{
+  int   i;
+  int   n;
+  int   j;
+  int   count;
+  int   codePoint;
+  int         space;
+  const char *fold;
+  char        letter[ 2 ];
+
+  n = 0;
+  space = 0;
+
+  for( i = 0; i < length && n < size - 1; i += count ) {
+    ofCHAR_t c = text[ i ];
+
+    count = 1;
+    fold = 0;
+
+    if( c >= 'a' && c <= 'z' ) {
+      c -= 'a' - 'A';
+    }
+
+    if( c >= 'A' && c <= 'Z' ) {
+      if( space && n > 0 ) {
+        buffer[ n++ ] = ' ';
+      }
+      if( n < size - 1 ) {
+        buffer[ n++ ] = c;
+      }
+      space = 0;
+      continue;
+    }
+
+    if( c < 0x80 ) {
+      space = 1;
+      continue;
+    }
+
+    /* work out the length of the UTF-8 sequence, if it is one */
+
+    if( c >= 0xC2 && c <= 0xDF ) {
+      count = 2;
+    } else if( c >= 0xE0 && c <= 0xEF ) {
+      count = 3;
+    } else if( c >= 0xF0 && c <= 0xF4 ) {
+      count = 4;
+    }
+
+    for( j = 1; j < count; j++ ) {
+      if( i + j >= length || !isContinuation( text[ i+j ] ) ) {
+        count = 1;
+        break;
+      }
+    }
+
+    if( count == 1 ) {
+      fold = foldLetter( c, letter );
+    } else if( count == 2 ) {
+      codePoint = ( ( c & 0x1F ) << 6 ) | ( text[ i+1 ] & 0x3F );
+      fold = foldLetter( codePoint, letter );
+      if( fold == 0 && codePoint < 0x180 ) {
+        space = 1;
+        continue;
+      }
+    }
+
+    if( fold == 0 && count == 1 ) {
+      space = 1;
+      continue;
+    }
+
+    if( space && n > 0 ) {
+      buffer[ n++ ] = ' ';
+    }
+    space = 0;
+
+    if( fold != 0 ) {
+      for( j = 0; fold[ j ] != '\0' && n < size - 1; j++ ) {
+        buffer[ n++ ] = fold[ j ];
+      }
+    } else if( n + count < size ) {
+      memcpy( buffer + n, text + i, count );
+      n += count;
+    }
+  }
+
+  buffer[ n ] = '\0';
+  return n;
+}
+
+
+/* american soundex: the first letter, then the codes of the consonants
+ * that follow, with repeats collapsed unless a vowel separates them (H and
+ * W do not separate) */
+
+static const char soundexCodes[] = "01230120022455012623010202";
+
+void soundexGEDCOMName( ofCHAR_t *normalized, ofCHAR_t *code )
+{
+  char last;
+  int  n;
+
+  n = 0;
+  last = 0;
+
+  for( ; *normalized != '\0' && n < gcSOUNDEXSIZE - 1; normalized++ ) {
+    ofCHAR_t c = *normalized;
+    char     digit;
+
+    if( c < 'A' || c > 'Z' ) {
+      continue;
+    }
+
+    digit = soundexCodes[ c - 'A' ];
+
+    if( n == 0 ) {
+      code[ n++ ] = c;
+      last = digit;
+    } else if( digit == '0' ) {
+      if( c != 'H' && c != 'W' ) {
+        last = 0;
+      }
+    } else if( digit != last ) {
+      code[ n++ ] = digit;
+      last = digit;
+    }
+  }
+
+  if( n == 0 ) {
+    code[ 0 ] = '\0';
+    return;
+  }
+
+  while( n < gcSOUNDEXSIZE - 1 ) {
+    code[ n++ ] = '0';
+  }
+  code[ n ] = '\0';
+}
+
+
+/* daitch-mokotoff soundex.  Each rule gives the code to use at the start of
+ * the name, before a vowel, and anywhere else; "|" separates alternatives,
+ * which branch the code, and an empty code means the letters are not coded.
+ * Rules starting with the same letter are listed longest first. */
+
+static struct {
+  const char *pattern;
+  const char *atStart;
+  const char *beforeVowel;
+  const char *other;
+} dmRules[] = {
+  { "AI",       "0",    "1",    ""     },
+  { "AJ",       "0",    "1",    ""     },
+  { "AY",       "0",    "1",    ""     },
+  { "AU",       "0",    "7",    ""     },
+  { "A",        "0",    "",     ""     },
+  { "B",        "7",    "7",    "7"    },
+  { "CHS",      "5",    "54",   "54"   },
+  { "CSZ",      "4",    "4",    "4"    },
+  { "CZS",      "4",    "4",    "4"    },
+  { "CH",       "5|4",  "5|4",  "5|4"  },
+  { "CK",       "5|45", "5|45", "5|45" },
+  { "CS",       "4",    "4",    "4"    },
+  { "CZ",       "4",    "4",    "4"    },
+  { "C",        "5|4",  "5|4",  "5|4"  },
+  { "DRS",      "4",    "4",    "4"    },
+  { "DRZ",      "4",    "4",    "4"    },
+  { "DSH",      "4",    "4",    "4"    },
+  { "DSZ",      "4",    "4",    "4"    },
+  { "DZH",      "4",    "4",    "4"    },
+  { "DZS",      "4",    "4",    "4"    },
+  { "DS",       "4",    "4",    "4"    },
+  { "DT",       "3",    "3",    "3"    },
+  { "DZ",       "4",    "4",    "4"    },
+  { "D",        "3",    "3",    "3"    },
+  { "EI",       "0",    "1",    ""     },
+  { "EJ",       "0",    "1",    ""     },
+  { "EY",       "0",    "1",    ""     },
+  { "EU",       "1",    "1",    ""     },
+  { "E",        "0",    "",     ""     },
+  { "FB",       "7",    "7",    "7"    },
+  { "F",        "7",    "7",    "7"    },
+  { "G",        "5",    "5",    "5"    },
+  { "H",        "5",    "5",    ""     },
+  { "IA",       "1",    "",     ""     },
+  { "IE",       "1",    "",     ""     },
+  { "IO",       "1",    "",     ""     },
+  { "IU",       "1",    "",     ""     },
+  { "I",        "0",    "",     ""     },
+  { "J",        "1|4",  "|4",   "|4"   },
+  { "KH",       "5",    "5",    "5"    },
+  { "KS",       "5",    "54",   "54"   },
+  { "K",        "5",    "5",    "5"    },
+  { "L",        "8",    "8",    "8"    },
+  { "MN",       "66",   "66",   "66"   },
+  { "M",        "6",    "6",    "6"    },
+  { "NM",       "66",   "66",   "66"   },
+  { "N",        "6",    "6",    "6"    },
+  { "OI",       "0",    "1",    ""     },
+  { "OJ",       "0",    "1",    ""     },
+  { "OY",       "0",    "1",    ""     },
+  { "O",        "0",    "",     ""     },
+  { "PF",       "7",    "7",    "7"    },
+  { "PH",       "7",    "7",    "7"    },
+  { "P",        "7",    "7",    "7"    },
+  { "Q",        "5",    "5",    "5"    },
+  { "RS",       "4|94", "4|94", "4|94" },
+  { "RZ",       "4|94", "4|94", "4|94" },
+  { "R",        "9",    "9",    "9"    },
+  { "SCHTSCH",  "2",    "4",    "4"    },
+  { "SCHTSH",   "2",    "4",    "4"    },
+  { "SCHTCH",   "2",    "4",    "4"    },
+  { "SHTCH",    "2",    "4",    "4"    },
+  { "SHTSH",    "2",    "4",    "4"    },
+  { "STSCH",    "2",    "4",    "4"    },
+  { "SCHT",     "2",    "43",   "43"   },
+  { "SCHD",     "2",    "43",   "43"   },
+  { "SHCH",     "2",    "4",    "4"    },
+  { "STCH",     "2",    "4",    "4"    },
+  { "STRZ",     "2",    "4",    "4"    },
+  { "STRS",     "2",    "4",    "4"    },
+  { "STSH",     "2",    "4",    "4"    },
+  { "SZCZ",     "2",    "4",    "4"    },
+  { "SZCS",     "2",    "4",    "4"    },
+  { "SCH",      "4",    "4",    "4"    },
+  { "SHT",      "2",    "43",   "43"   },
+  { "SZT",      "2",    "43",   "43"   },
+  { "SHD",      "2",    "43",   "43"   },
+  { "SZD",      "2",    "43",   "43"   },
+  { "SC",       "2",    "4",    "4"    },
+  { "SD",       "2",    "43",   "43"   },
+  { "SH",       "4",    "4",    "4"    },
+  { "ST",       "2",    "43",   "43"   },
+  { "SZ",       "4",    "4",    "4"    },
+  { "S",        "4",    "4",    "4"    },
+  { "TTSCH",    "4",    "4",    "4"    },
+  { "TSCH",     "4",    "4",    "4"    },
+  { "TTCH",     "4",    "4",    "4"    },
+  { "TTSZ",     "4",    "4",    "4"    },
+  { "TCH",      "4",    "4",    "4"    },
+  { "TRZ",      "4",    "4",    "4"    },
+  { "TRS",      "4",    "4",    "4"    },
+  { "TSH",      "4",    "4",    "4"    },
+  { "TTS",      "4",    "4",    "4"    },
+  { "TTZ",      "4",    "4",    "4"    },
+  { "TZS",      "4",    "4",    "4"    },
+  { "TSZ",      "4",    "4",    "4"    },
+  { "TC",       "4",    "4",    "4"    },
+  { "TH",       "3",    "3",    "3"    },
+  { "TS",       "4",    "4",    "4"    },
+  { "TZ",       "4",    "4",    "4"    },
+  { "T",        "3",    "3",    "3"    },
+  { "UI",       "0",    "1",    ""     },
+  { "UJ",       "0",    "1",    ""     },
+  { "UY",       "0",    "1",    ""     },
+  { "UE",       "0",    "",     ""     },
+  { "U",        "0",    "",     ""     },
+  { "V",        "7",    "7",    "7"    },
+  { "W",        "7",    "7",    "7"    },
+  { "X",        "5",    "54",   "54"   },
+  { "Y",        "1",    "",     ""     },
+  { "ZHDZH",    "2",    "4",    "4"    },
+  { "ZDZH",     "2",    "4",    "4"    },
+  { "ZSCH",     "4",    "4",    "4"    },
+  { "ZDZ",      "2",    "4",    "4"    },
+  { "ZHD",      "2",    "43",   "43"   },
+  { "ZSH",      "4",    "4",    "4"    },
+  { "ZD",       "2",    "43",   "43"   },
+  { "ZH",       "4",    "4",    "4"    },
+  { "ZS",       "4",    "4",    "4"    },
+  { "Z",        "4",    "4",    "4"    },
+  { 0,          0,      0,      0      }
+};
+
+typedef struct {
+  char code[ gcDMSOUNDEXSIZE ];
+  int  length;
+  char last[ 4 ];
+} gedDMBRANCH_t;
+
+
+static int isDMVowel( ofCHAR_t c )
+{
+  return ( c == 'A' || c == 'E' || c == 'I' || c == 'O' || c == 'U' );
+}
+
+
+/* appends one replacement to a branch; a code is not repeated when the
+ * previous letters produced the same code, unless M and N meet */
+
+static void appendDMCode( gedDMBRANCH_t *branch, const char *code, int length, int force )
+{
+  int lastLength;
+  int i;
+
+  lastLength = strlen( branch->last );
+
+  if( length > 0 && branch->length < gcDMSOUNDEXSIZE - 1 &&
+      ( force || lastLength < length || strncmp( branch->last + lastLength - length, code, length ) != 0 ) )
+  {
+    for( i = 0; i < length && branch->length < gcDMSOUNDEXSIZE - 1; i++ ) {
+      branch->code[ branch->length++ ] = code[ i ];
+    }
+  }
+
+  memcpy( branch->last, code, length );
+  branch->last[ length ] = '\0';
+}
+
+
+int dmSoundexGEDCOMName( ofCHAR_t *normalized, ofCHAR_t codes[][ gcDMSOUNDEXSIZE ], int max )
+{
+  gedDMBRANCH_t branches[ gcMAXDMCODES ];
+  gedDMBRANCH_t next[ gcMAXDMCODES ];
+  ofCHAR_t      letters[ gcMAXNAMESIZE ];
+  ofCHAR_t      lastLetter;
+  int           branchCount;
+  int           nextCount;
+  int           length;
+  int           i;
+  int           j;
+  int           r;
+  int           n;
+
+  /* only the letters take part */
+
+  for( i = 0, length = 0; normalized[ i ] != '\0' && length < gcMAXNAMESIZE - 1; i++ ) {
+    if( normalized[ i ] >= 'A' && normalized[ i ] <= 'Z' ) {
+      letters[ length++ ] = normalized[ i ];
+    }
+  }
+  letters[ length ] = '\0';
+
+  if( length == 0 ) {
+    return 0;
+  }
+
+  memset( &branches[ 0 ], 0, sizeof( gedDMBRANCH_t ) );
+  branchCount = 1;
+  lastLetter = 0;
+
+  for( i = 0; i < length; ) {
+    const char *replacement;
+    int         patternLength;
+    int         force;
+
+    for( r = 0; dmRules[ r ].pattern != 0; r++ ) {
+      if( dmRules[ r ].pattern[ 0 ] == letters[ i ] &&
+          strncmp( dmRules[ r ].pattern, (char*)letters + i, strlen( dmRules[ r ].pattern ) ) == 0 )
+      {
+        break;
+      }
+    }
+
+    if( dmRules[ r ].pattern == 0 ) {
+      lastLetter = letters[ i++ ];
+      continue;
+    }
+
+    patternLength = strlen( dmRules[ r ].pattern );
+
+    if( i == 0 ) {
+      replacement = dmRules[ r ].atStart;
+    } else if( isDMVowel( letters[ i + patternLength ] ) ) {
+      replacement = dmRules[ r ].beforeVowel;
+    } else {
+      replacement = dmRules[ r ].other;
+    }
+
+    force = ( lastLetter == 'M' && letters[ i ] == 'N' ) || ( lastLetter == 'N' && letters[ i ] == 'M' );
+
+    /* every branch is continued with every alternative */
+
+    nextCount = 0;
+    for( j = 0; j < branchCount; j++ ) {
+      const char *alternative = replacement;
+
+      for( ;; ) {
+        const char *bar = strchr( alternative, '|' );
+        int         altLength = ( bar != 0 ) ? bar - alternative : (int)strlen( alternative );
+
+        if( nextCount < gcMAXDMCODES ) {
+          next[ nextCount ] = branches[ j ];
+          appendDMCode( &next[ nextCount ], alternative, altLength, force );
+          nextCount++;
+        }
+
+        if( bar == 0 ) {
+          break;
+        }
+        alternative = bar + 1;
+      }
+    }
+
+    memcpy( branches, next, nextCount * sizeof( next[0] ) );
+    branchCount = nextCount;
+
+    lastLetter = letters[ i ];
+    i += patternLength;
+  }
+
+  /* pad to six digits and drop the branches that came out the same */
+
+  n = 0;
+  for( j = 0; j < branchCount && n < max; j++ ) {
+    while( branches[ j ].length < gcDMSOUNDEXSIZE - 1 ) {
+      branches[ j ].code[ branches[ j ].length++ ] = '0';
+    }
+    branches[ j ].code[ branches[ j ].length ] = '\0';
+
+    for( r = 0; r < n; r++ ) {
+      if( strcmp( (char*)codes[ r ], branches[ j ].code ) == 0 ) {
+        break;
+      }
+    }
+    if( r == n ) {
+      strcpy( (char*)codes[ n++ ], branches[ j ].code );
+    }
+  }
+
+  return n;
+}
+
+
+void initNameIndex( gedNAMEINDEX_t *index )
+{
+  memset( index, 0, sizeof( *index ) );
+}
+
+
+static void freeSortedKeys( gedNAMEKEYS_t *keys )
+{
+  free( keys->keys );
+  free( keys->starts );
+  free( keys->postings );
+  keys->keys = keys->starts = keys->postings = 0;
+  keys->keyCount = 0;
+  keys->sorted = 0;
+}
+
+
+void freeNameIndex( gedNAMEINDEX_t *index )
+{
+  int i;
+
+  for( i = 0; i < gnkCOUNT; i++ ) {
+    freeSortedKeys( &index->keys[ i ] );
+    free( index->keys[ i ].entries );
+    free( index->keys[ i ].arena );
+  }
+
+  initNameIndex( index );
+}
+
+
+/* the bytes allocated by the index, not counting the index itself.  The
+ * sorted arrays were sized for the entries there were when they were
+ * built, so they are counted from the current entries. */
+
+ofUI64_t getNameIndexMemory( gedNAMEINDEX_t *index )
+{
+  gedNAMEKEYS_t *keys;
+  ofUI64_t       memory;
+  int            i;
+
+  memory = 0;
+
+  for( i = 0; i < gnkCOUNT; i++ ) {
+    keys = &index->keys[ i ];
+    memory += (ofUI64_t)keys->size * sizeof( gedNAMEENTRY_t ) + keys->arenaSize;
+    if( keys->keys != 0 ) {
+      memory += (ofUI64_t)( keys->count + 1 ) * 3 * sizeof( ofUI32_t );
+    }
+  }
+
+  return memory;
+}
+
+
+static int addKey( gedNAMEKEYS_t *keys, ofCHAR_t *key, int length, ofUI32_t id )
+{
+  if( keys->count == keys->size ) {
+    ofUI32_t        size = ( keys->size == 0 ) ? 64 : keys->size * 2;
+    gedNAMEENTRY_t *entries = (gedNAMEENTRY_t*)realloc( keys->entries, size * sizeof( gedNAMEENTRY_t ) );
+
+    if( entries == 0 ) {
+      return -1;
+    }
+    keys->entries = entries;
+    keys->size = size;
+  }
+
+  if( keys->arenaLength + length + 1 > keys->arenaSize ) {
+    ofUI32_t  size = ( keys->arenaSize == 0 ) ? 1024 : keys->arenaSize;
+    ofCHAR_t *arena;
+
+    while( size < keys->arenaLength + length + 1 ) {
+      size *= 2;
+    }
+    arena = (ofCHAR_t*)realloc( keys->arena, size );
+    if( arena == 0 ) {
+      return -1;
+    }
+    keys->arena = arena;
+    keys->arenaSize = size;
+  }
+
+  memcpy( keys->arena + keys->arenaLength, key, length );
+  keys->arena[ keys->arenaLength + length ] = '\0';
+
+  keys->entries[ keys->count ].key = keys->arenaLength;
+  keys->entries[ keys->count ].id = id;
+  keys->count++;
+
+  keys->arenaLength += length + 1;
+  keys->sorted = 0;
+
+  return 0;
+}
+
+
+int addName( gedNAMEINDEX_t *index, ofUI32_t id, ofCHAR_t *value )
+{
+  gedNAME_t name;
+  ofCHAR_t  normalized[ gcMAXNAMESIZE ];
+  ofCHAR_t  soundex[ gcSOUNDEXSIZE ];
+  ofCHAR_t  dmCodes[ gcMAXDMCODES ][ gcDMSOUNDEXSIZE ];
+  int       length;
+  int       start;
+  int       count;
+  int       i;
+
+  splitGEDCOMName( value, &name );
+
+  length = normalizeGEDCOMName( value + name.surnameStart, name.surnameLength, normalized, sizeof( normalized ) );
+  if( length > 0 ) {
+    if( addKey( &index->keys[ gnkSURNAME ], normalized, length, id ) != 0 ) {
+      return -1;
+    }
+
+    soundexGEDCOMName( normalized, soundex );
+    if( soundex[ 0 ] != '\0' && addKey( &index->keys[ gnkSOUNDEX ], soundex, strlen( (char*)soundex ), id ) != 0 ) {
+      return -1;
+    }
+
+    count = dmSoundexGEDCOMName( normalized, dmCodes, gcMAXDMCODES );
+    for( i = 0; i < count; i++ ) {
+      if( addKey( &index->keys[ gnkDMSOUNDEX ], dmCodes[ i ], gcDMSOUNDEXSIZE - 1, id ) != 0 ) {
+        return -1;
+      }
+    }
+  }
+
+  /* each of the given names is a key of its own */
+
+  length = normalizeGEDCOMName( value + name.givenStart, name.givenLength, normalized, sizeof( normalized ) );
+  for( start = 0, i = 0; i <= length; i++ ) {
+    if( normalized[ i ] == ' ' || normalized[ i ] == '\0' ) {
+      if( i > start && addKey( &index->keys[ gnkGIVEN ], normalized + start, i - start, id ) != 0 ) {
+        return -1;
+      }
+      start = i + 1;
+    }
+  }
+
+  return 0;
+}
+
+
+/* drops the keys of the ids in 'removed' (a unique id list).  The arena
+ * is compacted as it goes, so that reloading records does not grow it. */
+
+void removeNames( gedNAMEINDEX_t *index, gedIDLIST_t *removed )
+{
+  gedNAMEKEYS_t *keys;
+  ofUI32_t       arenaLength;
+  ofUI32_t       length;
+  ofUI32_t       i;
+  ofUI32_t       n;
+  int            kind;
+
+  for( kind = 0; kind < gnkCOUNT; kind++ ) {
+    keys = &index->keys[ kind ];
+    arenaLength = 0;
+
+    /* entries are in arena order, so live keys only ever move down */
+
+    for( i = 0, n = 0; i < keys->count; i++ ) {
+      if( containsId( removed, keys->entries[ i ].id ) ) {
+        continue;
+      }
+
+      length = strlen( (char*)keys->arena + keys->entries[ i ].key ) + 1;
+      memmove( keys->arena + arenaLength, keys->arena + keys->entries[ i ].key, length );
+
+      keys->entries[ n ].key = arenaLength;
+      keys->entries[ n ].id = keys->entries[ i ].id;
+      arenaLength += length;
+      n++;
+    }
+
+    if( n != keys->count ) {
+      keys->count = n;
+      keys->arenaLength = arenaLength;
+      freeSortedKeys( keys );
+    }
+  }
+}
+
+
+typedef struct {
+  ofCHAR_t *text;
+  ofUI32_t  id;
+} gedSORTKEY_t;
+
+
+static int compareSortKeys( const void *a, const void *b )
+{
+  const gedSORTKEY_t *x = (const gedSORTKEY_t*)a;
+  const gedSORTKEY_t *y = (const gedSORTKEY_t*)b;
+  int                 rc;
+
+  rc = strcmp( (char*)x->text, (char*)y->text );
+  if( rc != 0 ) {
+    return rc;
+  }
+
+  return ( x->id < y->id ) ? -1 : ( x->id > y->id );
+}
+
+
+/* rebuilds the sorted keys and their posting lists from the entries */
+
+static int sortNameKeys( gedNAMEKEYS_t *keys )
+{
+  gedSORTKEY_t *sorted;
+  ofUI32_t      i;
+  ofUI32_t      k;
+  ofUI32_t      p;
+
+  freeSortedKeys( keys );
+
+  sorted = (gedSORTKEY_t*)malloc( ( keys->count + 1 ) * sizeof( gedSORTKEY_t ) );
+  keys->keys = (ofUI32_t*)malloc( ( keys->count + 1 ) * sizeof( ofUI32_t ) );
+  keys->starts = (ofUI32_t*)malloc( ( keys->count + 1 ) * sizeof( ofUI32_t ) );
+  keys->postings = (ofUI32_t*)malloc( ( keys->count + 1 ) * sizeof( ofUI32_t ) );
+
+  if( sorted == 0 || keys->keys == 0 || keys->starts == 0 || keys->postings == 0 ) {
+    free( sorted );
+    freeSortedKeys( keys );
+    return -1;
+  }
+
+  for( i = 0; i < keys->count; i++ ) {
+    sorted[ i ].text = keys->arena + keys->entries[ i ].key;
+    sorted[ i ].id = keys->entries[ i ].id;
+  }
+
+  qsort( sorted, keys->count, sizeof( gedSORTKEY_t ), compareSortKeys );
+
+  for( i = 0, k = 0, p = 0; i < keys->count; i++ ) {
+    if( i == 0 || strcmp( (char*)sorted[ i ].text, (char*)sorted[ i-1 ].text ) != 0 ) {
+      keys->keys[ k ] = sorted[ i ].text - keys->arena;
+      keys->starts[ k ] = p;
+      k++;
+    } else if( sorted[ i ].id == sorted[ i-1 ].id ) {
+      continue;
+    }
+    keys->postings[ p++ ] = sorted[ i ].id;
+  }
+
+  keys->starts[ k ] = p;
+  keys->keyCount = k;
+  keys->sorted = 1;
+
+  free( sorted );
+  return 0;
+}
+
+
+/* collects the ids filed under 'key' (or, if 'prefix' is set, under every
+ * key that starts with it) into 'result', sorted and without duplicates */
+
+int findNames( gedNAMEINDEX_t *index, int kind, ofCHAR_t *key, int prefix, gedIDLIST_t *result )
+{
+  gedNAMEKEYS_t *keys;
+  ofUI32_t       low;
+  ofUI32_t       high;
+  ofUI32_t       matched;
+  int            length;
+
+  if( kind < 0 || kind >= gnkCOUNT ) {
+    return -1;
+  }
+
+  keys = &index->keys[ kind ];
+  if( !keys->sorted && sortNameKeys( keys ) != 0 ) {
+    return -1;
+  }
+
+  low = 0;
+  high = keys->keyCount;
+  while( low < high ) {
+    ofUI32_t middle = ( low + high ) / 2;
+
+    if( strcmp( (char*)keys->arena + keys->keys[ middle ], (char*)key ) < 0 ) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+
+  length = strlen( (char*)key );
+
+  for( matched = 0; low < keys->keyCount; low++, matched++ ) {
+    ofCHAR_t *text = keys->arena + keys->keys[ low ];
+
+    if( prefix ? ( strncmp( (char*)text, (char*)key, length ) != 0 ) : ( strcmp( (char*)text, (char*)key ) != 0 ) ) {
+      break;
+    }
+
+    if( appendIdsToList( result, keys->postings + keys->starts[ low ], keys->starts[ low+1 ] - keys->starts[ low ] ) != 0 ) {
+      return -1;
+    }
+  }
+
+  if( matched > 1 ) {
+    uniqueIdList( result );
+  }
+
+  return 0;
+}
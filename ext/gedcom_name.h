@@ -0,0 +1,111 @@
+/* -------------------------------------------------------------------------
+ * gedcom_name.h -- Defines the interface for NAME values and the name index.
+ * Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+ * -------------------------------------------------------------------------
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ------------------------------------------------------------------------- */
+
+#ifndef __GEDNAME_H__
+#define __GEDNAME_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "gedcom_types.h"
+#include "gedcom_idlist.h"
+
+/* name key kinds */
+
+  #define gnkSURNAME     ( 0 )  /* normalized surname, searched by prefix */
+  #define gnkGIVEN       ( 1 )  /* each normalized given name, searched by prefix */
+  #define gnkSOUNDEX     ( 2 )  /* american soundex of the surname */
+  #define gnkDMSOUNDEX   ( 3 )  /* daitch-mokotoff codes of the surname */
+
+  #define gnkCOUNT       ( 4 )
+
+/* data type constants */
+
+  #define gcSOUNDEXSIZE      ( 5 )   /* "S530" plus terminator */
+  #define gcDMSOUNDEXSIZE    ( 7 )   /* "463000" plus terminator */
+  #define gcMAXDMCODES       ( 16 )
+  #define gcMAXNAMESIZE      ( 256 )
+
+/* types */
+
+typedef struct {
+  int givenStart;
+  int givenLength;
+  int surnameStart;
+  int surnameLength;
+  int suffixStart;
+  int suffixLength;
+} gedNAME_t;
+
+typedef struct {
+  ofUI32_t key;       /* offset of the key text in the arena */
+  ofUI32_t id;
+} gedNAMEENTRY_t;
+
+typedef struct {
+  gedNAMEENTRY_t *entries;
+  ofUI32_t        count;
+  ofUI32_t        size;
+
+  ofCHAR_t       *arena;
+  ofUI32_t        arenaLength;
+  ofUI32_t        arenaSize;
+
+  /* the sorted form, rebuilt on the first lookup after an add: the unique
+   * keys in ascending order, and for each key a run of ascending ids in
+   * 'postings' starting at 'starts[ key ]' */
+
+  ofUI32_t       *keys;
+  ofUI32_t       *starts;
+  ofUI32_t       *postings;
+  ofUI32_t        keyCount;
+  int             sorted;
+} gedNAMEKEYS_t;
+
+typedef struct {
+  gedNAMEKEYS_t keys[ gnkCOUNT ];
+} gedNAMEINDEX_t;
+
+
+void splitGEDCOMName( ofCHAR_t *value, gedNAME_t *name );
+
+int normalizeGEDCOMName( ofCHAR_t *text, int length, ofCHAR_t *buffer, int size );
+
+void soundexGEDCOMName( ofCHAR_t *normalized, ofCHAR_t *code );
+
+int dmSoundexGEDCOMName( ofCHAR_t *normalized, ofCHAR_t codes[][ gcDMSOUNDEXSIZE ], int max );
+
+void initNameIndex( gedNAMEINDEX_t *index );
+
+void freeNameIndex( gedNAMEINDEX_t *index );
+
+ofUI64_t getNameIndexMemory( gedNAMEINDEX_t *index );
+
+int addName( gedNAMEINDEX_t *index, ofUI32_t id, ofCHAR_t *value );
+
+void removeNames( gedNAMEINDEX_t *index, gedIDLIST_t *removed );
+
+int findNames( gedNAMEINDEX_t *index, int kind, ofCHAR_t *key, int prefix, gedIDLIST_t *result );
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // __GEDNAME_H__
@@ -0,0 +1,541 @@
+/* -------------------------------------------------------------------------
+ * gedcom_pipeline.c -- Defines the line event pipeline.
+ * Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+ * -------------------------------------------------------------------------
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ------------------------------------------------------------------------- */
+
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "gedcom_types.h"
+#include "gedcom_pipeline.h"
+#include "gedcom_probes.h"
+
+
+/* A reader thread reads the file and splits its lines into batches of
+ * events while the consumer (the Ruby thread) runs the handlers for the
+ * batches read before.  The batches live in a ring of slots with a single
+ * producer and a single consumer: the reader only ever moves 'head' and
+ * the consumer 'tail', so neither takes a lock while there is work.  Only
+ * a side that finds the ring full (the reader) or empty (the consumer)
+ * sleeps on a condition, and the time it sleeps is counted in the stats.
+ *
+ * Each slot owns its text and events, which are reused round the ring, so
+ * memory stays at about gcPIPELINECHUNK bytes a slot unless a line is
+ * longer than that. */
+
+
+/* the white-space of String#split( ' ' ): space, \t, \n, \v, \f and \r */
+
+static int isSplitSpace( ofCHAR_t c )
+{
+  return c == ' ' || ( c >= '\t' && c <= '\r' );
+}
+
+
+/* String#to_i: an optional sign, then digits with single underscores
+ * between them; saturates rather than growing a bignum */
+
+static long readLevel( const ofCHAR_t *p, const ofCHAR_t *end )
+{
+  const ofCHAR_t *digits;
+  long            level;
+  int             negative;
+
+  negative = 0;
+  if( p < end && ( *p == '+' || *p == '-' ) ) {
+    negative = ( *p == '-' );
+    p++;
+  }
+
+  level = 0;
+  digits = p;
+  while( p < end ) {
+    if( *p >= '0' && *p <= '9' ) {
+      level = ( level > ( LONG_MAX - 9 ) / 10 ) ? LONG_MAX : level * 10 + ( *p - '0' );
+    } else if( *p != '_' || p == digits || p + 1 == end || p[ 1 ] < '0' || p[ 1 ] > '9' ) {
+      break;
+    }
+    p++;
+  }
+
+  return negative ? -level : level;
+}
+
+
+/* splits the line [ start, end ) the way Parser#parse_lines does:
+
+     level, tag, rest = line.chomp.split( ' ', 3 )
+     tag, rest = rest, tag if tag =~ /@.*@/                               */
+
+static void splitLine( const ofCHAR_t *text, ofUI32_t start, ofUI32_t end, gedPIPEEVENT_t *event )
+{
+  ofUI32_t        p;
+  ofUI32_t        field;
+  ofUI32_t        swap;
+  const ofCHAR_t *at;
+
+  event->level = 0;
+  event->tagOffset = event->dataOffset = 0;
+  event->tagLength = event->dataLength = gcNOFIELD;
+
+  for( p = start; p < end && isSplitSpace( text[ p ] ); p++ );
+  if( p == end ) {
+    return;
+  }
+
+  for( field = p; p < end && !isSplitSpace( text[ p ] ); p++ );
+  event->level = readLevel( text + field, text + p );
+  if( p == end ) {
+    return;
+  }
+
+  /* the tag may be empty ("0 " is [ "0", "" ]), and so may the rest
+   * ("0 HEAD " is [ "0", "HEAD", "" ]) */
+
+  for( ; p < end && isSplitSpace( text[ p ] ); p++ );
+  for( field = p; p < end && !isSplitSpace( text[ p ] ); p++ );
+  event->tagOffset = field;
+  event->tagLength = p - field;
+
+  if( p < end ) {
+    for( ; p < end && isSplitSpace( text[ p ] ); p++ );
+    event->dataOffset = p;
+    event->dataLength = end - p;
+  }
+
+  at = (const ofCHAR_t*)memchr( text + event->tagOffset, '@', event->tagLength );
+  if( at != 0 && memchr( at + 1, '@', text + event->tagOffset + event->tagLength - at - 1 ) != 0 ) {
+    swap = event->tagOffset;
+    event->tagOffset = event->dataOffset;
+    event->dataOffset = swap;
+    swap = event->tagLength;
+    event->tagLength = event->dataLength;
+    event->dataLength = swap;
+  }
+}
+
+
+static int growText( gedPIPEBATCH_t *batch, ofUI64_t size )
+{
+  ofCHAR_t *text;
+  ofUI64_t  newSize;
+
+  if( size <= batch->size ) {
+    return 0;
+  }
+
+  /* offsets are 32 bits, so a single line cannot take up more than this */
+
+  if( size > 0x7FFFFFFFu ) {
+    return -1;
+  }
+
+  newSize = batch->size ? batch->size : gcPIPELINECHUNK;
+  while( newSize < size ) {
+    newSize *= 2;
+  }
+  if( newSize > 0x7FFFFFFFu ) {
+    newSize = 0x7FFFFFFFu;
+  }
+
+  text = (ofCHAR_t*)realloc( batch->text, newSize );
+  if( text == 0 ) {
+    return -1;
+  }
+
+  batch->text = text;
+  batch->size = (ofUI32_t)newSize;
+  return 0;
+}
+
+
+static int addEvent( gedPIPEBATCH_t *batch, ofUI32_t start, ofUI32_t end )
+{
+  gedPIPEEVENT_t *events;
+  ofUI32_t        capacity;
+
+  if( batch->count == batch->capacity ) {
+    capacity = batch->capacity ? batch->capacity * 2 : 1024;
+    events = (gedPIPEEVENT_t*)realloc( batch->events, capacity * sizeof( gedPIPEEVENT_t ) );
+    if( events == 0 ) {
+      return -1;
+    }
+    batch->events = events;
+    batch->capacity = capacity;
+  }
+
+  splitLine( batch->text, start, end, &batch->events[ batch->count++ ] );
+  return 0;
+}
+
+
+/* reads the next whole lines of the file into 'batch'.  The line the read
+ * cut in two is kept back for the next batch.  Returns 1 if the batch holds
+ * any lines, 0 at the end of the file, -1 if memory ran out and -2 if the
+ * file could not be read. */
+
+static int fillBatch( gedPIPELINE_t *pipeline, gedPIPEBATCH_t *batch )
+{
+  const ofCHAR_t *newline;
+  ofCHAR_t       *carry;
+  ofUI32_t        searched;
+  ofUI32_t        start;
+  ofUI32_t        end;
+  ofUI32_t        line;
+  size_t          read;
+
+  batch->length = 0;
+  batch->count = 0;
+
+  if( growText( batch, (ofUI64_t)pipeline->carryLength + gcPIPELINECHUNK ) != 0 ) {
+    return -1;
+  }
+  if( pipeline->carryLength > 0 ) {
+    memcpy( batch->text, pipeline->carry, pipeline->carryLength );
+  }
+  batch->length = searched = pipeline->carryLength;
+  pipeline->carryLength = 0;
+
+  end = 0;
+  while( !pipeline->eof ) {
+    if( growText( batch, (ofUI64_t)batch->length + gcPIPELINECHUNK ) != 0 ) {
+      return -1;
+    }
+
+    read = fread( batch->text + batch->length, 1, gcPIPELINECHUNK, pipeline->file );
+    if( read < gcPIPELINECHUNK ) {
+      if( ferror( pipeline->file ) ) {
+        pipeline->errnum = errno;
+        return -2;
+      }
+      pipeline->eof = 1;
+    }
+    batch->length += (ofUI32_t)read;
+    gedPROBE2( buffer__refill, read, batch->size );
+
+    for( end = batch->length; end > searched && batch->text[ end - 1 ] != '\n'; end-- );
+    if( end > searched ) {
+      break;
+    }
+    searched = batch->length;
+    end = 0;
+  }
+
+  if( pipeline->eof ) {
+    end = batch->length;
+  }
+
+  for( start = 0; start < end; start = line + 1 ) {
+    newline = (const ofCHAR_t*)memchr( batch->text + start, '\n', end - start );
+    line = newline ? (ofUI32_t)( newline - batch->text ) : end;
+
+    /* chomp: the newline, and a carriage return before it */
+
+    if( addEvent( batch, start, ( line > start && batch->text[ line - 1 ] == '\r' ) ? line - 1 : line ) != 0 ) {
+      return -1;
+    }
+  }
+
+  if( end < batch->length ) {
+    if( batch->length - end > pipeline->carrySize ) {
+      carry = (ofCHAR_t*)realloc( pipeline->carry, batch->length - end );
+      if( carry == 0 ) {
+        return -1;
+      }
+      pipeline->carry = carry;
+      pipeline->carrySize = batch->length - end;
+    }
+    pipeline->carryLength = batch->length - end;
+    memcpy( pipeline->carry, batch->text + end, pipeline->carryLength );
+    batch->length = end;
+  }
+
+  return batch->count > 0 ? 1 : 0;
+}
+
+
+static void takeBatch( gedPIPELINE_t *pipeline, gedPIPEBATCH_t *batch, gedPIPEBATCH_t **taken )
+{
+  pipeline->stats.events += batch->count;
+  pipeline->stats.batches++;
+  pipeline->stats.bytes += batch->length;
+  *taken = batch;
+}
+
+
+#ifdef gcPIPELINETHREADED
+
+static ofUI64_t getNanoseconds( void )
+{
+  struct timespec now;
+
+  clock_gettime( CLOCK_MONOTONIC, &now );
+  return (ofUI64_t)now.tv_sec * 1000000000u + now.tv_nsec;
+}
+
+
+static void wake( gedPIPELINE_t *pipeline, pthread_cond_t *condition )
+{
+  pthread_mutex_lock( &pipeline->lock );
+  pthread_cond_broadcast( condition );
+  pthread_mutex_unlock( &pipeline->lock );
+}
+
+
+/* waits until the slot after 'head' is free; returns 0 if the consumer
+ * asked the reader to stop instead */
+
+static int waitForSpace( gedPIPELINE_t *pipeline, unsigned head )
+{
+  ofUI64_t start;
+
+  if( head - atomic_load( &pipeline->tail ) < pipeline->slotCount ) {
+    return !atomic_load( &pipeline->stop );
+  }
+
+  start = getNanoseconds();
+
+  pthread_mutex_lock( &pipeline->lock );
+  atomic_store( &pipeline->readerWaiting, 1 );
+  while( head - atomic_load( &pipeline->tail ) >= pipeline->slotCount && !atomic_load( &pipeline->stop ) ) {
+    pthread_cond_wait( &pipeline->space, &pipeline->lock );
+  }
+  atomic_store( &pipeline->readerWaiting, 0 );
+  pthread_mutex_unlock( &pipeline->lock );
+
+  pipeline->stats.readerStalls++;
+  pipeline->stats.readerStallNs += getNanoseconds() - start;
+
+  return !atomic_load( &pipeline->stop );
+}
+
+
+/* the reader thread: fills a slot, publishes it by moving 'head', and
+ * wakes the consumer if it went to sleep on an empty ring */
+
+static void* readBatches( void *data )
+{
+  gedPIPELINE_t *pipeline = (gedPIPELINE_t*)data;
+  unsigned       head;
+  int            rc;
+
+  head = atomic_load( &pipeline->head );
+  while( waitForSpace( pipeline, head ) ) {
+    rc = fillBatch( pipeline, &pipeline->slots[ head % pipeline->slotCount ] );
+    if( rc <= 0 ) {
+      pipeline->error = rc;
+      break;
+    }
+
+    atomic_store( &pipeline->head, ++head );
+    if( atomic_load( &pipeline->handlerWaiting ) ) {
+      wake( pipeline, &pipeline->data );
+    }
+  }
+
+  atomic_store( &pipeline->done, 1 );
+  wake( pipeline, &pipeline->data );
+
+  return 0;
+}
+
+#endif
+
+
+int openPipeline( gedPIPELINE_t *pipeline, const char *path, ofUI32_t slots )
+{
+  memset( pipeline, 0, sizeof( *pipeline ) );
+
+  if( slots == 0 ) {
+    slots = gcPIPELINESLOTS;
+  } else if( slots > gcMAXPIPELINESLOTS ) {
+    slots = gcMAXPIPELINESLOTS;
+  }
+
+  pipeline->slots = (gedPIPEBATCH_t*)calloc( slots, sizeof( gedPIPEBATCH_t ) );
+  if( pipeline->slots == 0 ) {
+    return -1;
+  }
+  pipeline->slotCount = slots;
+
+  pipeline->file = fopen( path, "rb" );
+  if( pipeline->file == 0 ) {
+    pipeline->errnum = errno;
+    return -2;
+  }
+
+#ifdef gcPIPELINETHREADED
+  pthread_mutex_init( &pipeline->lock, 0 );
+  pthread_cond_init( &pipeline->space, 0 );
+  pthread_cond_init( &pipeline->data, 0 );
+#endif
+
+  return 0;
+}
+
+
+/* starts the reader thread.  If there are no threads, or one cannot be
+ * made, nextPipelineBatch reads each batch when it is asked for. */
+
+int startPipeline( gedPIPELINE_t *pipeline )
+{
+#ifdef gcPIPELINETHREADED
+  pipeline->started = ( pthread_create( &pipeline->thread, 0, readBatches, pipeline ) == 0 );
+  return pipeline->started;
+#else
+  return 0;
+#endif
+}
+
+
+/* stops and joins the reader, then frees everything */
+
+void closePipeline( gedPIPELINE_t *pipeline )
+{
+  ofUI32_t i;
+
+#ifdef gcPIPELINETHREADED
+  if( pipeline->started ) {
+    atomic_store( &pipeline->stop, 1 );
+    wake( pipeline, &pipeline->space );
+    pthread_join( pipeline->thread, 0 );
+    pipeline->started = 0;
+  }
+  if( pipeline->file != 0 ) {
+    pthread_mutex_destroy( &pipeline->lock );
+    pthread_cond_destroy( &pipeline->space );
+    pthread_cond_destroy( &pipeline->data );
+  }
+#endif
+
+  if( pipeline->file != 0 ) {
+    fclose( pipeline->file );
+    pipeline->file = 0;
+  }
+
+  for( i = 0; i < pipeline->slotCount; i++ ) {
+    free( pipeline->slots[ i ].text );
+    free( pipeline->slots[ i ].events );
+  }
+  free( pipeline->slots );
+  free( pipeline->carry );
+
+  pipeline->slots = 0;
+  pipeline->slotCount = 0;
+  pipeline->carry = 0;
+  pipeline->carryLength = pipeline->carrySize = 0;
+}
+
+
+/* hands the consumer the next batch, which it owns until it calls
+ * releasePipelineBatch.  Returns 1 with the batch, 0 once the file has been
+ * read, -1 if memory ran out and -2 if the file could not be read.  If the
+ * ring is empty it returns 2 straight away unless 'wait' is set, in which
+ * case it sleeps until a batch comes or interruptPipeline is called (and
+ * then returns 2). */
+
+int nextPipelineBatch( gedPIPELINE_t *pipeline, gedPIPEBATCH_t **batch, int wait )
+{
+  int      rc;
+#ifdef gcPIPELINETHREADED
+  unsigned tail;
+  ofUI64_t start;
+
+  if( pipeline->started ) {
+    tail = atomic_load( &pipeline->tail );
+    if( tail != atomic_load( &pipeline->head ) ) {
+      takeBatch( pipeline, &pipeline->slots[ tail % pipeline->slotCount ], batch );
+      return 1;
+    }
+
+    /* the reader publishes its last batch before it says it is done */
+
+    if( atomic_load( &pipeline->done ) ) {
+      if( tail != atomic_load( &pipeline->head ) ) {
+        takeBatch( pipeline, &pipeline->slots[ tail % pipeline->slotCount ], batch );
+        return 1;
+      }
+      return pipeline->error;
+    }
+
+    if( !wait ) {
+      return 2;
+    }
+
+    start = getNanoseconds();
+
+    pthread_mutex_lock( &pipeline->lock );
+    atomic_store( &pipeline->handlerWaiting, 1 );
+    while( tail == atomic_load( &pipeline->head ) && !atomic_load( &pipeline->done ) &&
+           !atomic_load( &pipeline->interrupt ) ) {
+      pthread_cond_wait( &pipeline->data, &pipeline->lock );
+    }
+    atomic_store( &pipeline->handlerWaiting, 0 );
+    atomic_store( &pipeline->interrupt, 0 );
+    pthread_mutex_unlock( &pipeline->lock );
+
+    pipeline->stats.handlerStalls++;
+    pipeline->stats.handlerStallNs += getNanoseconds() - start;
+
+    if( tail != atomic_load( &pipeline->head ) ) {
+      takeBatch( pipeline, &pipeline->slots[ tail % pipeline->slotCount ], batch );
+      return 1;
+    }
+    return atomic_load( &pipeline->done ) ? pipeline->error : 2;
+  }
+#endif
+
+  rc = fillBatch( pipeline, &pipeline->slots[ 0 ] );
+  if( rc <= 0 ) {
+    return rc;
+  }
+
+  takeBatch( pipeline, &pipeline->slots[ 0 ], batch );
+  return 1;
+}
+
+
+/* gives the consumer's batch back to the reader */
+
+void releasePipelineBatch( gedPIPELINE_t *pipeline )
+{
+#ifdef gcPIPELINETHREADED
+  if( pipeline->started ) {
+    atomic_fetch_add( &pipeline->tail, 1 );
+    if( atomic_load( &pipeline->readerWaiting ) ) {
+      wake( pipeline, &pipeline->space );
+    }
+  }
+#endif
+}
+
+
+/* makes a nextPipelineBatch that is waiting, or the next one to wait,
+ * return 2; safe to call from any thread */
+
+void interruptPipeline( gedPIPELINE_t *pipeline )
+{
+#ifdef gcPIPELINETHREADED
+  atomic_store( &pipeline->interrupt, 1 );
+  wake( pipeline, &pipeline->data );
+#endif
+}
+
@@ -0,0 +1,127 @@
+/* -------------------------------------------------------------------------
+ * gedcom_pipeline.h -- Defines the interface for the line event pipeline.
+ * Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+ * -------------------------------------------------------------------------
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ------------------------------------------------------------------------- */
+
+#ifndef __GEDPIPELINE_H__
+#define __GEDPIPELINE_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+
+#include "gedcom_types.h"
+
+/* without threads and atomics the batches are read by the consumer itself,
+ * one at a time, when it asks for them */
+
+#if defined( HAVE_PTHREAD_H ) && defined( HAVE_STDATOMIC_H )
+  #define gcPIPELINETHREADED
+  #include <pthread.h>
+  #include <stdatomic.h>
+#endif
+
+/* pipeline constants */
+
+  #define gcPIPELINESLOTS      ( 8 )          /* batches in the ring by default */
+  #define gcMAXPIPELINESLOTS   ( 64 )
+  #define gcPIPELINECHUNK      ( 64 * 1024 )  /* bytes read from the file at once */
+  #define gcNOFIELD            ( 0xFFFFFFFFu )
+
+/* types */
+
+/* one line, split as Parser#parse_lines splits it: a tag or data with a
+ * length of gcNOFIELD is not there (nil) */
+
+typedef struct {
+  long     level;
+  ofUI32_t tagOffset;
+  ofUI32_t tagLength;
+  ofUI32_t dataOffset;
+  ofUI32_t dataLength;
+} gedPIPEEVENT_t;
+
+typedef struct {
+  ofCHAR_t       *text;
+  ofUI32_t        length;
+  ofUI32_t        size;
+  gedPIPEEVENT_t *events;
+  ofUI32_t        count;
+  ofUI32_t        capacity;
+} gedPIPEBATCH_t;
+
+typedef struct {
+  ofUI64_t events;
+  ofUI64_t batches;
+  ofUI64_t bytes;
+  ofUI64_t readerStalls;     /* the reader found the ring full */
+  ofUI64_t readerStallNs;
+  ofUI64_t handlerStalls;    /* the consumer found it empty */
+  ofUI64_t handlerStallNs;
+} gedPIPELINESTATS_t;
+
+typedef struct {
+  FILE               *file;
+  gedPIPEBATCH_t     *slots;
+  ofUI32_t            slotCount;
+  ofCHAR_t           *carry;        /* the start of a line the last read cut */
+  ofUI32_t            carryLength;
+  ofUI32_t            carrySize;
+  int                 eof;
+  int                 error;        /* -1 out of memory, -2 read error */
+  int                 errnum;       /* errno of the read error */
+  gedPIPELINESTATS_t  stats;
+#ifdef gcPIPELINETHREADED
+  atomic_uint         head;         /* batches published by the reader */
+  atomic_uint         tail;         /* batches released by the consumer */
+  atomic_int          done;
+  atomic_int          stop;
+  atomic_int          interrupt;
+  atomic_int          readerWaiting;
+  atomic_int          handlerWaiting;
+  pthread_mutex_t     lock;         /* only taken to sleep and to wake up */
+  pthread_cond_t      space;
+  pthread_cond_t      data;
+  pthread_t           thread;
+  int                 started;
+#else
+  ofUI32_t            head;
+  ofUI32_t            tail;
+  int                 done;
+#endif
+} gedPIPELINE_t;
+
+
+int openPipeline( gedPIPELINE_t *pipeline, const char *path, ofUI32_t slots );
+
+int startPipeline( gedPIPELINE_t *pipeline );
+
+void closePipeline( gedPIPELINE_t *pipeline );
+
+int nextPipelineBatch( gedPIPELINE_t *pipeline, gedPIPEBATCH_t **batch, int wait );
+
+void releasePipelineBatch( gedPIPELINE_t *pipeline );
+
+void interruptPipeline( gedPIPELINE_t *pipeline );
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // __GEDPIPELINE_H__
@@ -0,0 +1,60 @@
+/* -------------------------------------------------------------------------
+ * gedcom_probes.h -- Defines the static tracepoints.
+ * Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+ * -------------------------------------------------------------------------
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ------------------------------------------------------------------------- */
+
+#ifndef __GEDPROBES_H__
+#define __GEDPROBES_H__
+
+/* static tracepoints, under the provider "gedcom", for attaching bpftrace,
+ * perf or systemtap to a running process.  With sys/sdt.h (systemtap-sdt
+ * on Linux) each probe is a nop plus a note in the object file, so a probe
+ * nothing is attached to costs next to nothing; without it they compile
+ * to nothing at all.  A double underscore in a name reads as a dash in the
+ * tools, e.g.
+ *
+ *   bpftrace -e 'usdt:./_gedcom.so:gedcom:date-parse-done { @[arg0] = count(); }'
+ *
+ * The probes and their arguments:
+ *
+ *   record__start      record number            readGEDCOMRecord starts
+ *   record__end        record number, bytes,    ... and has split the record
+ *                      nodes                    into nodes
+ *   buffer__refill     bytes read, buffer size  a reader read more of a file
+ *   batch__start       events                   each_event hands a batch to Ruby
+ *   batch__end         events                   ... and Ruby is done with it
+ *   event__dispatch    level, tag, tag length   each_event yields one event
+ *   date__parse__start text, calendar type      parseGEDCOMDate starts
+ *   date__parse__done  result, date flags       ... and returns 0 or -1 */
+
+#ifdef HAVE_SYS_SDT_H
+
+#include <sys/sdt.h>
+
+  #define gedPROBE1( name, a )           DTRACE_PROBE1( gedcom, name, a )
+  #define gedPROBE2( name, a, b )        DTRACE_PROBE2( gedcom, name, a, b )
+  #define gedPROBE3( name, a, b, c )     DTRACE_PROBE3( gedcom, name, a, b, c )
+
+#else
+
+  #define gedPROBE1( name, a )
+  #define gedPROBE2( name, a, b )
+  #define gedPROBE3( name, a, b, c )
+
+#endif
+
+#endif // __GEDPROBES_H__
@@ -0,0 +1,573 @@
+/* -------------------------------------------------------------------------
+ * gedcom_query.c -- Defines the path query compiler and matcher.
+ * Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+ * -------------------------------------------------------------------------
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ------------------------------------------------------------------------- */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "gedcom_types.h"
+#include "gedcom_date.h"
+#include "gedcom_query.h"
+
+
+/* A query is a path of tags from level 0 down, separated by dots:
+ *
+ *   INDI.BIRT.PLAC                  every birth place
+ *   @I12@.*.DATE                    every date one level under record @I12@
+ *   FAM[MARR.DATE < 1800]           families married before 1800
+ *   INDI[SEX = "F"].NAME            the names of women
+ *
+ * Step n of the path matches lines at level n; '*' matches any tag and
+ * the first step may be an xref instead.  A step may carry a condition in
+ * brackets: a path of tags below the step's line, optionally followed by
+ * an operator and either a quoted text (= and != only) or a date.  The
+ * line only matches if some line at the end of that path exists or, with
+ * an operator, has a value that satisfies it.  Dates compare by the days
+ * they can fall on, so a value only satisfies "< 1800" if all of them
+ * are before 1800: "BEF 1790" and "ABT 1799" do, "AFT 1700" and
+ * "BET 1790 AND 1810" do not.
+ *
+ * Running a query reads the text a line at a time and keeps one state per
+ * level of the current record, so it never builds more than that.  The
+ * values of the lines matching the whole path are the matches; those below
+ * a line that waits on its condition are kept back until the line's
+ * subtree ends, then kept or dropped together. */
+
+
+/* compiling */
+
+static int isBlank( ofCHAR_t c )
+{
+  return ( c == ' ' || c == '\t' );
+}
+
+
+static int isLineEnd( ofCHAR_t c )
+{
+  return ( c == '\n' || c == '\r' );
+}
+
+
+static int isTagChar( ofCHAR_t c )
+{
+  return ( ( c >= 'A' && c <= 'Z' ) || ( c >= 'a' && c <= 'z' ) || ( c >= '0' && c <= '9' ) || c == '_' );
+}
+
+
+static ofCHAR_t* skipBlanks( ofCHAR_t *p )
+{
+  while( isBlank( *p ) ) {
+    p++;
+  }
+
+  return p;
+}
+
+
+/* reads a tag or '*' at 'p' into 'tag' and returns the end, or 0 */
+
+static ofCHAR_t* readTag( ofCHAR_t *p, ofCHAR_t *tag )
+{
+  ofCHAR_t *start = p;
+
+  if( *p == '*' ) {
+    strcpy( (char*)tag, "*" );
+    return p + 1;
+  }
+
+  while( isTagChar( *p ) ) {
+    p++;
+  }
+
+  if( p == start || p - start >= gcMAXQUERYTAGSIZE ) {
+    return 0;
+  }
+
+  memcpy( tag, start, p - start );
+  tag[ p - start ] = '\0';
+
+  return p;
+}
+
+
+static ofCHAR_t* readXref( ofCHAR_t *p, ofCHAR_t *tag )
+{
+  ofCHAR_t *close;
+
+  close = (ofCHAR_t*)strchr( (char*)p + 1, '@' );
+  if( close == 0 || close - p + 1 >= gcMAXQUERYTAGSIZE ) {
+    return 0;
+  }
+
+  memcpy( tag, p, close - p + 1 );
+  tag[ close - p + 1 ] = '\0';
+
+  return close + 1;
+}
+
+
+static ofCHAR_t* readOperator( ofCHAR_t *p, int *op )
+{
+  if( p[ 0 ] == '<' && p[ 1 ] == '=' ) {
+    *op = gcQUERYLE;
+    return p + 2;
+  } else if( p[ 0 ] == '>' && p[ 1 ] == '=' ) {
+    *op = gcQUERYGE;
+    return p + 2;
+  } else if( p[ 0 ] == '!' && p[ 1 ] == '=' ) {
+    *op = gcQUERYNE;
+    return p + 2;
+  } else if( p[ 0 ] == '<' ) {
+    *op = gcQUERYLT;
+  } else if( p[ 0 ] == '>' ) {
+    *op = gcQUERYGT;
+  } else if( p[ 0 ] == '=' ) {
+    *op = gcQUERYEQ;
+  } else {
+    return 0;
+  }
+
+  return p + 1;
+}
+
+
+/* reads the condition after a step's '[' and returns the end of its ']',
+ * or 0 with 'error' set to where it went wrong */
+
+static ofCHAR_t* readCondition( ofCHAR_t *p, gedQUERYSTEP_t *step, ofCHAR_t **error )
+{
+  gedDATEVALUE_t date;
+  ofCHAR_t      *next;
+  ofCHAR_t      *close;
+  ofCHAR_t      *end;
+
+  for( ;; ) {
+    p = skipBlanks( p );
+    next = ( step->condLength < gcMAXQUERYSTEPS ) ? readTag( p, step->cond[ step->condLength ] ) : 0;
+    if( next == 0 ) {
+      *error = p;
+      return 0;
+    }
+    step->condLength++;
+
+    p = skipBlanks( next );
+    if( *p != '.' ) {
+      break;
+    }
+    p++;
+  }
+
+  if( *p == ']' ) {
+    step->op = gcQUERYEXISTS;
+    return p + 1;
+  }
+
+  next = readOperator( p, &step->op );
+  if( next == 0 ) {
+    *error = p;
+    return 0;
+  }
+  p = skipBlanks( next );
+
+  if( *p == '"' ) {
+    close = (ofCHAR_t*)strchr( (char*)p + 1, '"' );
+    if( ( step->op != gcQUERYEQ && step->op != gcQUERYNE ) ||
+        close == 0 || close - p - 1 >= gcMAXQUERYOPERANDSIZE )
+    {
+      *error = p;
+      return 0;
+    }
+
+    step->isText = 1;
+    step->operandLength = close - p - 1;
+    memcpy( step->operand, p + 1, step->operandLength );
+
+    p = skipBlanks( close + 1 );
+    if( *p != ']' ) {
+      *error = p;
+      return 0;
+    }
+    return p + 1;
+  }
+
+  close = (ofCHAR_t*)strchr( (char*)p, ']' );
+  if( close == 0 ) {
+    *error = p + strlen( (char*)p );
+    return 0;
+  }
+
+  for( end = close; end > p && isBlank( end[ -1 ] ); end-- )
+    ;
+
+  if( end == p || end - p >= gcMAXQUERYOPERANDSIZE || parseGEDCOMDateText( p, end - p, &date ) != 0 ) {
+    *error = p;
+    return 0;
+  }
+
+  getGEDCOMDateValueDays( &date, &step->first, &step->last );
+  if( step->first == 0 || step->last == 0 ) {
+    *error = p;
+    return 0;
+  }
+
+  step->operandLength = end - p;
+  memcpy( step->operand, p, step->operandLength );
+
+  return close + 1;
+}
+
+
+/* compiles 'source' into 'query'.  Returns 0, or -1 with 'error' set to
+ * the offset in 'source' where it stopped making sense. */
+
+int compileQuery( ofCHAR_t *source, gedQUERY_t *query, ofUI32_t *error )
+{
+  gedQUERYSTEP_t *step;
+  ofCHAR_t       *p = source;
+  ofCHAR_t       *next;
+  ofCHAR_t       *at;
+
+  memset( query, 0, sizeof( *query ) );
+
+  for( ;; ) {
+    p = skipBlanks( p );
+    if( query->count == gcMAXQUERYSTEPS ) {
+      *error = p - source;
+      return -1;
+    }
+
+    step = &query->steps[ query->count ];
+    next = ( query->count == 0 && *p == '@' ) ? readXref( p, step->tag ) : readTag( p, step->tag );
+    if( next == 0 ) {
+      *error = p - source;
+      return -1;
+    }
+    query->count++;
+
+    p = skipBlanks( next );
+    if( *p == '[' ) {
+      next = readCondition( p + 1, step, &at );
+      if( next == 0 ) {
+        *error = at - source;
+        return -1;
+      }
+      p = skipBlanks( next );
+    }
+
+    if( *p == '\0' ) {
+      return 0;
+    } else if( *p != '.' ) {
+      *error = p - source;
+      return -1;
+    }
+    p++;
+  }
+}
+
+
+/* running */
+
+void initQueryRun( gedQUERYRUN_t *run, gedQUERY_t *query, ofCHAR_t *text, ofUI64_t length )
+{
+  memset( run, 0, sizeof( *run ) );
+  run->query = query;
+  run->text = text;
+  run->length = length;
+  run->depth = -1;
+}
+
+
+void freeQueryRun( gedQUERYRUN_t *run )
+{
+  free( run->matches );
+  run->matches = 0;
+  run->count = run->size = 0;
+}
+
+
+/* splits the line [line, end) into its level, xref, tag and value.
+ * Returns -1 if it does not start with a level. */
+
+static int readLine( ofCHAR_t *line, ofCHAR_t *end, ofCHAR_t **xref, ofUI32_t *xrefLength,
+                     ofCHAR_t **tag, ofUI32_t *tagLength, ofCHAR_t **value, ofUI32_t *valueLength )
+{
+  ofCHAR_t *p = line;
+  ofCHAR_t *token;
+  int       level;
+
+  while( p < end && isBlank( *p ) ) {
+    p++;
+  }
+
+  if( p >= end || *p < '0' || *p > '9' ) {
+    return -1;
+  }
+
+  for( level = 0; p < end && *p >= '0' && *p <= '9'; p++ ) {
+    if( level < 1000 ) {
+      level = level * 10 + ( *p - '0' );
+    }
+  }
+
+  for( ; p < end && isBlank( *p ); p++ )
+    ;
+
+  *xref = p;
+  *xrefLength = 0;
+  if( p < end && *p == '@' ) {
+    for( ; p < end && !isBlank( *p ) && !isLineEnd( *p ); p++ )
+      ;
+    *xrefLength = p - *xref;
+    for( ; p < end && isBlank( *p ); p++ )
+      ;
+  }
+
+  for( token = p; p < end && !isBlank( *p ) && !isLineEnd( *p ); p++ )
+    ;
+  *tag = token;
+  *tagLength = p - token;
+
+  for( ; p < end && isBlank( *p ); p++ )
+    ;
+
+  while( end > p && isLineEnd( end[ -1 ] ) ) {
+    end--;
+  }
+  *value = p;
+  *valueLength = end - p;
+
+  return level;
+}
+
+
+static int isTag( ofCHAR_t *name, ofCHAR_t *tag, ofUI32_t length )
+{
+  if( name[ 0 ] == '*' ) {
+    return 1;
+  }
+
+  return ( strlen( (char*)name ) == length && memcmp( name, tag, length ) == 0 );
+}
+
+
+static int testValue( gedQUERYSTEP_t *step, ofCHAR_t *value, ofUI32_t length )
+{
+  gedDATEVALUE_t date;
+  ofI32_t        first;
+  ofI32_t        last;
+  int            equal;
+
+  if( step->op == gcQUERYEXISTS ) {
+    return 1;
+  }
+
+  if( step->isText ) {
+    equal = ( length == step->operandLength && memcmp( value, step->operand, length ) == 0 );
+    return ( step->op == gcQUERYEQ ) ? equal : !equal;
+  }
+
+  if( parseGEDCOMDateText( value, length, &date ) != 0 ) {
+    return 0;
+  }
+  getGEDCOMDateValueDays( &date, &first, &last );
+
+  switch( step->op ) {
+    case gcQUERYLT:
+      return ( last != 0 && last < step->first );
+    case gcQUERYLE:
+      return ( last != 0 && last <= step->last );
+    case gcQUERYGT:
+      return ( first != 0 && first > step->last );
+    case gcQUERYGE:
+      return ( first != 0 && first >= step->first );
+    case gcQUERYEQ:
+      return ( first != 0 && last != 0 && first >= step->first && last <= step->last );
+    case gcQUERYNE:
+      return ( ( last != 0 && last < step->first ) || ( first != 0 && first > step->last ) );
+  }
+
+  return 0;
+}
+
+
+static int addMatch( gedQUERYRUN_t *run, ofCHAR_t *value, ofUI32_t length )
+{
+  gedQUERYMATCH_t *match;
+
+  if( run->count == run->size ) {
+    ofUI32_t         size = ( run->size == 0 ) ? 256 : run->size * 2;
+    gedQUERYMATCH_t *matches = (gedQUERYMATCH_t*)realloc( run->matches, size * sizeof( gedQUERYMATCH_t ) );
+
+    if( matches == 0 ) {
+      return -1;
+    }
+    run->matches = matches;
+    run->size = size;
+  }
+
+  match = &run->matches[ run->count++ ];
+  match->xrefOffset = run->xrefOffset;
+  match->xrefLength = run->xrefLength;
+  match->valueOffset = value - run->text;
+  match->valueLength = length;
+
+  return 0;
+}
+
+
+/* ends the subtrees of the waiting lines at 'level' and deeper, dropping
+ * the matches below those whose condition never held */
+
+static void closeSteps( gedQUERYRUN_t *run, int level )
+{
+  int step;
+
+  for( step = run->query->count - 1; step >= level; step-- ) {
+    if( ( run->open & ( 1u << step ) ) != 0 ) {
+      run->open &= ~( 1u << step );
+      if( ( run->satisfied & ( 1u << step ) ) == 0 ) {
+        run->count = run->starts[ step ];
+      }
+    }
+  }
+}
+
+
+static int matchLine( gedQUERYRUN_t *run, int level, ofCHAR_t *tag, ofUI32_t tagLength,
+                      ofCHAR_t *value, ofUI32_t valueLength, int skipped )
+{
+  gedQUERY_t     *query = run->query;
+  gedQUERYSTEP_t *step;
+  ofUI32_t        conds;
+  int             alive;
+  int             depth;
+  int             f;
+
+  if( level >= gcMAXQUERYLEVELS ) {
+    return 0;
+  }
+
+  alive = 0;
+  conds = 0;
+
+  if( !skipped ) {
+    if( level < query->count && ( level == 0 || run->alive[ level-1 ] ) ) {
+      step = &query->steps[ level ];
+      if( step->tag[ 0 ] == '@' ) {
+        alive = ( run->xrefLength == strlen( (char*)step->tag ) &&
+                  memcmp( run->text + run->xrefOffset, step->tag, run->xrefLength ) == 0 );
+      } else {
+        alive = isTag( step->tag, tag, tagLength );
+      }
+    }
+
+    /* advance the conditions of the waiting lines above this one */
+
+    for( f = 0; f < level; f++ ) {
+      if( ( run->open & ( 1u << f ) ) == 0 ) {
+        continue;
+      }
+      step = &query->steps[ f ];
+      depth = level - f;
+      if( depth > step->condLength ||
+          ( depth > 1 && ( run->conds[ level-1 ] & ( 1u << f ) ) == 0 ) ||
+          !isTag( step->cond[ depth-1 ], tag, tagLength ) )
+      {
+        continue;
+      }
+      conds |= ( 1u << f );
+      if( depth == step->condLength && testValue( step, value, valueLength ) ) {
+        run->satisfied |= ( 1u << f );
+      }
+    }
+  }
+
+  run->alive[ level ] = (ofCHAR_t)alive;
+  run->conds[ level ] = conds;
+
+  if( alive ) {
+    if( query->steps[ level ].condLength > 0 ) {
+      run->open |= ( 1u << level );
+      run->satisfied &= ~( 1u << level );
+      run->starts[ level ] = run->count;
+    }
+    if( level == query->count - 1 && addMatch( run, value, valueLength ) != 0 ) {
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+
+/* runs the query over the text from where it last stopped, until the text
+ * ends or, at the start of a record, 'limit' matches were found.  Returns
+ * 1 if there is more text to run over, 0 if not, and -1 if memory ran out.
+ * The matches found this time are in 'matches'. */
+
+int runQuery( gedQUERYRUN_t *run, ofUI32_t limit )
+{
+  ofCHAR_t *end = run->text + run->length;
+  ofCHAR_t *line;
+  ofCHAR_t *next;
+  ofCHAR_t *xref;
+  ofCHAR_t *tag;
+  ofCHAR_t *value;
+  ofUI32_t  xrefLength;
+  ofUI32_t  tagLength;
+  ofUI32_t  valueLength;
+  int       level;
+  int       skipped;
+
+  run->count = 0;
+
+  for( line = run->text + run->position; line < end; line = next ) {
+    next = (ofCHAR_t*)memchr( line, '\n', end - line );
+    next = ( next != 0 ) ? next + 1 : end;
+
+    level = readLine( line, next, &xref, &xrefLength, &tag, &tagLength, &value, &valueLength );
+    if( level < 0 ) {
+      continue;
+    }
+
+    closeSteps( run, level );
+
+    if( level == 0 ) {
+      if( run->count >= limit ) {
+        run->position = line - run->text;
+        return 1;
+      }
+      run->xrefOffset = xref - run->text;
+      run->xrefLength = xrefLength;
+    }
+
+    /* a line deeper than one below the last is not part of the tree */
+
+    skipped = ( level > run->depth + 1 );
+    run->depth = level;
+
+    if( matchLine( run, level, tag, tagLength, value, valueLength, skipped ) != 0 ) {
+      return -1;
+    }
+  }
+
+  closeSteps( run, 0 );
+  run->position = run->length;
+
+  return 0;
+}
@@ -0,0 +1,108 @@
+/* -------------------------------------------------------------------------
+ * gedcom_query.h -- Defines the interface for path queries.
+ * Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+ * -------------------------------------------------------------------------
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ------------------------------------------------------------------------- */
+
+#ifndef __GEDQUERY_H__
+#define __GEDQUERY_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "gedcom_types.h"
+#include "gedcom_date.h"
+
+/* query constants */
+
+  #define gcMAXQUERYSTEPS        ( 16 )
+  #define gcMAXQUERYLEVELS       ( 2 * gcMAXQUERYSTEPS )  /* a step's level plus its condition */
+  #define gcMAXQUERYTAGSIZE      ( 32 )
+  #define gcMAXQUERYOPERANDSIZE  ( gcMAXDATETEXTSIZE )
+
+  #define gcQUERYBATCHSIZE       ( 4096 )  /* matches runQuery hands back at once */
+
+/* condition operators */
+
+  #define gcQUERYEXISTS  ( 0 )
+  #define gcQUERYLT      ( 1 )
+  #define gcQUERYLE      ( 2 )
+  #define gcQUERYGT      ( 3 )
+  #define gcQUERYGE      ( 4 )
+  #define gcQUERYEQ      ( 5 )
+  #define gcQUERYNE      ( 6 )
+
+/* types */
+
+typedef struct {
+  ofCHAR_t tag[ gcMAXQUERYTAGSIZE ];   /* "*" for any tag, "@..@" for a record's xref */
+  int      condLength;                 /* tags in the condition path, 0 if none */
+  ofCHAR_t cond[ gcMAXQUERYSTEPS ][ gcMAXQUERYTAGSIZE ];
+  int      op;
+  int      isText;                     /* compare the operand text, not dates */
+  ofCHAR_t operand[ gcMAXQUERYOPERANDSIZE ];
+  ofUI32_t operandLength;
+  ofI32_t  first;                      /* days of a date operand */
+  ofI32_t  last;
+} gedQUERYSTEP_t;
+
+typedef struct {
+  gedQUERYSTEP_t steps[ gcMAXQUERYSTEPS ];
+  int            count;
+} gedQUERY_t;
+
+typedef struct {
+  ofUI64_t xrefOffset;   /* xref of the record the match is in; */
+  ofUI32_t xrefLength;   /* xrefLength is 0 if it has none */
+  ofUI64_t valueOffset;
+  ofUI32_t valueLength;
+} gedQUERYMATCH_t;
+
+typedef struct {
+  gedQUERY_t      *query;
+  ofCHAR_t        *text;
+  ofUI64_t         length;
+  ofUI64_t         position;
+  gedQUERYMATCH_t *matches;
+  ofUI32_t         count;
+  ofUI32_t         size;
+
+  /* automaton state, per level of the current record */
+  ofUI64_t         xrefOffset;
+  ofUI32_t         xrefLength;
+  int              depth;
+  ofCHAR_t         alive[ gcMAXQUERYLEVELS ];  /* the line matched the path so far */
+  ofUI32_t         conds[ gcMAXQUERYLEVELS ];  /* bit f: it matched step f's condition so far */
+  ofUI32_t         open;                       /* bit f: step f's line waits on its condition */
+  ofUI32_t         satisfied;
+  ofUI32_t         starts[ gcMAXQUERYSTEPS ];  /* first match below each waiting line */
+} gedQUERYRUN_t;
+
+
+int compileQuery( ofCHAR_t *source, gedQUERY_t *query, ofUI32_t *error );
+
+void initQueryRun( gedQUERYRUN_t *run, gedQUERY_t *query, ofCHAR_t *text, ofUI64_t length );
+
+void freeQueryRun( gedQUERYRUN_t *run );
+
+int runQuery( gedQUERYRUN_t *run, ofUI32_t limit );
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // __GEDQUERY_H__
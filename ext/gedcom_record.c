@@ -0,0 +1,256 @@
+/* -------------------------------------------------------------------------
+ * gedcom_record.c -- Defines the level 0 record scanner and its content hash.
+ * Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+ * -------------------------------------------------------------------------
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ------------------------------------------------------------------------- */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "gedcom_types.h"
+#include "gedcom_ctype.h"
+#include "gedcom_record.h"
+
+
+/* xxHash64 (Yann Collet's algorithm).  Reads are done through memcpy, so
+ * the data does not need to be aligned; the hash of a given text is only
+ * compared with hashes made on the same machine. */
+
+#define PRIME64_1  0x9E3779B185EBCA87ULL
+#define PRIME64_2  0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3  0x165667B19E3779F9ULL
+#define PRIME64_4  0x85EBCA77C2B2AE63ULL
+#define PRIME64_5  0x27D4EB2F165667C5ULL
+
+#define ROTL64( x, r )  ( ( ( x ) << ( r ) ) | ( ( x ) >> ( 64 - ( r ) ) ) )
+
+
+static ofUI64_t read64( ofCHAR_t *p )
+{
+  ofUI64_t value;
+
+  memcpy( &value, p, sizeof( value ) );
+  return value;
+}
+
+
+static ofUI32_t read32( ofCHAR_t *p )
+{
+  ofUI32_t value;
+
+  memcpy( &value, p, sizeof( value ) );
+  return value;
+}
+
+
+static ofUI64_t hashRound( ofUI64_t acc, ofUI64_t input )
+{
+  acc += input * PRIME64_2;
+  acc = ROTL64( acc, 31 );
+  return acc * PRIME64_1;
+}
+
+
+static ofUI64_t hashMerge( ofUI64_t acc, ofUI64_t value )
+{
+  acc ^= hashRound( 0, value );
+  return acc * PRIME64_1 + PRIME64_4;
+}
+
+
+ofUI64_t hashGEDCOMBytes( ofCHAR_t *data, ofUI64_t length, ofUI64_t seed )
+{
+  ofCHAR_t *end = data + length;
+  ofUI64_t  hash;
+
+  if( length >= 32 ) {
+    ofCHAR_t *limit = end - 32;
+    ofUI64_t  v1 = seed + PRIME64_1 + PRIME64_2;
+    ofUI64_t  v2 = seed + PRIME64_2;
+    ofUI64_t  v3 = seed;
+    ofUI64_t  v4 = seed - PRIME64_1;
+
+    do {
+      v1 = hashRound( v1, read64( data ) );
+      v2 = hashRound( v2, read64( data + 8 ) );
+      v3 = hashRound( v3, read64( data + 16 ) );
+      v4 = hashRound( v4, read64( data + 24 ) );
+      data += 32;
+    } while( data <= limit );
+
+    hash = ROTL64( v1, 1 ) + ROTL64( v2, 7 ) + ROTL64( v3, 12 ) + ROTL64( v4, 18 );
+    hash = hashMerge( hash, v1 );
+    hash = hashMerge( hash, v2 );
+    hash = hashMerge( hash, v3 );
+    hash = hashMerge( hash, v4 );
+  } else {
+    hash = seed + PRIME64_5;
+  }
+
+  hash += length;
+
+  while( data + 8 <= end ) {
+    hash ^= hashRound( 0, read64( data ) );
+    hash = ROTL64( hash, 27 ) * PRIME64_1 + PRIME64_4;
+    data += 8;
+  }
+
+  if( data + 4 <= end ) {
+    hash ^= (ofUI64_t)read32( data ) * PRIME64_1;
+    hash = ROTL64( hash, 23 ) * PRIME64_2 + PRIME64_3;
+    data += 4;
+  }
+
+  while( data < end ) {
+    hash ^= (*data) * PRIME64_5;
+    hash = ROTL64( hash, 11 ) * PRIME64_1;
+    data++;
+  }
+
+  hash ^= hash >> 33;
+  hash *= PRIME64_2;
+  hash ^= hash >> 29;
+  hash *= PRIME64_3;
+  hash ^= hash >> 32;
+
+  return hash;
+}
+
+
+void initRecordList( gedRECORDLIST_t *list )
+{
+  list->records = 0;
+  list->count = 0;
+  list->size = 0;
+}
+
+
+void freeRecordList( gedRECORDLIST_t *list )
+{
+  free( list->records );
+  initRecordList( list );
+}
+
+
+/* if the line at 'line' is a level 0 line, fills in the xref and tag of
+ * 'record' (relative to 'line') and returns 1 */
+
+int readGEDCOMLevel0( ofCHAR_t *line, ofCHAR_t *end, gedRECORD_t *record )
+{
+  ofCHAR_t *p = line;
+  ofCHAR_t *token;
+
+  p += spanGEDCOMClass( p, end - p, gccBLANK );
+
+  if( p >= end || *p != '0' || ( p + 1 < end && !isGEDCOMClass( p[1], gccBLANK | gccLINEEND ) ) ) {
+    return 0;
+  }
+
+  for( p++; p < end && isGEDCOMClass( *p, gccBLANK ); p++ )
+    ;
+
+  record->xrefOffset = record->xrefLength = 0;
+
+  if( p < end && *p == '@' ) {
+    for( token = p; p < end && !isGEDCOMClass( *p, gccBLANK | gccLINEEND ); p++ )
+      ;
+    record->xrefOffset = token - line;
+    record->xrefLength = p - token;
+
+    for( ; p < end && isGEDCOMClass( *p, gccBLANK ); p++ )
+      ;
+  }
+
+  for( token = p; p < end && !isGEDCOMClass( *p, gccBLANK | gccLINEEND ); p++ )
+    ;
+  record->tagOffset = token - line;
+  record->tagLength = p - token;
+
+  return 1;
+}
+
+
+static int addRecord( gedRECORDLIST_t *list, gedRECORD_t *record )
+{
+  if( list->count == list->size ) {
+    ofUI32_t     size = ( list->size == 0 ) ? 256 : list->size * 2;
+    gedRECORD_t *records = (gedRECORD_t*)realloc( list->records, size * sizeof( gedRECORD_t ) );
+
+    if( records == 0 ) {
+      return -1;
+    }
+    list->records = records;
+    list->size = size;
+  }
+
+  list->records[ list->count++ ] = *record;
+  return 0;
+}
+
+
+static int closeRecord( gedRECORDLIST_t *list, gedRECORD_t *record, ofCHAR_t *text, ofUI64_t end )
+{
+  record->length = end - record->offset;
+  record->hash = hashGEDCOMBytes( text + record->offset, record->length, 0 );
+
+  return addRecord( list, record );
+}
+
+
+/* splits 'text' into its level 0 records and hashes each of them.  Lines
+ * end with LF (CR LF included); anything before the first level 0 line
+ * belongs to the first record.  Returns -1 if memory ran out. */
+
+int scanGEDCOMRecords( ofCHAR_t *text, ofUI64_t length, gedRECORDLIST_t *list )
+{
+  ofCHAR_t   *end = text + length;
+  ofCHAR_t   *line;
+  ofCHAR_t   *next;
+  gedRECORD_t record;
+  gedRECORD_t found;
+  int         started;
+
+  memset( &record, 0, sizeof( record ) );
+  started = 0;
+
+  for( line = text; line < end; line = next ) {
+    next = (ofCHAR_t*)memchr( line, '\n', end - line );
+    next = ( next != 0 ) ? next + 1 : end;
+
+    if( !readGEDCOMLevel0( line, next, &found ) ) {
+      continue;
+    }
+
+    if( started ) {
+      if( closeRecord( list, &record, text, line - text ) != 0 ) {
+        return -1;
+      }
+      record.offset = line - text;
+    }
+
+    record.xrefOffset = found.xrefOffset + ( line - text ) - record.offset;
+    record.xrefLength = found.xrefLength;
+    record.tagOffset = found.tagOffset + ( line - text ) - record.offset;
+    record.tagLength = found.tagLength;
+    started = 1;
+  }
+
+  if( length > record.offset ) {
+    return closeRecord( list, &record, text, length );
+  }
+
+  return 0;
+}
@@ -0,0 +1,62 @@
+/* -------------------------------------------------------------------------
+ * gedcom_record.h -- Defines the interface for the level 0 record scanner.
+ * Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+ * -------------------------------------------------------------------------
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ------------------------------------------------------------------------- */
+
+#ifndef __GEDRECORD_H__
+#define __GEDRECORD_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "gedcom_types.h"
+
+/* types */
+
+typedef struct {
+  ofUI64_t offset;      /* byte range of the record, from its level 0 line */
+  ofUI64_t length;      /* up to the next one */
+  ofUI64_t hash;        /* xxHash64 of those bytes */
+  ofUI32_t xrefOffset;  /* xref and tag of the level 0 line, relative to */
+  ofUI32_t xrefLength;  /* 'offset'; xrefLength is 0 if there is none */
+  ofUI32_t tagOffset;
+  ofUI32_t tagLength;
+} gedRECORD_t;
+
+typedef struct {
+  gedRECORD_t *records;
+  ofUI32_t     count;
+  ofUI32_t     size;
+} gedRECORDLIST_t;
+
+
+ofUI64_t hashGEDCOMBytes( ofCHAR_t *data, ofUI64_t length, ofUI64_t seed );
+
+void initRecordList( gedRECORDLIST_t *list );
+
+void freeRecordList( gedRECORDLIST_t *list );
+
+int readGEDCOMLevel0( ofCHAR_t *line, ofCHAR_t *end, gedRECORD_t *record );
+
+int scanGEDCOMRecords( ofCHAR_t *text, ofUI64_t length, gedRECORDLIST_t *list );
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // __GEDRECORD_H__
@@ -0,0 +1,423 @@
+/* -------------------------------------------------------------------------
+ * gedcom_sqlite.c -- Defines the bulk loader into SQLite.
+ * Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+ * -------------------------------------------------------------------------
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ------------------------------------------------------------------------- */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gedcom_types.h"
+#include "gedcom_date.h"
+#include "gedcom_name.h"
+#include "gedcom_stream.h"
+
+#ifdef HAVE_SQLITE3_H
+
+#include "gedcom_sqlite.h"
+
+
+/* The loader reads the file a record at a time with the record reader and
+ * inserts the INDI and FAM records into five tables through statements
+ * prepared once, a transaction of gcSQLITEROUND records at a time.  The
+ * tables are created without indexes; those are built once the rows are
+ * in, which is much cheaper than keeping them up to date row by row, and
+ * the links from families to people are resolved by xref at that point
+ * since a family may come before its members.
+ *
+ * Dates are kept as their text, the packed sort key of their first part
+ * (year << 9 | month << 5 | day) and the first and last julian day they
+ * can fall on, so that a date range query is an index range scan.  Each
+ * is NULL where not known. */
+
+const char *sqliteTableNames[ gstCOUNT ] = { "individuals", "families", "names", "events", "links" };
+
+static const char *schema =
+  "PRAGMA synchronous = OFF;"
+  "PRAGMA journal_mode = MEMORY;"
+  "DROP TABLE IF EXISTS individuals;"
+  "DROP TABLE IF EXISTS families;"
+  "DROP TABLE IF EXISTS names;"
+  "DROP TABLE IF EXISTS events;"
+  "DROP TABLE IF EXISTS links;"
+  "CREATE TABLE individuals ( id INTEGER PRIMARY KEY, xref TEXT, sex TEXT );"
+  "CREATE TABLE families ( id INTEGER PRIMARY KEY, xref TEXT );"
+  "CREATE TABLE names ( individual INTEGER, position INTEGER, name TEXT, given TEXT, surname TEXT,"
+  " suffix TEXT, surname_key TEXT );"
+  "CREATE TABLE events ( id INTEGER PRIMARY KEY, individual INTEGER, family INTEGER, tag TEXT, date TEXT,"
+  " sort_key INTEGER, first_day INTEGER, last_day INTEGER, place TEXT );"
+  "CREATE TABLE links ( family INTEGER, role TEXT, xref TEXT, individual INTEGER );";
+
+static const char *inserts[ gstCOUNT ] = {
+  "INSERT INTO individuals VALUES ( ?, ?, ? )",
+  "INSERT INTO families VALUES ( ?, ? )",
+  "INSERT INTO names VALUES ( ?, ?, ?, ?, ?, ?, ? )",
+  "INSERT INTO events VALUES ( ?, ?, ?, ?, ?, ?, ?, ?, ? )",
+  "INSERT INTO links VALUES ( ?, ?, ?, NULL )"
+};
+
+static const char *indexes =
+  "BEGIN;"
+  "CREATE INDEX individuals_xref ON individuals ( xref );"
+  "CREATE INDEX families_xref ON families ( xref );"
+  "CREATE INDEX names_individual ON names ( individual );"
+  "CREATE INDEX names_surname_key ON names ( surname_key );"
+  "CREATE INDEX events_individual ON events ( individual );"
+  "CREATE INDEX events_family ON events ( family );"
+  "CREATE INDEX events_sort_key ON events ( sort_key );"
+  "CREATE INDEX events_days ON events ( first_day, last_day );"
+  "UPDATE links SET individual = ( SELECT id FROM individuals WHERE individuals.xref = links.xref );"
+  "CREATE INDEX links_family ON links ( family );"
+  "CREATE INDEX links_individual ON links ( individual );"
+  "COMMIT;";
+
+/* the individual and family event tags of GEDCOM 5.5 */
+
+static const char *personEvents[] = { "ADOP", "BAPM", "BARM", "BASM", "BIRT", "BLES", "BURI", "CENS",
+                                      "CHR", "CHRA", "CONF", "CREM", "DEAT", "EMIG", "EVEN", "FCOM",
+                                      "GRAD", "IMMI", "NATU", "ORDN", "PROB", "RESI", "RETI", "WILL", 0 };
+
+static const char *familyEvents[] = { "ANUL", "CENS", "DIV", "DIVF", "ENGA", "EVEN", "MARB", "MARC",
+                                      "MARL", "MARR", "MARS", "RESI", 0 };
+
+
+static int isTag( ofCHAR_t *base, gedNODE_t *node, const char *tag )
+{
+  return node->tagLength == strlen( tag ) && memcmp( base + node->tagOffset, tag, node->tagLength ) == 0;
+}
+
+
+static int isOneOf( ofCHAR_t *base, gedNODE_t *node, const char **tags )
+{
+  int i;
+
+  for( i = 0; tags[ i ] != 0; i++ ) {
+    if( isTag( base, node, tags[ i ] ) ) {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+
+/* keeps sqlite's message for the glue and returns -3 */
+
+static int failed( gedSQLITELOADER_t *loader )
+{
+  strncpy( loader->message, sqlite3_errmsg( loader->db ), gcSQLITEMESSAGESIZE - 1 );
+  loader->message[ gcSQLITEMESSAGESIZE - 1 ] = '\0';
+
+  return -3;
+}
+
+
+/* binds text, or NULL if there is none */
+
+static int bindText( sqlite3_stmt *statement, int column, ofCHAR_t *text, ofUI32_t length )
+{
+  if( length == 0 ) {
+    return sqlite3_bind_null( statement, column );
+  }
+
+  return sqlite3_bind_text( statement, column, (char*)text, length, SQLITE_STATIC );
+}
+
+
+/* binds a number, or NULL if it is 0 (not known) */
+
+static int bindNumber( sqlite3_stmt *statement, int column, ofI64_t value )
+{
+  if( value == 0 ) {
+    return sqlite3_bind_null( statement, column );
+  }
+
+  return sqlite3_bind_int64( statement, column, value );
+}
+
+
+static int insertRow( gedSQLITELOADER_t *loader, int table )
+{
+  sqlite3_stmt *statement = loader->inserts[ table ];
+
+  if( sqlite3_step( statement ) != SQLITE_DONE ) {
+    sqlite3_reset( statement );
+    return failed( loader );
+  }
+  sqlite3_reset( statement );
+  loader->counts[ table ]++;
+
+  return 0;
+}
+
+
+static int insertName( gedSQLITELOADER_t *loader, ofCHAR_t *base, gedNODE_t *node, ofI64_t id, int position )
+{
+  sqlite3_stmt *statement = loader->inserts[ gstNAMES ];
+  ofCHAR_t      value[ gcMAXNAMESIZE ];
+  ofCHAR_t      key[ gcMAXNAMESIZE ];
+  gedNAME_t     name;
+  int           length;
+
+  sqlite3_bind_int64( statement, 1, id );
+  sqlite3_bind_int( statement, 2, position );
+  bindText( statement, 3, base + node->valueOffset, node->valueLength );
+
+  /* names too long to split are kept whole */
+
+  if( node->valueLength >= gcMAXNAMESIZE || memchr( base + node->valueOffset, 0, node->valueLength ) != 0 ) {
+    memset( &name, 0, sizeof( name ) );
+    value[ 0 ] = '\0';
+    length = 0;
+  } else {
+    memcpy( value, base + node->valueOffset, node->valueLength );
+    value[ node->valueLength ] = '\0';
+    splitGEDCOMName( value, &name );
+    length = normalizeGEDCOMName( value + name.surnameStart, name.surnameLength, key, sizeof( key ) );
+  }
+
+  bindText( statement, 4, value + name.givenStart, name.givenLength );
+  bindText( statement, 5, value + name.surnameStart, name.surnameLength );
+  bindText( statement, 6, value + name.suffixStart, name.suffixLength );
+  bindText( statement, 7, key, length );
+
+  return insertRow( loader, gstNAMES );
+}
+
+
+/* an event of a person ('table' gstINDIVIDUALS) or family, with its first
+ * DATE and PLAC */
+
+static int insertEvent( gedSQLITELOADER_t *loader, ofCHAR_t *base, gedNODE_t *event, int table, ofI64_t id )
+{
+  sqlite3_stmt   *statement = loader->inserts[ gstEVENTS ];
+  gedNODE_t      *date = 0;
+  gedNODE_t      *place = 0;
+  gedNODE_t      *node;
+  gedDATEVALUE_t  value;
+  ofUI32_t        child;
+  ofI32_t         first = 0;
+  ofI32_t         last = 0;
+  ofUI32_t        sortKey = 0;
+
+  for( child = event->firstChild; child != gcNONODE; child = node->next ) {
+    node = &loader->reader.nodes[ child ];
+    if( date == 0 && isTag( base, node, "DATE" ) ) {
+      date = node;
+    } else if( place == 0 && isTag( base, node, "PLAC" ) ) {
+      place = node;
+    }
+  }
+
+  if( date != 0 && parseGEDCOMDateText( base + date->valueOffset, date->valueLength, &value ) == 0 &&
+      value.flags <= gcINTERPRETED )
+  {
+    sortKey = packGEDCOMDate( &value.date1 );
+    getGEDCOMDateValueDays( &value, &first, &last );
+  }
+
+  sqlite3_bind_int64( statement, 1, (ofI64_t)loader->counts[ gstEVENTS ] + 1 );
+  if( table == gstINDIVIDUALS ) {
+    sqlite3_bind_int64( statement, 2, id );
+    sqlite3_bind_null( statement, 3 );
+  } else {
+    sqlite3_bind_null( statement, 2 );
+    sqlite3_bind_int64( statement, 3, id );
+  }
+  bindText( statement, 4, base + event->tagOffset, event->tagLength );
+  bindText( statement, 5, date ? base + date->valueOffset : base, date ? date->valueLength : 0 );
+  bindNumber( statement, 6, sortKey );
+  bindNumber( statement, 7, first );
+  bindNumber( statement, 8, last );
+  bindText( statement, 9, place ? base + place->valueOffset : base, place ? place->valueLength : 0 );
+
+  return insertRow( loader, gstEVENTS );
+}
+
+
+static int insertPerson( gedSQLITELOADER_t *loader, ofCHAR_t *base )
+{
+  sqlite3_stmt *statement = loader->inserts[ gstINDIVIDUALS ];
+  gedNODE_t    *root = &loader->reader.nodes[ 0 ];
+  gedNODE_t    *sex = 0;
+  gedNODE_t    *node;
+  ofI64_t       id = (ofI64_t)loader->counts[ gstINDIVIDUALS ] + 1;
+  ofUI32_t      child;
+  int           names = 0;
+  int           rc;
+
+  for( child = root->firstChild; child != gcNONODE; child = node->next ) {
+    node = &loader->reader.nodes[ child ];
+    if( isTag( base, node, "NAME" ) ) {
+      rc = insertName( loader, base, node, id, names++ );
+    } else if( isOneOf( base, node, personEvents ) ) {
+      rc = insertEvent( loader, base, node, gstINDIVIDUALS, id );
+    } else {
+      if( sex == 0 && isTag( base, node, "SEX" ) ) {
+        sex = node;
+      }
+      rc = 0;
+    }
+    if( rc != 0 ) {
+      return rc;
+    }
+  }
+
+  sqlite3_bind_int64( statement, 1, id );
+  bindText( statement, 2, base + root->xrefOffset, root->xrefLength );
+  bindText( statement, 3, sex ? base + sex->valueOffset : base, sex ? sex->valueLength : 0 );
+
+  return insertRow( loader, gstINDIVIDUALS );
+}
+
+
+static int insertFamily( gedSQLITELOADER_t *loader, ofCHAR_t *base )
+{
+  sqlite3_stmt *statement = loader->inserts[ gstFAMILIES ];
+  sqlite3_stmt *link = loader->inserts[ gstLINKS ];
+  gedNODE_t    *root = &loader->reader.nodes[ 0 ];
+  gedNODE_t    *node;
+  ofI64_t       id = (ofI64_t)loader->counts[ gstFAMILIES ] + 1;
+  ofUI32_t      child;
+  int           rc;
+
+  for( child = root->firstChild; child != gcNONODE; child = node->next ) {
+    node = &loader->reader.nodes[ child ];
+    if( isTag( base, node, "HUSB" ) || isTag( base, node, "WIFE" ) || isTag( base, node, "CHIL" ) ) {
+      sqlite3_bind_int64( link, 1, id );
+      bindText( link, 2, base + node->tagOffset, node->tagLength );
+      bindText( link, 3, base + node->valueOffset, node->valueLength );
+      rc = insertRow( loader, gstLINKS );
+    } else if( isOneOf( base, node, familyEvents ) ) {
+      rc = insertEvent( loader, base, node, gstFAMILIES, id );
+    } else {
+      rc = 0;
+    }
+    if( rc != 0 ) {
+      return rc;
+    }
+  }
+
+  sqlite3_bind_int64( statement, 1, id );
+  bindText( statement, 2, base + root->xrefOffset, root->xrefLength );
+
+  return insertRow( loader, gstFAMILIES );
+}
+
+
+/* returns 0, 1 if the file could not be opened (errno is set) and 2 if
+ * the database could not be set up (see loader->message) */
+
+int openSQLiteLoader( gedSQLITELOADER_t *loader, const char *path, const char *dbPath )
+{
+  int i;
+
+  memset( loader, 0, sizeof( *loader ) );
+
+  if( openRecordReader( &loader->reader, path ) != 0 ) {
+    return 1;
+  }
+
+  if( sqlite3_open( dbPath, &loader->db ) != SQLITE_OK ||
+      sqlite3_exec( loader->db, schema, 0, 0, 0 ) != SQLITE_OK )
+  {
+    failed( loader );
+    closeSQLiteLoader( loader );
+    return 2;
+  }
+
+  for( i = 0; i < gstCOUNT; i++ ) {
+    if( sqlite3_prepare_v2( loader->db, inserts[ i ], -1, &loader->inserts[ i ], 0 ) != SQLITE_OK ) {
+      failed( loader );
+      closeSQLiteLoader( loader );
+      return 2;
+    }
+  }
+
+  return 0;
+}
+
+
+/* loads up to gcSQLITEROUND records in one transaction, and builds the
+ * indexes after the last.  Returns 1 if there are more, 0 at the end, -1
+ * if memory ran out, -2 if reading failed and -3 on a database error. */
+
+int runSQLiteLoaderRound( gedSQLITELOADER_t *loader )
+{
+  gedRECORDREADER_t *reader = &loader->reader;
+  ofCHAR_t          *base;
+  int                rc = 1;
+  int                n;
+
+  if( sqlite3_exec( loader->db, "BEGIN", 0, 0, 0 ) != SQLITE_OK ) {
+    return failed( loader );
+  }
+
+  for( n = 0; n < gcSQLITEROUND && rc > 0; n++ ) {
+    rc = readGEDCOMRecord( reader );
+    if( rc <= 0 ) {
+      if( rc == -2 ) {
+        loader->errnum = errno;
+      }
+      break;
+    }
+
+    base = reader->buffer + reader->start;
+    if( reader->count > 0 && isTag( base, &reader->nodes[ 0 ], "INDI" ) ) {
+      rc = insertPerson( loader, base );
+    } else if( reader->count > 0 && isTag( base, &reader->nodes[ 0 ], "FAM" ) ) {
+      rc = insertFamily( loader, base );
+    }
+    rc = ( rc == 0 ) ? 1 : rc;
+  }
+
+  if( rc < 0 ) {
+    sqlite3_exec( loader->db, "ROLLBACK", 0, 0, 0 );
+    return rc;
+  }
+
+  if( sqlite3_exec( loader->db, "COMMIT", 0, 0, 0 ) != SQLITE_OK ) {
+    return failed( loader );
+  }
+
+  if( rc == 0 ) {
+    loader->done = 1;
+    if( sqlite3_exec( loader->db, indexes, 0, 0, 0 ) != SQLITE_OK ) {
+      rc = failed( loader );
+      sqlite3_exec( loader->db, "ROLLBACK", 0, 0, 0 );
+    }
+  }
+
+  return rc;
+}
+
+
+void closeSQLiteLoader( gedSQLITELOADER_t *loader )
+{
+  int i;
+
+  for( i = 0; i < gstCOUNT; i++ ) {
+    sqlite3_finalize( loader->inserts[ i ] );
+    loader->inserts[ i ] = 0;
+  }
+
+  sqlite3_close( loader->db );
+  loader->db = 0;
+  closeRecordReader( &loader->reader );
+}
+
+#endif /* HAVE_SQLITE3_H */
@@ -0,0 +1,72 @@
+/* -------------------------------------------------------------------------
+ * gedcom_sqlite.h -- Defines the interface for the SQLite bulk loader.
+ * Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+ * -------------------------------------------------------------------------
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ------------------------------------------------------------------------- */
+
+#ifndef __GEDSQLITE_H__
+#define __GEDSQLITE_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sqlite3.h>
+
+#include "gedcom_types.h"
+#include "gedcom_stream.h"
+
+/* loader constants */
+
+  #define gcSQLITEROUND        ( 16384 )  /* records loaded in one transaction */
+  #define gcSQLITEMESSAGESIZE  ( 256 )
+
+/* tables, in the order their row counts are kept */
+
+  #define gstINDIVIDUALS  ( 0 )
+  #define gstFAMILIES     ( 1 )
+  #define gstNAMES        ( 2 )
+  #define gstEVENTS       ( 3 )
+  #define gstLINKS        ( 4 )
+
+  #define gstCOUNT        ( 5 )
+
+/* types */
+
+typedef struct {
+  gedRECORDREADER_t reader;
+  sqlite3          *db;
+  sqlite3_stmt     *inserts[ gstCOUNT ];
+  ofUI64_t          counts[ gstCOUNT ];
+  int               done;
+  int               errnum;
+  char              message[ gcSQLITEMESSAGESIZE ];
+} gedSQLITELOADER_t;
+
+
+extern const char *sqliteTableNames[ gstCOUNT ];
+
+int openSQLiteLoader( gedSQLITELOADER_t *loader, const char *path, const char *dbPath );
+
+int runSQLiteLoaderRound( gedSQLITELOADER_t *loader );
+
+void closeSQLiteLoader( gedSQLITELOADER_t *loader );
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // __GEDSQLITE_H__
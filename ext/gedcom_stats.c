@@ -0,0 +1,603 @@
+/* -------------------------------------------------------------------------
+ * gedcom_stats.c -- Defines the one pass statistics of a file.
+ * Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+ * -------------------------------------------------------------------------
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ------------------------------------------------------------------------- */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+#include "gedcom_types.h"
+#include "gedcom_ctype.h"
+#include "gedcom_date.h"
+#include "gedcom_name.h"
+#include "gedcom_record.h"
+#include "gedcom_chunk.h"
+#include "gedcom_stats.h"
+
+
+/* The collector counts, in one pass over a file:
+ *
+ *   lines and malformed lines (no level, a level of more than two digits
+ *   or no tag; these are not counted anywhere else)
+ *   the tags of the level 0 lines and of every line
+ *   the lines at each level, and the records by their deepest level
+ *   the normalized surnames of the level 1 NAMEs of INDI records
+ *   the events of INDI and FAM records by tag and decade, from the first
+ *   DATE of each (the year of its first part, AD gregorian or julian)
+ *   every DATE by qualifier (or as invalid if it does not parse) and by
+ *   the calendar of its first part
+ *
+ * The file is read with the chunk reader, so each thread counts whole
+ * records into histograms of its own, and those are added up once the
+ * file has been read. */
+
+
+/* the individual and family event tags of GEDCOM 5.5, sorted, and which
+ * records have them: 1 for INDI, 2 for FAM */
+
+const char *statsEventTags[ gcSTATSEVENTS ] = {
+  "ADOP", "ANUL", "BAPM", "BARM", "BASM", "BIRT", "BLES", "BURI", "CENS", "CHR", "CHRA", "CONF", "CREM",
+  "DEAT", "DIV", "DIVF", "EMIG", "ENGA", "EVEN", "FCOM", "GRAD", "IMMI", "MARB", "MARC", "MARL", "MARR",
+  "MARS", "NATU", "ORDN", "PROB", "RESI", "RETI", "WILL" };
+
+static const int eventRecords[ gcSTATSEVENTS ] = {
+  1, 2, 1, 1, 1, 1, 1, 1, 3, 1, 1, 1, 1,
+  1, 2, 2, 1, 2, 3, 1, 1, 1, 2, 2, 2, 2,
+  2, 1, 1, 1, 3, 1, 1 };
+
+const int statsCalendarTypes[ gcSTATSCALENDARS ] = { gctGREGORIAN, gctJULIAN, gctHEBREW, gctFRENCH,
+                                                     gctFUTURE, gctUNKNOWN };
+
+/* where a chunk is: the record kind (0 for other records, -1 before the
+ * first), its deepest level so far, and the event of the level 1 line
+ * being read (-1 if none) and whether it had its DATE yet */
+
+typedef struct {
+  int kind;
+  int depth;
+  int event;
+  int dated;
+} gedSTATSSTATE_t;
+
+typedef struct {
+  gedSTATS_t *stats;
+  ofCHAR_t   *text;
+  ofUI64_t    length;
+} gedSTATSWORK_t;
+
+
+static void freeTable( gedSTATSTABLE_t *table )
+{
+  free( table->slots );
+  free( table->pool );
+  free( table->entries );
+  memset( table, 0, sizeof( *table ) );
+}
+
+
+static void freeStats( gedSTATS_t *stats )
+{
+  int i;
+
+  for( i = 0; i < gstsTABLES; i++ ) {
+    freeTable( &stats->tables[ i ] );
+  }
+  for( i = 0; i < gcSTATSEVENTS; i++ ) {
+    free( stats->decades[ i ] );
+  }
+  memset( stats, 0, sizeof( *stats ) );
+}
+
+
+static int growSlots( gedSTATSTABLE_t *table )
+{
+  gedSTATSCOUNT_t *slots;
+  ofUI32_t         slotCount = ( table->slotCount == 0 ) ? 256 : table->slotCount * 2;
+  ofUI32_t         slot;
+  ofUI32_t         i;
+
+  slots = (gedSTATSCOUNT_t*)calloc( slotCount, sizeof( gedSTATSCOUNT_t ) );
+  if( slots == 0 ) {
+    return -1;
+  }
+
+  for( i = 0; i < table->slotCount; i++ ) {
+    if( table->slots[ i ].length != 0 ) {
+      for( slot = table->slots[ i ].hash & ( slotCount - 1 ); slots[ slot ].length != 0; slot = ( slot + 1 ) & ( slotCount - 1 ) )
+        ;
+      slots[ slot ] = table->slots[ i ];
+    }
+  }
+
+  free( table->slots );
+  table->slots = slots;
+  table->slotCount = slotCount;
+
+  return 0;
+}
+
+
+/* adds 'count' to the count of 'key'.  Returns -1 if memory ran out. */
+
+static int addCount( gedSTATSTABLE_t *table, ofCHAR_t *key, ofUI32_t length, ofUI64_t count )
+{
+  gedSTATSCOUNT_t *entry;
+  ofUI64_t         hash;
+  ofUI32_t         slot;
+
+  if( ( table->count + 1 ) * 2 > table->slotCount && growSlots( table ) != 0 ) {
+    return -1;
+  }
+
+  hash = hashGEDCOMBytes( key, length, 0 );
+  for( slot = hash & ( table->slotCount - 1 ); ; slot = ( slot + 1 ) & ( table->slotCount - 1 ) ) {
+    entry = &table->slots[ slot ];
+    if( entry->length == 0 ) {
+      break;
+    }
+    if( entry->hash == hash && entry->length == length && memcmp( table->pool + entry->key, key, length ) == 0 ) {
+      entry->count += count;
+      return 0;
+    }
+  }
+
+  if( table->poolLength + length > table->poolSize ) {
+    ofUI64_t  size = ( table->poolSize == 0 ) ? 4096 : table->poolSize * 2;
+    ofCHAR_t *pool;
+
+    while( size < table->poolLength + length ) {
+      size *= 2;
+    }
+    pool = (ofCHAR_t*)realloc( table->pool, size );
+    if( pool == 0 ) {
+      return -1;
+    }
+    table->pool = pool;
+    table->poolSize = size;
+  }
+
+  memcpy( table->pool + table->poolLength, key, length );
+  entry->key = table->poolLength;
+  entry->hash = hash;
+  entry->count = count;
+  entry->length = length;
+  table->poolLength += length;
+  table->count++;
+
+  return 0;
+}
+
+
+static int findEvent( ofCHAR_t *tag, ofUI32_t length, int kind )
+{
+  int      low = 0;
+  int      high = gcSTATSEVENTS - 1;
+  int      middle;
+  int      order;
+  ofUI32_t size;
+
+  while( low <= high ) {
+    middle = ( low + high ) / 2;
+    size = strlen( statsEventTags[ middle ] );
+    order = memcmp( statsEventTags[ middle ], tag, ( size < length ) ? size : length );
+    if( order == 0 ) {
+      order = ( size < length ) ? -1 : ( size > length );
+    }
+    if( order == 0 ) {
+      return ( eventRecords[ middle ] & kind ) ? middle : -1;
+    }
+    if( order < 0 ) {
+      low = middle + 1;
+    } else {
+      high = middle - 1;
+    }
+  }
+
+  return -1;
+}
+
+
+static int isTag( ofCHAR_t *tag, ofUI32_t length, const char *name )
+{
+  return length == strlen( name ) && memcmp( tag, name, length ) == 0;
+}
+
+
+static int addSurname( gedSTATS_t *stats, ofCHAR_t *value, ofUI32_t length )
+{
+  ofCHAR_t  text[ gcMAXNAMESIZE ];
+  ofCHAR_t  key[ gcMAXNAMESIZE ];
+  gedNAME_t name;
+  int       n;
+
+  if( length >= gcMAXNAMESIZE || memchr( value, 0, length ) != 0 ) {
+    return 0;
+  }
+
+  memcpy( text, value, length );
+  text[ length ] = '\0';
+  splitGEDCOMName( text, &name );
+
+  n = normalizeGEDCOMName( text + name.surnameStart, name.surnameLength, key, sizeof( key ) );
+
+  return ( n > 0 ) ? addCount( &stats->tables[ gstsSURNAMES ], key, n, 1 ) : 0;
+}
+
+
+static int addDate( gedSTATS_t *stats, gedSTATSSTATE_t *state, int level, ofCHAR_t *value, ofUI32_t length )
+{
+  gedDATEVALUE_t date;
+  ofUI32_t       packed;
+  ofUI32_t       year;
+  int            first;
+  int            i;
+
+  first = ( level == 2 && state->event >= 0 && !state->dated );
+  state->dated |= first;
+
+  if( parseGEDCOMDateText( value, length, &date ) != 0 ) {
+    stats->qualifiers[ gcSTATSINVALIDDATE ]++;
+    return 0;
+  }
+
+  if( date.flags <= gcDEAD ) {
+    stats->qualifiers[ date.flags ]++;
+  }
+  for( i = 0; i < gcSTATSCALENDARS; i++ ) {
+    if( statsCalendarTypes[ i ] == date.date1.type ) {
+      stats->calendars[ i ]++;
+    }
+  }
+
+  if( !first || date.flags > gcINTERPRETED ) {
+    return 0;
+  }
+
+  packed = packGEDCOMDate( &date.date1 );
+  year = packed >> 9;
+  if( packed == 0 || year >= gcSTATSDECADES * 10 ) {
+    return 0;
+  }
+
+  if( stats->decades[ state->event ] == 0 ) {
+    stats->decades[ state->event ] = (ofUI64_t*)calloc( gcSTATSDECADES, sizeof( ofUI64_t ) );
+    if( stats->decades[ state->event ] == 0 ) {
+      return -1;
+    }
+  }
+  stats->decades[ state->event ][ year / 10 ]++;
+
+  return 0;
+}
+
+
+/* counts one line, split as the validator splits it */
+
+static int countLine( gedSTATS_t *stats, gedSTATSSTATE_t *state, ofCHAR_t *line, ofCHAR_t *end )
+{
+  ofCHAR_t *p;
+  ofCHAR_t *tag;
+  ofUI32_t  tagLength;
+  int       digits;
+  int       level;
+
+  while( end > line && isGEDCOMClass( end[ -1 ], gccLINEEND ) ) {
+    end--;
+  }
+  stats->lines++;
+
+  p = line + spanGEDCOMClass( line, end - line, gccBLANK );
+  for( level = 0, digits = 0; p < end && isGEDCOMClass( *p, gccDIGIT ); p++, digits++ ) {
+    level = level * 10 + ( *p - '0' );
+  }
+
+  if( digits == 0 || digits > 2 || p >= end || !isGEDCOMClass( *p, gccBLANK ) ) {
+    stats->malformed++;
+    return 0;
+  }
+  p += spanGEDCOMClass( p, end - p, gccBLANK );
+
+  if( p < end && *p == '@' ) {
+    while( p < end && !isGEDCOMClass( *p, gccBLANK ) ) {
+      p++;
+    }
+    p += spanGEDCOMClass( p, end - p, gccBLANK );
+  }
+
+  for( tag = p; p < end && !isGEDCOMClass( *p, gccBLANK ); p++ )
+    ;
+  tagLength = p - tag;
+  if( tagLength == 0 ) {
+    stats->malformed++;
+    return 0;
+  }
+  p += spanGEDCOMClass( p, end - p, gccBLANK );
+
+  stats->levels[ level ]++;
+  if( addCount( &stats->tables[ gstsTAGS ], tag, tagLength, 1 ) != 0 ) {
+    return -1;
+  }
+
+  if( level == 0 ) {
+    if( state->kind >= 0 ) {
+      stats->depths[ state->depth ]++;
+    }
+    state->kind = isTag( tag, tagLength, "INDI" ) ? 1 : isTag( tag, tagLength, "FAM" ) ? 2 : 0;
+    state->depth = 0;
+    state->event = -1;
+    if( addCount( &stats->tables[ gstsRECORDS ], tag, tagLength, 1 ) != 0 ) {
+      return -1;
+    }
+  } else if( state->kind >= 0 ) {
+    if( level > state->depth ) {
+      state->depth = level;
+    }
+    if( level == 1 ) {
+      state->event = ( state->kind > 0 ) ? findEvent( tag, tagLength, state->kind ) : -1;
+      state->dated = 0;
+      if( state->kind == 1 && isTag( tag, tagLength, "NAME" ) && addSurname( stats, p, end - p ) != 0 ) {
+        return -1;
+      }
+    }
+  }
+
+  if( isTag( tag, tagLength, "DATE" ) ) {
+    return addDate( stats, state, level, p, end - p );
+  }
+
+  return 0;
+}
+
+
+static void* countChunk( void *data )
+{
+  gedSTATSWORK_t  *work = (gedSTATSWORK_t*)data;
+  gedSTATSSTATE_t  state;
+  ofCHAR_t        *end = work->text + work->length;
+  ofCHAR_t        *line;
+  ofCHAR_t        *next;
+
+  state.kind = -1;
+  state.depth = 0;
+  state.event = -1;
+  state.dated = 0;
+
+  for( line = work->text; line < end && !work->stats->failed; line = next ) {
+    next = (ofCHAR_t*)memchr( line, '\n', end - line );
+    next = ( next != 0 ) ? next + 1 : end;
+
+    if( countLine( work->stats, &state, line, next ) != 0 ) {
+      work->stats->failed = 1;
+    }
+  }
+
+  if( state.kind >= 0 ) {
+    work->stats->depths[ state.depth ]++;
+  }
+
+  return 0;
+}
+
+
+static int compareEntries( const void *a, const void *b )
+{
+  const gedSTATSENTRY_t *e1 = (const gedSTATSENTRY_t*)a;
+  const gedSTATSENTRY_t *e2 = (const gedSTATSENTRY_t*)b;
+  int                    order;
+
+  order = memcmp( e1->key, e2->key, ( e1->length < e2->length ) ? e1->length : e2->length );
+  if( order != 0 ) {
+    return order;
+  }
+
+  return ( e1->length < e2->length ) ? -1 : ( e1->length > e2->length );
+}
+
+
+/* the entries of a table, by key */
+
+static int sortTable( gedSTATSTABLE_t *table )
+{
+  ofUI32_t i;
+  ofUI32_t n;
+
+  table->entries = (gedSTATSENTRY_t*)malloc( ( table->count > 0 ? table->count : 1 ) * sizeof( gedSTATSENTRY_t ) );
+  if( table->entries == 0 ) {
+    return -1;
+  }
+
+  for( i = n = 0; i < table->slotCount; i++ ) {
+    if( table->slots[ i ].length != 0 ) {
+      table->entries[ n ].key = table->pool + table->slots[ i ].key;
+      table->entries[ n ].length = table->slots[ i ].length;
+      table->entries[ n ].count = table->slots[ i ].count;
+      n++;
+    }
+  }
+
+  qsort( table->entries, n, sizeof( gedSTATSENTRY_t ), compareEntries );
+
+  return 0;
+}
+
+
+/* adds the histograms of every thread up into the totals */
+
+static int mergeStats( gedSTATSCOLLECTOR_t *collector )
+{
+  gedSTATS_t      *totals = &collector->totals;
+  gedSTATS_t      *stats;
+  gedSTATSTABLE_t *table;
+  ofUI32_t         i;
+  int              t;
+  int              j;
+
+  for( t = 0; t < collector->threads; t++ ) {
+    stats = &collector->workers[ t ];
+    totals->lines += stats->lines;
+    totals->malformed += stats->malformed;
+
+    for( i = 0; i < gcSTATSLEVELS; i++ ) {
+      totals->levels[ i ] += stats->levels[ i ];
+      totals->depths[ i ] += stats->depths[ i ];
+    }
+    for( i = 0; i < gcSTATSQUALIFIERS; i++ ) {
+      totals->qualifiers[ i ] += stats->qualifiers[ i ];
+    }
+    for( i = 0; i < gcSTATSCALENDARS; i++ ) {
+      totals->calendars[ i ] += stats->calendars[ i ];
+    }
+
+    for( j = 0; j < gcSTATSEVENTS; j++ ) {
+      if( stats->decades[ j ] == 0 ) {
+        continue;
+      }
+      if( totals->decades[ j ] == 0 ) {
+        totals->decades[ j ] = stats->decades[ j ];
+        stats->decades[ j ] = 0;
+        continue;
+      }
+      for( i = 0; i < gcSTATSDECADES; i++ ) {
+        totals->decades[ j ][ i ] += stats->decades[ j ][ i ];
+      }
+    }
+
+    for( j = 0; j < gstsTABLES; j++ ) {
+      table = &stats->tables[ j ];
+      for( i = 0; i < table->slotCount; i++ ) {
+        if( table->slots[ i ].length != 0 &&
+            addCount( &totals->tables[ j ], table->pool + table->slots[ i ].key, table->slots[ i ].length,
+                      table->slots[ i ].count ) != 0 )
+        {
+          return -1;
+        }
+      }
+    }
+
+    freeStats( stats );
+  }
+
+  for( j = 0; j < gstsTABLES; j++ ) {
+    if( sortTable( &totals->tables[ j ] ) != 0 ) {
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+
+/* opens the file at 'path' for a collector that reads it on up to
+ * 'threads' threads.  Returns -1 if the file cannot be opened (see
+ * errno). */
+
+int openStatsCollector( gedSTATSCOLLECTOR_t *collector, const char *path, int threads )
+{
+  memset( collector, 0, sizeof( *collector ) );
+
+#ifdef HAVE_PTHREAD_H
+  if( threads > gcMAXSTATSTHREADS ) {
+    threads = gcMAXSTATSTHREADS;
+  }
+#else
+  threads = 1;
+#endif
+  if( threads < 1 ) {
+    threads = 1;
+  }
+  collector->threads = threads;
+
+  return openChunkReader( &collector->reader, path );
+}
+
+
+/* reads the next round of the file and counts it.  Returns 1 if there is
+ * more to read, 0 once the whole file has been read and the totals are
+ * ready, -1 if memory ran out and -2 if reading failed (see the reader's
+ * errnum). */
+
+int runStatsRound( gedSTATSCOLLECTOR_t *collector )
+{
+  gedSTATSWORK_t work[ gcMAXSTATSTHREADS ];
+#ifdef HAVE_PTHREAD_H
+  pthread_t      workers[ gcMAXSTATSTHREADS ];
+  int            started[ gcMAXSTATSTHREADS ];
+#endif
+  ofCHAR_t      *starts[ gcMAXSTATSTHREADS + 1 ];
+  int            failed;
+  int            rc;
+  int            t;
+
+  rc = readChunks( &collector->reader, gcSTATSCHUNK, collector->threads, starts );
+  if( rc != 0 ) {
+    return rc;
+  }
+
+  for( t = 0; t < collector->threads; t++ ) {
+    work[ t ].stats = &collector->workers[ t ];
+    work[ t ].text = starts[ t ];
+    work[ t ].length = starts[ t + 1 ] - starts[ t ];
+  }
+
+#ifdef HAVE_PTHREAD_H
+  for( t = 1; t < collector->threads; t++ ) {
+    started[ t ] = ( pthread_create( &workers[ t ], 0, countChunk, &work[ t ] ) == 0 );
+  }
+  countChunk( &work[ 0 ] );
+  for( t = 1; t < collector->threads; t++ ) {
+    if( started[ t ] ) {
+      pthread_join( workers[ t ], 0 );
+    } else {
+      countChunk( &work[ t ] );
+    }
+  }
+#else
+  countChunk( &work[ 0 ] );
+#endif
+
+  failed = 0;
+  for( t = 0; t < collector->threads; t++ ) {
+    failed |= collector->workers[ t ].failed;
+  }
+  if( failed ) {
+    return -1;
+  }
+
+  if( skipChunks( &collector->reader ) == 0 ) {
+    closeChunkReader( &collector->reader );
+    return ( mergeStats( collector ) != 0 ) ? -1 : 0;
+  }
+
+  return 1;
+}
+
+
+void closeStatsCollector( gedSTATSCOLLECTOR_t *collector )
+{
+  int t;
+
+  closeChunkReader( &collector->reader );
+
+  for( t = 0; t < gcMAXSTATSTHREADS; t++ ) {
+    freeStats( &collector->workers[ t ] );
+  }
+  freeStats( &collector->totals );
+}
@@ -0,0 +1,111 @@
+/* -------------------------------------------------------------------------
+ * gedcom_stats.h -- Defines the interface for the file statistics.
+ * Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+ * -------------------------------------------------------------------------
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ------------------------------------------------------------------------- */
+
+#ifndef __GEDSTATS_H__
+#define __GEDSTATS_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "gedcom_types.h"
+#include "gedcom_date.h"
+#include "gedcom_chunk.h"
+
+/* statistics constants */
+
+  #define gcMAXSTATSTHREADS   ( 16 )
+  #define gcSTATSCHUNK        ( 1024 * 1024 )  /* bytes read per thread and round */
+  #define gcSTATSLEVELS       ( 100 )          /* levels have at most two digits */
+  #define gcSTATSDECADES      ( 1000 )         /* of the years 0 to 9999 */
+  #define gcSTATSEVENTS       ( 33 )
+  #define gcSTATSCALENDARS    ( 6 )
+  #define gcSTATSINVALIDDATE  ( gcDEAD + 1 )   /* the qualifier of dates that do not parse */
+  #define gcSTATSQUALIFIERS   ( gcDEAD + 2 )
+
+/* the tables of counts by text */
+
+  #define gstsRECORDS   ( 0 )  /* level 0 tags */
+  #define gstsTAGS      ( 1 )  /* the tags of every line */
+  #define gstsSURNAMES  ( 2 )  /* normalized surnames of the NAMEs of INDI records */
+
+  #define gstsTABLES    ( 3 )
+
+/* types */
+
+typedef struct {
+  ofUI64_t key;      /* offset of the text in the pool */
+  ofUI64_t hash;
+  ofUI64_t count;
+  ofUI32_t length;   /* 0 marks an empty slot */
+} gedSTATSCOUNT_t;
+
+typedef struct {
+  ofCHAR_t *key;
+  ofUI32_t  length;
+  ofUI64_t  count;
+} gedSTATSENTRY_t;
+
+typedef struct {
+  gedSTATSCOUNT_t *slots;      /* open addressing, at most half full */
+  ofUI32_t         slotCount;  /* a power of two */
+  ofUI32_t         count;
+  ofCHAR_t        *pool;
+  ofUI64_t         poolLength;
+  ofUI64_t         poolSize;
+  gedSTATSENTRY_t *entries;    /* by key, once the counts are merged */
+} gedSTATSTABLE_t;
+
+/* the histograms of one thread, and their totals */
+
+typedef struct {
+  gedSTATSTABLE_t tables[ gstsTABLES ];
+  ofUI64_t        lines;
+  ofUI64_t        malformed;
+  ofUI64_t        levels[ gcSTATSLEVELS ];      /* lines by level */
+  ofUI64_t        depths[ gcSTATSLEVELS ];      /* records by their deepest level */
+  ofUI64_t        qualifiers[ gcSTATSQUALIFIERS ];
+  ofUI64_t        calendars[ gcSTATSCALENDARS ];
+  ofUI64_t       *decades[ gcSTATSEVENTS ];     /* 0 until the event is seen */
+  int             failed;
+} gedSTATS_t;
+
+typedef struct {
+  gedCHUNKREADER_t reader;
+  int              threads;
+  gedSTATS_t       workers[ gcMAXSTATSTHREADS ];
+  gedSTATS_t       totals;
+} gedSTATSCOLLECTOR_t;
+
+
+extern const char *statsEventTags[ gcSTATSEVENTS ];
+
+extern const int statsCalendarTypes[ gcSTATSCALENDARS ];
+
+int openStatsCollector( gedSTATSCOLLECTOR_t *collector, const char *path, int threads );
+
+int runStatsRound( gedSTATSCOLLECTOR_t *collector );
+
+void closeStatsCollector( gedSTATSCOLLECTOR_t *collector );
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // __GEDSTATS_H__
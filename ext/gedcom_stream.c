@@ -0,0 +1,341 @@
+/* -------------------------------------------------------------------------
+ * gedcom_stream.c -- Defines the record-at-a-time file reader.
+ * Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+ * -------------------------------------------------------------------------
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ------------------------------------------------------------------------- */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gedcom_types.h"
+#include "gedcom_record.h"
+#include "gedcom_stream.h"
+#include "gedcom_probes.h"
+
+
+/* The reader hands out a file one level 0 record at a time, as a tree of
+ * nodes over the record's bytes.  Records end where the next level 0 line
+ * starts, as for scanGEDCOMRecords.  The buffer only ever holds the current
+ * record and the unread bytes after it, and the node array is reused for
+ * every record, so both only grow to fit the largest record of the file.
+ *
+ * Lines without a level are left out of the tree, and so is anything
+ * before the first level 0 line or that has no line above it. */
+
+
+int openRecordReader( gedRECORDREADER_t *reader, const char *path )
+{
+  memset( reader, 0, sizeof( *reader ) );
+
+  reader->file = fopen( path, "rb" );
+  if( reader->file == 0 ) {
+    return -1;
+  }
+
+  return 0;
+}
+
+
+void closeRecordReader( gedRECORDREADER_t *reader )
+{
+  if( reader->file != 0 ) {
+    fclose( reader->file );
+  }
+  free( reader->buffer );
+  free( reader->nodes );
+
+  reader->file = 0;
+  reader->buffer = 0;
+  reader->nodes = 0;
+  reader->size = reader->length = reader->start = reader->next = 0;
+  reader->count = reader->nodeSize = 0;
+  reader->generation++;
+}
+
+
+/* the bytes allocated by the reader, not counting the reader itself */
+
+ofUI64_t getRecordReaderMemory( gedRECORDREADER_t *reader )
+{
+  return reader->size + (ofUI64_t)reader->nodeSize * sizeof( gedNODE_t );
+}
+
+
+static int isBlank( ofCHAR_t c )
+{
+  return ( c == ' ' || c == '\t' );
+}
+
+
+static int isLineEnd( ofCHAR_t c )
+{
+  return ( c == '\n' || c == '\r' );
+}
+
+
+/* drops the bytes before the current record and reads some more after
+ * them, growing the buffer if the record fills it.  Returns -1 if memory
+ * ran out and -2 if reading failed. */
+
+static int fillBuffer( gedRECORDREADER_t *reader )
+{
+  size_t read;
+
+  if( reader->start > 0 ) {
+    memmove( reader->buffer, reader->buffer + reader->start, reader->length - reader->start );
+    reader->length -= reader->start;
+    reader->next -= reader->start;
+    reader->start = 0;
+  }
+
+  if( reader->size - reader->length < gcRECORDREADERCHUNK ) {
+    ofUI64_t  size = ( reader->size == 0 ) ? 4 * gcRECORDREADERCHUNK : reader->size * 2;
+    ofCHAR_t *buffer = (ofCHAR_t*)realloc( reader->buffer, size );
+
+    if( buffer == 0 ) {
+      return -1;
+    }
+    reader->buffer = buffer;
+    reader->size = size;
+  }
+
+  read = fread( reader->buffer + reader->length, 1, reader->size - reader->length, reader->file );
+  if( read == 0 ) {
+    if( ferror( reader->file ) ) {
+      return -2;
+    }
+    reader->eof = 1;
+  }
+  reader->length += read;
+  gedPROBE2( buffer__refill, read, reader->size );
+
+  return 0;
+}
+
+
+/* splits the line [line, end) into its level, xref, tag and value, the
+ * offsets relative to 'base'.  Returns -1 if it does not start with a
+ * level. */
+
+static int readNode( ofCHAR_t *base, ofCHAR_t *line, ofCHAR_t *end, gedNODE_t *node )
+{
+  ofCHAR_t *p = line;
+  ofCHAR_t *token;
+  int       level;
+
+  while( p < end && isBlank( *p ) ) {
+    p++;
+  }
+
+  if( p >= end || *p < '0' || *p > '9' ) {
+    return -1;
+  }
+
+  for( level = 0; p < end && *p >= '0' && *p <= '9'; p++ ) {
+    if( level < 1000 ) {
+      level = level * 10 + ( *p - '0' );
+    }
+  }
+
+  for( ; p < end && isBlank( *p ); p++ )
+    ;
+
+  node->xrefOffset = p - base;
+  node->xrefLength = 0;
+  if( p < end && *p == '@' ) {
+    for( token = p; p < end && !isBlank( *p ) && !isLineEnd( *p ); p++ )
+      ;
+    node->xrefLength = p - token;
+    for( ; p < end && isBlank( *p ); p++ )
+      ;
+  }
+
+  for( token = p; p < end && !isBlank( *p ) && !isLineEnd( *p ); p++ )
+    ;
+  node->tagOffset = token - base;
+  node->tagLength = p - token;
+
+  for( ; p < end && isBlank( *p ); p++ )
+    ;
+
+  node->valueOffset = p - base;
+  while( end > p && isLineEnd( end[ -1 ] ) ) {
+    end--;
+  }
+  node->valueLength = end - p;
+
+  node->level = level;
+  node->offset = line - base;
+
+  return level;
+}
+
+
+static gedNODE_t* addNode( gedRECORDREADER_t *reader )
+{
+  if( reader->count == reader->nodeSize ) {
+    ofUI32_t   size = ( reader->nodeSize == 0 ) ? 256 : reader->nodeSize * 2;
+    gedNODE_t *nodes = (gedNODE_t*)realloc( reader->nodes, size * sizeof( gedNODE_t ) );
+
+    if( nodes == 0 ) {
+      return 0;
+    }
+    reader->nodes = nodes;
+    reader->nodeSize = size;
+  }
+
+  return &reader->nodes[ reader->count ];
+}
+
+
+/* builds the tree of the record [start, next) */
+
+static int readNodes( gedRECORDREADER_t *reader )
+{
+  ofCHAR_t   *base = reader->buffer + reader->start;
+  ofCHAR_t   *end = reader->buffer + reader->next;
+  ofCHAR_t   *line;
+  ofCHAR_t   *next;
+  gedNODE_t  *node;
+  gedNODE_t  *nodes;
+  gedRECORD_t found;
+  ofUI32_t    parent;
+  ofUI32_t    i;
+  int         level;
+
+  reader->count = 0;
+
+  for( line = base; line < end; line = next ) {
+    next = (ofCHAR_t*)memchr( line, '\n', end - line );
+    next = ( next != 0 ) ? next + 1 : end;
+
+    node = addNode( reader );
+    if( node == 0 ) {
+      return -1;
+    }
+
+    level = readNode( base, line, next, node );
+    if( level < 0 ) {
+      continue;
+    }
+
+    nodes = reader->nodes;
+    if( reader->count == 0 ) {
+      if( !readGEDCOMLevel0( line, next, &found ) ) {
+        continue;
+      }
+      parent = gcNONODE;
+    } else {
+      for( parent = reader->count - 1; parent != gcNONODE && nodes[ parent ].level >= (ofUI32_t)level; ) {
+        parent = nodes[ parent ].parent;
+      }
+      if( parent == gcNONODE ) {
+        continue;
+      }
+    }
+
+    i = reader->count++;
+    node->end = next - base;
+    node->parent = parent;
+    node->firstChild = node->lastChild = node->next = gcNONODE;
+
+    if( parent != gcNONODE ) {
+      if( nodes[ parent ].lastChild != gcNONODE ) {
+        nodes[ nodes[ parent ].lastChild ].next = i;
+      } else {
+        nodes[ parent ].firstChild = i;
+      }
+      nodes[ parent ].lastChild = i;
+
+      for( ; parent != gcNONODE; parent = nodes[ parent ].parent ) {
+        nodes[ parent ].end = node->end;
+      }
+    }
+  }
+
+  return 0;
+}
+
+
+/* moves on to the next record.  Returns 1 if there is one, 0 at the end
+ * of the file, -1 if memory ran out and -2 if reading failed. */
+
+int readGEDCOMRecord( gedRECORDREADER_t *reader )
+{
+  gedRECORD_t found;
+  ofCHAR_t   *line;
+  ofCHAR_t   *next;
+  ofUI64_t    position;
+  int         rooted;
+  int         rc;
+
+  reader->generation++;
+  gedPROBE1( record__start, reader->records );
+
+  do {
+    reader->start = reader->next;
+    position = reader->start;
+    rooted = 0;
+
+    for( ;; ) {
+      line = reader->buffer + position;
+      next = ( position < reader->length ) ?
+             (ofCHAR_t*)memchr( line, '\n', reader->length - position ) : 0;
+
+      if( next == 0 && !reader->eof ) {
+        position -= reader->start;
+        rc = fillBuffer( reader );
+        if( rc != 0 ) {
+          return rc;
+        }
+        position += reader->start;
+        continue;
+      }
+
+      if( position == reader->length ) {
+        break;
+      }
+      next = ( next != 0 ) ? next + 1 : reader->buffer + reader->length;
+
+      if( readGEDCOMLevel0( line, next, &found ) ) {
+        if( rooted ) {
+          break;
+        }
+        rooted = 1;
+      }
+      position = next - reader->buffer;
+    }
+
+    reader->next = position;
+    if( reader->next == reader->start ) {
+      reader->count = 0;
+      return 0;
+    }
+  } while( !rooted );
+
+  if( reader->next - reader->start > 0xFFFFFFFFu ) {
+    return -1;
+  }
+
+  if( readNodes( reader ) != 0 ) {
+    return -1;
+  }
+  gedPROBE3( record__end, reader->records, reader->next - reader->start, reader->count );
+  reader->records++;
+
+  return 1;
+}
@@ -0,0 +1,82 @@
+/* -------------------------------------------------------------------------
+ * gedcom_stream.h -- Defines the interface for the record reader.
+ * Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+ * -------------------------------------------------------------------------
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ------------------------------------------------------------------------- */
+
+#ifndef __GEDSTREAM_H__
+#define __GEDSTREAM_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+
+#include "gedcom_types.h"
+
+/* reader constants */
+
+  #define gcRECORDREADERCHUNK  ( 64 * 1024 )  /* bytes read from the file at once */
+  #define gcNONODE             ( 0xFFFFFFFFu )
+
+/* types */
+
+typedef struct {
+  ofUI32_t level;
+  ofUI32_t offset;        /* the line, from the start of the record */
+  ofUI32_t end;           /* end of the last line of the subtree */
+  ofUI32_t xrefOffset;    /* xrefLength is 0 if there is none */
+  ofUI32_t xrefLength;
+  ofUI32_t tagOffset;
+  ofUI32_t tagLength;
+  ofUI32_t valueOffset;
+  ofUI32_t valueLength;
+  ofUI32_t parent;        /* node indexes, or gcNONODE */
+  ofUI32_t firstChild;
+  ofUI32_t lastChild;
+  ofUI32_t next;
+} gedNODE_t;
+
+typedef struct {
+  FILE      *file;
+  ofCHAR_t  *buffer;
+  ofUI64_t   size;
+  ofUI64_t   length;       /* bytes read into the buffer */
+  ofUI64_t   start;        /* the current record */
+  ofUI64_t   next;         /* where the next one starts */
+  int        eof;
+  gedNODE_t *nodes;        /* the lines of the current record; node 0 */
+  ofUI32_t   count;        /* is its level 0 line */
+  ofUI32_t   nodeSize;
+  ofUI64_t   records;
+  ofUI64_t   generation;   /* changes whenever the nodes are reused */
+} gedRECORDREADER_t;
+
+
+int openRecordReader( gedRECORDREADER_t *reader, const char *path );
+
+void closeRecordReader( gedRECORDREADER_t *reader );
+
+ofUI64_t getRecordReaderMemory( gedRECORDREADER_t *reader );
+
+int readGEDCOMRecord( gedRECORDREADER_t *reader );
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // __GEDSTREAM_H__
@@ -29,8 +29,10 @@ typedef signed char ofI8_t;
 typedef unsigned char ofUI8_t;
 typedef signed short int ofI16_t;
 typedef unsigned short int ofUI16_t;
-typedef signed long int ofI32_t;
-typedef unsigned long int ofUI32_t;
+typedef signed int ofI32_t;
+typedef unsigned int ofUI32_t;
+typedef signed long long ofI64_t;
+typedef unsigned long long ofUI64_t;
 
 typedef unsigned char ofCHAR_t;
 
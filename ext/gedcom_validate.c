@@ -0,0 +1,830 @@
+/* -------------------------------------------------------------------------
+ * gedcom_validate.c -- Defines the single pass structural validator.
+ * Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+ * -------------------------------------------------------------------------
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ------------------------------------------------------------------------- */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+#include "gedcom_types.h"
+#include "gedcom_ctype.h"
+#include "gedcom_date.h"
+#include "gedcom_record.h"
+#include "gedcom_chunk.h"
+#include "gedcom_validate.h"
+
+
+/* The validator checks every line of a file in one pass:
+ *
+ *   line_too_long     the line, without its line end, does not fit in
+ *                     maxLineLength bytes with the terminator
+ *   malformed_line    no level, a level of more than two digits, or no tag
+ *   level_jump        the level is more than one below the line before's
+ *   bad_xref          the xref of the line is not @ID@ (at most 22 bytes,
+ *                     ID without an @ and not starting with #)
+ *   duplicate_xref    the xref was defined on an earlier line
+ *   unknown_tag       not a 5.5.1 tag, a user tag (_TAG) or an extra tag
+ *   bad_pointer       a value that starts like a pointer and has no blank
+ *                     in it, but is not a well-formed xref
+ *   dangling_pointer  the first reference to an xref no line defines
+ *   bad_date          a DATE value parseGEDCOMDateText rejects
+ *
+ * The file is read in rounds of up to gcVALIDATECHUNK bytes per thread.
+ * The bytes read are cut before the last level 0 line and split into one
+ * chunk per thread, again at level 0 lines, so that no chunk needs the
+ * level of a line before it; the rest waits for the next round.  Each
+ * thread keeps its own xrefs and diagnostics, and once the file has been
+ * read they are merged, the lines counted from the start of the file and
+ * the diagnostics sorted by offset (and by code within a line). */
+
+
+/* the 5.5.1 tags, sorted */
+
+static const char *standardTags[] = {
+  "ABBR", "ADDR", "ADOP", "ADR1", "ADR2", "AFN", "AGE", "AGNC", "ALIA", "ANCE", "ANCI", "ANUL", "ASSO",
+  "AUTH", "BAPL", "BAPM", "BARM", "BASM", "BIRT", "BLES", "BLOB", "BURI", "CALN", "CAST", "CAUS", "CENS",
+  "CHAN", "CHAR", "CHIL", "CHR", "CHRA", "CITY", "CONC", "CONF", "CONL", "CONT", "COPR", "CORP", "CREM",
+  "CTRY", "DATA", "DATE", "DEAT", "DESC", "DESI", "DEST", "DIV", "DIVF", "DSCR", "EDUC", "EMAIL", "EMIG",
+  "ENDL", "ENGA", "EVEN", "FACT", "FAM", "FAMC", "FAMF", "FAMS", "FAX", "FCOM", "FILE", "FONE", "FORM",
+  "GEDC", "GIVN", "GRAD", "HEAD", "HUSB", "IDNO", "IMMI", "INDI", "LANG", "LATI", "LONG", "MAP", "MARB",
+  "MARC", "MARL", "MARR", "MARS", "MEDI", "NAME", "NATI", "NATU", "NCHI", "NICK", "NMR", "NOTE", "NPFX",
+  "NSFX", "OBJE", "OCCU", "ORDI", "ORDN", "PAGE", "PEDI", "PHON", "PLAC", "POST", "PROB", "PROP", "PUBL",
+  "QUAY", "REFN", "RELA", "RELI", "REPO", "RESI", "RESN", "RETI", "RFN", "RIN", "ROLE", "ROMN", "SEX",
+  "SLGC", "SLGS", "SOUR", "SPFX", "SSN", "STAE", "STAT", "SUBM", "SUBN", "SURN", "TEMP", "TEXT", "TIME",
+  "TITL", "TRLR", "TYPE", "VERS", "WIFE", "WILL", "WWW", 0 };
+
+#define gcMAXPACKEDTAG  ( 7 )
+
+typedef struct {
+  gedVALIDATOR_t   *validator;
+  gedVALIDWORKER_t *worker;
+  ofCHAR_t         *text;
+  ofUI64_t          length;
+  ofUI64_t          offset;      /* of the text in the file */
+  ofUI32_t          chunk;
+  ofUI64_t          lines;
+} gedVALIDWORK_t;
+
+
+/* tags of up to gcMAXPACKEDTAG bytes are looked up as one number: the
+ * bytes from the most significant end and the length in the low byte,
+ * which sorts them the way memcmp does */
+
+static ofUI64_t packTag( ofCHAR_t *tag, ofUI32_t length )
+{
+  ofUI64_t packed = 0;
+  ofUI32_t i;
+
+  for( i = 0; i < gcMAXPACKEDTAG; i++ ) {
+    packed = ( packed << 8 ) | ( i < length ? tag[ i ] : 0 );
+  }
+
+  return ( packed << 8 ) | length;
+}
+
+
+static int addPackedTag( gedVALIDATOR_t *validator, ofUI64_t packed )
+{
+  ofUI64_t *tags;
+  ofUI32_t  i;
+
+  for( i = validator->tagCount; i > 0 && validator->tags[ i-1 ] > packed; i-- )
+    ;
+  if( i > 0 && validator->tags[ i-1 ] == packed ) {
+    return 0;
+  }
+
+  tags = (ofUI64_t*)realloc( validator->tags, ( validator->tagCount + 1 ) * sizeof( ofUI64_t ) );
+  if( tags == 0 ) {
+    return -1;
+  }
+  validator->tags = tags;
+
+  memmove( tags + i + 1, tags + i, ( validator->tagCount - i ) * sizeof( ofUI64_t ) );
+  tags[ i ] = packed;
+  validator->tagCount++;
+
+  return 0;
+}
+
+
+static int isKnownTag( gedVALIDATOR_t *validator, ofCHAR_t *tag, ofUI32_t length )
+{
+  ofUI64_t packed;
+  ofUI32_t low;
+  ofUI32_t high;
+  ofUI32_t middle;
+
+  if( tag[ 0 ] == '_' ) {
+    return 1;
+  }
+
+  if( length > gcMAXPACKEDTAG ) {
+    for( low = 0; low < validator->longTagCount; low++ ) {
+      if( strlen( (char*)validator->longTags[ low ] ) == length &&
+          memcmp( validator->longTags[ low ], tag, length ) == 0 ) {
+        return 1;
+      }
+    }
+    return 0;
+  }
+
+  packed = packTag( tag, length );
+  low = 0;
+  high = validator->tagCount;
+
+  while( low < high ) {
+    middle = ( low + high ) / 2;
+    if( validator->tags[ middle ] < packed ) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+
+  return ( low < validator->tagCount && validator->tags[ low ] == packed );
+}
+
+
+/* xref tables */
+
+static void freeXrefTable( gedXREFTABLE_t *table )
+{
+  free( table->slots );
+  free( table->defined );
+  free( table->referenced );
+  free( table->firstDefinition );
+  free( table->firstReference );
+  memset( table, 0, sizeof( *table ) );
+}
+
+
+#define isXrefSet( bits, id )   ( ( ( bits )[ ( id ) / 64 ] >> ( ( id ) % 64 ) ) & 1 )
+#define setXref( bits, id )     ( ( bits )[ ( id ) / 64 ] |= 1ULL << ( ( id ) % 64 ) )
+
+
+static int growIds( gedXREFTABLE_t *table )
+{
+  ofUI32_t size = ( table->size == 0 ) ? 1024 : table->size * 2;
+  ofUI32_t words = table->size / 64;
+  void    *p;
+
+  if( ( p = realloc( table->firstDefinition, size * sizeof( gedVALIDPOS_t ) ) ) == 0 ) {
+    return -1;
+  }
+  table->firstDefinition = (gedVALIDPOS_t*)p;
+
+  if( ( p = realloc( table->firstReference, size * sizeof( gedVALIDPOS_t ) ) ) == 0 ) {
+    return -1;
+  }
+  table->firstReference = (gedVALIDPOS_t*)p;
+
+  if( ( p = realloc( table->defined, size / 64 * sizeof( ofUI64_t ) ) ) == 0 ) {
+    return -1;
+  }
+  table->defined = (ofUI64_t*)p;
+  memset( table->defined + words, 0, ( size / 64 - words ) * sizeof( ofUI64_t ) );
+
+  if( ( p = realloc( table->referenced, size / 64 * sizeof( ofUI64_t ) ) ) == 0 ) {
+    return -1;
+  }
+  table->referenced = (ofUI64_t*)p;
+  memset( table->referenced + words, 0, ( size / 64 - words ) * sizeof( ofUI64_t ) );
+
+  table->size = size;
+
+  return 0;
+}
+
+
+static int growSlots( gedXREFTABLE_t *table )
+{
+  ofUI32_t   count = ( table->slotCount == 0 ) ? 2048 : table->slotCount * 2;
+  gedXREF_t *slots;
+  ofUI32_t   slot;
+  ofUI32_t   i;
+
+  slots = (gedXREF_t*)calloc( count, sizeof( gedXREF_t ) );
+  if( slots == 0 ) {
+    return -1;
+  }
+
+  for( i = 0; i < table->slotCount; i++ ) {
+    if( table->slots[ i ].length != 0 ) {
+      for( slot = table->slots[ i ].hash & ( count - 1 ); slots[ slot ].length != 0; slot = ( slot + 1 ) & ( count - 1 ) )
+        ;
+      slots[ slot ] = table->slots[ i ];
+    }
+  }
+
+  free( table->slots );
+  table->slots = slots;
+  table->slotCount = count;
+
+  return 0;
+}
+
+
+/* finds the id of an xref of 3 to gcMAXXREFSIZE bytes, adding it if it is
+ * new.  Returns -1 if memory ran out. */
+
+static int internXref( gedXREFTABLE_t *table, ofCHAR_t *key, ofUI32_t length, ofUI32_t *id )
+{
+  gedXREF_t *xref;
+  ofUI32_t   hash;
+  ofUI32_t   slot;
+
+  if( ( table->count + 1 ) * 2 > table->slotCount && growSlots( table ) != 0 ) {
+    return -1;
+  }
+
+  hash = (ofUI32_t)hashGEDCOMBytes( key, length, 0 );
+
+  for( slot = hash & ( table->slotCount - 1 ); table->slots[ slot ].length != 0; slot = ( slot + 1 ) & ( table->slotCount - 1 ) ) {
+    xref = &table->slots[ slot ];
+    if( xref->hash == hash && xref->length == length && memcmp( xref->key, key, length ) == 0 ) {
+      *id = xref->id;
+      return 0;
+    }
+  }
+
+  if( table->count == table->size && growIds( table ) != 0 ) {
+    return -1;
+  }
+
+  xref = &table->slots[ slot ];
+  memcpy( xref->key, key, length );
+  xref->length = (ofUI8_t)length;
+  xref->hash = hash;
+  xref->id = table->count;
+
+  *id = table->count++;
+
+  return 0;
+}
+
+
+/* workers */
+
+static void freeWorker( gedVALIDWORKER_t *worker )
+{
+  freeXrefTable( &worker->table );
+  free( worker->diagnostics );
+  free( worker->text );
+  worker->diagnostics = 0;
+  worker->text = 0;
+  worker->count = worker->size = 0;
+  worker->textLength = worker->textSize = 0;
+}
+
+
+static int addDiagnostic( gedVALIDWORKER_t *worker, gedVALIDPOS_t *where, int code, ofCHAR_t *text, ofUI32_t length )
+{
+  gedDIAGNOSTIC_t *diagnostic;
+
+  if( worker->count == worker->size ) {
+    ofUI32_t         size = ( worker->size == 0 ) ? 64 : worker->size * 2;
+    gedDIAGNOSTIC_t *diagnostics = (gedDIAGNOSTIC_t*)realloc( worker->diagnostics, size * sizeof( gedDIAGNOSTIC_t ) );
+
+    if( diagnostics == 0 ) {
+      return -1;
+    }
+    worker->diagnostics = diagnostics;
+    worker->size = size;
+  }
+
+  if( length > gcMAXDIAGNOSTICTEXT ) {
+    length = gcMAXDIAGNOSTICTEXT;
+  }
+
+  if( worker->textLength + length > worker->textSize ) {
+    ofUI64_t  size = ( worker->textSize == 0 ) ? 4096 : worker->textSize * 2;
+    ofCHAR_t *text2 = (ofCHAR_t*)realloc( worker->text, size );
+
+    if( text2 == 0 ) {
+      return -1;
+    }
+    worker->text = text2;
+    worker->textSize = size;
+  }
+
+  diagnostic = &worker->diagnostics[ worker->count++ ];
+  diagnostic->where = *where;
+  diagnostic->code = code;
+  diagnostic->owner = worker->index;
+  diagnostic->textOffset = worker->textLength;
+  diagnostic->textLength = length;
+
+  if( length > 0 ) {
+    memcpy( worker->text + worker->textLength, text, length );
+    worker->textLength += length;
+  }
+
+  return 0;
+}
+
+
+static int isXref( ofCHAR_t *token, ofUI32_t length )
+{
+  if( length < 3 || length > gcMAXXREFSIZE || token[ 0 ] != '@' || token[ length-1 ] != '@' || token[ 1 ] == '#' ) {
+    return 0;
+  }
+
+  return ( memchr( token + 1, '@', length - 2 ) == 0 );
+}
+
+
+static int defineXref( gedVALIDWORKER_t *worker, ofCHAR_t *key, ofUI32_t length, gedVALIDPOS_t *where )
+{
+  gedXREFTABLE_t *table = &worker->table;
+  ofUI32_t        id;
+
+  if( internXref( table, key, length, &id ) != 0 ) {
+    return -1;
+  }
+
+  if( isXrefSet( table->defined, id ) ) {
+    return addDiagnostic( worker, where, gcdDUPLICATEXREF, key, length );
+  }
+
+  setXref( table->defined, id );
+  table->firstDefinition[ id ] = *where;
+
+  return 0;
+}
+
+
+static int referXref( gedVALIDWORKER_t *worker, ofCHAR_t *key, ofUI32_t length, gedVALIDPOS_t *where )
+{
+  gedXREFTABLE_t *table = &worker->table;
+  ofUI32_t        id;
+
+  if( internXref( table, key, length, &id ) != 0 ) {
+    return -1;
+  }
+
+  if( !isXrefSet( table->referenced, id ) ) {
+    setXref( table->referenced, id );
+    table->firstReference[ id ] = *where;
+  }
+
+  return 0;
+}
+
+
+/* checks the line [line, end), 'end' being past its line end.  'level'
+ * is the level of the line before, which this one's replaces if it has
+ * one.  Returns -1 if memory ran out. */
+
+static int validateLine( gedVALIDWORK_t *work, ofCHAR_t *line, ofCHAR_t *end, gedVALIDPOS_t *where, int *level )
+{
+  gedVALIDWORKER_t *worker = work->worker;
+  gedDATEVALUE_t    date;
+  ofCHAR_t         *p;
+  ofCHAR_t         *token;
+  int               digits;
+  int               value;
+  int               isDate;
+  int               rc = 0;
+
+  while( end > line && isGEDCOMClass( end[ -1 ], gccLINEEND ) ) {
+    end--;
+  }
+
+  if( (ofUI64_t)( end - line ) >= work->validator->maxLineLength ) {
+    rc |= addDiagnostic( worker, where, gcdLINETOOLONG, 0, 0 );
+  }
+
+  p = line + spanGEDCOMClass( line, end - line, gccBLANK );
+
+  for( value = 0, digits = 0; p < end && isGEDCOMClass( *p, gccDIGIT ); p++, digits++ ) {
+    if( digits < 2 ) {
+      value = value * 10 + ( *p - '0' );
+    }
+  }
+
+  if( digits == 0 || digits > 2 ) {
+    return rc | addDiagnostic( worker, where, gcdMALFORMEDLINE, 0, 0 );
+  }
+
+  if( value > *level + 1 ) {
+    rc |= addDiagnostic( worker, where, gcdLEVELJUMP, 0, 0 );
+  }
+  *level = value;
+
+  if( p >= end || !isGEDCOMClass( *p, gccBLANK ) ) {
+    return rc | addDiagnostic( worker, where, gcdMALFORMEDLINE, 0, 0 );
+  }
+  p += spanGEDCOMClass( p, end - p, gccBLANK );
+
+  if( p < end && *p == '@' ) {
+    for( token = p; p < end && !isGEDCOMClass( *p, gccBLANK ); p++ )
+      ;
+    if( isXref( token, p - token ) ) {
+      rc |= defineXref( worker, token, p - token, where );
+    } else {
+      rc |= addDiagnostic( worker, where, gcdBADXREF, token, p - token );
+    }
+    p += spanGEDCOMClass( p, end - p, gccBLANK );
+  }
+
+  for( token = p; p < end && !isGEDCOMClass( *p, gccBLANK ); p++ )
+    ;
+  if( p == token ) {
+    return rc | addDiagnostic( worker, where, gcdMALFORMEDLINE, 0, 0 );
+  }
+
+  if( !isKnownTag( work->validator, token, p - token ) ) {
+    rc |= addDiagnostic( worker, where, gcdUNKNOWNTAG, token, p - token );
+  }
+
+  isDate = ( p - token == 4 && memcmp( token, "DATE", 4 ) == 0 );
+  p += spanGEDCOMClass( p, end - p, gccBLANK );
+
+  /* a value that starts with @ but not @@ or @# and has no blank in it is
+   * taken for a pointer; anything else is text */
+
+  if( end - p >= 2 && p[ 0 ] == '@' && p[ 1 ] != '@' && p[ 1 ] != '#' ) {
+    for( token = p; token < end && !isGEDCOMClass( *token, gccBLANK ); token++ )
+      ;
+    if( token == end ) {
+      if( isXref( p, end - p ) ) {
+        rc |= referXref( worker, p, end - p, where );
+      } else {
+        rc |= addDiagnostic( worker, where, gcdBADPOINTER, p, end - p );
+      }
+    }
+  }
+
+  if( isDate && parseGEDCOMDateText( p, end - p, &date ) != 0 ) {
+    rc |= addDiagnostic( worker, where, gcdBADDATE, p, end - p );
+  }
+
+  return rc;
+}
+
+
+static void* validateChunk( void *data )
+{
+  gedVALIDWORK_t *work = (gedVALIDWORK_t*)data;
+  ofCHAR_t       *end = work->text + work->length;
+  ofCHAR_t       *line;
+  ofCHAR_t       *next;
+  gedVALIDPOS_t   where;
+  int             level = -1;
+
+  where.chunk = work->chunk;
+  where.line = 0;
+
+  for( line = work->text; line < end && !work->worker->failed; line = next ) {
+    next = (ofCHAR_t*)memchr( line, '\n', end - line );
+    next = ( next != 0 ) ? next + 1 : end;
+
+    where.offset = work->offset + ( line - work->text );
+    if( validateLine( work, line, next, &where, &level ) != 0 ) {
+      work->worker->failed = 1;
+    }
+    where.line++;
+  }
+
+  work->lines = where.line;
+
+  return 0;
+}
+
+
+static int addChunkLines( gedVALIDATOR_t *validator, ofUI64_t lines )
+{
+  if( validator->chunkCount == validator->chunkSize ) {
+    ofUI32_t  size = ( validator->chunkSize == 0 ) ? 256 : validator->chunkSize * 2;
+    ofUI64_t *chunkLines = (ofUI64_t*)realloc( validator->chunkLines, size * sizeof( ofUI64_t ) );
+
+    if( chunkLines == 0 ) {
+      return -1;
+    }
+    validator->chunkLines = chunkLines;
+    validator->chunkSize = size;
+  }
+
+  validator->chunkLines[ validator->chunkCount++ ] = lines;
+
+  return 0;
+}
+
+
+/* merges the xrefs of every worker into the last one, which reports the
+ * definitions that were not the first of the file and the references to
+ * xrefs that are never defined */
+
+static int mergeXrefs( gedVALIDATOR_t *validator )
+{
+  gedVALIDWORKER_t *merger = &validator->workers[ gcMAXVALIDATETHREADS ];
+  gedXREFTABLE_t   *all = &merger->table;
+  gedXREFTABLE_t   *table;
+  gedXREF_t        *xref;
+  gedVALIDPOS_t    *later;
+  ofUI32_t          slot;
+  ofUI32_t          id;
+  ofUI32_t          merged;
+  int               t;
+
+  for( t = 0; t < validator->threads; t++ ) {
+    table = &validator->workers[ t ].table;
+
+    for( slot = 0; slot < table->slotCount; slot++ ) {
+      xref = &table->slots[ slot ];
+      if( xref->length == 0 ) {
+        continue;
+      }
+      id = xref->id;
+
+      if( internXref( all, xref->key, xref->length, &merged ) != 0 ) {
+        return -1;
+      }
+
+      if( isXrefSet( table->defined, id ) ) {
+        if( !isXrefSet( all->defined, merged ) ) {
+          setXref( all->defined, merged );
+          all->firstDefinition[ merged ] = table->firstDefinition[ id ];
+        } else {
+          later = &table->firstDefinition[ id ];
+          if( later->offset < all->firstDefinition[ merged ].offset ) {
+            gedVALIDPOS_t first = *later;
+
+            *later = all->firstDefinition[ merged ];
+            all->firstDefinition[ merged ] = first;
+          }
+          if( addDiagnostic( merger, later, gcdDUPLICATEXREF, xref->key, xref->length ) != 0 ) {
+            return -1;
+          }
+        }
+      }
+
+      if( isXrefSet( table->referenced, id ) ) {
+        if( !isXrefSet( all->referenced, merged ) ||
+            table->firstReference[ id ].offset < all->firstReference[ merged ].offset ) {
+          all->firstReference[ merged ] = table->firstReference[ id ];
+        }
+        setXref( all->referenced, merged );
+      }
+    }
+
+    freeXrefTable( table );
+  }
+
+  for( slot = 0; slot < all->slotCount; slot++ ) {
+    xref = &all->slots[ slot ];
+    if( xref->length != 0 && isXrefSet( all->referenced, xref->id ) && !isXrefSet( all->defined, xref->id ) &&
+        addDiagnostic( merger, &all->firstReference[ xref->id ], gcdDANGLINGPOINTER, xref->key, xref->length ) != 0 ) {
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+
+static int compareDiagnostics( const void *a, const void *b )
+{
+  const gedDIAGNOSTIC_t *d1 = (const gedDIAGNOSTIC_t*)a;
+  const gedDIAGNOSTIC_t *d2 = (const gedDIAGNOSTIC_t*)b;
+
+  if( d1->where.offset != d2->where.offset ) {
+    return ( d1->where.offset < d2->where.offset ) ? -1 : 1;
+  }
+
+  return (int)d1->code - (int)d2->code;
+}
+
+
+/* merges the xrefs, gathers every diagnostic with its line counted from
+ * the start of the file (from 1), and sorts them */
+
+static int finishValidator( gedVALIDATOR_t *validator )
+{
+  gedVALIDWORKER_t *worker;
+  gedDIAGNOSTIC_t  *diagnostic;
+  ofUI64_t          lines;
+  ofUI64_t          count;
+  ofUI32_t          i;
+  int               t;
+
+  if( mergeXrefs( validator ) != 0 ) {
+    return -1;
+  }
+
+  for( i = 0, lines = 0; i < validator->chunkCount; i++ ) {
+    count = validator->chunkLines[ i ];
+    validator->chunkLines[ i ] = lines;
+    lines += count;
+  }
+
+  for( t = 0, count = 0; t <= gcMAXVALIDATETHREADS; t++ ) {
+    count += validator->workers[ t ].count;
+  }
+
+  if( count > 0 ) {
+    validator->diagnostics = (gedDIAGNOSTIC_t*)malloc( count * sizeof( gedDIAGNOSTIC_t ) );
+    if( validator->diagnostics == 0 ) {
+      return -1;
+    }
+  }
+
+  for( t = 0; t <= gcMAXVALIDATETHREADS; t++ ) {
+    worker = &validator->workers[ t ];
+    for( i = 0; i < worker->count; i++ ) {
+      diagnostic = &validator->diagnostics[ validator->count++ ];
+      *diagnostic = worker->diagnostics[ i ];
+      diagnostic->where.line += validator->chunkLines[ diagnostic->where.chunk ] + 1;
+    }
+  }
+
+  qsort( validator->diagnostics, validator->count, sizeof( gedDIAGNOSTIC_t ), compareDiagnostics );
+
+  return 0;
+}
+
+
+/* opens the file at 'path' for a validator that checks it on up to
+ * 'threads' threads.  Returns -1 if the file cannot be opened (see errno)
+ * and -2 if memory ran out. */
+
+int openValidator( gedVALIDATOR_t *validator, const char *path, int threads )
+{
+  int i;
+
+  memset( validator, 0, sizeof( *validator ) );
+
+#ifdef HAVE_PTHREAD_H
+  if( threads > gcMAXVALIDATETHREADS ) {
+    threads = gcMAXVALIDATETHREADS;
+  }
+#else
+  threads = 1;
+#endif
+  if( threads < 1 ) {
+    threads = 1;
+  }
+  validator->threads = threads;
+  validator->maxLineLength = gcMAXVALIDATELINE;
+
+  for( i = 0; i <= gcMAXVALIDATETHREADS; i++ ) {
+    validator->workers[ i ].index = i;
+  }
+
+  for( i = 0; standardTags[ i ] != 0; i++ ) {
+    if( addPackedTag( validator, packTag( (ofCHAR_t*)standardTags[ i ], strlen( standardTags[ i ] ) ) ) != 0 ) {
+      closeValidator( validator );
+      return -2;
+    }
+  }
+
+  if( openChunkReader( &validator->reader, path ) != 0 ) {
+    i = errno;
+    closeValidator( validator );
+    errno = i;
+    return -1;
+  }
+
+  return 0;
+}
+
+
+/* makes 'tag' (1 to gcMAXEXTRATAGSIZE - 1 bytes) a known tag.  Returns -1
+ * if memory ran out. */
+
+int addValidatorTag( gedVALIDATOR_t *validator, ofCHAR_t *tag, ofUI32_t length )
+{
+  ofCHAR_t (*longTags)[ gcMAXEXTRATAGSIZE ];
+
+  if( length <= gcMAXPACKEDTAG ) {
+    return addPackedTag( validator, packTag( tag, length ) );
+  }
+
+  longTags = (ofCHAR_t(*)[ gcMAXEXTRATAGSIZE ])realloc( validator->longTags,
+                                                          ( validator->longTagCount + 1 ) * gcMAXEXTRATAGSIZE );
+  if( longTags == 0 ) {
+    return -1;
+  }
+  validator->longTags = longTags;
+
+  memcpy( longTags[ validator->longTagCount ], tag, length );
+  longTags[ validator->longTagCount++ ][ length ] = '\0';
+
+  return 0;
+}
+
+
+/* reads the next round of the file and checks it.  Returns 1 if there is
+ * more to read, 0 once the whole file has been checked and the
+ * diagnostics are ready, -1 if memory ran out and -2 if reading failed
+ * (see errnum). */
+
+int runValidatorRound( gedVALIDATOR_t *validator )
+{
+  gedVALIDWORK_t work[ gcMAXVALIDATETHREADS ];
+#ifdef HAVE_PTHREAD_H
+  pthread_t      workers[ gcMAXVALIDATETHREADS ];
+  int            started[ gcMAXVALIDATETHREADS ];
+#endif
+  ofCHAR_t      *starts[ gcMAXVALIDATETHREADS + 1 ];
+  int            failed;
+  int            rc;
+  int            t;
+
+  rc = readChunks( &validator->reader, gcVALIDATECHUNK, validator->threads, starts );
+  if( rc != 0 ) {
+    return rc;
+  }
+
+  for( t = 0; t < validator->threads; t++ ) {
+    memset( &work[ t ], 0, sizeof( work[ t ] ) );
+    work[ t ].validator = validator;
+    work[ t ].worker = &validator->workers[ t ];
+    work[ t ].text = starts[ t ];
+    work[ t ].length = starts[ t + 1 ] - starts[ t ];
+    work[ t ].offset = validator->reader.offset + ( starts[ t ] - validator->reader.buffer );
+    work[ t ].chunk = validator->chunkCount + t;
+  }
+
+#ifdef HAVE_PTHREAD_H
+  for( t = 1; t < validator->threads; t++ ) {
+    started[ t ] = ( pthread_create( &workers[ t ], 0, validateChunk, &work[ t ] ) == 0 );
+  }
+  validateChunk( &work[ 0 ] );
+  for( t = 1; t < validator->threads; t++ ) {
+    if( started[ t ] ) {
+      pthread_join( workers[ t ], 0 );
+    } else {
+      validateChunk( &work[ t ] );
+    }
+  }
+#else
+  validateChunk( &work[ 0 ] );
+#endif
+
+  failed = 0;
+  for( t = 0; t < validator->threads; t++ ) {
+    failed |= validator->workers[ t ].failed;
+    failed |= addChunkLines( validator, work[ t ].lines );
+  }
+  if( failed ) {
+    return -1;
+  }
+
+  if( skipChunks( &validator->reader ) == 0 ) {
+    return ( finishValidator( validator ) != 0 ) ? -1 : 0;
+  }
+
+  return 1;
+}
+
+
+void closeValidator( gedVALIDATOR_t *validator )
+{
+  int i;
+
+  closeChunkReader( &validator->reader );
+
+  for( i = 0; i <= gcMAXVALIDATETHREADS; i++ ) {
+    freeWorker( &validator->workers[ i ] );
+  }
+
+  free( validator->tags );
+  free( validator->longTags );
+  free( validator->chunkLines );
+  free( validator->diagnostics );
+  validator->tags = 0;
+  validator->longTags = 0;
+  validator->chunkLines = 0;
+  validator->diagnostics = 0;
+  validator->tagCount = validator->longTagCount = 0;
+  validator->chunkCount = validator->chunkSize = validator->count = 0;
+}
+
+
+/* the text kept with a diagnostic (its length is textLength) */
+
+ofCHAR_t* getDiagnosticText( gedVALIDATOR_t *validator, gedDIAGNOSTIC_t *diagnostic )
+{
+  return validator->workers[ diagnostic->owner ].text + diagnostic->textOffset;
+}
@@ -0,0 +1,142 @@
+/* -------------------------------------------------------------------------
+ * gedcom_validate.h -- Defines the interface for the structural validator.
+ * Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+ * -------------------------------------------------------------------------
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ------------------------------------------------------------------------- */
+
+#ifndef __GEDVALIDATE_H__
+#define __GEDVALIDATE_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+
+#include "gedcom_types.h"
+#include "gedcom_chunk.h"
+
+/* validator constants */
+
+  #define gcMAXVALIDATETHREADS   ( 16 )
+  #define gcMAXVALIDATELINE      ( 255 )          /* including the terminator, as in 5.5 */
+  #define gcVALIDATECHUNK        ( 1024 * 1024 )  /* bytes read per thread and round */
+  #define gcMAXXREFSIZE          ( 22 )           /* the @s included, as in 5.5 */
+  #define gcMAXDIAGNOSTICTEXT    ( 64 )           /* bytes of the line kept with a diagnostic */
+  #define gcMAXEXTRATAGSIZE      ( 32 )
+
+/* diagnostic codes, in the order they are given for one line */
+
+  #define gcdLINETOOLONG         ( 0 )
+  #define gcdMALFORMEDLINE       ( 1 )
+  #define gcdLEVELJUMP           ( 2 )
+  #define gcdBADXREF             ( 3 )
+  #define gcdDUPLICATEXREF       ( 4 )
+  #define gcdUNKNOWNTAG          ( 5 )
+  #define gcdBADPOINTER          ( 6 )
+  #define gcdDANGLINGPOINTER     ( 7 )
+  #define gcdBADDATE             ( 8 )
+
+/* types */
+
+/* where a line is.  Lines are counted from the first line of the chunk
+ * they were read in until the validator is done, since chunks are read in
+ * parallel. */
+
+typedef struct {
+  ofUI64_t offset;
+  ofUI64_t line;
+  ofUI32_t chunk;
+} gedVALIDPOS_t;
+
+typedef struct {
+  gedVALIDPOS_t where;
+  ofUI32_t      code;
+  ofUI32_t      owner;       /* the worker whose text pool holds the text */
+  ofUI64_t      textOffset;
+  ofUI32_t      textLength;  /* 0 if there is no text */
+} gedDIAGNOSTIC_t;
+
+/* an xref and its id; the key is kept in the hash table itself so that a
+ * lookup only touches one slot.  A length of 0 marks an empty slot. */
+
+typedef struct {
+  ofCHAR_t key[ gcMAXXREFSIZE ];
+  ofUI8_t  length;
+  ofUI32_t hash;
+  ofUI32_t id;
+} gedXREF_t;
+
+/* the xrefs a worker saw, numbered in the order it first saw them.  Which
+ * of them were defined and which referenced is kept in two bitmaps by id;
+ * the first definition and reference are only looked at for those that
+ * have one. */
+
+typedef struct {
+  gedXREF_t       *slots;       /* open addressing, at most half full */
+  ofUI32_t         slotCount;   /* a power of two */
+  ofUI32_t         count;
+  ofUI32_t         size;        /* ids the arrays below have room for */
+  ofUI64_t        *defined;
+  ofUI64_t        *referenced;
+  gedVALIDPOS_t   *firstDefinition;
+  gedVALIDPOS_t   *firstReference;
+} gedXREFTABLE_t;
+
+typedef struct {
+  gedXREFTABLE_t   table;
+  gedDIAGNOSTIC_t *diagnostics;
+  ofUI32_t         count;
+  ofUI32_t         size;
+  ofCHAR_t        *text;
+  ofUI64_t         textLength;
+  ofUI64_t         textSize;
+  ofUI32_t         index;
+  int              failed;
+} gedVALIDWORKER_t;
+
+typedef struct {
+  gedCHUNKREADER_t  reader;
+  int               threads;
+  ofUI32_t          maxLineLength;
+  ofUI64_t         *tags;          /* known tags of up to 7 bytes, packed and sorted */
+  ofUI32_t          tagCount;
+  ofCHAR_t        (*longTags)[ gcMAXEXTRATAGSIZE ];
+  ofUI32_t          longTagCount;
+  ofUI64_t         *chunkLines;    /* the lines of each chunk read */
+  ofUI32_t          chunkCount;
+  ofUI32_t          chunkSize;
+  gedVALIDWORKER_t  workers[ gcMAXVALIDATETHREADS + 1 ];  /* the last merges the others */
+  gedDIAGNOSTIC_t  *diagnostics;   /* all of them, by offset, once done */
+  ofUI32_t          count;
+} gedVALIDATOR_t;
+
+
+int openValidator( gedVALIDATOR_t *validator, const char *path, int threads );
+
+int addValidatorTag( gedVALIDATOR_t *validator, ofCHAR_t *tag, ofUI32_t length );
+
+int runValidatorRound( gedVALIDATOR_t *validator );
+
+void closeValidator( gedVALIDATOR_t *validator );
+
+ofCHAR_t* getDiagnosticText( gedVALIDATOR_t *validator, gedDIAGNOSTIC_t *diagnostic );
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // __GEDVALIDATE_H__
@@ -0,0 +1,303 @@
+/* -------------------------------------------------------------------------
+ * gedcom_writer.c -- Defines the GEDCOM line writer.
+ * Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+ * -------------------------------------------------------------------------
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ------------------------------------------------------------------------- */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "gedcom_types.h"
+#include "gedcom_date.h"
+#include "gedcom_writer.h"
+
+
+/* lines are formatted straight into one large buffer, which is handed to
+ * the flush callback whenever the next line would not fit.  Values are
+ * copied out of the caller's text once, a CONC or CONT line at a time. */
+
+int initWriter( gedWRITER_t *writer, int lineLimit, gedWRITERFLUSH_t flush, void *context )
+{
+  if( lineLimit < gcMINLINELENGTH ) {
+    lineLimit = gcMINLINELENGTH;
+  }
+
+  writer->buffer = (ofCHAR_t*)malloc( gcWRITERBUFFERSIZE );
+  writer->length = 0;
+  writer->size = ( writer->buffer != 0 ) ? gcWRITERBUFFERSIZE : 0;
+  writer->lineLimit = lineLimit;
+  writer->lines = 0;
+  writer->flush = flush;
+  writer->context = context;
+
+  return ( writer->buffer != 0 ) ? 0 : -1;
+}
+
+
+void freeWriter( gedWRITER_t *writer )
+{
+  free( writer->buffer );
+  writer->buffer = 0;
+  writer->length = writer->size = 0;
+}
+
+
+/* the bytes allocated by the writer, not counting the writer itself */
+
+ofUI64_t getWriterMemory( gedWRITER_t *writer )
+{
+  return writer->size;
+}
+
+
+int flushWriter( gedWRITER_t *writer )
+{
+  if( writer->length > 0 ) {
+    if( writer->flush( writer->context, writer->buffer, writer->length ) != 0 ) {
+      return -1;
+    }
+    writer->length = 0;
+  }
+
+  return 0;
+}
+
+
+/* makes room for 'length' more bytes, flushing (or, for a line bigger than
+ * the whole buffer, growing) as needed */
+
+static int reserve( gedWRITER_t *writer, ofUI32_t length )
+{
+  if( writer->length + length <= writer->size ) {
+    return 0;
+  }
+
+  if( flushWriter( writer ) != 0 ) {
+    return -1;
+  }
+
+  if( length > writer->size ) {
+    ofCHAR_t *buffer = (ofCHAR_t*)realloc( writer->buffer, length );
+
+    if( buffer == 0 ) {
+      return -1;
+    }
+    writer->buffer = buffer;
+    writer->size = length;
+  }
+
+  return 0;
+}
+
+
+static int formatLevel( int level, ofCHAR_t *text )
+{
+  ofCHAR_t digits[ 12 ];
+  int      count;
+  int      i;
+
+  if( level < 0 ) {
+    level = 0;
+  }
+
+  count = 0;
+  do {
+    digits[ count++ ] = '0' + level % 10;
+    level /= 10;
+  } while( level > 0 );
+
+  for( i = 0; i < count; i++ ) {
+    text[ i ] = digits[ count - 1 - i ];
+  }
+
+  return count;
+}
+
+
+static int emitLine( gedWRITER_t *writer, int level, ofCHAR_t *xref, ofCHAR_t *tag,
+                     ofCHAR_t *value, ofUI32_t length )
+{
+  ofCHAR_t  prefix[ 12 ];
+  int       prefixLength;
+  int       xrefLength;
+  int       tagLength;
+  ofCHAR_t *out;
+
+  prefixLength = formatLevel( level, prefix );
+  xrefLength = ( xref != 0 ) ? strlen( (char*)xref ) : 0;
+  tagLength = strlen( (char*)tag );
+
+  if( reserve( writer, prefixLength + xrefLength + tagLength + length + 3 ) != 0 ) {
+    return -1;
+  }
+
+  out = writer->buffer + writer->length;
+
+  memcpy( out, prefix, prefixLength );
+  out += prefixLength;
+
+  if( xrefLength > 0 ) {
+    *out++ = ' ';
+    memcpy( out, xref, xrefLength );
+    out += xrefLength;
+  }
+
+  *out++ = ' ';
+  memcpy( out, tag, tagLength );
+  out += tagLength;
+
+  if( length > 0 ) {
+    *out++ = ' ';
+    memcpy( out, value, length );
+    out += length;
+  }
+
+  *out++ = '\n';
+
+  writer->length = out - writer->buffer;
+  writer->lines++;
+
+  return 0;
+}
+
+
+/* how much of 'value' fits on a line with 'room' bytes for it.  A split
+ * is moved back so that it does not land inside a UTF-8 sequence or next
+ * to a space, which some readers strip from CONC lines. */
+
+static ofUI32_t splitPoint( ofCHAR_t *value, ofUI32_t length, ofUI32_t room )
+{
+  ofUI32_t split;
+
+  if( length <= room ) {
+    return length;
+  }
+
+  for( split = room; split > room / 2; split-- ) {
+    if( ( value[ split ] & 0xC0 ) != 0x80 && value[ split ] != ' ' && value[ split-1 ] != ' ' ) {
+      return split;
+    }
+  }
+
+  for( split = room; split > 1 && ( value[ split ] & 0xC0 ) == 0x80; split-- )
+    ;
+
+  return split;
+}
+
+
+static int levelWidth( int level )
+{
+  int width;
+
+  for( width = 1; level >= 10; width++ ) {
+    level /= 10;
+  }
+
+  return width;
+}
+
+
+/* writes one line of a value, carrying on with CONC lines at 'concLevel'
+ * when it does not fit in the line length limit */
+
+static int writeSegment( gedWRITER_t *writer, int level, ofCHAR_t *xref, ofCHAR_t *tag,
+                         ofCHAR_t *value, ofUI32_t length, int concLevel )
+{
+  ofUI32_t split;
+  int      used;
+
+  /* level, tag, two blanks and the terminator, plus the xref and a blank */
+
+  used = levelWidth( level ) + strlen( (char*)tag ) + 3;
+  if( xref != 0 ) {
+    used += strlen( (char*)xref ) + 1;
+  }
+
+  split = splitPoint( value, length, ( writer->lineLimit > used ) ? writer->lineLimit - used : 1 );
+  if( emitLine( writer, level, xref, tag, value, split ) != 0 ) {
+    return -1;
+  }
+
+  used = levelWidth( concLevel ) + 4 + 3;
+
+  while( split < length ) {
+    value += split;
+    length -= split;
+
+    split = splitPoint( value, length, writer->lineLimit - used );
+    if( emitLine( writer, concLevel, 0, (ofCHAR_t*)"CONC", value, split ) != 0 ) {
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+
+/* writes "level [xref] tag [value]".  Each line break in the value starts
+ * a CONT line, and lines over the limit are split into CONC lines; both
+ * are one level below the first line. */
+
+int writeGEDCOMLine( gedWRITER_t *writer, int level, ofCHAR_t *xref, ofCHAR_t *tag,
+                     ofCHAR_t *value, ofUI32_t length )
+{
+  ofCHAR_t *end;
+  ofUI32_t  segment;
+  int       first;
+
+  if( value == 0 ) {
+    length = 0;
+  }
+
+  for( first = 1; ; first = 0 ) {
+    end = ( length > 0 ) ? (ofCHAR_t*)memchr( value, '\n', length ) : 0;
+    segment = ( end != 0 ) ? end - value : length;
+
+    /* a CR LF line break counts as one */
+
+    if( end != 0 && segment > 0 && value[ segment-1 ] == '\r' ) {
+      segment--;
+    }
+
+    if( first ) {
+      if( writeSegment( writer, level, xref, tag, value, segment, level + 1 ) != 0 ) {
+        return -1;
+      }
+    } else if( writeSegment( writer, level + 1, 0, (ofCHAR_t*)"CONT", value, segment, level + 1 ) != 0 ) {
+      return -1;
+    }
+
+    if( end == 0 ) {
+      break;
+    }
+
+    length -= end + 1 - value;
+    value = end + 1;
+  }
+
+  return 0;
+}
+
+
+int writeGEDCOMDate( gedWRITER_t *writer, int level, ofCHAR_t *tag, gedDATEVALUE_t *date )
+{
+  ofCHAR_t text[ gcMAXDATETEXTSIZE ];
+
+  buildGEDCOMDateText( date, text );
+
+  return writeGEDCOMLine( writer, level, 0, tag, text, strlen( (char*)text ) );
+}
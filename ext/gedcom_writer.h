@@ -0,0 +1,70 @@
+/* -------------------------------------------------------------------------
+ * gedcom_writer.h -- Defines the interface for the GEDCOM line writer.
+ * Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+ * -------------------------------------------------------------------------
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ * ------------------------------------------------------------------------- */
+
+#ifndef __GEDWRITER_H__
+#define __GEDWRITER_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "gedcom_types.h"
+#include "gedcom_date.h"
+
+/* writer constants */
+
+  #define gcWRITERBUFFERSIZE   ( 65536 )
+  #define gcMAXLINELENGTH      ( 255 )   /* including the terminator, as in 5.5 */
+  #define gcMINLINELENGTH      ( 32 )
+
+/* types */
+
+/* called with each full buffer; returns 0, or -1 to fail the write */
+
+typedef int (*gedWRITERFLUSH_t)( void *context, ofCHAR_t *data, ofUI32_t length );
+
+typedef struct {
+  ofCHAR_t        *buffer;
+  ofUI32_t         length;
+  ofUI32_t         size;
+  int              lineLimit;
+  ofUI32_t         lines;
+  gedWRITERFLUSH_t flush;
+  void            *context;
+} gedWRITER_t;
+
+
+int initWriter( gedWRITER_t *writer, int lineLimit, gedWRITERFLUSH_t flush, void *context );
+
+void freeWriter( gedWRITER_t *writer );
+
+ofUI64_t getWriterMemory( gedWRITER_t *writer );
+
+int writeGEDCOMLine( gedWRITER_t *writer, int level, ofCHAR_t *xref, ofCHAR_t *tag,
+                     ofCHAR_t *value, ofUI32_t length );
+
+int writeGEDCOMDate( gedWRITER_t *writer, int level, ofCHAR_t *tag, gedDATEVALUE_t *date );
+
+int flushWriter( gedWRITER_t *writer );
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // __GEDWRITER_H__
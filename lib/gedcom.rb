@@ -17,13 +17,57 @@
 # Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 # -------------------------------------------------------------------------
 
-#require '_gedcom'
-require 'gedcom_date'
-
 module GEDCOM
+  # Freezes a table constant all the way down, so that Ractors other than
+  # the main one can read it.
+  def GEDCOM.shareable( object )
+    defined?( Ractor ) ? Ractor.make_shareable( object ) : object.freeze
+  end
+
+  # The C extension (ext/) and the pure-Ruby files below implement the same
+  # date parser, indexes, duplicate finder, writer, record scanner and
+  # reader, event exporter and path queries.  The extension is used when it
+  # can be loaded, from the load path or from an in-place build in ext/; the
+  # GEDCOM_BACKEND environment variable set to "ruby" or "native" picks one
+  # explicitly ("native" fails if the extension cannot be loaded).
+  RUBY_FILES = GEDCOM.shareable( [ 'gedcom_date', 'gedcom_anniversary', 'gedcom_name', 'gedcom_dedupe',
+                                  'gedcom_writer', 'gedcom_record', 'gedcom_export', 'gedcom_query',
+                                  'gedcom_stream', 'gedcom_pipeline', 'gedcom_validate',
+                                  'gedcom_diff', 'gedcom_sqlite', 'gedcom_stats',
+                                  'gedcom_datecolumn' ] )
+
+  # Returns :native or :ruby, whichever implementation was loaded.  It is
+  # picked once, when gedcom.rb is required, and GEDCOM_BACKEND is the only
+  # way to change it.
+  def GEDCOM.backend
+    @backend
+  end
+
+  # Loads the backend +requested+ ("ruby", "native" or "" for either) at
+  # require time.  Loading the other one on top of it would mix the two.
+  def GEDCOM.load_backend( requested )
+    if requested != "ruby"
+      begin
+        begin
+          require '_gedcom'
+        rescue LoadError
+          require File.expand_path( '../ext/_gedcom', File.dirname( __FILE__ ) )
+        end
+        return @backend = :native
+      rescue LoadError
+        raise if requested == "native"
+      end
+    end
+
+    RUBY_FILES.each { |file| require file }
+    @backend = :ruby
+  end
+
+  load_backend( ( ENV[ "GEDCOM_BACKEND" ] || "" ).downcase )
+  private_class_method :load_backend
 
   # Possibly a better way to do this?
-  VERSION = "0.0.1"
+  VERSION = "0.0.1".freeze
 	
   class Parser
     def defaultHandler( data, cookie, parm )
@@ -33,6 +77,35 @@ module GEDCOM
       @cookie = cookie
       @pre_handler = Hash.new( [ method( "defaultHandler" ), nil ] )
       @post_handler = Hash.new( [ method( "defaultHandler" ), nil ] )
+      @batch_size = nil
+      @pre_batches = {}
+      @post_batches = {}
+      @timing = false
+      @count_dates = false
+      @stats = ParserStats.new
+    end
+
+    attr_reader :batch_size
+
+    # The ParserStats of the parse running or last run
+    attr_reader :stats
+
+    # Splits the time of each parse between the handlers and the rest
+    # (see ParserStats)
+    attr_accessor :timing
+
+    # Reads the value of each DATE line as a GEDCOM::Date and counts the
+    # outcomes (see ParserStats)
+    attr_accessor :count_dates
+
+    # Makes the handlers get an Array of the data of up to +size+ lines of
+    # their context at a time rather than a call per line (nil turns it
+    # off).  What is left over is handed over at the end of the parse,
+    # pre-handlers first, so handlers of different contexts no longer see
+    # the lines in file order.
+    def batch_size=( size )
+      raise ArgumentError, "batch size must be at least 1" if size && size < 1
+      @batch_size = size
     end
 
     def setPreHandler( context, func, parm = nil )
@@ -60,27 +133,161 @@ module GEDCOM
     # handlers are called.
 
     def parse( file )
-      ctxStack = []
-      dataStack = []
-      curlvl = -1
       File.open( file, "r" ) do |f|
-        f.each_line do |line|
-          level, tag, rest = line.chop.split( ' ', 3 )
-          while level.to_i <= curlvl
-            callPostHandler( ctxStack, dataStack.last, @cookie )
-            ctxStack.pop
-            dataStack.pop
-            curlvl -= 1
+        parse_lines( f )
+      end
+    end
+
+    # Parses anything that responds to each_line (an IO, or a String holding
+    # one or more records).
+    def parse_lines( lines )
+      start_parse
+      lines.each_line do |line|
+        @stats.bytes += line.bytesize
+        level, tag, rest = line.chomp.split( ' ', 3 )
+        tag, rest = rest, tag if tag =~ /@.*@/
+        parse_event( level.to_i, tag, rest )
+      end
+      finish_parse
+    end
+
+    # Parses the file with the given name as parse does, while a reader
+    # thread reads and splits the lines ahead of the handlers (see
+    # GEDCOM.each_event).  Returns the pipeline's counters.
+    def parse_pipelined( file, slots = PIPELINE_SLOTS )
+      start_parse
+      stats = GEDCOM.each_event( file, slots ) do |level, tag, rest|
+        parse_event( level, tag, rest )
+      end
+      @stats.bytes = stats[ :bytes ]
+      finish_parse
+      stats
+    end
+
+    private
+
+    def start_parse
+      @ctxStack = []
+      @dataStack = []
+      @curlvl = -1
+      @pre_batches.clear
+      @post_batches.clear
+      if @batch_size
+        @pre_handler.each_key { |context| @pre_batches[ context.dup ] = [] }
+        @post_handler.each_key { |context| @post_batches[ context.dup ] = [] }
+      end
+
+      # Each context with a handler of its own maps to its [ pre, post ]
+      # line counts, and the contexts above one to false.  The stack holds
+      # what each level of the current context maps to, and nil below a
+      # context that maps to nothing, where no lookups are needed.
+      @stats = ParserStats.new
+      @watch = {}
+      @watchStack = []
+      [ [ @pre_handler, 0 ], [ @post_handler, 1 ] ].each do |handlers, side|
+        handlers.each_key do |context|
+          1.upto( context.length - 1 ) { |depth| @watch[ context[ 0, depth ] ] ||= false }
+          counts = @watch[ context ]
+          @stats.watch( context, @watch[ context.dup ] = counts = [ nil, nil ] ) if !counts
+          counts[ side ] = 0
+        end
+      end
+      @stats.start( @timing )
+    end
+
+    def finish_parse
+      flush_batches
+      @stats.finish
+    end
+
+    def parse_event( level, tag, rest )
+      @stats.lines += 1
+      while level <= @curlvl
+        counts = @watchStack.pop
+        if @batch_size
+          add_to_batch( @post_handler, @post_batches, @ctxStack, @dataStack.last, counts, 1 )
+        elsif counts && counts[ 1 ]
+          counts[ 1 ] += 1
+          if @timing
+            timed { callPostHandler( @ctxStack, @dataStack.last, @cookie ) }
+          else
+            callPostHandler( @ctxStack, @dataStack.last, @cookie )
           end
+        else
+          callPostHandler( @ctxStack, @dataStack.last, @cookie )
+        end
+        @ctxStack.pop
+        @dataStack.pop
+        @curlvl -= 1
+      end
+
+      reachable = @watchStack.empty? || !@watchStack.last.nil?
+      @ctxStack.push tag
+      @dataStack.push rest
+      @curlvl = level
+      counts = reachable ? @watch[ @ctxStack ] : nil
+      @stats.skipped += 1 if reachable && counts.nil?
+      @watchStack.push counts
+
+      @stats.records[ tag[ /\A[^ ]*/ ] ] += 1 if level == 0 && tag
+      @stats.count_date( rest || "" ) if @count_dates && tag == "DATE"
+
+      if @batch_size
+        add_to_batch( @pre_handler, @pre_batches, @ctxStack, @dataStack.last, counts, 0 )
+      elsif counts && counts[ 0 ]
+        counts[ 0 ] += 1
+        if @timing
+          timed { callPreHandler( @ctxStack, @dataStack.last, @cookie ) }
+        else
+          callPreHandler( @ctxStack, @dataStack.last, @cookie )
+        end
+      else
+        callPreHandler( @ctxStack, @dataStack.last, @cookie )
+      end
+    end
+
+    # Adds the wall clock and CPU time of the block to the handlers' time
+    def timed
+      wall = ParserStats.wall_clock
+      cpu = ParserStats.cpu_clock
+      begin
+        yield
+      ensure
+        @stats.handler_cpu_seconds += ParserStats.cpu_clock - cpu
+        @stats.handler_wall_seconds += ParserStats.wall_clock - wall
+      end
+    end
+
+    # Only contexts with a handler of their own when the parse started are
+    # batched.
+    def add_to_batch( handlers, batches, context, data, counts, side )
+      batch = batches[ context ]
+      return if batch.nil?
 
-          tag, rest = rest, tag if tag =~ /@.*@/
+      counts[ side ] += 1
+      batch << data
+      if batch.length >= @batch_size
+        batches[ context ] = []
+        call_batch( handlers, context, batch )
+      end
+    end
 
-          ctxStack.push tag
-          dataStack.push rest
-          curlvl = level.to_i
+    def call_batch( handlers, context, batch )
+      func, parm = handlers[ context ]
+      if @timing
+        timed { func.call( batch, @cookie, parm ) }
+      else
+        func.call( batch, @cookie, parm )
+      end
+    end
 
-          callPreHandler( ctxStack, dataStack.last, @cookie )
-        end 
+    def flush_batches
+      [ [ @pre_handler, @pre_batches ], [ @post_handler, @post_batches ] ].each do |handlers, batches|
+        batches.each do |context, batch|
+          next if batch.empty?
+          call_batch( handlers, context, batch )
+        end
+        batches.clear
       end
     end
   end
@@ -115,9 +322,24 @@ module GEDCOM
     end
   end
   
+  class Writer
+    # Writes to the file at +path+, closing the writer when the block is
+    # done with it.
+    def Writer.open( path, line_limit = nil )
+      File.open( path, "wb" ) do |f|
+        writer = Writer.new( f, line_limit )
+        begin
+          yield writer
+        ensure
+          writer.close
+        end
+      end
+    end
+  end
+
   class Date
     def Date.safe_new( parm )
-      Date.new( parm ) { |errmsg| }
+      Date.try_parse( parm ) { |error| error.date }
     end
 
     def <=>( d )
@@ -145,3 +367,13 @@ module GEDCOM
   end
 end
 
+
+# the loader builds on Parser, so it comes after it
+require 'gedcom_loader'
+
+# merging builds on GEDCOM.diff and GEDCOM.each_record, whichever backend
+# defines them
+require 'gedcom_merge'
+
+# the counters of a Parser, whichever backend
+require 'gedcom_parser_stats'
@@ -0,0 +1,93 @@
+# -------------------------------------------------------------------------
+# gedcom_anniversary.rb -- month/day anniversary index
+# Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+# -------------------------------------------------------------------------
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2.1 of the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library; if not, write to the Free Software
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+# -------------------------------------------------------------------------
+#
+# Pure-Ruby version of the index in ext/gedcom_anniversary.c.  Each event
+# tag gets 366 day-of-year buckets (29 Feb included) and 12 month buckets
+# holding the ids that were added for it.
+module GEDCOM
+  class AnniversaryIndex
+    DAYS = 366
+    MONTHS = 12
+
+    # Number of days preceding the first of each month in a leap year
+    MONTH_START = [   0,  31,  60,  91, 121, 152,
+                    182, 213, 244, 274, 305, 335, 366 ].freeze
+
+    def AnniversaryIndex.day_of_year( month, day )
+      return nil if ( month < 1 || month > MONTHS )
+      return nil if ( day < 1 || day > MONTH_START[ month ] - MONTH_START[ month - 1 ] )
+      MONTH_START[ month - 1 ] + day - 1
+    end
+
+    def initialize
+      @events = {}
+    end
+
+    # Adds +id+ under the +tag+ event if +date+ (a GEDCOM::Date or the raw
+    # DATE text) has a usable month.  Dates without a day only go into the
+    # month bucket.  Returns true if the date was indexed.
+    def add( tag, id, date )
+      date = Date.try_parse( date ) { |error| return false } if date.kind_of?( String )
+      return false if date.format > Date::INTERPRETED
+
+      first = date.first
+      return false if first.compliance != DatePart::NONE
+      return false if first.calendar != DateType::GREGORIAN && first.calendar != DateType::JULIAN
+      return false if !first.has_month? || first.month > MONTHS
+
+      days, months = ( @events[ tag ] ||= [ Array.new( DAYS ) { [] }, Array.new( MONTHS ) { [] } ] )
+      months[ first.month - 1 ] << id
+
+      if first.has_day?
+        yday = AnniversaryIndex.day_of_year( first.month, first.day )
+        days[ yday ] << id if yday
+      end
+
+      true
+    end
+
+    # Returns the ids whose +tag+ event falls on the given month and day.
+    def on( tag, month, day )
+      yday = AnniversaryIndex.day_of_year( month, day )
+      return [] if yday.nil? || !@events.has_key?( tag )
+      @events[ tag ][ 0 ][ yday ].dup
+    end
+
+    # Returns the ids whose +tag+ event falls in the given month, including
+    # those with no day.
+    def in_month( tag, month )
+      return [] if month < 1 || month > MONTHS || !@events.has_key?( tag )
+      @events[ tag ][ 1 ][ month - 1 ].dup
+    end
+
+    def events
+      @events.keys
+    end
+
+    # Drops every event of the ids in the array +ids+.
+    def remove( ids )
+      removed = {}
+      ids.each { |id| removed[ id ] = true }
+      @events.each_value do |buckets|
+        buckets.each { |bucket| bucket.each { |list| list.reject! { |id| removed.has_key?( id ) } } }
+      end
+      self
+    end
+  end
+end
@@ -31,66 +31,70 @@ module GEDCOM
       NOYEAR = GEDCOM_DATE_PARSER::GFNOYEAR
       YEARSPAN = GEDCOM_DATE_PARSER::GFYEARSPAN
       
-      def initialize(type=GEDCOM_DATE_PARSER::GCTGREGORIAN, flags=NONE, data=nil)
+      # a part that is never parsed is all zeroes, as in the C version; the
+      # parser replaces the data rather than changing it, so it can be shared
+      UNPARSED = GEDCOM_DATE_PARSER::GEDDateGreg.new( 0, 0, 0, 0, 0, GEDCOM_DATE_PARSER::GEDADBCBC ).freeze
+
+      def initialize(type=GEDCOM_DATE_PARSER::GCTGREGORIAN, flags=NONE, data=UNPARSED)
         super( type, flags, data )
       end
       
       def calendar
-        @type
+        type
       end
       
       def compliance
-        @flags
+        flags
       end
       
       def phrase
-        raise DateFormatException if( @flags != PHRASE )
-        @data
+        raise DateFormatException if( flags != PHRASE )
+        data
       end
       
       def has_day?
-        return false if ( @flags == PHRASE )
-        return ((@data.flags & NODAY) != 0 ? false : true)
+        return false if ( flags != NONE )
+        return ((data.flags & NODAY) != 0 ? false : true)
       end
       
       def has_month?
-        return false if ( @flags == PHRASE )
-        return ((@data.flags & NOMONTH) != 0 ? false : true)
+        return false if ( flags != NONE )
+        return ((data.flags & NOMONTH) != 0 ? false : true)
       end
         
       def has_year?
-        return false if ( @flags == PHRASE )
-        return ((@data.flags & NOYEAR) != 0 ? false : true)
+        return false if ( flags != NONE )
+        return ((data.flags & NOYEAR) != 0 ? false : true)
       end
       
       def has_year_span?
-        return false if ( @flags == PHRASE )
-        return ((@data.flags & YEARSPAN) != 0 ? true : false)
+        return false if ( flags != NONE )
+        return ((data.flags & YEARSPAN) != 0 ? true : false)
       end
       
       def day
-        raise DateFormatException, "date has no day" if (@flags == PHRASE || (@data.flags & NODAY) != 0)
-        @data.day
+        raise DateFormatException, "date has no day" if (flags != NONE || (data.flags & NODAY) != 0)
+        data.day
       end
       
       def month
-        raise DateFormatException, "date has no month" if (@flags == PHRASE || (@data.flags & NOMONTH) != 0)
-        @data.month
+        raise DateFormatException, "date has no month" if (flags != NONE || (data.flags & NOMONTH) != 0)
+        data.month
       end
       
       def year
-        raise DateFormatException, "date has no year" if (@flags == PHRASE || (@data.flags & NOYEAR) != 0)
-        @data.year
+        raise DateFormatException, "date has no year" if (flags != NONE || (data.flags & NOYEAR) != 0)
+        data.year
       end
       
       def to_year
-        raise DateFormatException, "date has no year span" if (@flags == PHRASE || (@data.flags & YEARSPAN) == 0)
-        @data.year2
+        raise DateFormatException, "date has no year span" if (flags != NONE || (data.flags & YEARSPAN) == 0)
+        data.year2
       end
       
       def epoch
-        raise DateFormatException, "only gregorian dates have epoch" if ( @flags == PHRASE || @type != GEDCOM_DATE_PARSER::GCTGREGORIAN )
-        return (( @data.adbc == GEDCOM_DATE_PARSER::GEDADBCBC ) ? "BC" : "AD" )
+        raise DateFormatException, "only gregorian dates have epoch" if ( flags != NONE || type != GEDCOM_DATE_PARSER::GCTGREGORIAN )
+        return (( data.adbc == GEDCOM_DATE_PARSER::GEDADBCBC ) ? "BC" : "AD" )
       end
       
       def to_s
@@ -127,19 +131,9 @@ module GEDCOM
       DEAD = GEDCOM_DATE_PARSER::GCDEAD
 
       def initialize ( date_str, calendar=DateType::DEFAULT )
-        begin
-          @date1 = DatePart.new
-          @date2 = DatePart.new
-          super(GEDCOM_DATE_PARSER::DateParser::GEDFNONE, @date1, @date2)
-          GEDCOM_DATE_PARSER::DateParser.parse_gedcom_date( date_str, self, calendar )
-       rescue GEDCOM_DATE_PARSER::DateParseException
-          err_msg = "format error at '"
-          if (@date1 && (@date1.flags & DatePart::NONSTANDARD))
-            err_msg += @date1.data.to_s
-          elsif (@date2)
-            err_msg += @date2.data.to_s
-          end
-          err_msg += "'"
+        super(GEDCOM_DATE_PARSER::DateParser::GEDFNONE, DatePart.new, DatePart.new)
+        if ( GEDCOM_DATE_PARSER::DateParser.parse_gedcom_date( date_str, self, calendar ) != 0 )
+          err_msg = DateError.new( self ).message
           if (block_given?)
             yield( err_msg ) 
           else
@@ -148,29 +142,48 @@ module GEDCOM
         end
       end
       
+      # Returns true if +date_str+ parses.  The text is parsed into a bare
+      # GEDDateValue, so no Date, message or exception is made.
+      def Date.valid?( date_str, calendar=DateType::DEFAULT )
+        value = GEDCOM_DATE_PARSER::GEDDateValue.new( GEDCOM_DATE_PARSER::DateParser::GEDFNONE, nil, nil )
+        GEDCOM_DATE_PARSER::DateParser.parse_gedcom_date( date_str, value, calendar ) == 0
+      end
+      
+      # Returns the Date, or nil if +date_str+ does not parse; with a block,
+      # the block is called with a DateError instead and its value returned.
+      def Date.try_parse( date_str, calendar=DateType::DEFAULT )
+        date = allocate
+        date.flags = GEDCOM_DATE_PARSER::DateParser::GEDFNONE
+        date.date1 = DatePart.new
+        date.date2 = DatePart.new
+        return date if ( GEDCOM_DATE_PARSER::DateParser.parse_gedcom_date( date_str, date, calendar ) == 0 )
+        block_given? ? yield( DateError.new( date ) ) : nil
+      end
+      
       def format
-        @flags
+        flags
       end
       
       def first
-        @date1
+        date1
       end
       
       def last
-        @date2
+        date2
       end
       
       def to_s
         GEDCOM_DATE_PARSER::DateParser.build_gedcom_date_string( self )
       end
       
+      # The formats are plain values, not bits
       def is_date?
-        (@flags & (NONE | ABOUT | CALCULATED | ESTIMATED | BEFORE | AFTER | BETWEEN \
-              | FROM | TO | FROMTO | INTERPRETED)) != 0 ? false : true
+        [ NONE, ABOUT, CALCULATED, ESTIMATED, BEFORE, AFTER, BETWEEN,
+          FROM, TO, FROMTO, INTERPRETED ].include?( flags )
       end
       
       def is_range?
-        (@flags & (BETWEEN | FROMTO)) != 0 ? true : false
+        flags == BETWEEN || flags == FROMTO
       end
       
     end
@@ -188,4 +201,28 @@ module GEDCOM
     class DateFormatException < Exception
       
     end
+    
+    # What Date.try_parse gives for text that does not parse.  It only keeps
+    # the failed parse; the message is built when it is asked for.
+    class DateError
+      def initialize( date )
+        @date = date
+      end
+      
+      def message
+        "format error at '" + text + "'"
+      end
+      alias to_s message
+      
+      # The text that could not be parsed
+      def text
+        part = ( ( @date.first.flags & DatePart::NONSTANDARD ) != 0 ) ? @date.first : @date.last
+        part.data.to_s
+      end
+      
+      # The Date that Date.new makes of the text when it is given a block
+      def date
+        @date
+      end
+    end
 end
\ No newline at end of file
@@ -17,6 +17,8 @@
 # Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 # -------------------------------------------------------------------------
 #
+require 'strscan'
+
 module GEDCOM_DATE_PARSER
   # Token Constants
   # General Tokens
@@ -203,15 +205,40 @@ module GEDCOM_DATE_PARSER
   GEDADBCBC = 0
   GEDADBCAD = 1
   
-  Default_Months = [ "Jan", "Feb", "Mar", "Apr", "May", "Jun",
-                                  "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" ]
+  Default_Months = GEDCOM.shareable( [ "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                  "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" ] )
 
-  Hebrew_Months = [ "Tishri", "Cheshvan", "Kislev", "Tevet", "Shevat", "Adar",
+  Hebrew_Months = GEDCOM.shareable( [ "Tishri", "Cheshvan", "Kislev", "Tevet", "Shevat", "Adar",
                                  "Adar Sheni", "Nisan", "Iyar", "Sivan", "Tammuz", "Av",
-                                 "Elul", "Sheni" ]
+                                 "Elul", "Sheni" ] )
+
+  French_Months = GEDCOM.shareable( [ "Vend", "Brum", "Frim", "Niv", "Pluv", "Vent", "Germ", "Flor",
+                                 "Prair", "Mess", "Therm", "Fruct", "J. Comp", "Jour", "Comp" ] )
+
+  # The month codes of the GEDCOM date grammar, which build_gedcom_date_text
+  # writes
+  Default_Codes = GEDCOM.shareable( [ "JAN", "FEB", "MAR", "APR", "MAY", "JUN",
+                                      "JUL", "AUG", "SEP", "OCT", "NOV", "DEC" ] )
+
+  Hebrew_Codes = GEDCOM.shareable( [ "TSH", "CSH", "KSL", "TVT", "SHV", "ADR", "ADS",
+                                     "NSN", "IYR", "SVN", "TMZ", "AAV", "ELL" ] )
 
-  French_Months = [ "Vend", "Brum", "Frim", "Niv", "Pluv", "Vent", "Germ", "Flor",
-                                 "Prair", "Mess", "Therm", "Fruct", "J. Comp", "Jour", "Comp" ]
+  French_Codes = GEDCOM.shareable( [ "VEND", "BRUM", "FRIM", "NIVO", "PLUV", "VENT", "GERM",
+                                     "FLOR", "PRAI", "MESS", "THER", "FRUC", "COMP" ] )
+
+  Calendar_Escapes = GEDCOM.shareable( { GCTJULIAN => "@#DJULIAN@ ", GCTHEBREW => "@#DHEBREW@ ",
+                                         GCTFRENCH => "@#DFRENCH R@ ", GCTUNKNOWN => "@#DUNKNOWN@ " } )
+
+  Status_Keywords = GEDCOM.shareable( { GCCHILD => "CHILD", GCCLEARED => "CLEARED", GCCOMPLETED => "COMPLETED",
+                                        GCINFANT => "INFANT", GCPRE1970 => "PRE1970", GCQUALIFIED => "QUALIFIED",
+                                        GCSTILLBORN => "STILLBORN", GCSUBMITTED => "SUBMITTED",
+                                        GCUNCLEARED => "UNCLEARED", GCBIC => "BIC", GCDNS => "DNS",
+                                        GCDNSCAN => "DNSCAN", GCDEAD => "DEAD" } )
+
+  Date_Keywords = GEDCOM.shareable( { GCABOUT => "ABT ", GCCALCULATED => "CAL ", GCESTIMATED => "EST ",
+                                      GCBEFORE => "BEF ", GCAFTER => "AFT ", GCBETWEEN => "BET ",
+                                      GCFROM => "FROM ", GCFROMTO => "FROM ", GCTO => "TO ",
+                                      GCINTERPRETED => "INT " } )
 
   class Token
     attr_accessor :lexeme, :general, :specific
@@ -231,6 +258,7 @@ module GEDCOM_DATE_PARSER
   TokenTable << Token.new("ABT",             TKAPPROXIMATED,    TKABOUT )
   TokenTable << Token.new("ADAR",            TKMONTH,           TKADAR )
   TokenTable << Token.new("ADR",             TKMONTH,           TKADAR )
+  TokenTable << Token.new("ADS",             TKMONTH,           TKADAR_SHENI )
   TokenTable << Token.new("AFTER",           TKRANGE,           TKAFTER )
   TokenTable << Token.new("AND",             TKAND,             0 )
   TokenTable << Token.new("APRIL",           TKMONTH,           TKAPRIL )
@@ -245,6 +273,7 @@ module GEDCOM_DATE_PARSER
   TokenTable << Token.new("CHESHVAN",        TKMONTH,           TKCHESHVAN )
   TokenTable << Token.new("CHILD",           TKSTATUS,          TKCHILD )
   TokenTable << Token.new("CLEARED",         TKSTATUS,          TKCLEARED )
+  TokenTable << Token.new("COMP",            TKMONTH,           TKCOMP )
   TokenTable << Token.new("COMPLETED",       TKSTATUS,          TKCOMPLETED )
   TokenTable << Token.new("COMPLIMENTAIRS",  TKMONTH,           TKCOMP )
   TokenTable << Token.new("CSH",             TKMONTH,           TKCHESHVAN )
@@ -303,6 +332,23 @@ module GEDCOM_DATE_PARSER
   TokenTable << Token.new("VENDEMIAIRE",     TKMONTH,           TKVENDEMIAIRE )
   TokenTable << Token.new("VENTOSE",         TKMONTH,           TKVENTOSE )
   TokenTable << Token.new(0,                 0,                 0 )
+  GEDCOM.shareable( TokenTable )
+
+  # The tokenizer looks words up here rather than walking TokenTable.  Every
+  # prefix of a keyword maps to the [ general, specific ] of the first keyword
+  # in the table that starts with it, which is what the C tokenizer makes of
+  # an abbreviation ("JAN" is JANUARY, "A" is AAV).
+  Keywords = {}
+  TokenTable.each do |token|
+    break if token.lexeme == 0
+    1.upto( token.lexeme.length ) do |length|
+      Keywords[ token.lexeme[ 0, length ] ] ||= [ token.general, token.specific ].freeze
+    end
+  end
+  Keywords.freeze
+
+  # Leading white-space, then a number, a word or a one character symbol
+  Lexeme = /\s*(?:([0-9]+)|([A-Za-z][A-Za-z0-9]*|[()\/-]))/
   
   
   class GEDStateEntry
@@ -347,6 +393,7 @@ module GEDCOM_DATE_PARSER
   DateValueStateTable << GEDStateEntry.new( ST_DV_TO,           TKMONTH,          ST_DV_DATE,          0 ) # 0: inc dates read, parse a date 
   DateValueStateTable << GEDStateEntry.new( ST_DV_STATUS,       TKEOF,            ST_DV_END,           6 )
   DateValueStateTable << GEDStateEntry.new( 0, 0, 0, 0 )
+  GEDCOM.shareable( DateValueStateTable )
 
   DateStateTable = []
   DateStateTable << GEDStateEntry.new( ST_DT_START,        TKNUMBER,        ST_DT_NUMBER,         0 ) # 0: store number, set NUMBER 
@@ -355,68 +402,64 @@ module GEDCOM_DATE_PARSER
   DateStateTable << GEDStateEntry.new( ST_DT_NUMBER,       TKSLASH,         ST_DT_SLASH,          2 ) # 2: if SLASH, then error, else set SLASH, set number to be year 
   DateStateTable << GEDStateEntry.new( ST_DT_NUMBER,       TKBC,            ST_DT_BC,             3 ) # 3: if not SLASH set number to be year, set bc 
   DateStateTable << GEDStateEntry.new( ST_DT_NUMBER,       TKEOF,           ST_DT_END,            4 ) # 4: if not SLASH set number to be year, terminate
-  DateStateTable << GEDStateEntry.new( ST_DT_NUMBER,       TKTO,            ST_DT_END,            4 ) # 4: if TO set number to be year, terminate
-  DateStateTable << GEDStateEntry.new( ST_DT_NUMBER,       TKAND,           ST_DT_END,            4 ) # 4: if AND set number to be year, terminate
   DateStateTable << GEDStateEntry.new( ST_DT_MONTH,        TKNUMBER,        ST_DT_NUMBER,         5 ) # 5: if NUMBER, set number to be day.  set number to be year, store number, set NUMBER 
   DateStateTable << GEDStateEntry.new( ST_DT_MONTH,        TKEOF,           ST_DT_END,            6 ) # 6: terminate
-  DateStateTable << GEDStateEntry.new( ST_DT_MONTH,        TKTO,            ST_DT_END,            6 ) # 6: if TO, terminate
-  DateStateTable << GEDStateEntry.new( ST_DT_MONTH,        TKAND,           ST_DT_END,            6 ) # 6: if AND, terminate
   DateStateTable << GEDStateEntry.new( ST_DT_SLASH,        TKNUMBER,        ST_DT_NUMBER,         7 ) # 7: set number to be year2 
   DateStateTable << GEDStateEntry.new( ST_DT_BC,           TKEOF,           ST_DT_END,            6 ) # 6: terminate 
   DateStateTable << GEDStateEntry.new( 0, 0, 0, 0 )
-  
-  class GEDParserState
-     attr_accessor :buffer, :lastGeneralToken, :lastSpecificToken, :pos
-     def initialize( buf, lgt, lst, p )
-       @buffer = buf
-       @lastGeneralToken = lgt
-       @lastSpecificToken = lst
-       @pos = p
-     end
-  end
-  
-  # Gregorian Date Class
-  class GEDDateGreg
-      attr_accessor :flags, :day, :month, :year, :year2, :adbc
-      def initialize(flg, d, m, y, y2, adbc)
-        @flags = flg
-        @day = d
-        @month = m
-        @year = y
-        @year2 = y2
-        @adbc = adbc
-      end
-  end 
-  
-  # General Date Class
-  class GEDDateGeneral
-    attr_accessor :flags, :day, :month, :year
-    def initialize(flg, d, m, y)
-      @flags = flg
-      @day = d
-      @month = m
-      @year = y
+  GEDCOM.shareable( DateStateTable )
+
+  # The state tables as nested arrays, so that a transition is two index
+  # lookups: table[ state ][ general - TKERROR ] is [ nextState, action ], or
+  # nil if there is none.  The first entry for a state and input wins, as it
+  # does in the C version.
+  def GEDCOM_DATE_PARSER.transitions( table )
+    states = []
+    table.each do |entry|
+      break if entry.state < 1
+      row = ( states[ entry.state ] ||= [] )
+      row[ entry.input - TKERROR ] ||= [ entry.nextState, entry.action ].freeze
     end
+    states.map { |row| ( row || [] ).freeze }.freeze
   end
 
-  class GEDDate
-    attr_accessor :type, :flags, :data
-    def initialize(type, flags, data)
-      @type = type
-      @flags = flags
-      @data = data  # Data should be either a string, Gregorian date or General Date
+  DateValueTransitions = transitions( DateValueStateTable )
+  DateTransitions = transitions( DateStateTable )
+
+  # Text that is not ASCII is scanned as bytes, so that an invalid byte
+  # sequence is just an unknown token; phrases get the encoding back.
+  GEDParserState = Struct.new( :scanner, :lastGeneralToken, :lastSpecificToken, :encoding ) do
+    def pos
+      scanner.pos
+    end
+
+    def pos=( pos )
+      scanner.pos = pos
     end
-  end
 
-  class GEDDateValue  # This should be the end result of our parsing
-    attr_accessor :flags, :date1, :date2
-    def initialize(flags, d1, d2)
-      @flags = flags
-      @date1 = d1
-      @date2 = d2
+    # The rest of the text, from the current position
+    def rest
+      scanner.rest.force_encoding( encoding )
+    end
+
+    # The same, without trailing white-space and closing parenthesis
+    def phrase
+      scanner.rest.rstrip.chomp( ')' ).force_encoding( encoding )
     end
   end
 
+  # Gregorian Date
+  GEDDateGreg = Struct.new( :flags, :day, :month, :year, :year2, :adbc )
+
+  # General Date
+  GEDDateGeneral = Struct.new( :flags, :day, :month, :year )
+
+  # Data should be either a string, Gregorian date or General Date
+  GEDDate = Struct.new( :type, :flags, :data )
+
+  # This should be the end result of our parsing
+  GEDDateValue = Struct.new( :flags, :date1, :date2 )
+
   class DateParser
       GEDFNONE    = 0
       GEDFBETWEEN = 1
@@ -426,12 +469,14 @@ module GEDCOM_DATE_PARSER
       GEDFMONTH   = 16
       GEDFSLASH   = 32
       
+      EOF_TOKEN = [ TKEOF, TKNONE ].freeze
+      ERROR_TOKEN = [ TKERROR, TKNONE ].freeze
+
       def self.get_token( parser )
         # Get a single token from this parser state (class method)
         # Inputs:  parser    -  parser state  (GEDParserState)
         # Outputs: general   -  general token
         #          specific  -  specific token
-        startPos = parser.pos
 
         # if we've got a token saved in the parser, return it
         if ( parser.lastGeneralToken != TKNONE )
@@ -442,65 +487,26 @@ module GEDCOM_DATE_PARSER
           return general, specific
         end
 
-        #eat leading white-space
-       parser.pos+=1 while ( parser.buffer[ parser.pos, 1 ]==" " )
-
-        #if the buffer is empty, return TKEOF
-        if ( parser.buffer[ parser.pos, 1 ] == nil || parser.buffer[parser.pos, 1] == "")
-          specific = TKNONE
-          general = TKEOF
-          return general, specific
-        end
-
-        lexeme = ""
-        # if it's a number, parse it out and return it
-        if ( parser.buffer[ parser.pos, 1 ] =~ /[0-9]/ )
-          while ( parser.buffer[ parser.pos, 1 ] =~ /[0-9]/)
-            lexeme << parser.buffer[ parser.pos, 1 ]
-            parser.pos+=1
-          end
-          specific = lexeme.to_i
-          general = TKNUMBER
-          return general, specific
-        end
-
-        currentToken = 0
-        lexPos = 0
-        # if it is not a number, incrementally look at each token in the table
-        while ( TokenTable[ currentToken ].lexeme != 0 )
-          lexeme << parser.buffer[ parser.pos, 1 ].upcase
-          lexPos+=1
-          parser.pos+=1
-
-          if( lexeme[ lexPos-1, 1 ] != TokenTable[ currentToken ].lexeme[ lexPos-1, 1 ] )
-            currentToken+=1 while( ( TokenTable[ currentToken ].lexeme != 0 ) &&
-                   ( (TokenTable[ currentToken ].lexeme[0, lexPos] <=> lexeme[0, lexPos] ) < 0 ) )
-            
-            #if the lexeme does not appear in the table, exit with an error
-            break if ( TokenTable[ currentToken ].lexeme == 0 || \
-                (TokenTable[ currentToken ].lexeme[0, lexPos] <=> lexeme[0, lexPos] ) != 0 )
-             
-          end
+        scanner = parser.scanner
+        startPos = scanner.pos
 
-          #if the lexeme terminates, return the value of the current token
-          if( ( ( lexeme[0,1] =~ /[a-zA-Z]/) && ( parser.buffer[ parser.pos, 1 ] !~ /[0-9a-zA-Z]/) ) ||
-              ( ( lexeme[0,1] !~ /[a-zA-Z]/ ) && ( lexPos >= TokenTable[ currentToken ].lexeme.length ) ) )
-            specific = TokenTable[ currentToken ].specific
-            general = TokenTable[ currentToken ].general
-            return general, specific
-          end
+        if ( scanner.skip( Lexeme ) )
+          # if it's a number, return it
+          number = scanner[ 1 ]
+          return TKNUMBER, number.to_i if ( number )
 
-          #if the current token terminates before the lexeme, then we have an error
-          break if ( TokenTable[ currentToken ].lexeme[ lexPos, 1 ] == nil )
-            
+          word = scanner[ 2 ]
+          token = Keywords[ word ] || Keywords[ word.upcase ]
+          return token if ( token )
+        else
+          # if the buffer is empty, return TKEOF
+          scanner.skip( /\s*/ )
+          return EOF_TOKEN if ( scanner.eos? )
         end
 
-        parser.pos = startPos
-
-        specific = TKNONE
-        general = TKERROR
-        
-        return general, specific
+        # the lexeme does not appear in the table
+        scanner.pos = startPos
+        ERROR_TOKEN
       end
 
       def self.put_token( parser, general, specific )
@@ -520,7 +526,7 @@ module GEDCOM_DATE_PARSER
         buffer = ""
         
         if ( (date.flags & (GFPHRASE | GFNONSTANDARD)) != 0)
-          buffer += date.data
+          buffer << date.data
           return buffer
         end 
 
@@ -533,27 +539,28 @@ module GEDCOM_DATE_PARSER
             months = Default_Months
         end
         
-        return buffer if not (date.data)
+        # a part that was never parsed has no fields, not even the "no ..." flags
+        return buffer if ( date.data.flags == 0 && date.data.month == 0 )
 
         if ( date.data.flags && (( date.data.flags & GFNODAY ) == 0) )
-          buffer += date.data.day.to_s
-          buffer += " " if ( (( date.data.flags & GFNOMONTH ) == 0) || (( date.data.flags & GFNOYEAR ) == 0) )
+          buffer << date.data.day.to_s
+          buffer << " " if ( (( date.data.flags & GFNOMONTH ) == 0) || (( date.data.flags & GFNOYEAR ) == 0) )
         end
 
         if ( date.data.flags && (( date.data.flags & GFNOMONTH ) == 0) )
-          buffer += months[ date.data.month - 1 ]
-          buffer += " " if( ( date.data.flags & GFNOYEAR ) == 0 )
+          buffer << months[ date.data.month - 1 ]
+          buffer << " " if( ( date.data.flags & GFNOYEAR ) == 0 )
         end
 
         if ( date.data.flags && (( date.data.flags & GFNOYEAR ) == 0) )
-          buffer += date.data.year.to_s
+          buffer << date.data.year.to_s
           if ( ( date.data.flags & GFYEARSPAN ) != 0 )
-            buffer += "-"
-            buffer += date.data.year2.to_s
+            buffer << "-"
+            buffer << date.data.year2.to_s
           end
         end
 
-        buffer += " BC" if ( (date.type == GCTGREGORIAN) && (date.data.adbc != GEDADBCAD) )
+        buffer << " BC" if ( (date.type == GCTGREGORIAN) && (date.data.adbc != GEDADBCAD) )
         buffer
       end
                            
@@ -563,7 +570,7 @@ module GEDCOM_DATE_PARSER
         # Outputs: general   -  general token
         #          specific  -  specific token
         case calType
-          when GCTGREGORIAN || GCTJULIAN
+          when GCTGREGORIAN, GCTJULIAN
             return ( month - TKJANUARY + 1 ) if( month >= TKJANUARY && month <= TKDECEMBER )
              
           when GCTHEBREW
@@ -580,7 +587,7 @@ module GEDCOM_DATE_PARSER
         # Inputs:  parser    -  parser state
         #          datePart  -  date part (GEDDate)
         #          type      -  calendar type
-        # Outputs: None  (updated date part)
+        # Outputs: 0, or -1 if the text is not a date part  (updated date part)
         state = ST_DT_START
         flags = GEDFNONE
 
@@ -596,147 +603,137 @@ module GEDCOM_DATE_PARSER
 
         while ( ( state != ST_DT_END ) && ( state != ST_DT_ERROR ) ) 
           general, specific = get_token( parser )
-          raise DateParseException, "error parsing datepart, pre-transition" if (general == TKERROR)
-          transitionFound = 0
+          return -1 if (general == TKERROR)
 
+          # any other token ends the date part; it is put back for the
+          # caller, and the part is finished as if the text had ended
           case ( general )
-            when TKNUMBER
-            when TKMONTH
-            when TKSLASH
-            when TKBC
-            when TKEOF
-            when TKERROR
-            when TKTO, TKAND
-              put_token( parser, general, specific)
+            when TKNUMBER, TKMONTH, TKSLASH, TKBC, TKEOF, TKERROR
             else
               put_token( parser, general, specific )
               general = TKEOF
               specific = TKNONE
-              break
           end
 
-          DateStateTable.each do |dateState|
-            break if dateState.state < 1
-            
-            if( ( dateState.state == state ) && ( dateState.input == general ) )
-              state = dateState.nextState
-              transitionFound = 1
-              
-              case dateState.action
-                # 0: store number, set NUMBER
-                when 0
-                  number = specific
-                  flags |= GEDFNUMBER
-
-                # 1: if MONTH, then error, else set number to be day, set month, set MONTH
-                when 1
-                  if ( type == GCTFRENCH )
-                    # if the token is "JOUR", make sure they also typed at least
-                    # part of "COMPLIMENTAIRES"
-
-                    case specific
-                      when TKJOUR
-                        general, specific = get_token( parser )
-                        raise DateParseException, "error parsing datepart, post-JOUR (french calendar)" if (general == TKERROR)
-                        if ( general != TKMONTH && specific != TKCOMP )
-                          state = ST_DT_ERROR
-                          put_token( parser, general, specific )
-                        end #fall through
-
-                      when TKCOMP
-                        specific = TKJOUR_COMP
-                    end
-                  elsif ( type == GCTHEBREW )
-                    # if the token is "ADAR", see if it is followed by "SHENI",
-                    # and if it is, change the month to "ADAR SHENI"
-
-                    if( specific == TKADAR )
-                      general, specific = get_token( parser )
-                      raise DateParseException, "error parsing datepart, post-ADAR" if (general == TKERROR)
-                      if( general == TKMONTH && specific == TKSHENI )
-                        specific = TKADAR_SHENI
-                      else
-                        put_token( parser, general, specific )
-                      end
-                    end
-                  end
-
-                  if ( ( flags & GEDFMONTH ) != 0 )
-                    state = ST_DT_ERROR 
-                  else
-                    month = validate_month_for_type( specific, type )
-                    if ( month < 1 )
+          transition = DateTransitions[ state ][ general - TKERROR ]
+          if( transition.nil? )
+            state = ST_DT_ERROR
+            next
+          end
+          state, action = transition
+
+          case action
+            # 0: store number, set NUMBER
+            when 0
+              number = specific
+              flags |= GEDFNUMBER
+
+            # 1: if MONTH, then error, else set number to be day, set month, set MONTH
+            when 1
+              if ( type == GCTFRENCH )
+                # if the token is "JOUR", make sure they also typed at least
+                # part of "COMPLIMENTAIRES"
+
+                case specific
+                  when TKJOUR
+                    general, specific = get_token( parser )
+                    return -1 if (general == TKERROR)
+                    if ( general != TKMONTH && specific != TKCOMP )
                       state = ST_DT_ERROR
+                      put_token( parser, general, specific )
                     else
-                      datePart.data.day = number
-                      datePart.data.month = month
+                      specific = TKJOUR_COMP
                     end
-                    flags |= GEDFMONTH
-                    number = 0
-                  end
 
-                # 2: if SLASH, then error, else set SLASH, set number to be year
-                when 2
-                  if ( ( ( flags & GEDFSLASH ) != 0 ) || ( type != GCTGREGORIAN ) )
-                    state = ST_DT_ERROR
+                  when TKCOMP
+                    specific = TKJOUR_COMP
+                end
+              elsif ( type == GCTHEBREW )
+                # if the token is "ADAR", see if it is followed by "SHENI",
+                # and if it is, change the month to "ADAR SHENI"
+
+                if( specific == TKADAR )
+                  general, specific = get_token( parser )
+                  return -1 if (general == TKERROR)
+                  if( general == TKMONTH && specific == TKSHENI )
+                    specific = TKADAR_SHENI
                   else
-                    datePart.data.year = number if ( number > 0 )
-                      
-                    datePart.data.flags |= GFYEARSPAN
-                    number = 0
-                    flags |= GEDFSLASH
+                    put_token( parser, general, specific )
                   end
+                end
+              end
 
-                # 3: if not SLASH set number to be year, set bc
-                # 4: if not SLASH set number to be year, terminate
-                # 6: terminate
-                when 3, 4, 6
-                  if (dateState.action == 3)
-                    if( type != GCTGREGORIAN )
-                      state = ST_DT_ERROR
-                      break
-                    end
-                    datePart.data.adbc = GEDADBCBC
-                  end
-                  
-                  if (dateState.action == 3 || dateState.action == 4)
-                    if( ( number > 0 ) && ( ( flags & GEDFSLASH ) == 0 ) )
-                      datePart.data.year = number
-                      number = 0
-                    end
-                  end
+              if ( ( flags & GEDFMONTH ) != 0 )
+                state = ST_DT_ERROR 
+              else
+                month = validate_month_for_type( specific, type )
+                if ( month < 1 )
+                  state = ST_DT_ERROR
+                else
+                  datePart.data.day = number
+                  datePart.data.month = month
+                end
+                flags |= GEDFMONTH
+                number = 0
+              end
 
+            # 2: if SLASH, then error, else set SLASH, set number to be year
+            when 2
+              if ( ( ( flags & GEDFSLASH ) != 0 ) || ( type != GCTGREGORIAN ) )
+                state = ST_DT_ERROR
+              else
+                datePart.data.year = number if ( number > 0 )
                   
-                  datePart.data.flags |= GFNODAY if( datePart.data.day < 1 )
+                datePart.data.flags |= GFYEARSPAN
+                number = 0
+                flags |= GEDFSLASH
+              end
+
+            # 3: if not SLASH set number to be year, set bc
+            # 4: if not SLASH set number to be year, terminate
+            # 6: terminate
+            when 3, 4, 6
+              if (action == 3)
+                if( type != GCTGREGORIAN )
+                  state = ST_DT_ERROR
+                  next
+                end
+                datePart.data.adbc = GEDADBCBC
+              end
+              
+              if (action == 3 || action == 4)
+                if( ( number > 0 ) && ( ( flags & GEDFSLASH ) == 0 ) )
+                  datePart.data.year = number
+                  number = 0
+                end
+              end
 
-                  datePart.data.flags |= GFNOMONTH if( datePart.data.month < 1 )
+              
+              datePart.data.flags |= GFNODAY if( datePart.data.day < 1 )
 
-                  datePart.data.flags |= GFNOYEAR if( datePart.data.year < 1 )
-                    
+              datePart.data.flags |= GFNOMONTH if( datePart.data.month < 1 )
 
-                # 5: if NUMBER, set number to be day.  set number to be year, store number, set NUMBER
-                when 5
-                  datePart.data.day = number if( ( number > 0 ) && ( ( flags & GEDFNUMBER ) != 0 ) )
+              datePart.data.flags |= GFNOYEAR if( datePart.data.year < 1 )
+                
 
-                  datePart.data.year = specific
+            # 5: if NUMBER, set number to be day.  set number to be year, store number, set NUMBER
+            when 5
+              datePart.data.day = number if( ( number > 0 ) && ( ( flags & GEDFNUMBER ) != 0 ) )
 
-                  number = 0
-                  flags |= GEDFNUMBER
+              datePart.data.year = specific
 
-                # 7: set number to be year2  (Gregorian Calendar)
-                when 7
-                  datePart.data.year2 = ( specific % 100 )
-                  number = 0
-              end
+              number = 0
+              flags |= GEDFNUMBER
 
-              break
-            end
+            # 7: set number to be year2  (Gregorian Calendar)
+            when 7
+              datePart.data.year2 = ( specific % 100 )
+              number = 0
           end
-
-          state = ST_DT_ERROR if( !transitionFound )
         end
 
-        raise DateParseException, "error parsing datepart, general" if( state == ST_DT_ERROR )
+        return -1 if( state == ST_DT_ERROR )
+        0
 
       end
       
@@ -746,10 +743,10 @@ module GEDCOM_DATE_PARSER
         # Inputs:  dateString    - String containing GEDCOM date
         #          date          -  date  (GEDDateValue)
         #          type          -  calendar type
-        # Outputs: None  (updated date)
+        # Outputs: 0, or -1 if the text is not a GEDCOM date  (updated date)
 
-        parser = GEDParserState.new( "", 0, 0, 0 )
-        parser.buffer = dateString
+        text = dateString.ascii_only? ? dateString : dateString.b
+        parser = GEDParserState.new( StringScanner.new( text ), TKNONE, TKNONE, dateString.encoding )
 
         # New date 1 if it's nil
         date.date1 = GEDDate.new( type, GFNONE, nil ) if not date.date1
@@ -762,152 +759,144 @@ module GEDCOM_DATE_PARSER
         while ( ( state != ST_DV_END ) && ( state != ST_DV_ERROR ) )
           savePos = parser.pos
           general, specific = get_token( parser )
-          raise DateParseException, "error parsing date" if (general == TKERROR)
-          transitionFound = 0
-
-          DateValueStateTable.each do |dateValueState|
-            break if dateValueState.state < 1
-            
-            if( ( dateValueState.state == state ) && ( dateValueState.input == general ) )
-            
-              transitionFound = 1
-              state = dateValueState.nextState
-
-              case ( dateValueState.action ) 
-                # 0: inc dates read, parse a date                               
-                when 0
-                  put_token( parser, general, specific )
-                  begin
-                    if (datesRead != 0)
-                      # New date 2 if it's nil
-                      date.date2 = GEDDate.new( type, GFNONE, nil ) if not date.date2
-                      datePart = date.date2
-                    end
-                    parse_date_part( parser, datePart, type )
-                    datesRead+=1
-                  rescue 
-                    state = ST_DV_ERROR
-                  end
 
-                # 1: set the approx type                                       
-                when 1
-                  case ( specific ) 
-                    when TKABOUT
-                      date.flags = GCABOUT
-                    when TKCALCULATED
-                      date.flags = GCCALCULATED
-                    when TKESTIMATED
-                      date.flags = GCESTIMATED
-                  end
+          transition = DateValueTransitions[ state ][ general - TKERROR ]
+          if( transition.nil? )
+            state = ST_DV_ERROR
+            next
+          end
+          state, action = transition
 
-                # 2: set the range type                                         
-                when 2
-                  case ( specific ) 
-                    when TKBEFORE
-                      date.flags = GCBEFORE
-                    when TKAFTER
-                      date.flags = GCAFTER
-                    when TKBETWEEN
-                      date.flags = GCBETWEEN
-                      flags |= GEDFBETWEEN
-                  end
+          case ( action ) 
+            # 0: inc dates read, parse a date                               
+            when 0
+              put_token( parser, general, specific )
+              if ( parse_date_part( parser, datePart, type ) != 0 )
+                state = ST_DV_ERROR
+              else
+                datesRead+=1
+                # Anything that follows (a second date, a phrase) goes
+                # into date 2, as in the C version
+                date.date2 = GEDDate.new( type, GFNONE, nil ) if not date.date2
+                datePart = date.date2
+                datePart.flags = GFNONE
+              end
 
-                # 3: set the period type
-                when 3
-                  if( general == TKTO ) 
-                    date.flags = GCTO
-                  elsif( specific == TKFROM ) 
-                    date.flags = GCFROM
-                    flags |= GEDFFROM
-                  end
+            # 1: set the approx type                                       
+            when 1
+              case ( specific ) 
+                when TKABOUT
+                  date.flags = GCABOUT
+                when TKCALCULATED
+                  date.flags = GCCALCULATED
+                when TKESTIMATED
+                  date.flags = GCESTIMATED
+              end
 
-                # 4: set interpreted                                          
-                when 4
-                  date.flags = GCINTERPRETED
-                  flags |= GEDFINTERP
-
-                # 5: get remaining buffer as phrase
-                # 7: if 'interpreted', get remaining buffer as phrase            
-                when 5, 7
-                  # This is kind of a sucky way to handle this, but the shared functionality
-                  # between action 5 and 7 doesn't seem like enough to warrant breaking out 
-                  # into it's own method. 
-                  if( dateValueState.action == 7 && ( flags & GEDFINTERP ) == 0 ) 
-                    state = ST_DV_ERROR
-                    break 
-                  end
+            # 2: set the range type                                         
+            when 2
+              case ( specific ) 
+                when TKBEFORE
+                  date.flags = GCBEFORE
+                when TKAFTER
+                  date.flags = GCAFTER
+                when TKBETWEEN
+                  date.flags = GCBETWEEN
+                  flags |= GEDFBETWEEN
+              end
 
-                  # Strip off trailing whitespace and closing parenthesis
-                  buffer = parser.buffer.slice( parser.pos, parser.buffer.length ).rstrip.split( ')' )[0]
-                  datePart.data = buffer
-                  datePart.flags = GFPHRASE
-                  parser.pos = parser.buffer.length
+            # 3: set the period type
+            when 3
+              if( general == TKTO ) 
+                date.flags = GCTO
+              elsif( specific == TKFROM ) 
+                date.flags = GCFROM
+                flags |= GEDFFROM
+              end
 
-                # 6: if 'between' and not second date read, error, else terminate
-                when 6
-                  state = ST_DV_ERROR if( ( ( flags & GEDFBETWEEN ) != 0 ) && datesRead < 2 ) 
-                  
-                # else -- nextState is ST_DV_END, so we're done!
+            # 4: set interpreted                                          
+            when 4
+              date.flags = GCINTERPRETED
+              flags |= GEDFINTERP
+
+            # 5: get remaining buffer as phrase
+            # 7: if 'interpreted', get remaining buffer as phrase            
+            when 5, 7
+              # This is kind of a sucky way to handle this, but the shared functionality
+              # between action 5 and 7 doesn't seem like enough to warrant breaking out 
+              # into it's own method. 
+              if( action == 7 && ( flags & GEDFINTERP ) == 0 ) 
+                state = ST_DV_ERROR
+                next
+              end
 
-                # 7: see above 5
+              # Strip off trailing whitespace and closing parenthesis
+              buffer = parser.phrase
+              datePart.data = buffer
+              datePart.flags = GFPHRASE
+              parser.scanner.terminate
 
-                # 8: if 'between', prepare to read next date                  
-                when 8
-                  state = ST_DV_ERROR if( ( flags & GEDFBETWEEN ) == 0 ) 
+            # 6: if 'between' and not second date read, error, else terminate
+            when 6
+              state = ST_DV_ERROR if( ( ( flags & GEDFBETWEEN ) != 0 ) && datesRead < 2 ) 
+              
+            # else -- nextState is ST_DV_END, so we're done!
 
-                # 9: if 'from', set FROMTO, prepare to read next date                       
-                when 9
-                  if( ( flags & GEDFFROM ) == 0 ) 
-                    state = ST_DV_ERROR
-                  else 
-                    date.flags = GCFROMTO
-                  end
+            # 7: see above 5
 
-                # 10: set status 
-                when 10
-                  case ( specific ) 
-                    when TKCHILD
-                      date.flags = GCCHILD
-                    when TKCLEARED
-                      date.flags = GCCLEARED
-                    when TKCOMPLETED
-                      date.flags = GCCOMPLETED
-                    when TKINFANT
-                      date.flags = GCINFANT
-                    when TKPRE1970
-                      date.flags = GCPRE1970
-                    when TKQUALIFIED
-                      date.flags = GCQUALIFIED
-                    when TKSTILLBORN
-                      date.flags = GCSTILLBORN
-                    when TKSUBMITTED
-                      date.flags = GCSUBMITTED
-                    when TKUNCLEARED
-                      date.flags = GCUNCLEARED
-                    when TKBIC
-                      date.flags = GCBIC
-                    when TKDNS
-                      date.flags = GCDNS
-                    when TKDNSCAN
-                      date.flags = GCDNSCAN
-                    when TKDEAD
-                      date.flags = GCDEAD
-                  end
-                  
+            # 8: if 'between', prepare to read next date                  
+            when 8
+              state = ST_DV_ERROR if( ( flags & GEDFBETWEEN ) == 0 ) 
+
+            # 9: if 'from', set FROMTO, prepare to read next date                       
+            when 9
+              if( ( flags & GEDFFROM ) == 0 ) 
+                state = ST_DV_ERROR
+              else 
+                date.flags = GCFROMTO
               end
-              break  # ... Out of the DateValueStateTable.each block
-            end
-          end
 
-          state = ST_DV_ERROR if( !transitionFound ) 
+            # 10: set status 
+            when 10
+              case ( specific ) 
+                when TKCHILD
+                  date.flags = GCCHILD
+                when TKCLEARED
+                  date.flags = GCCLEARED
+                when TKCOMPLETED
+                  date.flags = GCCOMPLETED
+                when TKINFANT
+                  date.flags = GCINFANT
+                when TKPRE1970
+                  date.flags = GCPRE1970
+                when TKQUALIFIED
+                  date.flags = GCQUALIFIED
+                when TKSTILLBORN
+                  date.flags = GCSTILLBORN
+                when TKSUBMITTED
+                  date.flags = GCSUBMITTED
+                when TKUNCLEARED
+                  date.flags = GCUNCLEARED
+                when TKBIC
+                  date.flags = GCBIC
+                when TKDNS
+                  date.flags = GCDNS
+                when TKDNSCAN
+                  date.flags = GCDNSCAN
+                when TKDEAD
+                  date.flags = GCDEAD
+              end
+              
+          end
         end
 
         if( state == ST_DV_ERROR ) 
           parser.pos = savePos
           datePart.flags = GFNONSTANDARD
-          datePart.data = parser.buffer.slice( parser.pos, parser.buffer.length )
-          raise DateParseException, "error parsing date, general"
+          datePart.data = parser.rest
+          return -1
         end
+        0
       end
       
       def self.build_gedcom_date_string( date )
@@ -917,49 +906,110 @@ module GEDCOM_DATE_PARSER
         buffer = ""
 
         case ( date.flags )
-          when GCABOUT then       buffer += "abt "
-          when GCCALCULATED then  buffer += "cal "
-          when GCESTIMATED then   buffer += "est "
-          when GCBEFORE then      buffer += "bef "
-          when GCAFTER then       buffer += "aft "
-          when GCBETWEEN then     buffer += "bet "
-          when GCFROM then
-          when GCFROMTO then      buffer += "from "
-          when GCTO then          buffer += "to "
-          when GCINTERPRETED then buffer += "int "
-
-          when GCCHILD then       buffer += "child"; return
-          when GCCLEARED then     buffer += "cleared"; return
-          when GCCOMPLETED then   buffer += "completed"; return
-          when GCINFANT then      buffer += "infant"; return
-          when GCPRE1970 then     buffer += "pre-1970"; return
-          when GCQUALIFIED then   buffer += "qualified"; return
-          when GCSTILLBORN then   buffer += "stillborn"; return
-          when GCSUBMITTED then   buffer += "submitted"; return
-          when GCUNCLEARED then   buffer += "uncleared"; return
-          when GCBIC then         buffer += "BIC"; return
-          when GCDNS then         buffer += "DNS"; return
-          when GCDNSCAN then      buffer += "DNSCAN"; return
-          when GCDEAD then        buffer += "dead"; return
+          when GCABOUT then       buffer << "abt "
+          when GCCALCULATED then  buffer << "cal "
+          when GCESTIMATED then   buffer << "est "
+          when GCBEFORE then      buffer << "bef "
+          when GCAFTER then       buffer << "aft "
+          when GCBETWEEN then     buffer << "bet "
+          when GCFROM, GCFROMTO then buffer << "from "
+          when GCTO then          buffer << "to "
+          when GCINTERPRETED then buffer << "int "
+
+          when GCCHILD then       return buffer + "child"
+          when GCCLEARED then     return buffer + "cleared"
+          when GCCOMPLETED then   return buffer + "completed"
+          when GCINFANT then      return buffer + "infant"
+          when GCPRE1970 then     return buffer + "pre-1970"
+          when GCQUALIFIED then   return buffer + "qualified"
+          when GCSTILLBORN then   return buffer + "stillborn"
+          when GCSUBMITTED then   return buffer + "submitted"
+          when GCUNCLEARED then   return buffer + "uncleared"
+          when GCBIC then         return buffer + "BIC"
+          when GCDNS then         return buffer + "DNS"
+          when GCDNSCAN then      return buffer + "DNSCAN"
+          when GCDEAD then        return buffer + "dead"
         end
 
-        buffer += get_date_text( date.date1 ) if (date.date1)
+        buffer << get_date_text( date.date1 ) if (date.date1)
 
         case ( date.flags )
-          when GCBETWEEN then buffer += " and "
-          when GCFROMTO then  buffer += " to "
+          when GCBETWEEN then buffer << " and "
+          when GCFROMTO then  buffer << " to "
+          else return buffer
         end
         
-        buffer += get_date_text( date.date2 ) if (date.date2)
+        buffer << get_date_text( date.date2 ) if (date.date2)
         buffer
       end
 
+      def self.get_date_codes( date )
+        # As get_date_text, in the GEDCOM date grammar (class method)
+        # Inputs:  date      -  Date Part  (GEDDate)
+        # Outputs: buffer    -  Output string
+        return "(" + date.data + ")" if ( date.flags == GFPHRASE )
+        return date.data.dup if ( date.flags == GFNONSTANDARD )
+
+        buffer = ""
+        return buffer if ( date.data.flags == 0 && date.data.month == 0 )
+
+        case ( date.type )
+          when GCTHEBREW
+            codes = Hebrew_Codes
+          when GCTFRENCH
+            codes = French_Codes
+          else
+            codes = Default_Codes
+        end
+
+        buffer << date.data.day.to_s << " " if ( ( date.data.flags & GFNODAY ) == 0 )
+
+        if ( ( date.data.flags & GFNOMONTH ) == 0 )
+          buffer << codes[ date.data.month - 1 ]
+          buffer << " " if ( ( date.data.flags & GFNOYEAR ) == 0 )
+        end
+
+        if ( ( date.data.flags & GFNOYEAR ) == 0 )
+          buffer << date.data.year.to_s
+          if ( date.type == GCTGREGORIAN && ( date.data.flags & GFYEARSPAN ) != 0 )
+            buffer << format( "/%02d", date.data.year2 )
+          end
+        end
+
+        buffer << " BC" if ( (date.type == GCTGREGORIAN) && (date.data.adbc != GEDADBCAD) )
+        buffer
+      end
+
+      def self.build_gedcom_date_text( date )
+        # Write a GEDCOM date as the value of a DATE line, in the GEDCOM
+        # date grammar, so that it parses back to the same date (class method)
+        # Inputs:  date      -  date (GEDDateValue)
+        # Outputs: buffer    -  output string
+        return Status_Keywords[ date.flags ].dup if ( Status_Keywords.has_key?( date.flags ) )
+
+        buffer = ""
+        buffer << Calendar_Escapes[ date.date1.type ] if ( date.date1.flags == GFNONE && Calendar_Escapes.has_key?( date.date1.type ) )
+        buffer << Date_Keywords[ date.flags ] if ( Date_Keywords.has_key?( date.flags ) )
+        buffer << get_date_codes( date.date1 )
+
+        case ( date.flags )
+          when GCBETWEEN then buffer << " AND "
+          when GCFROMTO then  buffer << " TO "
+          when GCINTERPRETED
+            return buffer if ( date.date2.nil? || date.date2.flags != GFPHRASE )
+            buffer << " "
+          else return buffer
+        end
+
+        buffer << get_date_codes( date.date2 )
+      end
+
       def self.build_gedcom_date_part_string( date )
         # Stringify a GEDCOM date part (class method)
         # Inputs:  date      -  date part (GEDDate)
         # Outputs: buffer    -  output string
         buffer = ""
-        buffer += get_date_text( date )
+        buffer << get_date_text( date )
         buffer
       end
 
@@ -0,0 +1,230 @@
+# -------------------------------------------------------------------------
+# gedcom_datecolumn.rb -- packed date keys for timeline histograms
+# Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+# -------------------------------------------------------------------------
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2.1 of the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library; if not, write to the Free Software
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+# -------------------------------------------------------------------------
+#
+# Pure-Ruby version of the column in ext/gedcom_datecolumn.c, keeping the
+# same keys and giving the same counts.  A key packs the gregorian year,
+# month and day of a date as year << 9 | month << 5 | day, 0 standing for
+# a month or day the date does not give.
+module GEDCOM
+  class DateColumn
+    TAG_LIMIT = 255
+    TAG_SIZE = 32
+    MAX_YEAR = 1000000
+    MAX_HISTOGRAM_SIZE = 1 << 26
+
+    QUALIFIERS = GEDCOM.shareable( [ :none, :about, :calculated, :estimated, :before, :after, :between, :from,
+                                     :to, :fromto, :interpreted ] )
+
+    # As getDateColumnKey: the first date at the day in the middle of the
+    # days it covers, cut to the precision it was given in, or nil
+    def DateColumn.key( date )
+      return nil if date.format > Date::INTERPRETED
+      first, last = Export.days( date.first )
+      return nil if first.nil?
+
+      year, month, day = Export.civil_date( first + ( last - first ) / 2 )
+      return nil if year > MAX_YEAR || year < -MAX_YEAR
+
+      if !date.first.has_month?
+        month = day = 0
+      elsif !date.first.has_day?
+        day = 0
+      end
+      ( year << 9 ) + ( month << 5 ) + day
+    end
+
+    def DateColumn.unpack( key )
+      date = [ key >> 9 ]
+      date << ( key >> 5 & 15 ) if key >> 5 & 15 != 0
+      date << ( key & 31 ) if key >> 5 & 15 != 0 && key & 31 != 0
+      date
+    end
+
+    # As static_gedcom_datecolumn_bound
+    def DateColumn.bound( bound, upper )
+      return ( upper ? 1 << 31 : -( 1 << 31 ) ) if bound.nil?
+
+      month, day = upper ? [ 15, 31 ] : [ 0, 0 ]
+      if bound.kind_of?( Array )
+        if bound.length < 1 || bound.length > 3
+          raise ArgumentError, "date bound must be [ year ], [ year, month ] or [ year, month, day ]"
+        end
+        year = Integer( bound[ 0 ] )
+        month = Integer( bound[ 1 ] ) if bound.length > 1
+        day = Integer( bound[ 2 ] ) if bound.length > 2
+      else
+        year = Integer( bound )
+      end
+      raise ArgumentError, "date bound out of range" if month < 0 || month > 15 || day < 0 || day > 31
+
+      year = year.clamp( -MAX_YEAR - 1, MAX_YEAR + 1 )
+      ( year << 9 ) + ( month << 5 ) + day
+    end
+
+    def initialize
+      @keys = []
+      @qualifiers = []
+      @tags = []
+      @tag_names = []
+      @tag_index = {}
+    end
+
+    # Adds a GEDCOM::Date or the raw DATE text, which may start with a
+    # calendar escape, under +tag+ (or none).  Returns false for dates that
+    # have no gregorian or julian year.
+    def add( date, tag = nil )
+      if !date.kind_of?( Date )
+        raise TypeError, "expected a GEDCOM::Date or String" if !date.respond_to?( :to_str )
+        date = Export.parse_date_text( date.to_str.b )
+        return false if date.nil?
+      end
+
+      key = DateColumn.key( date )
+      return false if key.nil?
+
+      index = nil
+      if !tag.nil?
+        index = find_tag( tag.to_str.b )
+        raise ArgumentError, "date column tag too long, holding a NUL or beyond TAG_LIMIT tags" if index.nil?
+      end
+
+      @keys << key
+      @qualifiers << date.format
+      @tags << index
+      true
+    end
+
+    # Adds the first DATE of each event of the INDI and FAM records of the
+    # file at +path+, under the event's tag, and returns how many it added.
+    def load( path )
+      added = 0
+      GEDCOM.each_record( path ) do |record|
+        next if record.tag != "INDI" && record.tag != "FAM"
+        record.each do |event|
+          next if event.tag == "CHAN"
+          line = event[ "DATE" ]
+          date = line && Export.parse_date_text( line.value.b )
+          next if date.nil?
+
+          begin
+            added += 1 if add( date, event.tag )
+          rescue ArgumentError
+            added += 1 if add( date )
+          end
+        end
+      end
+      added
+    end
+
+    def length
+      @keys.length
+    end
+    alias size length
+
+    def tags
+      @tag_names.collect { |name| name.dup }
+    end
+
+    # The earliest date within the bounds as [ year ], [ year, month ] or
+    # [ year, month, day ], or nil.
+    def min( from = nil, to = nil )
+      low, high = range( DateColumn.bound( from, false ), DateColumn.bound( to, true ) )
+      low && DateColumn.unpack( low )
+    end
+
+    def max( from = nil, to = nil )
+      low, high = range( DateColumn.bound( from, false ), DateColumn.bound( to, true ) )
+      high && DateColumn.unpack( high )
+    end
+
+    # A String of a bit a date, the low bit of each byte first, set for the
+    # dates within the bounds.
+    def mask( from = nil, to = nil )
+      from, to = DateColumn.bound( from, false ), DateColumn.bound( to, true )
+      [ @keys.collect { |key| key >= from && key <= to ? "1" : "0" }.join ].pack( "b*" )
+    end
+
+    # Counts the dates by :year (the default), :decade or :month.  Options:
+    # :by (:tag or :qualifier) splits the counts into a Hash of them by tag
+    # (nil for dates added without one) or qualifier, and :from and :to
+    # bound the dates counted as mask does.
+    def histogram( unit = nil, options = nil )
+      unit ||= :year
+      if unit != :year && unit != :decade && unit != :month
+        raise ArgumentError, "unknown histogram unit (expected :year, :decade or :month)"
+      end
+
+      split, from, to = nil, DateColumn.bound( nil, false ), DateColumn.bound( nil, true )
+      if !options.nil?
+        raise TypeError, "options must be a Hash" if !options.kind_of?( Hash )
+        split = options[ :by ]
+        if !split.nil? && split != :tag && split != :qualifier
+          raise ArgumentError, "unknown histogram split (expected :tag or :qualifier)"
+        end
+        from, to = DateColumn.bound( options[ :from ], false ), DateColumn.bound( options[ :to ], true )
+      end
+
+      rows = split == :tag ? @tag_names.length + 1 : split == :qualifier ? QUALIFIERS.length : 1
+      low, high = range( from, to )
+      return {} if low.nil?
+
+      buckets = unit == :month ? ( ( high >> 9 ) - ( low >> 9 ) + 1 ) * 12 : ( high >> 9 ) - ( low >> 9 ) + 1
+      if ( buckets + 1 ) * rows > MAX_HISTOGRAM_SIZE
+        raise ArgumentError, "histogram too large (narrow it with :from and :to)"
+      end
+
+      counts = Array.new( rows ) { Hash.new( 0 ) }
+      @keys.each_with_index do |key, i|
+        next if key < from || key > to
+        next if unit == :month && key >> 5 & 15 == 0
+
+        row = split == :tag ? ( @tags[ i ] || @tag_names.length ) : split == :qualifier ? @qualifiers[ i ] : 0
+        bucket = unit == :month ? [ key >> 9, key >> 5 & 15 ] : unit == :decade ? ( key >> 9 ) / 10 * 10 : key >> 9
+        counts[ row ][ bucket ] += 1
+      end
+      counts.collect! { |row| row.sort.to_h }
+
+      return counts[ 0 ] if split.nil?
+      result = {}
+      counts.each_with_index do |row, i|
+        next if row.empty?
+        result[ split == :qualifier ? QUALIFIERS[ i ] : @tag_names[ i ] && @tag_names[ i ].dup ] = row
+      end
+      result
+    end
+
+    private
+
+    # As findTag: the index of +tag+, added if new, or nil if it cannot be
+    # kept
+    def find_tag( tag )
+      return nil if tag.bytesize >= TAG_SIZE || tag.include?( "\0" )
+      return @tag_index[ tag ] if @tag_index.has_key?( tag )
+      return nil if @tag_names.length == TAG_LIMIT
+
+      @tag_names << tag
+      @tag_index[ tag ] = @tag_names.length - 1
+    end
+
+    def range( from, to )
+      inside = @keys.select { |key| key >= from && key <= to }
+      inside.empty? ? [ nil, nil ] : inside.minmax
+    end
+  end
+end
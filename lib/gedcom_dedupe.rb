@@ -0,0 +1,172 @@
+# -------------------------------------------------------------------------
+# gedcom_dedupe.rb -- duplicate individual detection
+# Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+# -------------------------------------------------------------------------
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2.1 of the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library; if not, write to the Free Software
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+# -------------------------------------------------------------------------
+#
+#
+# Pure-Ruby version of ext/gedcom_dedupe.c.  The blocking, window and
+# scores are the same; the threads argument is accepted but the scan runs
+# on the calling thread.
+module GEDCOM
+  class DuplicateFinder
+    MIN_SCORE = 60
+
+    MAX_RELATIVES = 4
+    YEAR_SLACK = 2
+    WINDOW = 32
+
+    Person = Struct.new( :id, :soundex, :surname, :given, :initial, :sex, :birth, :death, :relatives )
+
+    # 32-bit FNV-1a, so that people sort the way they do in the C version
+    def DuplicateFinder.hash_name( text )
+      hash = 2166136261
+      text.each_byte { |b| hash = ( ( hash ^ b ) * 16777619 ) & 0xFFFFFFFF }
+      hash
+    end
+
+    # year << 9 | month << 5 | day for a gregorian (AD) or julian date with
+    # a year, otherwise 0
+    def DuplicateFinder.pack_date( date )
+      return 0 if date.nil?
+      date = Date.try_parse( date ) { |error| return 0 } if date.kind_of?( String )
+      return 0 if date.format > Date::ESTIMATED && date.format != Date::INTERPRETED
+
+      part = date.first
+      return 0 if part.compliance != DatePart::NONE
+      return 0 if part.calendar != DateType::GREGORIAN && part.calendar != DateType::JULIAN
+      return 0 if part.calendar == DateType::GREGORIAN && part.epoch != "AD"
+      return 0 if !part.has_year? || part.year == 0
+
+      packed = part.year << 9
+      if part.has_month?
+        packed |= part.month << 5
+        packed |= part.day if part.has_day?
+      end
+      packed
+    end
+
+    def initialize
+      @people = []
+      @busy = false
+    end
+
+    # Adds a person to compare.  +name+ is their NAME value, +birth+ and
+    # +death+ are GEDCOM::Dates or DATE texts (or nil) and +family+ holds
+    # the NAME values of their parents and spouses.  Returns false if the
+    # name has no surname to block on.
+    def add( id, name, sex = nil, birth = nil, death = nil, family = nil )
+      check_idle
+      given, surname, suffix = Name.split( name )
+      surname = Name.normalize( surname )
+      return false if surname.empty?
+
+      person = Person.new( id, Name.soundex( surname ), DuplicateFinder.hash_name( surname ), 0, nil, nil )
+
+      given = Name.normalize( given ).split( " " ).first
+      if given
+        person.given = DuplicateFinder.hash_name( given )
+        person.initial = given[ 0, 1 ]
+      end
+
+      person.sex = sex[ 0, 1 ] if sex && ( sex[ 0, 1 ] == "M" || sex[ 0, 1 ] == "F" )
+      person.birth = DuplicateFinder.pack_date( birth )
+      person.death = DuplicateFinder.pack_date( death )
+
+      person.relatives = []
+      ( family || [] ).first( MAX_RELATIVES ).each do |relative|
+        relative = Name.normalize( relative )
+        person.relatives << DuplicateFinder.hash_name( relative ) if !relative.empty?
+      end
+
+      @people << person
+      true
+    end
+
+    def size
+      check_idle
+      @people.length
+    end
+
+    # Returns [ id1, id2, score ] for each pair scoring at least
+    # +min_score+ (out of 110), best first.  The finder cannot be used
+    # from other threads until it returns.
+    def candidates( min_score = MIN_SCORE, threads = 1 )
+      check_idle
+      begin
+        @busy = true
+        search( min_score || MIN_SCORE )
+      ensure
+        @busy = false
+      end
+    end
+
+    private
+
+    def check_idle
+      raise RuntimeError, "duplicate finder used while it searches" if @busy
+    end
+
+    def search( min_score )
+      @people = @people.sort_by { |p| [ p.soundex, p.birth >> 9, p.given, p.id ] }
+      pairs = []
+
+      @people.each_with_index do |a, i|
+        ( i + 1 .. i + WINDOW ).each do |j|
+          b = @people[ j ]
+          break if b.nil? || b.soundex != a.soundex
+          break if a.birth != 0 && ( b.birth >> 9 ) - ( a.birth >> 9 ) > YEAR_SLACK
+
+          score = score_pair( a, b )
+          pairs << [ [ a.id, b.id ].min, [ a.id, b.id ].max, score ] if score >= min_score
+        end
+      end
+
+      pairs.sort_by { |id1, id2, score| [ -score, id1, id2 ] }
+    end
+
+    def score_dates( x, y, full )
+      return 0 if x == 0 || y == 0
+      return full if x == y && ( x & 0x1F ) != 0
+
+      difference = ( ( x >> 9 ) - ( y >> 9 ) ).abs
+      if difference == 0
+        return full * 3 / 5 if ( x >> 5 ) == ( y >> 5 ) && ( x & 0x1E0 ) != 0
+        return full * 2 / 5
+      end
+      return full / 5 if difference <= YEAR_SLACK
+      -full
+    end
+
+    def score_pair( a, b )
+      return -1 if a.sex && b.sex && a.sex != b.sex
+
+      score = ( a.surname == b.surname ) ? 20 : 10
+
+      if a.given != 0 && a.given == b.given
+        score += 30
+      elsif a.initial && a.initial == b.initial
+        score += 10
+      end
+
+      score += score_dates( a.birth, b.birth, 25 )
+      score += score_dates( a.death, b.death, 15 )
+
+      shared = a.relatives.select { |r| b.relatives.include?( r ) }.length
+      score + [ shared, 2 ].min * 10
+    end
+  end
+end
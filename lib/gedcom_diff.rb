@@ -0,0 +1,142 @@
+# -------------------------------------------------------------------------
+# gedcom_diff.rb -- record hash diff of two files
+# Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+# -------------------------------------------------------------------------
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2.1 of the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library; if not, write to the Free Software
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+# -------------------------------------------------------------------------
+#
+# Pure-Ruby version of the diff in ext/gedcom_diff.c, giving the same
+# changes.  Records are told apart by an MD5 digest of their subtrees
+# rather than the XXH64 hash the C version keeps.
+require 'digest/md5'
+
+module GEDCOM
+  module Diff
+    Record = Struct.new( :key, :offset, :hash, :children, :match )
+
+    # [ digest of the root, digests of its level 1 children ] of the
+    # record the reader is on.  Xrefs are left out so that renamed
+    # records hash alike.
+    def Diff.hash_nodes( nodes )
+      hashes = []
+      ( nodes.length - 1 ).downto( 0 ) do |i|
+        node = nodes[ i ]
+        digest = Digest::MD5.new
+        digest << [ node.tag.bytesize ].pack( "V" ) << node.tag << [ node.value.bytesize ].pack( "V" ) << node.value
+        node.children.each { |child| digest << hashes[ child ] }
+        hashes[ i ] = digest.digest
+      end
+      [ hashes[ 0 ], nodes[ 0 ].children.collect { |child| hashes[ child ] } ]
+    end
+
+    # The records of the file at +path+ and a hash from their keys to
+    # their indexes.  A record's key is its xref, or its tag if it has
+    # none; repeats of a key get ":2", ":3", ... appended.
+    def Diff.index( path, subtrees )
+      records = []
+      keys = {}
+      duplicates = Hash.new( 1 )
+      offset = 0
+
+      File.open( path, "rb" ) do |file|
+        reader = RecordReader.new
+        reader.each( file ) do |root|
+          nodes = reader.nodes
+          hash, children = hash_nodes( nodes )
+          key = nodes[ 0 ].xref || nodes[ 0 ].tag
+          key += ":#{duplicates[ key ] += 1}" if keys.has_key?( key )
+          keys[ key ] = records.length
+          records << Record.new( key, offset + nodes[ 0 ].offset, hash, subtrees ? children : nil, nil )
+          offset += reader.text.bytesize
+        end
+      end
+
+      [ records, keys ]
+    end
+
+    # [ removed, added ]: the indexes of the level 1 subtrees that only
+    # one of the records has, matching equal subtrees one for one
+    def Diff.children( old, updated )
+      counts = Hash.new( 0 )
+      updated.each { |hash| counts[ hash ] += 1 }
+      removed = []
+      old.each_with_index do |hash, i|
+        if counts[ hash ] > 0
+          counts[ hash ] -= 1
+        else
+          removed << i
+        end
+      end
+
+      counts = Hash.new( 0 )
+      old.each { |hash| counts[ hash ] += 1 }
+      added = []
+      updated.each_with_index do |hash, i|
+        if counts[ hash ] > 0
+          counts[ hash ] -= 1
+        else
+          added << i
+        end
+      end
+
+      [ removed, added ]
+    end
+  end
+
+  # Compares the records of the files at +old_path+ and +new_path+ and
+  # returns the changes as [ kind, old_key, new_key, old_offset,
+  # new_offset, removed, added ] arrays.  See ext/gedcom_diff.c.
+  def GEDCOM.diff( old_path, new_path, options = nil )
+    subtrees = true
+    if !options.nil?
+      raise TypeError, "wrong argument type #{options.class} (expected Hash)" if !options.kind_of?( Hash )
+      subtrees = options.fetch( :subtrees, true ) ? true : false
+    end
+
+    old, old_keys = Diff.index( old_path, subtrees )
+    updated = Diff.index( new_path, subtrees )[ 0 ]
+    changes = []
+    additions = []
+
+    updated.each_with_index do |record, i|
+      match = old_keys[ record.key ]
+      if match.nil?
+        changes << [ :added, nil, record.key, nil, record.offset, nil, nil ]
+        additions << [ changes.last, record ]
+        next
+      end
+
+      old[ match ].match = record.match = i
+      next if old[ match ].hash == record.hash
+
+      removed, added = subtrees ? Diff.children( old[ match ].children, record.children ) : [ nil, nil ]
+      changes << [ :changed, old[ match ].key, record.key, old[ match ].offset, record.offset, removed, added ]
+    end
+
+    # added records that hash like an unmatched old one were renamed
+    unmatched = {}
+    old.each { |record| ( unmatched[ record.hash ] ||= [] ) << record if record.match.nil? }
+    additions.each do |change, record|
+      candidates = unmatched[ record.hash ]
+      next if candidates.nil? || candidates.empty?
+      renamed = candidates.shift
+      renamed.match = true
+      change[ 0 ], change[ 1 ], change[ 3 ] = :renamed, renamed.key, renamed.offset
+    end
+
+    old.each { |record| changes << [ :removed, record.key, nil, record.offset, nil, nil, nil ] if record.match.nil? }
+    changes
+  end
+end
@@ -0,0 +1,284 @@
+# -------------------------------------------------------------------------
+# gedcom_export.rb -- flat event table of the individuals of a file
+# Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+# -------------------------------------------------------------------------
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2.1 of the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library; if not, write to the Free Software
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+# -------------------------------------------------------------------------
+#
+# Pure-Ruby version of ext/gedcom_export.c, writing the same bytes.  The
+# threads argument is accepted and ignored.
+module GEDCOM
+  module Export
+    BATCH_SIZE = 1024
+    MAX_DATE_SIZE = 256
+
+    INT32 = 1
+    TEXT = 2
+
+    COLUMNS = [ [ "id", INT32 ], [ "xref", TEXT ], [ "sex", TEXT ], [ "name", TEXT ], [ "event", TEXT ],
+                [ "date", TEXT ], [ "sort_key", INT32 ], [ "start", INT32 ], [ "end", INT32 ], [ "place", TEXT ] ]
+    GEDCOM.shareable( COLUMNS )
+
+    EVENTS = {}
+    [ "ADOP", "BAPM", "BARM", "BASM", "BIRT", "BLES", "BURI", "CENS", "CHR", "CHRA", "CONF", "CREM",
+      "DEAT", "EMIG", "EVEN", "FCOM", "GRAD", "IMMI", "NATU", "ORDN", "PROB", "RESI", "RETI", "WILL" ].each do |tag|
+      EVENTS[ tag.b ] = true
+    end
+    EVENTS.freeze
+
+    CALENDARS = GEDCOM.shareable( { "DGREGORIAN" => DateType::GREGORIAN, "DJULIAN" => DateType::JULIAN,
+                  "DHEBREW" => DateType::HEBREW, "DFRENCH R" => DateType::FRENCH,
+                  "DUNKNOWN" => DateType::UNKNOWN } )
+
+    LINE = /\A[ \t]*(\d+)[ \t]*(?:@[^ \t\r\n]*[ \t]*)?([^ \t\r\n]*)[ \t]*(.*?)[\r\n]*\z/mn
+    ESCAPE = /\A@#([^@]*)@[ \t]*(.*)\z/mn
+    QUOTED = /[,"\r\n]/n
+
+    MONTH_DAYS = [ 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 ].freeze
+
+    Row = Struct.new( :id, :xref, :sex, :name, :event, :date, :sort_key, :start, :end, :place )
+
+    # The rows of one INDI record: one per event, or a single one without
+    # an event.
+    def Export.person_rows( id, xref, text )
+      rows = []
+      name = sex = event = nil
+
+      text.each_line( "\n" ) do |line|
+        match = LINE.match( line )
+        next if match.nil?
+        level, tag, value = match[ 1 ].to_i, match[ 2 ], match[ 3 ]
+
+        if level == 1
+          event = nil
+          if tag == "NAME"
+            name ||= value
+          elsif tag == "SEX"
+            sex ||= value
+          elsif EVENTS.has_key?( tag )
+            rows << ( event = Row.new( id, xref, nil, nil, tag, nil, 0, 0, 0, nil ) )
+          end
+        elsif level == 2 && event
+          if tag == "DATE"
+            event.date ||= value
+          elsif tag == "PLAC"
+            event.place ||= value
+          end
+        end
+      end
+
+      rows << Row.new( id, xref, nil, nil, nil, nil, 0, 0, 0, nil ) if rows.empty?
+      rows.each do |row|
+        row.name, row.sex = name, sex
+        read_date( row ) if row.date
+      end
+      rows
+    end
+
+    def Export.read_date( row )
+      date = parse_date_text( row.date )
+      return if date.nil? || date.format > Date::INTERPRETED
+
+      row.sort_key = sort_key( date.first )
+      row.start, row.end = date_days( date )
+    end
+
+    # As parseGEDCOMDateText: a DATE value that may start with a calendar
+    # escape, or nil
+    def Export.parse_date_text( text )
+      calendar = DateType::DEFAULT
+      if text.start_with?( "@#" )
+        match = ESCAPE.match( text )
+        return nil if match.nil? || !CALENDARS.has_key?( match[ 1 ] )
+        text, calendar = match[ 2 ], CALENDARS[ match[ 1 ] ]
+      end
+      return nil if text.bytesize >= MAX_DATE_SIZE || text.include?( "\0" )
+
+      Date.try_parse( text, calendar ) { |error| return nil }
+    end
+
+    # [ first, last ] days of a whole date, 0 where not known, as
+    # getGEDCOMDateValueDays
+    def Export.date_days( date )
+      case date.format
+      when Date::BEFORE, Date::TO
+        [ 0, ( days( date.first ) || [ 0, 0 ] )[ 1 ] ]
+      when Date::AFTER, Date::FROM
+        [ ( days( date.first ) || [ 0, 0 ] )[ 0 ], 0 ]
+      when Date::BETWEEN, Date::FROMTO
+        first, last = days( date.first ), days( date.last )
+        first && last ? [ first[ 0 ], last[ 1 ] ] : [ 0, 0 ]
+      when Date::NONE, Date::ABOUT, Date::CALCULATED, Date::ESTIMATED, Date::INTERPRETED
+        days( date.first ) || [ 0, 0 ]
+      else
+        [ 0, 0 ]
+      end
+    end
+
+    # As packGEDCOMDate
+    def Export.sort_key( part )
+      return 0 if part.compliance != DatePart::NONE
+      return 0 if part.calendar != DateType::GREGORIAN && part.calendar != DateType::JULIAN
+      return 0 if part.calendar == DateType::GREGORIAN && part.epoch != "AD"
+      return 0 if !part.has_year? || part.year == 0
+
+      packed = part.year << 9
+      if part.has_month?
+        packed |= part.month << 5
+        packed |= part.day if part.has_day?
+      end
+      packed
+    end
+
+    # [ first, last ] julian day numbers the part covers, as
+    # getGEDCOMDateDays, or nil
+    def Export.days( part )
+      return nil if part.compliance != DatePart::NONE
+      return nil if part.calendar != DateType::GREGORIAN && part.calendar != DateType::JULIAN
+      return nil if !part.has_year? || part.year == 0
+
+      gregorian = ( part.calendar == DateType::GREGORIAN )
+      year = part.year
+      year = 1 - year if gregorian && part.epoch == "BC"
+
+      if part.has_month?
+        return nil if part.month < 1 || part.month > 12
+        month1 = month2 = part.month
+      else
+        month1, month2 = 1, 12
+      end
+
+      if part.has_month? && part.has_day?
+        day1 = day2 = part.day
+      else
+        leap = gregorian ? ( year % 4 == 0 && year % 100 != 0 ) || year % 400 == 0 : year % 4 == 0
+        day1, day2 = 1, MONTH_DAYS[ month2 - 1 ] + ( month2 == 2 && leap ? 1 : 0 )
+      end
+
+      if gregorian
+        [ gregorian_day( year, month1, day1 ), gregorian_day( year, month2, day2 ) ]
+      else
+        [ julian_day( year, month1, day1 ), julian_day( year, month2, day2 ) ]
+      end
+    end
+
+    # Integer division rounds down here, as the C version arranges to.
+    def Export.gregorian_day( year, month, day )
+      year -= 1 if month <= 2
+      era = year / 400
+      year_of_era = year - era * 400
+      day_of_year = ( 153 * ( month > 2 ? month - 3 : month + 9 ) + 2 ) / 5 + day - 1
+      era * 146097 + year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year + 1721120
+    end
+
+    def Export.julian_day( year, month, day )
+      year -= 1 if month <= 2
+      cycle = year / 4
+      day_of_year = ( 153 * ( month > 2 ? month - 3 : month + 9 ) + 2 ) / 5 + day - 1
+      cycle * 1461 + ( year - cycle * 4 ) * 365 + day_of_year + 1721118
+    end
+
+    # [ year, month, day ] in the gregorian calendar, as getGEDCOMCivilDate
+    def Export.civil_date( jdn )
+      days = jdn - 1721120
+      era = days / 146097
+      day_of_era = days - era * 146097
+      year_of_era = ( day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096 ) / 365
+      day_of_year = day_of_era - ( 365 * year_of_era + year_of_era / 4 - year_of_era / 100 )
+      month = ( 5 * day_of_year + 2 ) / 153
+      day = day_of_year - ( 153 * month + 2 ) / 5 + 1
+      month = month < 10 ? month + 3 : month - 9
+      [ year_of_era + era * 400 + ( month <= 2 ? 1 : 0 ), month, day ]
+    end
+
+    def Export.iso_date( jdn )
+      year, month, day = civil_date( jdn )
+      ( year < 0 ? "-" : "" ) + "%04d-%02d-%02d" % [ year.abs, month, day ]
+    end
+
+    def Export.csv_field( text )
+      return "" if text.nil?
+      text =~ QUOTED ? '"' + text.gsub( '"', '""' ) + '"' : text
+    end
+
+    def Export.csv( rows )
+      out = "".b
+      rows.each do |row|
+        out << row.id.to_s << "," << csv_field( row.xref ) << "," << csv_field( row.sex ) << "," <<
+               csv_field( row.name ) << "," << csv_field( row.event ) << "," << csv_field( row.date ) << "," <<
+               row.sort_key.to_s << "," << ( row.start != 0 ? iso_date( row.start ) : "" ) << "," <<
+               ( row.end != 0 ? iso_date( row.end ) : "" ) << "," << csv_field( row.place ) << "\n"
+      end
+      out
+    end
+
+    def Export.pad( data )
+      data << "\0" * ( ( 8 - data.bytesize % 8 ) % 8 )
+    end
+
+    def Export.columns( rows )
+      return "".b if rows.empty?
+      body = "".b
+      COLUMNS.each_with_index do |( name, type ), column|
+        values = rows.collect { |row| row[ column ] }
+        if type == INT32
+          body << pad( values.pack( "l<*" ) )
+        else
+          offset = 0
+          offsets = [ 0 ] + values.collect { |value| offset += ( value ? value.bytesize : 0 ) }
+          body << pad( offsets.pack( "V*" ) )
+          body << pad( values.collect { |value| value || "" }.join.b )
+        end
+      end
+      [ rows.length, 0, body.bytesize ].pack( "VVQ<" ) + body
+    end
+
+    def Export.header( format )
+      return COLUMNS.collect { |name, type| name }.join( "," ) + "\n" if format == :csv
+      header = "GEDCOLS1" + [ COLUMNS.length, 0 ].pack( "VV" )
+      COLUMNS.each { |name, type| header << [ type, name.length ].pack( "CC" ) << name }
+      pad( header.b )
+    end
+  end
+
+  # Writes one row per event of each INDI record of +text+ to +io+, as CSV
+  # (:csv) or in column batches (:columns), and returns the number of rows.
+  # See ext/gedcom_export.c for the columns and the batch layout.
+  def GEDCOM.export_events( text, io, format = :csv, threads = 1 )
+    format ||= :csv
+    raise ArgumentError, "unknown export format (expected :csv or :columns)" if format != :csv && format != :columns
+
+    text = text.b
+    people = GEDCOM.scan_records( text ).select { |xref, tag| tag == "INDI" }
+    batches = people.each_slice( Export::BATCH_SIZE ).to_a
+    batches << [] if batches.empty?
+    total = 0
+
+    batches.each_with_index do |batch, i|
+      id = i * Export::BATCH_SIZE - 1
+      rows = batch.collect_concat do |xref, tag, offset, length|
+        Export.person_rows( id += 1, xref || "", text.byteslice( offset, length ) )
+      end
+      total += rows.length
+
+      out = ( i == 0 ) ? Export.header( format ).b : "".b
+      out << ( format == :csv ? Export.csv( rows ) : Export.columns( rows ) )
+      out << "\0" * 16 if format == :columns && i + 1 == batches.length
+      io.write( out ) if !out.empty?
+    end
+
+    total
+  end
+end
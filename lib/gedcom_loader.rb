@@ -0,0 +1,275 @@
+# -------------------------------------------------------------------------
+# gedcom_loader.rb -- loads the individuals of a file and indexes them
+# Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+# -------------------------------------------------------------------------
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2.1 of the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library; if not, write to the Free Software
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+# -------------------------------------------------------------------------
+
+module GEDCOM
+
+  # One INDI record.  +id+ is the record's position in Loader#individuals,
+  # which is also the id the indexes hand back; +xref+ is its @I1@ label.
+  class Individual
+    attr_accessor :id
+    attr_accessor :xref
+    attr_accessor :names
+    attr_accessor :sex
+    attr_accessor :events
+
+    def initialize( id, xref )
+      @id, @xref = id, xref
+      @names = []
+      @sex = nil
+      @events = {}
+    end
+
+    def name
+      @names.first
+    end
+  end
+
+
+  # One FAM record, holding the xrefs of its members.
+  class Family
+    attr_accessor :id
+    attr_accessor :xref
+    attr_accessor :husband
+    attr_accessor :wife
+    attr_accessor :children
+
+    def initialize( id, xref )
+      @id, @xref = id, xref
+      @husband = @wife = nil
+      @children = []
+    end
+  end
+
+
+  # Parser that keeps the individuals and families of a file, and indexes their names
+  # and event dates as it goes:
+  #
+  #   loader = GEDCOM::Loader.new
+  #   loader.parse "royal.ged"
+  #   loader.names.surname( "tud" ).collect { |id| loader.individuals[ id ] }
+  #   loader.anniversaries.on( "BIRT", 12, 25 )
+  #   loader.duplicates.each { |id1, id2, score| ... }
+  #
+  # Files read with load can later be re-read with reload, which only
+  # re-parses the level 0 records that were added or changed since.
+  # Individuals and families keep their ids across reloads; the slots of
+  # removed ones are left nil.
+  class Loader < Parser
+    EVENTS = GEDCOM.shareable( [ "BIRT", "CHR", "BAPM", "DEAT", "BURI", "CREM" ] )
+
+    attr_reader :individuals
+    attr_reader :families
+    attr_reader :names
+    attr_reader :anniversaries
+
+    def initialize( cookie = nil )
+      super
+
+      setPreHandler  [ "INDI" ], method( :startIndividual )
+      setPreHandler  [ "INDI", "NAME" ], method( :registerName )
+      setPreHandler  [ "INDI", "SEX" ], method( :registerSex )
+      EVENTS.each do |tag|
+        setPreHandler [ "INDI", tag, "DATE" ], method( :registerEventDate ), tag
+      end
+      setPostHandler [ "INDI" ], method( :endIndividual )
+
+      setPreHandler  [ "FAM" ], method( :startFamily )
+      setPreHandler  [ "FAM", "HUSB" ], method( :registerHusband )
+      setPreHandler  [ "FAM", "WIFE" ], method( :registerWife )
+      setPreHandler  [ "FAM", "CHIL" ], method( :registerChild )
+
+      @individuals = []
+      @families = []
+      @xrefs = {}
+      @family_xrefs = {}
+      @records = nil
+      @names = NameIndex.new
+      @anniversaries = AnniversaryIndex.new
+      @current = nil
+    end
+
+    # Returns the individual labelled +xref+ ("@I1@"), if there is one.
+    def individual( xref )
+      id = @xrefs[ xref ]
+      id && @individuals[ id ]
+    end
+
+    # Reads +file+ from scratch, remembering the hash of each of its level 0
+    # records for reload.
+    def load( file )
+      text = File.open( file, "rb" ) { |f| f.read }
+      scanned = GEDCOM.scan_records( text )
+      @records = Hash[ record_keys( scanned ).zip( scanned.collect { |record| record[ 4 ] } ) ]
+      parse_lines( text.force_encoding( Encoding.default_external ) )
+      self
+    end
+
+    # Re-reads +file+, re-parsing only the records whose hash changed and
+    # dropping the individuals and families whose records are gone.  Returns
+    # the keys (the xref, or "TAG#n" for the n-th record without one) of the
+    # records that were :added, :changed and :removed.  A loader that was
+    # never loaded is loaded in full.
+    def reload( file )
+      if @records.nil?
+        load( file )
+        return { :added => @records.keys, :changed => [], :removed => [] }
+      end
+
+      text = File.open( file, "rb" ) { |f| f.read }
+      scanned = GEDCOM.scan_records( text )
+      keys = record_keys( scanned )
+      records = Hash[ keys.zip( scanned.collect { |record| record[ 4 ] } ) ]
+      old = @records
+
+      changes = { :added => [], :changed => [], :removed => [] }
+      records.each do |key, hash|
+        if !old.has_key?( key )
+          changes[ :added ] << key
+        elsif old[ key ] != hash
+          changes[ :changed ] << key
+        end
+      end
+      changes[ :removed ] = old.keys - records.keys
+
+      forget( changes[ :changed ], false )
+      forget( changes[ :removed ], true )
+
+      dirty = {}
+      ( changes[ :added ] + changes[ :changed ] ).each { |key| dirty[ key ] = true }
+      scanned.zip( keys ).each do |record, key|
+        next if !dirty.has_key?( key )
+        chunk = text.byteslice( record[ 2 ], record[ 3 ] )
+        parse_lines( chunk.force_encoding( Encoding.default_external ) )
+      end
+
+      @records = records
+      changes
+    end
+
+    def startIndividual( data, cookie, parm )
+      id = data && @xrefs[ data ]
+      id = @individuals.length if id.nil? || @individuals[ id ]
+      @current = Individual.new( id, data )
+      @individuals[ id ] = @current
+      @xrefs[ data ] = id if data
+    end
+
+    def registerName( data, cookie, parm )
+      return if data.nil?
+      @current.names.push data
+      @names.add( @current.id, data )
+    end
+
+    def registerSex( data, cookie, parm )
+      @current.sex = data
+    end
+
+    # Only the first date of each event is kept and indexed.
+    def registerEventDate( data, cookie, tag )
+      return if data.nil? || @current.events.has_key?( tag )
+      date = Date.safe_new( data )
+      @current.events[ tag ] = date
+      @anniversaries.add( tag, @current.id, date )
+    end
+
+    def endIndividual( data, cookie, parm )
+      @current = nil
+    end
+
+    def startFamily( data, cookie, parm )
+      id = data && @family_xrefs[ data ]
+      id = @families.length if id.nil? || @families[ id ]
+      @family = Family.new( id, data )
+      @families[ id ] = @family
+      @family_xrefs[ data ] = id if data
+    end
+
+    def registerHusband( data, cookie, parm )
+      @family.husband = data
+    end
+
+    def registerWife( data, cookie, parm )
+      @family.wife = data
+    end
+
+    def registerChild( data, cookie, parm )
+      @family.children.push data if data
+    end
+
+    # Returns [ id1, id2, score ] for the pairs of individuals that are
+    # probably the same person, best first.  Individuals are compared on
+    # their first name, sex, birth and death dates and the names of their
+    # parents and spouses; see GEDCOM::DuplicateFinder.
+    def duplicates( min_score = DuplicateFinder::MIN_SCORE, threads = 1 )
+      finder = DuplicateFinder.new
+      relatives = Hash.new { |h, id| h[ id ] = [] }
+
+      @families.each do |family|
+        next if family.nil?
+        husband, wife = individual( family.husband ), individual( family.wife )
+        relatives[ husband.id ] << wife.name if husband && wife && wife.name
+        relatives[ wife.id ] << husband.name if husband && wife && husband.name
+        family.children.each do |xref|
+          child = individual( xref )
+          next if child.nil?
+          relatives[ child.id ] << husband.name if husband && husband.name
+          relatives[ child.id ] << wife.name if wife && wife.name
+        end
+      end
+
+      @individuals.each do |ind|
+        next if ind.nil? || ind.name.nil?
+        finder.add( ind.id, ind.name, ind.sex, ind.events[ "BIRT" ], ind.events[ "DEAT" ],
+                    relatives.has_key?( ind.id ) ? relatives[ ind.id ] : nil )
+      end
+
+      finder.candidates( min_score, threads )
+    end
+
+    private
+
+    # The keys of the records from GEDCOM.scan_records, in file order
+    def record_keys( scanned )
+      counts = Hash.new( 0 )
+      scanned.collect do |xref, tag|
+        xref ? xref.dup.force_encoding( Encoding.default_external ) : "#{tag}##{counts[ tag ] += 1}"
+      end
+    end
+
+    # Takes the individuals and families of the records +keys+ out of the
+    # indexes.  Their ids stay reserved for the re-parse unless +removed+.
+    def forget( keys, removed )
+      ids = []
+      keys.each do |key|
+        if ( id = @xrefs[ key ] ) && @individuals[ id ]
+          ids << id
+          @individuals[ id ] = nil
+          @xrefs.delete( key ) if removed
+        end
+        if ( id = @family_xrefs[ key ] ) && @families[ id ]
+          @families[ id ] = nil
+          @family_xrefs.delete( key ) if removed
+        end
+      end
+      return if ids.empty?
+      @names.remove( ids )
+      @anniversaries.remove( ids )
+    end
+  end
+end
@@ -0,0 +1,90 @@
+# -------------------------------------------------------------------------
+# gedcom_merge.rb -- three way merge of GEDCOM files by record
+# Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+# -------------------------------------------------------------------------
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2.1 of the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library; if not, write to the Free Software
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+# -------------------------------------------------------------------------
+
+module GEDCOM
+  module Merge
+
+    # [ [ key, text ], ... ] for the records of the file at +path+, keyed
+    # the way GEDCOM.diff keys them
+    def Merge.records( path )
+      records = []
+      seen = Hash.new( 0 )
+      GEDCOM.each_record( path ) do |record|
+        key = ( record.xref || record.tag ).b
+        key += ":#{seen[ key ]}" if ( seen[ key ] += 1 ) > 1
+        records << [ key, record.to_s.b ]
+      end
+      records
+    end
+
+    # { base key => new key or nil if it was removed } and the keys the
+    # other file added.  A renamed record counts as removed and added.
+    def Merge.changes( base, other )
+      changed = {}
+      added = {}
+      GEDCOM.diff( base, other, :subtrees => false ).each do |kind, old_key, new_key|
+        changed[ old_key ] = ( kind == :changed ? new_key : nil ) if old_key
+        added[ new_key ] = true if new_key && kind != :changed
+      end
+      [ changed, added ]
+    end
+  end
+
+  # Merges the files at +ours+ and +theirs+, both edited from the file at
+  # +base+, a record at a time, and writes the result to +io+.  Records
+  # only one side changed, added or removed take that side; records both
+  # sides changed alike are taken once.  Anything else conflicts, keeps
+  # our side and has its key returned.  Records only they added go
+  # before our TRLR.
+  def GEDCOM.merge( base, ours, theirs, io )
+    our_changes, our_additions = Merge.changes( base, ours )
+    their_changes, their_additions = Merge.changes( base, theirs )
+    their_records = {}
+    Merge.records( theirs ).each { |key, text| their_records[ key ] = text }
+    conflicts = []
+    out = []
+
+    Merge.records( ours ).each do |key, text|
+      if our_additions.has_key?( key )
+        conflicts << key if their_additions.has_key?( key ) && their_records[ key ] != text
+        their_additions.delete( key )
+      elsif their_changes.has_key?( key )
+        if our_changes.has_key?( key ) && ( their_changes[ key ].nil? || their_records[ key ] != text )
+          conflicts << key
+        elsif their_changes[ key ].nil?
+          next
+        else
+          text = their_records[ key ]
+        end
+      end
+      out << [ key, text ]
+    end
+
+    our_changes.each do |key, new_key|
+      conflicts << key if new_key.nil? && their_changes.has_key?( key ) && !their_changes[ key ].nil?
+    end
+
+    trailer = ( !out.empty? && out.last[ 1 ] =~ /\A[ \t]*0[ \t]+TRLR/n ) ? out.pop : nil
+    their_additions.each_key { |key| out << [ key, their_records[ key ] ] }
+    out << trailer if trailer
+
+    out.each { |key, text| io.write( text ) }
+    conflicts
+  end
+end
@@ -0,0 +1,445 @@
+# -------------------------------------------------------------------------
+# gedcom_name.rb -- NAME value splitting, phonetic codes and the name index
+# Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+# -------------------------------------------------------------------------
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2.1 of the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library; if not, write to the Free Software
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+# -------------------------------------------------------------------------
+#
+# Pure-Ruby version of ext/gedcom_name.c.  Names are compared on their
+# normalized form: upper case ASCII with the diacritics stripped.
+module GEDCOM
+  module Name
+    SOUNDEX_SIZE = 4
+    DM_SOUNDEX_SIZE = 6
+    MAX_DM_CODES = 16
+
+    # ASCII folding of U+00C0 through U+017F; see foldTable in the C version
+    FOLD_TABLE = "AAAAAAaCEEEEIIIIDNOOOOO OUUUUYts" +
+                 "AAAAAAaCEEEEIIIIDNOOOOO OUUUUYtY" +
+                 "AAAAAACCCCCCCCDDDDEEEEEEEEEEGGGG" +
+                 "GGGGHHHHIIIIIIIIIIiiJJKKKLLLLLLL" +
+                 "LLLNNNNNNNNNOOOOOOooRRRRRRSSSSSS" +
+                 "SSTTTTTTUUUUUUUUUUUUWWYYYZZZZZZS"
+    FOLD_TABLE.freeze
+
+    FOLD_PAIRS = GEDCOM.shareable( { "a" => "AE", "i" => "IJ", "o" => "OE", "s" => "SS", "t" => "TH" } )
+
+    SOUNDEX_CODES = "01230120022455012623010202".freeze
+
+    # [ pattern, at start, before a vowel, anywhere else ]; see dmRules
+    DM_RULES = [
+      [ "AI",       "0",    "1",    ""     ],
+      [ "AJ",       "0",    "1",    ""     ],
+      [ "AY",       "0",    "1",    ""     ],
+      [ "AU",       "0",    "7",    ""     ],
+      [ "A",        "0",    "",     ""     ],
+      [ "B",        "7",    "7",    "7"    ],
+      [ "CHS",      "5",    "54",   "54"   ],
+      [ "CSZ",      "4",    "4",    "4"    ],
+      [ "CZS",      "4",    "4",    "4"    ],
+      [ "CH",       "5|4",  "5|4",  "5|4"  ],
+      [ "CK",       "5|45", "5|45", "5|45" ],
+      [ "CS",       "4",    "4",    "4"    ],
+      [ "CZ",       "4",    "4",    "4"    ],
+      [ "C",        "5|4",  "5|4",  "5|4"  ],
+      [ "DRS",      "4",    "4",    "4"    ],
+      [ "DRZ",      "4",    "4",    "4"    ],
+      [ "DSH",      "4",    "4",    "4"    ],
+      [ "DSZ",      "4",    "4",    "4"    ],
+      [ "DZH",      "4",    "4",    "4"    ],
+      [ "DZS",      "4",    "4",    "4"    ],
+      [ "DS",       "4",    "4",    "4"    ],
+      [ "DT",       "3",    "3",    "3"    ],
+      [ "DZ",       "4",    "4",    "4"    ],
+      [ "D",        "3",    "3",    "3"    ],
+      [ "EI",       "0",    "1",    ""     ],
+      [ "EJ",       "0",    "1",    ""     ],
+      [ "EY",       "0",    "1",    ""     ],
+      [ "EU",       "1",    "1",    ""     ],
+      [ "E",        "0",    "",     ""     ],
+      [ "FB",       "7",    "7",    "7"    ],
+      [ "F",        "7",    "7",    "7"    ],
+      [ "G",        "5",    "5",    "5"    ],
+      [ "H",        "5",    "5",    ""     ],
+      [ "IA",       "1",    "",     ""     ],
+      [ "IE",       "1",    "",     ""     ],
+      [ "IO",       "1",    "",     ""     ],
+      [ "IU",       "1",    "",     ""     ],
+      [ "I",        "0",    "",     ""     ],
+      [ "J",        "1|4",  "|4",   "|4"   ],
+      [ "KH",       "5",    "5",    "5"    ],
+      [ "KS",       "5",    "54",   "54"   ],
+      [ "K",        "5",    "5",    "5"    ],
+      [ "L",        "8",    "8",    "8"    ],
+      [ "MN",       "66",   "66",   "66"   ],
+      [ "M",        "6",    "6",    "6"    ],
+      [ "NM",       "66",   "66",   "66"   ],
+      [ "N",        "6",    "6",    "6"    ],
+      [ "OI",       "0",    "1",    ""     ],
+      [ "OJ",       "0",    "1",    ""     ],
+      [ "OY",       "0",    "1",    ""     ],
+      [ "O",        "0",    "",     ""     ],
+      [ "PF",       "7",    "7",    "7"    ],
+      [ "PH",       "7",    "7",    "7"    ],
+      [ "P",        "7",    "7",    "7"    ],
+      [ "Q",        "5",    "5",    "5"    ],
+      [ "RS",       "4|94", "4|94", "4|94" ],
+      [ "RZ",       "4|94", "4|94", "4|94" ],
+      [ "R",        "9",    "9",    "9"    ],
+      [ "SCHTSCH",  "2",    "4",    "4"    ],
+      [ "SCHTSH",   "2",    "4",    "4"    ],
+      [ "SCHTCH",   "2",    "4",    "4"    ],
+      [ "SHTCH",    "2",    "4",    "4"    ],
+      [ "SHTSH",    "2",    "4",    "4"    ],
+      [ "STSCH",    "2",    "4",    "4"    ],
+      [ "SCHT",     "2",    "43",   "43"   ],
+      [ "SCHD",     "2",    "43",   "43"   ],
+      [ "SHCH",     "2",    "4",    "4"    ],
+      [ "STCH",     "2",    "4",    "4"    ],
+      [ "STRZ",     "2",    "4",    "4"    ],
+      [ "STRS",     "2",    "4",    "4"    ],
+      [ "STSH",     "2",    "4",    "4"    ],
+      [ "SZCZ",     "2",    "4",    "4"    ],
+      [ "SZCS",     "2",    "4",    "4"    ],
+      [ "SCH",      "4",    "4",    "4"    ],
+      [ "SHT",      "2",    "43",   "43"   ],
+      [ "SZT",      "2",    "43",   "43"   ],
+      [ "SHD",      "2",    "43",   "43"   ],
+      [ "SZD",      "2",    "43",   "43"   ],
+      [ "SC",       "2",    "4",    "4"    ],
+      [ "SD",       "2",    "43",   "43"   ],
+      [ "SH",       "4",    "4",    "4"    ],
+      [ "ST",       "2",    "43",   "43"   ],
+      [ "SZ",       "4",    "4",    "4"    ],
+      [ "S",        "4",    "4",    "4"    ],
+      [ "TTSCH",    "4",    "4",    "4"    ],
+      [ "TSCH",     "4",    "4",    "4"    ],
+      [ "TTCH",     "4",    "4",    "4"    ],
+      [ "TTSZ",     "4",    "4",    "4"    ],
+      [ "TCH",      "4",    "4",    "4"    ],
+      [ "TRZ",      "4",    "4",    "4"    ],
+      [ "TRS",      "4",    "4",    "4"    ],
+      [ "TSH",      "4",    "4",    "4"    ],
+      [ "TTS",      "4",    "4",    "4"    ],
+      [ "TTZ",      "4",    "4",    "4"    ],
+      [ "TZS",      "4",    "4",    "4"    ],
+      [ "TSZ",      "4",    "4",    "4"    ],
+      [ "TC",       "4",    "4",    "4"    ],
+      [ "TH",       "3",    "3",    "3"    ],
+      [ "TS",       "4",    "4",    "4"    ],
+      [ "TZ",       "4",    "4",    "4"    ],
+      [ "T",        "3",    "3",    "3"    ],
+      [ "UI",       "0",    "1",    ""     ],
+      [ "UJ",       "0",    "1",    ""     ],
+      [ "UY",       "0",    "1",    ""     ],
+      [ "UE",       "0",    "",     ""     ],
+      [ "U",        "0",    "",     ""     ],
+      [ "V",        "7",    "7",    "7"    ],
+      [ "W",        "7",    "7",    "7"    ],
+      [ "X",        "5",    "54",   "54"   ],
+      [ "Y",        "1",    "",     ""     ],
+      [ "ZHDZH",    "2",    "4",    "4"    ],
+      [ "ZDZH",     "2",    "4",    "4"    ],
+      [ "ZSCH",     "4",    "4",    "4"    ],
+      [ "ZDZ",      "2",    "4",    "4"    ],
+      [ "ZHD",      "2",    "43",   "43"   ],
+      [ "ZSH",      "4",    "4",    "4"    ],
+      [ "ZD",       "2",    "43",   "43"   ],
+      [ "ZH",       "4",    "4",    "4"    ],
+      [ "ZS",       "4",    "4",    "4"    ],
+      [ "Z",        "4",    "4",    "4"    ]
+    ]
+
+    GEDCOM.shareable( DM_RULES )
+    DM_RULES_BY_LETTER = GEDCOM.shareable( DM_RULES.group_by { |rule| rule[ 0 ][ 0, 1 ] } )
+
+    # Splits a "given /surname/ suffix" NAME value into its three parts.  A
+    # value with no slashes is all given name.
+    def Name.split( value )
+      slash1 = value.index( "/" )
+      return [ Name.trim( value ), value[ value.length, 0 ], value[ value.length, 0 ] ] if slash1.nil?
+
+      slash2 = value.index( "/", slash1 + 1 ) || value.length
+      [ Name.trim( value[ 0, slash1 ] ),
+        Name.trim( value[ slash1 + 1 ... slash2 ] ),
+        Name.trim( value[ slash2 + 1 .. -1 ] || value[ value.length, 0 ] ) ]
+    end
+
+    def Name.trim( part )
+      part.sub( /\A[ \t]+/, "" ).sub( /[ \t]+\z/, "" )
+    end
+
+    # Returns +text+ as upper case ASCII with the diacritics stripped and
+    # each run of non-letters turned into a single space.  Letters beyond
+    # Latin Extended-A are kept as they are, and bytes that are not valid
+    # UTF-8 are read as Latin-1.
+    def Name.normalize( text )
+      bytes = text.unpack( "C*" )
+      out = []
+      space = false
+      i = 0
+
+      while i < bytes.length
+        c = bytes[ i ]
+        count = 1
+        fold = nil
+        c -= 32 if c >= 0x61 && c <= 0x7A
+
+        if c >= 0x41 && c <= 0x5A
+          out << 0x20 if space && !out.empty?
+          out << c
+          space = false
+          i += 1
+          next
+        end
+
+        if c < 0x80
+          space = true
+          i += 1
+          next
+        end
+
+        if c >= 0xC2 && c <= 0xDF then count = 2
+        elsif c >= 0xE0 && c <= 0xEF then count = 3
+        elsif c >= 0xF0 && c <= 0xF4 then count = 4
+        end
+
+        ( 1 ... count ).each do |j|
+          if i + j >= bytes.length || ( bytes[ i + j ] & 0xC0 ) != 0x80
+            count = 1
+            break
+          end
+        end
+
+        if count == 1
+          fold = Name.fold_letter( c )
+        elsif count == 2
+          code_point = ( ( c & 0x1F ) << 6 ) | ( bytes[ i + 1 ] & 0x3F )
+          fold = Name.fold_letter( code_point )
+          if fold.nil? && code_point < 0x180
+            space = true
+            i += count
+            next
+          end
+        end
+
+        if fold.nil? && count == 1
+          space = true
+          i += 1
+          next
+        end
+
+        out << 0x20 if space && !out.empty?
+        space = false
+        out.concat( fold ? fold.unpack( "C*" ) : bytes[ i, count ] )
+        i += count
+      end
+
+      out.pack( "C*" )
+    end
+
+    def Name.fold_letter( code_point )
+      return nil if code_point < 0xC0 || code_point > 0x17F
+      letter = FOLD_TABLE[ code_point - 0xC0, 1 ]
+      return nil if letter == " "
+      FOLD_PAIRS[ letter ] || letter
+    end
+
+    # American Soundex of the (normalized) +text+, or "" if it has no
+    # letters.
+    def Name.soundex( text )
+      code = ""
+      last = nil
+
+      Name.normalize( text ).each_byte do |c|
+        next if c < 0x41 || c > 0x5A
+        break if code.length == SOUNDEX_SIZE
+        digit = SOUNDEX_CODES[ c - 0x41, 1 ]
+
+        if code.empty?
+          code << c.chr
+          last = digit
+        elsif digit == "0"
+          last = nil if c != 0x48 && c != 0x57
+        elsif digit != last
+          code << digit
+          last = digit
+        end
+      end
+
+      code.empty? ? code : code.ljust( SOUNDEX_SIZE, "0" )
+    end
+
+    # Daitch-Mokotoff codes of the (normalized) +text+.  A name can have
+    # several codes when some of its letters may be said more than one way.
+    def Name.daitch_mokotoff( text )
+      letters = Name.normalize( text ).delete( "^A-Z" )
+      return [] if letters.empty?
+
+      branches = [ [ "", "" ] ]
+      last_letter = nil
+      i = 0
+
+      while i < letters.length
+        rule = ( DM_RULES_BY_LETTER[ letters[ i, 1 ] ] || [] ).find { |r| letters[ i, r[ 0 ].length ] == r[ 0 ] }
+        if rule.nil?
+          last_letter = letters[ i, 1 ]
+          i += 1
+          next
+        end
+
+        pattern = rule[ 0 ]
+        if i == 0
+          replacement = rule[ 1 ]
+        elsif i + pattern.length < letters.length && "AEIOU".include?( letters[ i + pattern.length, 1 ] )
+          replacement = rule[ 2 ]
+        else
+          replacement = rule[ 3 ]
+        end
+
+        letter = letters[ i, 1 ]
+        force = ( last_letter == "M" && letter == "N" ) || ( last_letter == "N" && letter == "M" )
+
+        alternatives = replacement.split( "|", -1 )
+        alternatives = [ "" ] if alternatives.empty?
+
+        next_branches = []
+        branches.each do |code, last|
+          alternatives.each do |alternative|
+            next if next_branches.length == MAX_DM_CODES
+            if !alternative.empty? && code.length < DM_SOUNDEX_SIZE && ( force || !last.end_with?( alternative ) )
+              next_branches << [ ( code + alternative )[ 0, DM_SOUNDEX_SIZE ], alternative ]
+            else
+              next_branches << [ code, alternative ]
+            end
+          end
+        end
+        branches = next_branches
+
+        last_letter = letter
+        i += pattern.length
+      end
+
+      branches.map { |code, last| code.ljust( DM_SOUNDEX_SIZE, "0" ) }.uniq
+    end
+  end
+
+  # Index over the NAME values of a file.  Each kind of key (normalized
+  # surname, normalized given name, Soundex and Daitch-Mokotoff code of the
+  # surname) is kept as a sorted array of keys with a posting list of ids
+  # per key; the arrays are rebuilt on the first search after an add.
+  class NameIndex
+    def initialize
+      @entries = { :surname => [], :given => [], :soundex => [], :daitch_mokotoff => [] }
+      @sorted = {}
+    end
+
+    # Files +id+ under the parts of the NAME +value+.
+    def add( id, value )
+      given, surname, suffix = Name.split( value )
+
+      surname = Name.normalize( surname )
+      if !surname.empty?
+        add_key( :surname, surname, id )
+        soundex = Name.soundex( surname )
+        add_key( :soundex, soundex, id ) if !soundex.empty?
+        Name.daitch_mokotoff( surname ).each { |code| add_key( :daitch_mokotoff, code, id ) }
+      end
+
+      Name.normalize( given ).split( " " ).each { |name| add_key( :given, name, id ) }
+      self
+    end
+
+    # Returns the ids of the names whose surname starts with +prefix+.
+    def surname( prefix )
+      find( :surname, [ Name.normalize( prefix ) ], true )
+    end
+
+    # Returns the ids of the names with a given name that starts with
+    # +prefix+.
+    def given( prefix )
+      find( :given, [ Name.normalize( prefix ) ], true )
+    end
+
+    # Returns the ids of the surnames that sound like +name+.
+    def soundex( name )
+      code = Name.soundex( name )
+      return [] if code.empty?
+      find( :soundex, [ code ], false )
+    end
+
+    def daitch_mokotoff( name )
+      find( :daitch_mokotoff, Name.daitch_mokotoff( name ), false )
+    end
+
+    # Drops everything filed under the ids in the array +ids+.
+    def remove( ids )
+      removed = {}
+      ids.each { |id| removed[ id ] = true }
+      @entries.each do |kind, entries|
+        @sorted.delete( kind ) if entries.reject! { |key, id| removed.has_key?( id ) }
+      end
+      self
+    end
+
+    private
+
+    def add_key( kind, key, id )
+      @entries[ kind ] << [ key, id ]
+      @sorted.delete( kind )
+    end
+
+    # [ keys, postings ], with postings[ i ] holding the ids filed under keys[ i ]
+    def sorted( kind )
+      @sorted[ kind ] ||= begin
+        keys = []
+        postings = []
+        @entries[ kind ].sort.each do |key, id|
+          if keys.last != key
+            keys << key
+            postings << [ id ]
+          elsif postings.last.last != id
+            postings.last << id
+          end
+        end
+        [ keys, postings ]
+      end
+    end
+
+    def find( kind, search_keys, prefix )
+      keys, postings = sorted( kind )
+      ids = []
+
+      search_keys.each do |key|
+        low, high = 0, keys.length
+        while low < high
+          middle = ( low + high ) / 2
+          if keys[ middle ] < key
+            low = middle + 1
+          else
+            high = middle
+          end
+        end
+
+        while low < keys.length && ( prefix ? keys[ low ][ 0, key.length ] == key : keys[ low ] == key )
+          ids.concat( postings[ low ] )
+          low += 1
+        end
+      end
+
+      ids.sort.uniq
+    end
+  end
+end
@@ -0,0 +1,202 @@
+# -------------------------------------------------------------------------
+# gedcom_parser_stats.rb -- counters a Parser keeps while it parses
+# Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+# -------------------------------------------------------------------------
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2.1 of the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library; if not, write to the Free Software
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+# -------------------------------------------------------------------------
+
+module GEDCOM
+  # What a Parser saw in its current or last parse.  The counters go up as
+  # the parse goes, so they can be read from another thread while it runs.
+  #
+  #   lines, bytes     the lines parsed and their bytes (for
+  #                    Parser#parse_pipelined, only once the parse is done)
+  #   records          level 0 tag => records
+  #   handler_lines    context => { :pre => lines, :post => lines } for the
+  #                    contexts with a handler of their own: the lines handed
+  #                    to each handler, one a call or with Parser#batch_size
+  #                    many to a call
+  #   skipped          subtrees no handler was set for, at any depth, so that
+  #                    only Parser#defaultHandler saw their lines
+  #   dates            with Parser#count_dates, the DATE lines by outcome:
+  #                    the format of the dates that parse (:none, :about,
+  #                    :between, ... as GEDCOM::Date#format) or :bad_calendar,
+  #                    :unreadable (too long, or a NUL byte) or :bad_format
+  #
+  # The wall clock and thread CPU seconds of the parse are always kept;
+  # with Parser#timing they are split between the handlers and the rest
+  # (reading and splitting lines, keeping the context), at the cost of
+  # reading the clocks around each call of a handler of its own.
+  class ParserStats
+    MAX_DATE_SIZE = 256
+
+    CALENDARS = GEDCOM.shareable( { "DGREGORIAN" => DateType::GREGORIAN, "DJULIAN" => DateType::JULIAN,
+                                    "DHEBREW" => DateType::HEBREW, "DFRENCH R" => DateType::FRENCH,
+                                    "DUNKNOWN" => DateType::UNKNOWN } )
+
+    # Date#format => its name, e.g. Date::ABOUT => :about
+    FORMATS = GEDCOM.shareable( Date.constants.collect { |name| [ Date.const_get( name ), name.to_s.downcase.to_sym ] }.to_h )
+
+    ESCAPE = /\A@#([^@]*)@[ \t]*(.*)\z/mn
+
+    attr_accessor :lines, :bytes, :skipped, :handler_wall_seconds, :handler_cpu_seconds
+    attr_reader :records, :dates
+
+    def initialize
+      @lines = @bytes = @skipped = 0
+      @records = Hash.new( 0 )
+      @dates = Hash.new( 0 )
+      @handlers = {}
+      @handler_wall_seconds = @handler_cpu_seconds = nil
+      @wall = @cpu = nil
+      @finished_wall = @finished_cpu = nil
+    end
+
+    # Adds a counter pair [ pre lines, post lines ] for +context+, nil on a
+    # side with no handler.  The parser counts into the pair.
+    def watch( context, counts )
+      @handlers[ context ] = counts
+    end
+
+    def handler_lines
+      result = {}
+      @handlers.each do |context, ( pre, post )|
+        lines = {}
+        lines[ :pre ] = pre if pre
+        lines[ :post ] = post if post
+        result[ context ] = lines
+      end
+      result
+    end
+
+    def start( timing )
+      @handler_wall_seconds = @handler_cpu_seconds = 0.0 if timing
+      @wall = ParserStats.wall_clock
+      @cpu = ParserStats.cpu_clock
+    end
+
+    def finish
+      @finished_wall = ParserStats.wall_clock
+      @finished_cpu = ParserStats.cpu_clock
+    end
+
+    def running?
+      !@wall.nil? && @finished_wall.nil?
+    end
+
+    # Seconds from the start of the parse to its end, or to now while it
+    # runs
+    def wall_seconds
+      return 0.0 if @wall.nil?
+      ( @finished_wall || ParserStats.wall_clock ) - @wall
+    end
+
+    # CPU seconds of the thread running the parse.  The reader thread of
+    # Parser#parse_pipelined is not counted.
+    def cpu_seconds
+      return 0.0 if @cpu.nil?
+      ( @finished_cpu || ParserStats.cpu_clock ) - @cpu
+    end
+
+    # The rest, when the handlers were timed, or nil
+    def scan_wall_seconds
+      @handler_wall_seconds && wall_seconds - @handler_wall_seconds
+    end
+
+    def scan_cpu_seconds
+      @handler_cpu_seconds && cpu_seconds - @handler_cpu_seconds
+    end
+
+    # Counts the outcome of reading +text+, the value of a DATE line, as a
+    # date, which may start with a calendar escape
+    def count_date( text )
+      calendar = DateType::DEFAULT
+      if text.start_with?( "@#" )
+        match = ESCAPE.match( text )
+        return @dates[ :bad_calendar ] += 1 if match.nil? || !CALENDARS.has_key?( match[ 1 ] )
+        text, calendar = match[ 2 ], CALENDARS[ match[ 1 ] ]
+      end
+      return @dates[ :unreadable ] += 1 if text.bytesize >= MAX_DATE_SIZE || text.include?( "\0" )
+
+      date = Date.try_parse( text, calendar ) { |error| return @dates[ :bad_format ] += 1 }
+      @dates[ FORMATS[ date.format ] ] += 1
+    end
+
+    def to_h
+      { :lines => @lines,
+        :bytes => @bytes,
+        :records => @records.dup,
+        :handler_lines => handler_lines,
+        :skipped => @skipped,
+        :dates => @dates.dup,
+        :wall_seconds => wall_seconds,
+        :cpu_seconds => cpu_seconds,
+        :handler_wall_seconds => @handler_wall_seconds,
+        :handler_cpu_seconds => @handler_cpu_seconds,
+        :scan_wall_seconds => scan_wall_seconds,
+        :scan_cpu_seconds => scan_cpu_seconds }
+    end
+
+    # The counters in the Prometheus text exposition format, the metric
+    # names starting with +prefix+ and every sample carrying the +labels+
+    # Hash as well (e.g. { "worker" => "3" })
+    def to_prometheus( prefix = "gedcom_parser", labels = {} )
+      out = ""
+      metric = lambda do |name, type, help, samples|
+        out << "# HELP #{prefix}_#{name} #{help}\n# TYPE #{prefix}_#{name} #{type}\n"
+        samples.each do |sample_labels, value|
+          out << "#{prefix}_#{name}#{ParserStats.labels( labels.merge( sample_labels ) )} #{value}\n"
+        end
+      end
+
+      metric.call( "lines_total", "counter", "Lines parsed.", [ [ {}, @lines ] ] )
+      metric.call( "bytes_total", "counter", "Bytes parsed.", [ [ {}, @bytes ] ] )
+      metric.call( "records_total", "counter", "Records by level 0 tag.",
+                   @records.collect { |tag, count| [ { "tag" => tag.to_s }, count ] } )
+      metric.call( "handler_lines_total", "counter", "Lines handed to each handler.",
+                   handler_lines.collect_concat do |context, lines|
+                     lines.collect { |side, count| [ { "context" => context.join( "/" ), "handler" => side.to_s }, count ] }
+                   end )
+      metric.call( "skipped_subtrees_total", "counter", "Subtrees with no handler.", [ [ {}, @skipped ] ] )
+      metric.call( "dates_total", "counter", "DATE lines by outcome.",
+                   @dates.collect { |outcome, count| [ { "outcome" => outcome.to_s }, count ] } )
+
+      seconds = [ [ { "clock" => "wall", "phase" => "total" }, wall_seconds ],
+                  [ { "clock" => "cpu", "phase" => "total" }, cpu_seconds ] ]
+      if @handler_wall_seconds
+        seconds += [ [ { "clock" => "wall", "phase" => "handlers" }, @handler_wall_seconds ],
+                     [ { "clock" => "wall", "phase" => "scan" }, scan_wall_seconds ],
+                     [ { "clock" => "cpu", "phase" => "handlers" }, @handler_cpu_seconds ],
+                     [ { "clock" => "cpu", "phase" => "scan" }, scan_cpu_seconds ] ]
+      end
+      metric.call( "seconds_total", "counter", "Seconds spent parsing.", seconds )
+
+      out
+    end
+
+    def ParserStats.labels( labels )
+      return "" if labels.empty?
+      "{" + labels.collect { |name, value| "#{name}=\"#{value.to_s.gsub( /[\\"\n]/ ) { |c| c == "\n" ? "\\n" : "\\" + c }}\"" }.join( "," ) + "}"
+    end
+
+    def ParserStats.wall_clock
+      Process.clock_gettime( Process::CLOCK_MONOTONIC )
+    end
+
+    def ParserStats.cpu_clock
+      Process.clock_gettime( Process::CLOCK_THREAD_CPUTIME_ID )
+    end
+  end
+end
@@ -0,0 +1,199 @@
+# -------------------------------------------------------------------------
+# gedcom_pipeline.rb -- reader thread handing line events to the parser
+# Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+# -------------------------------------------------------------------------
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2.1 of the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library; if not, write to the Free Software
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+# -------------------------------------------------------------------------
+#
+# Pure-Ruby version of ext/gedcom_pipeline.c.  The reader thread splits
+# the lines of about 64k of the file at a time and hands each batch over
+# through a SizedQueue of 'slots' batches, which holds it back when the
+# handlers fall behind as the ring does.  Under the interpreter lock the
+# two threads take turns rather than overlap, but the events are the same.
+module GEDCOM
+  PIPELINE_SLOTS = 8
+
+  module Pipeline
+    CHUNK = 64 * 1024
+    MAX_SLOTS = 64
+
+    # [ level, tag, data ] of a line, split as Parser#parse_lines does
+    def Pipeline.split( line )
+      level, tag, rest = line.chomp.split( ' ', 3 )
+      tag, rest = rest, tag if tag =~ /@.*@/
+      [ level.to_i, tag, rest ]
+    end
+
+    # Runs the reader thread over the file at +path+ and yields the events
+    # of each batch it hands over; returns the counters.
+    def Pipeline.run( path, slots )
+      slots ||= PIPELINE_SLOTS
+      raise ArgumentError, "slots must be at least 1" if slots < 1
+
+      stats = { :events => 0, :batches => 0, :bytes => 0, :threaded => true,
+                :reader_stalls => 0, :reader_stall_seconds => 0.0,
+                :handler_stalls => 0, :handler_stall_seconds => 0.0 }
+      queue = SizedQueue.new( [ slots, MAX_SLOTS ].min )
+
+      File.open( path, "r" ) do |file|
+        reader = Thread.new { read( file, queue, stats ) }
+        begin
+          while ( batch = pop( queue, stats ) )
+            events, bytes = batch
+            stats[ :events ] += events.length
+            stats[ :batches ] += 1
+            stats[ :bytes ] += bytes
+            yield events
+          end
+        ensure
+          queue.close
+          error = reader.value
+        end
+        raise error if error
+      end
+
+      stats
+    end
+
+    def Pipeline.now
+      Process.clock_gettime( Process::CLOCK_MONOTONIC )
+    end
+
+    # Runs on the reader thread; returns the exception that stopped it, if
+    # any, for the consumer to raise.
+    def Pipeline.read( file, queue, stats )
+      events, bytes = [], 0
+      file.each_line do |line|
+        events << split( line )
+        bytes += line.bytesize
+        if bytes >= CHUNK
+          push( queue, [ events, bytes ], stats )
+          events, bytes = [], 0
+        end
+      end
+      push( queue, [ events, bytes ], stats ) if !events.empty?
+      nil
+    rescue ClosedQueueError
+      nil
+    rescue Exception => error
+      error
+    ensure
+      queue.close
+    end
+
+    def Pipeline.push( queue, batch, stats )
+      queue.push( batch, true )
+    rescue ThreadError
+      start = now
+      queue.push( batch )
+      stats[ :reader_stalls ] += 1
+      stats[ :reader_stall_seconds ] += now - start
+    end
+
+    def Pipeline.pop( queue, stats )
+      return queue.pop if !queue.empty? || queue.closed?
+      start = now
+      batch = queue.pop
+      stats[ :handler_stalls ] += 1
+      stats[ :handler_stall_seconds ] += now - start
+      batch
+    end
+  end
+
+  # A batch of the events each_event_batch reads, column by column.  The
+  # same object is refilled for every batch, so it can only be used within
+  # the block it was yielded to.
+  class EventBatch
+    include Enumerable
+
+    # Used by each_event_batch: the events the batch stands for, or nil
+    # once its block has returned.
+    def fill( events )
+      @events = events
+    end
+
+    def length
+      events.length
+    end
+    alias size length
+
+    def level( index )
+      event = events[ index ]
+      event && event[ 0 ]
+    end
+
+    def tag( index )
+      event = events[ index ]
+      event && event[ 1 ]
+    end
+
+    def value( index )
+      event = events[ index ]
+      event && event[ 2 ]
+    end
+
+    def levels
+      events.collect { |event| event[ 0 ] }
+    end
+
+    def tags
+      events.collect { |event| event[ 1 ] }
+    end
+
+    def values
+      events.collect { |event| event[ 2 ] }
+    end
+
+    def each
+      return to_enum( :each ) if !block_given?
+      events.each { |level, tag, value| yield level, tag, value }
+      self
+    end
+
+    private
+
+    def events
+      raise RuntimeError, "event batch used outside its each_event_batch block" if @events.nil?
+      @events
+    end
+  end
+
+  # Yields the level, tag and data of each line of the file at +path+ as
+  # Parser#parse_lines splits them, while a reader thread reads and splits
+  # the lines ahead in batches, at most +slots+ batches ahead.  Returns a
+  # Hash of counters: the events, batches and bytes handed over, whether a
+  # reader thread was used, and how often and how long the reader waited
+  # for a free slot and the handlers for a batch.
+  def GEDCOM.each_event( path, slots = PIPELINE_SLOTS )
+    raise LocalJumpError, "no block given" if !block_given?
+    Pipeline.run( path, slots ) do |events|
+      events.each { |level, tag, data| yield level, tag, data }
+    end
+  end
+
+  # The same, yielding each batch as one EventBatch rather than each event.
+  def GEDCOM.each_event_batch( path, slots = PIPELINE_SLOTS )
+    raise LocalJumpError, "no block given" if !block_given?
+    batch = EventBatch.new
+    Pipeline.run( path, slots ) do |events|
+      batch.fill( events )
+      begin
+        yield batch
+      ensure
+        batch.fill( nil )
+      end
+    end
+  end
+end
@@ -0,0 +1,252 @@
+# -------------------------------------------------------------------------
+# gedcom_query.rb -- path queries over the lines of a file
+# Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+# -------------------------------------------------------------------------
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2.1 of the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library; if not, write to the Free Software
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+# -------------------------------------------------------------------------
+#
+# Pure-Ruby version of ext/gedcom_query.c, which describes the syntax.  It
+# compiles and matches the same way, with one state per level of the
+# current record.
+module GEDCOM
+  class Query
+    MAX_STEPS = 16
+    MAX_LEVELS = 2 * MAX_STEPS
+    MAX_TAG_SIZE = 32
+    MAX_OPERAND_SIZE = Export::MAX_DATE_SIZE
+
+    LINE = /\A[ \t]*(\d+)[ \t]*(?:(@[^ \t\r\n]*)[ \t]*)?([^ \t\r\n]*)[ \t]*(.*?)[\r\n]*\z/mn
+    TAG = /\G(?:\*|[A-Za-z0-9_]+)/n
+    BLANKS = /\G[ \t]*/n
+    OPERATORS = GEDCOM.shareable( [ "<=", ">=", "!=", "<", ">", "=" ] )
+
+    Step = Struct.new( :tag, :cond, :op, :text, :operand, :first, :last )
+
+    # The state of one pass over a text, kept apart from the compiled steps
+    # (as gedQUERYRUN_t is) so that a query can be frozen and shared
+    Run = Struct.new( :xref, :record, :depth, :alive, :conds, :open )
+
+    # Compiles +source+, raising ArgumentError where it stops making sense.
+    def initialize( source )
+      @source = source.b
+      raise ArgumentError, "string contains null byte" if @source.include?( "\0" )
+      @steps = []
+      @pos = 0
+
+      loop do
+        skip_blanks
+        error if @steps.length == MAX_STEPS
+        step = Step.new( nil, [] )
+        step.tag = ( @steps.empty? && @source[ @pos ] == "@" ) ? read_xref : read_tag
+        error if step.tag.nil?
+        @steps << step
+
+        skip_blanks
+        if @source[ @pos ] == "["
+          @pos += 1
+          read_condition( step )
+          skip_blanks
+        end
+
+        break if @pos == @source.bytesize
+        error if @source[ @pos ] != "."
+        @pos += 1
+      end
+    end
+
+    # Yields [ xref, value ] for each match in +text+, with a nil xref for
+    # records that have none.
+    def each( text )
+      return to_enum( :each, text ) if !block_given?
+
+      binary = text.b
+      matches = []
+      run = Run.new( nil, nil, -1, [], [], {} )
+
+      offset = 0
+      binary.each_line( "\n" ) do |line|
+        match = LINE.match( line )
+        if match
+          level = match[ 1 ].to_i
+          close_steps( run, level, matches )
+
+          if level == 0
+            matches.each { |pair| yield pair }
+            matches.clear
+            run.xref = match[ 2 ]
+            run.record = run.xref && text.byteslice( offset + match.begin( 2 ), run.xref.bytesize )
+          end
+
+          # a line deeper than one below the last is not part of the tree
+          skipped = level > run.depth + 1
+          run.depth = level
+
+          match_line( run, level, match[ 3 ], match[ 4 ], skipped, matches ) do
+            text.byteslice( offset + match.begin( 4 ), match[ 4 ].bytesize )
+          end
+        end
+        offset += line.bytesize
+      end
+
+      close_steps( run, 0, matches )
+      matches.each { |pair| yield pair }
+      self
+    end
+
+    # Returns [ xref, value ] for each match in +text+.
+    def run( text )
+      each( text ).to_a
+    end
+
+    private
+
+    def error
+      raise ArgumentError, "bad query at '#{@source.byteslice( @pos..-1 )}'"
+    end
+
+    def skip_blanks
+      @pos = BLANKS.match( @source, @pos ).end( 0 )
+    end
+
+    def read_tag
+      match = TAG.match( @source, @pos )
+      return nil if match.nil? || match[ 0 ].bytesize >= MAX_TAG_SIZE
+      @pos = match.end( 0 )
+      match[ 0 ]
+    end
+
+    def read_xref
+      close = @source.index( "@", @pos + 1 )
+      return nil if close.nil? || close - @pos + 1 >= MAX_TAG_SIZE
+      tag = @source.byteslice( @pos..close )
+      @pos = close + 1
+      tag
+    end
+
+    def read_condition( step )
+      loop do
+        skip_blanks
+        tag = ( step.cond.length < MAX_STEPS ) ? read_tag : nil
+        error if tag.nil?
+        step.cond << tag
+
+        skip_blanks
+        break if @source[ @pos ] != "."
+        @pos += 1
+      end
+
+      if @source[ @pos ] == "]"
+        @pos += 1
+        return
+      end
+
+      step.op = OPERATORS.find { |op| @source[ @pos, op.length ] == op }
+      error if step.op.nil?
+      @pos += step.op.length
+      skip_blanks
+
+      if @source[ @pos ] == '"'
+        close = @source.index( '"', @pos + 1 )
+        error if ( step.op != "=" && step.op != "!=" ) || close.nil? || close - @pos - 1 >= MAX_OPERAND_SIZE
+        step.text = true
+        step.operand = @source.byteslice( @pos + 1...close )
+
+        @pos = close + 1
+        skip_blanks
+        error if @source[ @pos ] != "]"
+        @pos += 1
+        return
+      end
+
+      close = @source.index( "]", @pos )
+      if close.nil?
+        @pos = @source.bytesize
+        error
+      end
+
+      step.operand = @source.byteslice( @pos...close ).sub( /[ \t]+\z/n, "" )
+      error if step.operand.empty? || step.operand.bytesize >= MAX_OPERAND_SIZE
+      date = Export.parse_date_text( step.operand )
+      error if date.nil?
+      step.first, step.last = Export.date_days( date )
+      error if step.first == 0 || step.last == 0
+      @pos = close + 1
+    end
+
+    def tag?( name, tag )
+      name == "*" || name == tag
+    end
+
+    def test_value( step, value )
+      return true if step.op.nil?
+      return ( value == step.operand ) == ( step.op == "=" ) if step.text
+
+      date = Export.parse_date_text( value )
+      return false if date.nil?
+      first, last = Export.date_days( date )
+
+      case step.op
+      when "<" then last != 0 && last < step.first
+      when "<=" then last != 0 && last <= step.last
+      when ">" then first != 0 && first > step.last
+      when ">=" then first != 0 && first >= step.first
+      when "=" then first != 0 && last != 0 && first >= step.first && last <= step.last
+      when "!=" then ( last != 0 && last < step.first ) || ( first != 0 && first > step.last )
+      end
+    end
+
+    # Ends the subtrees of the waiting lines at +level+ and deeper, dropping
+    # the matches below those whose condition never held.  run.open maps
+    # the step of each waiting line to [ first match below it, satisfied ].
+    def close_steps( run, level, matches )
+      ( @steps.length - 1 ).downto( level ) do |step|
+        start, satisfied = run.open.delete( step )
+        matches.slice!( start..-1 ) if start && !satisfied
+      end
+    end
+
+    def match_line( run, level, tag, value, skipped, matches )
+      return if level >= MAX_LEVELS
+      alive = false
+      conds = []
+
+      if !skipped
+        if level < @steps.length && ( level == 0 || run.alive[ level - 1 ] )
+          step = @steps[ level ]
+          alive = step.tag.start_with?( "@" ) ? run.xref == step.tag : tag?( step.tag, tag )
+        end
+
+        # advance the conditions of the waiting lines above this one
+        run.open.each do |f, state|
+          step = @steps[ f ]
+          depth = level - f
+          next if depth > step.cond.length
+          next if depth > 1 && !run.conds[ level - 1 ].include?( f )
+          next if !tag?( step.cond[ depth - 1 ], tag )
+          conds << f
+          state[ 1 ] = true if depth == step.cond.length && test_value( step, value )
+        end
+      end
+
+      run.alive[ level ] = alive
+      run.conds[ level ] = conds
+
+      if alive
+        run.open[ level ] = [ matches.length, false ] if !@steps[ level ].cond.empty?
+        matches << [ run.record, yield ] if level == @steps.length - 1
+      end
+    end
+  end
+end
@@ -0,0 +1,62 @@
+# -------------------------------------------------------------------------
+# gedcom_record.rb -- splits a file into hashed level 0 records
+# Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+# -------------------------------------------------------------------------
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2.1 of the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library; if not, write to the Free Software
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+# -------------------------------------------------------------------------
+#
+#
+# Pure-Ruby version of the scanner in ext/gedcom_record.c.  The C version
+# hashes each record with XXH64; this one takes the first 64 bits of its
+# MD5 instead, so the two only agree with themselves.
+require 'digest/md5'
+
+module GEDCOM
+  LEVEL0 = /\A[ \t]*0(?:[ \t]+|(?=[\r\n])|\z)(?:(@[^ \t\r\n]*)[ \t]*)?([^ \t\r\n]*)/n
+
+  # Returns [ xref, tag, offset, length, hash ] for each level 0 record of
+  # +text+, xref being nil for records that have none.  Offsets and lengths
+  # are in bytes; anything before the first level 0 line belongs to the
+  # first record.
+  def GEDCOM.scan_records( text )
+    text = text.dup.force_encoding( "BINARY" )
+    records = []
+    current = nil
+    offset = 0
+
+    text.each_line( "\n" ) do |line|
+      if ( match = LEVEL0.match( line ) )
+        if current.nil?
+          current = [ match[ 1 ], match[ 2 ], 0 ]
+        else
+          records << current
+          current = [ match[ 1 ], match[ 2 ], offset ]
+        end
+      end
+      offset += line.bytesize
+    end
+
+    current ||= [ nil, "", 0 ] if offset > 0
+    records << current if current
+
+    records.each_with_index do |record, i|
+      stop = ( i + 1 < records.length ) ? records[ i + 1 ][ 2 ] : offset
+      record << stop - record[ 2 ]
+      record << Digest::MD5.digest( text.byteslice( record[ 2 ], record[ 3 ] ) ).unpack( "Q>" ).first
+    end
+
+    records
+  end
+end
@@ -0,0 +1,234 @@
+# -------------------------------------------------------------------------
+# gedcom_sqlite.rb -- bulk loader into SQLite
+# Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+# -------------------------------------------------------------------------
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2.1 of the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library; if not, write to the Free Software
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+# -------------------------------------------------------------------------
+#
+# Pure-Ruby version of the loader in ext/gedcom_sqlite.c, writing the same
+# tables and rows through the sqlite3 gem.  GEDCOM.to_sqlite is only
+# defined if the gem can be loaded.
+begin
+  require 'sqlite3'
+rescue LoadError
+end
+
+module GEDCOM
+  module SQLiteLoader
+    ROUND = 16384
+    MAX_NAME_SIZE = 256
+
+    TABLES = GEDCOM.shareable( [ :individuals, :families, :names, :events, :links ] )
+
+    SCHEMA = <<-SQL.freeze
+      PRAGMA synchronous = OFF;
+      PRAGMA journal_mode = MEMORY;
+      DROP TABLE IF EXISTS individuals;
+      DROP TABLE IF EXISTS families;
+      DROP TABLE IF EXISTS names;
+      DROP TABLE IF EXISTS events;
+      DROP TABLE IF EXISTS links;
+      CREATE TABLE individuals ( id INTEGER PRIMARY KEY, xref TEXT, sex TEXT );
+      CREATE TABLE families ( id INTEGER PRIMARY KEY, xref TEXT );
+      CREATE TABLE names ( individual INTEGER, position INTEGER, name TEXT, given TEXT, surname TEXT,
+        suffix TEXT, surname_key TEXT );
+      CREATE TABLE events ( id INTEGER PRIMARY KEY, individual INTEGER, family INTEGER, tag TEXT, date TEXT,
+        sort_key INTEGER, first_day INTEGER, last_day INTEGER, place TEXT );
+      CREATE TABLE links ( family INTEGER, role TEXT, xref TEXT, individual INTEGER );
+    SQL
+
+    INSERTS = GEDCOM.shareable( [ "INSERT INTO individuals VALUES ( ?, ?, ? )",
+                                  "INSERT INTO families VALUES ( ?, ? )",
+                                  "INSERT INTO names VALUES ( ?, ?, ?, ?, ?, ?, ? )",
+                                  "INSERT INTO events VALUES ( ?, ?, ?, ?, ?, ?, ?, ?, ? )",
+                                  "INSERT INTO links VALUES ( ?, ?, ?, NULL )" ] )
+
+    INDEXES = <<-SQL.freeze
+      BEGIN;
+      CREATE INDEX individuals_xref ON individuals ( xref );
+      CREATE INDEX families_xref ON families ( xref );
+      CREATE INDEX names_individual ON names ( individual );
+      CREATE INDEX names_surname_key ON names ( surname_key );
+      CREATE INDEX events_individual ON events ( individual );
+      CREATE INDEX events_family ON events ( family );
+      CREATE INDEX events_sort_key ON events ( sort_key );
+      CREATE INDEX events_days ON events ( first_day, last_day );
+      UPDATE links SET individual = ( SELECT id FROM individuals WHERE individuals.xref = links.xref );
+      CREATE INDEX links_family ON links ( family );
+      CREATE INDEX links_individual ON links ( individual );
+      COMMIT;
+    SQL
+
+    PERSON_EVENTS = {}
+    [ "ADOP", "BAPM", "BARM", "BASM", "BIRT", "BLES", "BURI", "CENS", "CHR", "CHRA", "CONF", "CREM",
+      "DEAT", "EMIG", "EVEN", "FCOM", "GRAD", "IMMI", "NATU", "ORDN", "PROB", "RESI", "RETI", "WILL" ].each do |tag|
+      PERSON_EVENTS[ tag.b ] = true
+    end
+    PERSON_EVENTS.freeze
+
+    FAMILY_EVENTS = {}
+    [ "ANUL", "CENS", "DIV", "DIVF", "ENGA", "EVEN", "MARB", "MARC", "MARL", "MARR", "MARS", "RESI" ].each do |tag|
+      FAMILY_EVENTS[ tag.b ] = true
+    end
+    FAMILY_EVENTS.freeze
+
+    LINKS = GEDCOM.shareable( { "HUSB".b => true, "WIFE".b => true, "CHIL".b => true } )
+
+    # Text as the C version binds it: NULL if empty.  Binary strings would
+    # go in as blobs.
+    def SQLiteLoader.text( value )
+      value.nil? || value.empty? ? nil : value.dup.force_encoding( Encoding::UTF_8 )
+    end
+
+    # NULL if 0 (not known)
+    def SQLiteLoader.number( value )
+      value == 0 ? nil : value
+    end
+
+    class Loader
+      attr_reader :counts
+
+      def initialize( db )
+        @statements = INSERTS.collect { |sql| db.prepare( sql ) }
+        @counts = Array.new( TABLES.length, 0 )
+      end
+
+      def close
+        @statements.each { |statement| statement.close }
+      end
+
+      def insert( table, *values )
+        @statements[ table ].execute( *values )
+        @counts[ table ] += 1
+      end
+
+      def person( nodes )
+        root = nodes[ 0 ]
+        id = @counts[ 0 ] + 1
+        sex = nil
+        names = 0
+
+        root.children.each do |child|
+          node = nodes[ child ]
+          if node.tag == "NAME"
+            name( node, id, names )
+            names += 1
+          elsif PERSON_EVENTS.has_key?( node.tag )
+            event( nodes, node, true, id )
+          elsif node.tag == "SEX"
+            sex ||= node
+          end
+        end
+
+        insert( 0, id, SQLiteLoader.text( root.xref ), SQLiteLoader.text( sex && sex.value ) )
+      end
+
+      def family( nodes )
+        root = nodes[ 0 ]
+        id = @counts[ 1 ] + 1
+
+        root.children.each do |child|
+          node = nodes[ child ]
+          if LINKS.has_key?( node.tag )
+            insert( 4, id, SQLiteLoader.text( node.tag ), SQLiteLoader.text( node.value ) )
+          elsif FAMILY_EVENTS.has_key?( node.tag )
+            event( nodes, node, false, id )
+          end
+        end
+
+        insert( 1, id, SQLiteLoader.text( root.xref ) )
+      end
+
+      # Names too long to split are kept whole.
+      def name( node, id, position )
+        value = node.value
+        given = surname = suffix = key = nil
+        if value.bytesize < MAX_NAME_SIZE && !value.include?( "\0" )
+          given, surname, suffix = Name.split( value )
+          key = Name.normalize( surname )
+        end
+
+        insert( 2, id, position, SQLiteLoader.text( value ), SQLiteLoader.text( given ), SQLiteLoader.text( surname ),
+                SQLiteLoader.text( suffix ), SQLiteLoader.text( key ) )
+      end
+
+      # An event with its first DATE and PLAC
+      def event( nodes, event, person, id )
+        date = place = nil
+        event.children.each do |child|
+          node = nodes[ child ]
+          if node.tag == "DATE"
+            date ||= node.value
+          elsif node.tag == "PLAC"
+            place ||= node.value
+          end
+        end
+
+        sort_key = first = last = 0
+        value = date && Export.parse_date_text( date )
+        if value && value.format <= Date::INTERPRETED
+          sort_key = Export.sort_key( value.first )
+          first, last = Export.date_days( value )
+        end
+
+        insert( 3, @counts[ 3 ] + 1, person ? id : nil, person ? nil : id, SQLiteLoader.text( event.tag ),
+                SQLiteLoader.text( date ), SQLiteLoader.number( sort_key ), SQLiteLoader.number( first ),
+                SQLiteLoader.number( last ), SQLiteLoader.text( place ) )
+      end
+    end
+  end
+
+  if defined?( ::SQLite3::Database )
+    # Loads the people and families of the file at +path+ into the SQLite
+    # database at +db_path+ and returns the rows added to each table.  See
+    # ext/gedcom_sqlite.c for the tables.
+    def GEDCOM.to_sqlite( path, db_path )
+      path, db_path = File.path( path ), File.path( db_path )
+      file = File.open( path, "rb" )
+      begin
+        db = ::SQLite3::Database.new( db_path )
+        db.execute_batch( SQLiteLoader::SCHEMA )
+        loader = SQLiteLoader::Loader.new( db )
+        reader = RecordReader.new
+        records = 0
+
+        db.execute( "BEGIN" )
+        reader.each( file ) do |root|
+          if root.tag == "INDI"
+            loader.person( reader.nodes )
+          elsif root.tag == "FAM"
+            loader.family( reader.nodes )
+          end
+          if ( records += 1 ) % SQLiteLoader::ROUND == 0
+            db.execute( "COMMIT" )
+            db.execute( "BEGIN" )
+          end
+        end
+        db.execute( "COMMIT" )
+        db.execute_batch( SQLiteLoader::INDEXES )
+      rescue ::SQLite3::Exception => error
+        raise RuntimeError, "sqlite: #{error.message}"
+      ensure
+        loader.close if loader
+        db.close if db
+        file.close
+      end
+
+      counts = {}
+      SQLiteLoader::TABLES.each_with_index { |table, i| counts[ table ] = loader.counts[ i ] }
+      counts
+    end
+  end
+end
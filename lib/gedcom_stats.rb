@@ -0,0 +1,168 @@
+# -------------------------------------------------------------------------
+# gedcom_stats.rb -- one pass statistics of a file
+# Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+# -------------------------------------------------------------------------
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2.1 of the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library; if not, write to the Free Software
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+# -------------------------------------------------------------------------
+#
+# Pure-Ruby version of the collector in ext/gedcom_stats.c, giving the
+# same counts.  The :threads option is accepted and ignored.
+module GEDCOM
+  module Stats
+    LEVELS = 100
+    MAX_YEAR = 9999
+    MAX_NAME_SIZE = 256
+
+    # The event tags and which records have them: 1 for INDI, 2 for FAM
+    EVENTS = {}
+    [ [ "ADOP", 1 ], [ "ANUL", 2 ], [ "BAPM", 1 ], [ "BARM", 1 ], [ "BASM", 1 ], [ "BIRT", 1 ], [ "BLES", 1 ],
+      [ "BURI", 1 ], [ "CENS", 3 ], [ "CHR", 1 ], [ "CHRA", 1 ], [ "CONF", 1 ], [ "CREM", 1 ], [ "DEAT", 1 ],
+      [ "DIV", 2 ], [ "DIVF", 2 ], [ "EMIG", 1 ], [ "ENGA", 2 ], [ "EVEN", 3 ], [ "FCOM", 1 ], [ "GRAD", 1 ],
+      [ "IMMI", 1 ], [ "MARB", 2 ], [ "MARC", 2 ], [ "MARL", 2 ], [ "MARR", 2 ], [ "MARS", 2 ], [ "NATU", 1 ],
+      [ "ORDN", 1 ], [ "PROB", 1 ], [ "RESI", 3 ], [ "RETI", 1 ], [ "WILL", 1 ] ].each do |tag, records|
+      EVENTS[ tag.b ] = records
+    end
+    EVENTS.freeze
+
+    # By Date#format, then dates that do not parse
+    QUALIFIERS = GEDCOM.shareable( [ :none, :about, :calculated, :estimated, :before, :after, :between, :from,
+                                     :to, :fromto, :interpreted, :child, :cleared, :completed, :infant, :pre1970,
+                                     :qualified, :stillborn, :submitted, :uncleared, :bic, :dns, :dnscan, :dead,
+                                     :invalid ] )
+
+    CALENDARS = GEDCOM.shareable( { DateType::GREGORIAN => :gregorian, DateType::JULIAN => :julian,
+                                    DateType::HEBREW => :hebrew, DateType::FRENCH => :french,
+                                    DateType::FUTURE => :future, DateType::UNKNOWN => :unknown } )
+
+    LEVEL = /\A[ \t]*(\d*)/n
+    TOKEN = /\A([^ \t]*)[ \t]*/n
+
+    # The counts of one file, line by line
+    class Counter
+      def initialize
+        @lines = @malformed = 0
+        @records = Hash.new( 0 )
+        @tags = Hash.new( 0 )
+        @surnames = Hash.new( 0 )
+        @levels = Array.new( LEVELS, 0 )
+        @depths = Array.new( LEVELS, 0 )
+        @dates = Hash.new( 0 )
+        @calendars = Hash.new( 0 )
+        @events = {}
+
+        # the record kind (0 for other records, -1 before the first), its
+        # deepest level, and the event being read and whether it had its
+        # DATE yet
+        @kind = -1
+        @depth = 0
+        @event = nil
+        @dated = false
+      end
+
+      def count( text )
+        text = text.sub( /[\r\n]+\z/n, "" )
+        @lines += 1
+
+        digits = LEVEL.match( text )
+        rest = digits.post_match
+        return @malformed += 1 if digits[ 1 ].empty? || digits[ 1 ].length > 2 || rest !~ /\A[ \t]/n
+        level = digits[ 1 ].to_i
+
+        rest = rest.sub( /\A[ \t]+/n, "" )
+        rest = TOKEN.match( rest ).post_match if rest.start_with?( "@" )
+        token = TOKEN.match( rest )
+        tag, value = token[ 1 ], token.post_match
+        return @malformed += 1 if tag.empty?
+
+        @levels[ level ] += 1
+        @tags[ tag ] += 1
+
+        if level == 0
+          @depths[ @depth ] += 1 if @kind >= 0
+          @kind = ( tag == "INDI" ) ? 1 : ( tag == "FAM" ) ? 2 : 0
+          @depth = 0
+          @event = nil
+          @records[ tag ] += 1
+        elsif @kind >= 0
+          @depth = level if level > @depth
+          if level == 1
+            @event = ( @kind > 0 && ( EVENTS[ tag ] || 0 ) & @kind != 0 ) ? tag : nil
+            @dated = false
+            surname( value ) if @kind == 1 && tag == "NAME"
+          end
+        end
+
+        date( level, value ) if tag == "DATE"
+      end
+
+      def surname( value )
+        return if value.bytesize >= MAX_NAME_SIZE || value.include?( "\0" )
+        key = Name.normalize( Name.split( value )[ 1 ] )
+        @surnames[ key.b ] += 1 if !key.empty?
+      end
+
+      def date( level, value )
+        first = ( level == 2 && @event && !@dated )
+        @dated ||= first
+
+        date = Export.parse_date_text( value )
+        return @dates[ :invalid ] += 1 if date.nil?
+
+        @dates[ QUALIFIERS[ date.format ] ] += 1 if date.format < QUALIFIERS.length - 1
+        @calendars[ CALENDARS[ date.first.calendar ] ] += 1 if CALENDARS.has_key?( date.first.calendar )
+        return if !first || date.format > Date::INTERPRETED
+
+        packed = Export.sort_key( date.first )
+        year = packed >> 9
+        return if packed == 0 || year > MAX_YEAR
+        ( @events[ @event ] ||= Hash.new( 0 ) )[ year / 10 * 10 ] += 1
+      end
+
+      def finish
+        @depths[ @depth ] += 1 if @kind >= 0
+        { :lines => @lines,
+          :malformed => @malformed,
+          :records => @records.sort.to_h,
+          :tags => @tags.sort.to_h,
+          :levels => Stats.trim( @levels ),
+          :depths => Stats.trim( @depths ),
+          :surnames => @surnames.sort.to_h,
+          :events => @events.sort.collect { |tag, decades| [ tag, decades.sort.to_h ] }.to_h,
+          :dates => QUALIFIERS.select { |qualifier| @dates.has_key?( qualifier ) }.collect { |qualifier| [ qualifier, @dates[ qualifier ] ] }.to_h,
+          :calendars => CALENDARS.values.select { |calendar| @calendars.has_key?( calendar ) }.collect { |calendar| [ calendar, @calendars[ calendar ] ] }.to_h }
+      end
+    end
+
+    # The counts up to the last that is not 0
+    def Stats.trim( counts )
+      last = counts.rindex { |count| count != 0 }
+      last ? counts[ 0 .. last ] : []
+    end
+  end
+
+  # Counts tags, records, levels, surnames, events by decade and dates by
+  # qualifier and calendar in one pass over the file at +path+ and returns
+  # them as a Hash.  See ext/gedcom_stats.c for what is counted.
+  def GEDCOM.stats( path, options = nil )
+    options ||= {}
+    raise TypeError, "options must be a Hash" if !options.kind_of?( Hash )
+
+    counter = Stats::Counter.new
+    File.open( path, "rb" ) do |file|
+      file.each_line( "\n" ) { |line| counter.count( line ) }
+    end
+    counter.finish
+  end
+end
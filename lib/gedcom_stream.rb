@@ -0,0 +1,174 @@
+# -------------------------------------------------------------------------
+# gedcom_stream.rb -- record-at-a-time file reader
+# Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+# -------------------------------------------------------------------------
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2.1 of the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library; if not, write to the Free Software
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+# -------------------------------------------------------------------------
+#
+# Pure-Ruby version of the reader in ext/gedcom_stream.c.  The text of the
+# current record and its nodes are kept in a buffer and an array that are
+# cleared and refilled for every record, never reallocated.
+module GEDCOM
+  class RecordReader
+    LINE = /\A[ \t]*(\d+)[ \t]*(?:(@[^ \t\r\n]*)[ \t]*)?([^ \t\r\n]*)[ \t]*(.*?)[\r\n]*\z/mn
+
+    Node = Struct.new( :level, :offset, :end, :xref, :tag, :value, :parent, :children )
+
+    attr_reader :text, :nodes, :generation, :records
+
+    def initialize
+      @text = "".b
+      @nodes = []
+      @count = 0
+      @generation = 0
+      @records = 0
+    end
+
+    # Yields each level 0 record of +io+ as the root Record.
+    def each( io )
+      rooted = false
+      io.each_line( "\n" ) do |line|
+        if LEVEL0.match( line )
+          if rooted
+            yield read_nodes
+            @text.clear
+          end
+          rooted = true
+        end
+        @text << line
+      end
+      yield read_nodes if rooted
+    ensure
+      @text.clear
+      @count = 0
+      @generation += 1
+    end
+
+    private
+
+    def read_nodes
+      @generation += 1
+      @count = 0
+      offset = 0
+
+      @text.each_line( "\n" ) do |line|
+        match = LINE.match( line )
+        start, offset = offset, offset + line.bytesize
+        next if match.nil?
+        level = match[ 1 ].to_i
+
+        if @count == 0
+          next if !LEVEL0.match( line )
+          parent = nil
+        else
+          parent = @count - 1
+          parent = @nodes[ parent ].parent while parent && @nodes[ parent ].level >= level
+          next if parent.nil?
+        end
+
+        node = ( @nodes[ @count ] ||= Node.new( 0, 0, 0, nil, nil, nil, nil, [] ) )
+        node.level, node.offset, node.end, node.parent = level, start, offset, parent
+        node.xref, node.tag, node.value = match[ 2 ], match[ 3 ], match[ 4 ]
+        node.children.clear
+
+        if parent
+          @nodes[ parent ].children << @count
+          ancestor = parent
+          while ancestor
+            @nodes[ ancestor ].end = offset
+            ancestor = @nodes[ ancestor ].parent
+          end
+        end
+        @count += 1
+      end
+
+      @records += 1
+      Record.new( self, 0 )
+    end
+  end
+
+  # A line of the record each_record is reading, and the lines under it.
+  # It can only be used within the block it was yielded to.
+  class Record
+    include Enumerable
+
+    def initialize( reader, node )
+      @reader = reader
+      @node = node
+      @generation = reader.generation
+    end
+
+    def level
+      node.level
+    end
+
+    def xref
+      node.xref && external( node.xref )
+    end
+
+    def tag
+      external( node.tag )
+    end
+
+    def value
+      external( node.value )
+    end
+
+    def children
+      node.children.collect { |child| Record.new( @reader, child ) }
+    end
+
+    def each( &block )
+      return to_enum( :each ) if block.nil?
+      children.each( &block )
+      self
+    end
+
+    # The first child tagged +tag+, or nil.
+    def []( tag )
+      tag = tag.b
+      child = node.children.find { |i| @reader.nodes[ i ].tag == tag }
+      child && Record.new( @reader, child )
+    end
+
+    # The lines of the record and everything under it, as they were read.
+    def to_s
+      external( @reader.text.byteslice( node.offset, node.end - node.offset ) )
+    end
+
+    private
+
+    def node
+      raise RuntimeError, "record used outside its each_record block" if @generation != @reader.generation
+      @reader.nodes[ @node ]
+    end
+
+    def external( text )
+      text.dup.force_encoding( Encoding.default_external )
+    end
+  end
+
+  # Yields each level 0 record of the file at +path+ as a GEDCOM::Record
+  # tree, and returns the number of records.  The records share one reader
+  # that reuses its memory for the next record once the block returns.
+  def GEDCOM.each_record( path )
+    raise LocalJumpError, "no block given" if !block_given?
+    reader = RecordReader.new
+    File.open( path, "rb" ) do |file|
+      reader.each( file ) { |record| yield record }
+    end
+    reader.records
+  end
+end
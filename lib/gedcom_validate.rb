@@ -0,0 +1,165 @@
+# -------------------------------------------------------------------------
+# gedcom_validate.rb -- single pass structural validator
+# Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+# -------------------------------------------------------------------------
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2.1 of the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library; if not, write to the Free Software
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+# -------------------------------------------------------------------------
+#
+#
+# Pure-Ruby version of the validator in ext/gedcom_validate.c, giving the
+# same diagnostics.  The :threads option is accepted and ignored.
+module GEDCOM
+  module Validate
+    LINE_LIMIT = 255
+    MAX_XREF_SIZE = 22
+    MAX_TEXT_SIZE = 64
+    MAX_EXTRA_TAG_SIZE = 32
+
+    # In the order they are given for one line
+    CODES = GEDCOM.shareable( [ :line_too_long, :malformed_line, :level_jump, :bad_xref, :duplicate_xref,
+                                :unknown_tag, :bad_pointer, :dangling_pointer, :bad_date ] )
+    ORDER = {}
+    CODES.each_with_index { |code, i| ORDER[ code ] = i }
+    ORDER.freeze
+
+    TAGS = {}
+    [ "ABBR", "ADDR", "ADOP", "ADR1", "ADR2", "AFN", "AGE", "AGNC", "ALIA", "ANCE", "ANCI", "ANUL", "ASSO",
+      "AUTH", "BAPL", "BAPM", "BARM", "BASM", "BIRT", "BLES", "BLOB", "BURI", "CALN", "CAST", "CAUS", "CENS",
+      "CHAN", "CHAR", "CHIL", "CHR", "CHRA", "CITY", "CONC", "CONF", "CONL", "CONT", "COPR", "CORP", "CREM",
+      "CTRY", "DATA", "DATE", "DEAT", "DESC", "DESI", "DEST", "DIV", "DIVF", "DSCR", "EDUC", "EMAIL", "EMIG",
+      "ENDL", "ENGA", "EVEN", "FACT", "FAM", "FAMC", "FAMF", "FAMS", "FAX", "FCOM", "FILE", "FONE", "FORM",
+      "GEDC", "GIVN", "GRAD", "HEAD", "HUSB", "IDNO", "IMMI", "INDI", "LANG", "LATI", "LONG", "MAP", "MARB",
+      "MARC", "MARL", "MARR", "MARS", "MEDI", "NAME", "NATI", "NATU", "NCHI", "NICK", "NMR", "NOTE", "NPFX",
+      "NSFX", "OBJE", "OCCU", "ORDI", "ORDN", "PAGE", "PEDI", "PHON", "PLAC", "POST", "PROB", "PROP", "PUBL",
+      "QUAY", "REFN", "RELA", "RELI", "REPO", "RESI", "RESN", "RETI", "RFN", "RIN", "ROLE", "ROMN", "SEX",
+      "SLGC", "SLGS", "SOUR", "SPFX", "SSN", "STAE", "STAT", "SUBM", "SUBN", "SURN", "TEMP", "TEXT", "TIME",
+      "TITL", "TRLR", "TYPE", "VERS", "WIFE", "WILL", "WWW" ].each do |tag|
+      TAGS[ tag.b ] = true
+    end
+    TAGS.freeze
+
+    LEVEL = /\A[ \t]*(\d*)/n
+    TOKEN = /\A([^ \t]*)[ \t]*/n
+    XREF = /\A@[^@#][^@]*@\z/n
+
+    def Validate.xref?( token )
+      token.bytesize <= MAX_XREF_SIZE && XREF.match?( token )
+    end
+
+    # The checks of one file, line by line
+    class Checker
+      attr_reader :diagnostics
+
+      def initialize( max_line_length, tags )
+        @max_line_length = max_line_length
+        @tags = tags
+        @diagnostics = []
+        @defined = {}
+        @referenced = {}
+        @level = -1
+      end
+
+      def add( offset, line, code, text = nil )
+        @diagnostics << [ offset, line, code, text && text.byteslice( 0, MAX_TEXT_SIZE ) ]
+      end
+
+      def check( text, offset, line )
+        text = text.sub( /[\r\n]+\z/n, "" )
+        add( offset, line, :line_too_long ) if text.bytesize >= @max_line_length
+
+        digits = LEVEL.match( text )
+        return add( offset, line, :malformed_line ) if digits[ 1 ].empty? || digits[ 1 ].length > 2
+
+        level = digits[ 1 ].to_i
+        add( offset, line, :level_jump ) if level > @level + 1
+        @level = level
+
+        rest = digits.post_match
+        return add( offset, line, :malformed_line ) if rest !~ /\A[ \t]/n
+        rest = rest.sub( /\A[ \t]+/n, "" )
+
+        if rest.start_with?( "@" )
+          token = TOKEN.match( rest )
+          xref, rest = token[ 1 ], token.post_match
+          if !Validate.xref?( xref )
+            add( offset, line, :bad_xref, xref )
+          elsif @defined.has_key?( xref )
+            add( offset, line, :duplicate_xref, xref )
+          else
+            @defined[ xref ] = true
+          end
+        end
+
+        token = TOKEN.match( rest )
+        tag, value = token[ 1 ], token.post_match
+        return add( offset, line, :malformed_line ) if tag.empty?
+        add( offset, line, :unknown_tag, tag ) if !tag.start_with?( "_" ) && !TAGS.has_key?( tag ) && !@tags.has_key?( tag )
+
+        # a value that starts with @ but not @@ or @# and has no blank in
+        # it is taken for a pointer; anything else is text
+        if value.bytesize >= 2 && value.start_with?( "@" ) && value[ 1 ] != "@" && value[ 1 ] != "#" && value !~ /[ \t]/n
+          if !Validate.xref?( value )
+            add( offset, line, :bad_pointer, value )
+          elsif !@referenced.has_key?( value )
+            @referenced[ value ] = [ offset, line ]
+          end
+        end
+
+        add( offset, line, :bad_date, value ) if tag == "DATE" && Export.parse_date_text( value ).nil?
+      end
+
+      def finish
+        @referenced.each do |xref, ( offset, line )|
+          add( offset, line, :dangling_pointer, xref ) if !@defined.has_key?( xref )
+        end
+        @diagnostics.sort_by! { |offset, line, code, text| [ offset, ORDER[ code ] ] }
+      end
+    end
+  end
+
+  VALIDATE_LINE_LIMIT = Validate::LINE_LIMIT
+
+  # Checks the structure of the file at +path+ in one pass and returns its
+  # diagnostics as [ offset, line, code, text ] arrays, by offset.  See
+  # ext/gedcom_validate.c for the codes; the options are :threads,
+  # :max_line_length (the terminator included) and :tags, tags to accept
+  # besides the standard ones.
+  def GEDCOM.validate( path, options = nil )
+    options ||= {}
+    raise TypeError, "options must be a Hash" if !options.kind_of?( Hash )
+
+    max_line_length = options[ :max_line_length ] || Validate::LINE_LIMIT
+    raise ArgumentError, "max line length must be at least 1" if max_line_length < 1
+
+    tags = {}
+    Array( options[ :tags ] ).each do |tag|
+      tag = tag.to_str.b
+      if tag.bytesize < 1 || tag.bytesize >= Validate::MAX_EXTRA_TAG_SIZE
+        raise ArgumentError, "tags must be 1 to #{Validate::MAX_EXTRA_TAG_SIZE - 1} bytes long"
+      end
+      tags[ tag ] = true
+    end
+
+    checker = Validate::Checker.new( max_line_length, tags )
+    offset = 0
+    File.open( path, "rb" ) do |file|
+      file.each_line( "\n" ).with_index( 1 ) do |line, number|
+        checker.check( line, offset, number )
+        offset += line.bytesize
+      end
+    end
+    checker.finish
+  end
+end
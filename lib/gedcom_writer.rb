@@ -0,0 +1,146 @@
+# -------------------------------------------------------------------------
+# gedcom_writer.rb -- GEDCOM line writer
+# Copyright (C) 2008 Phillip Davies (binary011010@verizon.net)
+# -------------------------------------------------------------------------
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2.1 of the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library; if not, write to the Free Software
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+# -------------------------------------------------------------------------
+#
+#
+# Pure-Ruby version of ext/gedcom_writer.c.  Lines are gathered into a
+# buffer that is written to the io whenever it fills up.
+module GEDCOM
+  class Writer
+    LINE_LIMIT = 255
+    MIN_LINE_LIMIT = 32
+    BUFFER_SIZE = 65536
+
+    attr_reader :lines
+
+    def initialize( io, line_limit = nil )
+      @io = io
+      @line_limit = [ line_limit || LINE_LIMIT, MIN_LINE_LIMIT ].max
+      @buffer = Writer.binary( "" )
+      @lines = 0
+      @closed = false
+    end
+
+    def Writer.binary( text )
+      text.respond_to?( :force_encoding ) ? text.dup.force_encoding( "BINARY" ) : text
+    end
+
+    # Writes "level [xref] tag [value]".  Each line break in the value
+    # starts a CONT line, and lines over the limit go on in CONC lines.
+    def line( level, tag, value = nil, xref = nil )
+      check_open
+      level = 0 if level < 0
+      segments = value.nil? ? [ "" ] : Writer.binary( value ).split( "\n", -1 )
+      segments = [ "" ] if segments.empty?
+
+      segments.each_with_index do |segment, i|
+        segment = segment.chomp( "\r" ) if i < segments.length - 1
+        if i == 0
+          write_segment( level, xref, tag, segment, level + 1 )
+        else
+          write_segment( level + 1, nil, "CONT", segment, level + 1 )
+        end
+      end
+      self
+    end
+
+    # Writes a GEDCOM::Date in the GEDCOM date grammar; DATE text is
+    # written as it is given.
+    def date( level, date, tag = "DATE" )
+      check_open
+      return self if date.nil?
+      if date.kind_of?( Date )
+        text = GEDCOM_DATE_PARSER::DateParser.build_gedcom_date_text( date )
+      else
+        raise TypeError, "expected a GEDCOM::Date or String" if !date.respond_to?( :to_str )
+        text = date.to_str
+      end
+      line( level, tag || "DATE", text )
+    end
+
+    def flush
+      check_open
+      flush_buffer
+      self
+    end
+
+    def close
+      check_open
+      flush_buffer
+      @closed = true
+      nil
+    end
+
+    private
+
+    def check_open
+      raise IOError, "closed writer" if @closed
+    end
+
+    def flush_buffer
+      @io.write( @buffer ) if !@buffer.empty?
+      @buffer = Writer.binary( "" )
+    end
+
+    def emit( level, xref, tag, value )
+      text = Writer.binary( level.to_s )
+      text << " " << Writer.binary( xref ) if xref
+      text << " " << Writer.binary( tag )
+      text << " " << value if !value.empty?
+      text << "\n"
+
+      flush_buffer if @buffer.length + text.length > BUFFER_SIZE
+      @buffer << text
+      @lines += 1
+    end
+
+    def continuation?( byte )
+      ( byte & 0xC0 ) == 0x80
+    end
+
+    # See splitPoint in the C version.
+    def split_point( value, room )
+      return value.length if value.length <= room
+
+      split = room
+      while split > room / 2
+        return split if !continuation?( value.getbyte( split ) ) && value.getbyte( split ) != 32 && value.getbyte( split - 1 ) != 32
+        split -= 1
+      end
+
+      split = room
+      split -= 1 while split > 1 && continuation?( value.getbyte( split ) )
+      split
+    end
+
+    def write_segment( level, xref, tag, value, conc_level )
+      used = level.to_s.length + tag.length + 3
+      used += xref.length + 1 if xref
+
+      split = split_point( value, @line_limit > used ? @line_limit - used : 1 )
+      emit( level, xref, tag, value[ 0, split ] )
+
+      used = conc_level.to_s.length + 4 + 3
+      while split < value.length
+        value = value[ split .. -1 ]
+        split = split_point( value, @line_limit - used )
+        emit( conc_level, nil, "CONC", value[ 0, split ] )
+      end
+    end
+  end
+end
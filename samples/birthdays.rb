@@ -49,7 +49,8 @@ class BirthdayExtractor < GEDCOM::Parser
     setPostHandler [ "INDI" ], method( :endPerson )
 
     @currentPerson = nil
-    @allBirthdays = []
+    @people = []
+    @birthdays = GEDCOM::AnniversaryIndex.new
   end
 
   def startPerson( data, state, parm )
@@ -69,31 +70,29 @@ class BirthdayExtractor < GEDCOM::Parser
     end
   end
 
+  # Each person with a birthdate gets the next compact id (their position
+  # in @people), which is what the anniversary index hands back.
   def endPerson( data, state, parm )
-    @allBirthdays.push @currentPerson if @currentPerson.date != nil
+    if @currentPerson.date != nil
+      @birthdays.add( "BIRT", @people.length, @currentPerson.date )
+      @people.push @currentPerson
+    end
     @currentPerson = nil
   end
 
   def showPeopleBornIn( month )
-    count = 0
-    @allBirthdays.sort.each do |ind|
-      if ind.date.first.month == month
-        count += 1
-        showPerson( ind )
-      end
-    end
-    puts "=- none -=" if count == 0
+    showPeople( @birthdays.in_month( "BIRT", month ) )
   end
 
   def showPeopleBornOn( month, day )
-    count = 0
-    @allBirthdays.sort.each do |ind|
-      if ind.date.first.month == month && ind.date.first.has_day? && ind.date.first.day == day
-        count += 1
-        showPerson( ind )
-      end
+    showPeople( @birthdays.on( "BIRT", month, day ) )
+  end
+
+  def showPeople( ids )
+    ids.collect { |id| @people[ id ] }.sort.each do |ind|
+      showPerson( ind )
     end
-    puts "=- none -=" if count == 0
+    puts "=- none -=" if ids.empty?
   end
 
   def showPerson( ind )
@@ -0,0 +1,42 @@
+require 'gedcom'
+include GEDCOM
+
+describe AnniversaryIndex do
+  before(:each) do
+    @index = GEDCOM::AnniversaryIndex.new
+    @index.add( "BIRT", 0, GEDCOM::Date.new("29 FEBRUARY 1904") )
+    @index.add( "BIRT", 1, GEDCOM::Date.new("FEBRUARY 1900") )
+    @index.add( "BIRT", 2, "ABT 3 FEBRUARY 1800" )
+    @index.add( "DEAT", 3, "3 FEBRUARY 1900" )
+  end
+
+  it "finds events on a given day" do
+    @index.on( "BIRT", 2, 29 ).should == [ 0 ]
+    @index.on( "BIRT", 2, 3 ).should == [ 2 ]
+    @index.on( "DEAT", 2, 3 ).should == [ 3 ]
+    @index.on( "BIRT", 3, 1 ).should == []
+  end
+
+  it "finds events in a given month, including those with no day" do
+    @index.in_month( "BIRT", 2 ).should == [ 0, 1, 2 ]
+    @index.in_month( "DEAT", 2 ).should == [ 3 ]
+    @index.in_month( "BIRT", 1 ).should == []
+  end
+
+  it "keeps each event type separate" do
+    @index.events.sort.should == [ "BIRT", "DEAT" ]
+    @index.on( "BURI", 2, 3 ).should == []
+  end
+
+  it "skips dates without a usable month" do
+    @index.add( "BIRT", 4, "1900" ).should == false
+    @index.add( "BIRT", 5, "(unknown)" ).should == false
+    @index.add( "BIRT", 6, "STILLBORN" ).should == false
+    @index.add( "BIRT", 7, "12 MAY 1900" ).should == true
+  end
+
+  it "rejects days that do not exist" do
+    @index.on( "BIRT", 2, 30 ).should == []
+    @index.on( "BIRT", 13, 1 ).should == []
+  end
+end
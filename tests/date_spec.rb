@@ -36,8 +36,6 @@ describe Date do
     (@date_range_between.first <=> @date_range_between.last).should == -1
   end
   
-  # to_s currently works differently in the Ruby vs. C extension
-  # code, therefore this test is failing (in C)
   it "converts to string" do
     @date.to_s.should == "1 Apr 2008"
     @date_range_from.to_s.should == "from Apr 2007 to Jun 2008"
@@ -45,4 +43,59 @@ describe Date do
     @date_bc.to_s.should == "25 Jan 1 BC"
     @date_year_span.to_s.should == "1 Apr 2007-8"
   end
+
+  it "reads statuses and interpreted phrases the same way in both backends" do
+    GEDCOM::Date.new("DNSCAN").to_s.should == "DNSCAN"
+    GEDCOM::Date.new("STILLBORN").to_s.should == "stillborn"
+    GEDCOM::Date.new("INT 1850 (after the war)").to_s.should == "int 1850"
+    GEDCOM::Date.new("INT 1850 (after the war)").last.phrase.should == "after the war"
+  end
+
+  it "reports which backend was loaded" do
+    [ :native, :ruby ].include?( GEDCOM.backend ).should == true
+    GEDCOM.backend.to_s.should == ENV[ "GEDCOM_BACKEND" ].downcase if ENV[ "GEDCOM_BACKEND" ]
+    lambda { GEDCOM.load_backend( "ruby" ) }.should raise_error( NoMethodError )
+  end
+
+  it "reads abbreviations, any white-space and text that is not ASCII" do
+    GEDCOM::Date.new("abt\t12 jan 1850").to_s.should == "abt 12 Jan 1850"
+    GEDCOM::Date.new("12 SEPT 1850").first.month.should == 9
+    GEDCOM::Date.new("(\xff)".b).first.phrase.bytes.should == [ 0xff ]
+  end
+
+  it "uses the white-space and letters of the C locale whatever LC_CTYPE is" do
+    GEDCOM::Date.new("ABT\v\f1850").to_s.should == "abt 1850"
+    GEDCOM::Date.new("BET\r\n1800 AND 1801").last.year.should == 1801
+    [ "ABT\xa01850", "12 JAN\xc9 1850", "\xe9t\xe9 1850" ].each do |text|
+      GEDCOM::Date.valid?( text.b ).should == false
+    end
+  end
+
+  it "checks and parses dates without raising" do
+    GEDCOM::Date.valid?( "1 APRIL 2008" ).should == true
+    GEDCOM::Date.valid?( "1 APRIL 2008 ZZZ" ).should == false
+    GEDCOM::Date.try_parse( "1 APRIL 2008" ).to_s.should == "1 Apr 2008"
+    GEDCOM::Date.try_parse( "1 APRIL 2008 ZZZ" ).nil?.should == true
+
+    error = GEDCOM::Date.try_parse( "ABT 1850 ZZZ" ) { |e| e }
+    error.text.should == " 1850 ZZZ"
+    error.message.should == "format error at ' 1850 ZZZ'"
+    message = nil
+    GEDCOM::Date.new( "ABT 1850 ZZZ" ) { |err_msg| message = err_msg }
+    error.message.should == message
+    error.date.format.should == GEDCOM::Date::ABOUT
+  end
+
+  it "can be shared with and parsed in other Ractors" do
+    if defined?( Ractor )
+      date = Ractor.make_shareable( GEDCOM::Date.new( "BET 1 JAN 1900 AND 1901" ) )
+      Ractor.shareable?( date ).should == true
+
+      ractor = Ractor.new( date ) do |shared|
+        [ shared.first.year, shared.last.to_s, GEDCOM::Date.new( "ABT 12 MAR 1850" ).to_s,
+          GEDCOM::Date.try_parse( "1850 ZZZ" ) { |e| e.message } ]
+      end
+      ractor.take.should == [ 1900, "1901", "abt 12 Mar 1850", "format error at '1850 ZZZ'" ]
+    end
+  end
 end
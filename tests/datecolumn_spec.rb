@@ -0,0 +1,58 @@
+require 'gedcom'
+require 'tempfile'
+include GEDCOM
+
+describe "GEDCOM::DateColumn" do
+  before(:each) do
+    @column = DateColumn.new
+    @column.add( "12 MAR 1850", "BIRT" ).should == true
+    @column.add( "@#DJULIAN@ 25 DEC 1699", "CHR" ).should == true
+    @column.add( "ABT 1901", "DEAT" ).should == true
+    @column.add( Date.new( "FEB 1901" ) ).should == true
+    @column.add( "BEF 1750", "BURI" ).should == true
+    @column.add( "44 BC" ).should == true
+    @column.add( "not a date", "BIRT" ).should == false
+    @column.add( "CHILD", "BIRT" ).should == false
+  end
+
+  it "keeps julian dates in the gregorian calendar, at their own precision" do
+    @column.length.should == 6
+    @column.tags.should == [ "BIRT", "CHR", "DEAT", "BURI" ]
+    @column.min.should == [ -43 ]
+    @column.max.should == [ 1901, 2 ]
+    @column.min( 1800 ).should == [ 1850, 3, 12 ]
+    @column.max( nil, [ 1750 ] ).should == [ 1750 ]
+    @column.histogram( :month ).should == { [ 1700, 1 ] => 1, [ 1850, 3 ] => 1, [ 1901, 2 ] => 1 }
+  end
+
+  it "counts dates by year, decade and month, split by tag or qualifier" do
+    @column.histogram.should == { -43 => 1, 1700 => 1, 1750 => 1, 1850 => 1, 1901 => 2 }
+    @column.histogram( :decade ).should == { -50 => 1, 1700 => 1, 1750 => 1, 1850 => 1, 1900 => 2 }
+    @column.histogram( :year, :by => :tag ).should == { "BIRT" => { 1850 => 1 }, "CHR" => { 1700 => 1 },
+                                                        "DEAT" => { 1901 => 1 }, "BURI" => { 1750 => 1 },
+                                                        nil => { -43 => 1, 1901 => 1 } }
+    @column.histogram( :year, :by => :qualifier, :from => 1800 ).should == { :none => { 1850 => 1, 1901 => 1 },
+                                                                            :about => { 1901 => 1 } }
+    DateColumn.new.histogram.should == {}
+    lambda { @column.histogram( :week ) }.should raise_error( ArgumentError )
+  end
+
+  it "masks the dates within a range, a bit a date" do
+    @column.mask.unpack( "b*" ).should == [ "11111100" ]
+    @column.mask( 1800, [ 1901, 2 ] ).unpack( "b*" ).should == [ "10110000" ]
+    @column.mask( [ 1901, 3 ] ).unpack( "b*" ).should == [ "00000000" ]
+  end
+
+  it "loads the event dates of a file" do
+    file = Tempfile.new( "datecolumn" )
+    file.binmode
+    file.write( "0 HEAD\n1 DATE 1 JAN 2000\n" +
+                "0 @I1@ INDI\n1 BIRT\n2 DATE 12 MAR 1850\n2 DATE 1700\n1 CHAN\n2 DATE 1 JAN 1999\n" +
+                "0 @F1@ FAM\n1 MARR\n2 DATE @#DJULIAN@ 1875\n1 EVEN\n2 DATE not a date\n0 TRLR\n" )
+    file.flush
+    column = DateColumn.new
+    column.load( file.path ).should == 2
+    column.histogram( :year, :by => :tag ).should == { "BIRT" => { 1850 => 1 }, "MARR" => { 1875 => 1 } }
+    file.close!
+  end
+end
@@ -0,0 +1,62 @@
+require 'gedcom'
+include GEDCOM
+
+describe DuplicateFinder do
+  before(:each) do
+    @finder = GEDCOM::DuplicateFinder.new
+    @finder.add( 0, "John /Smith/", "M", "12 MAR 1850", "1910", [ "Thomas /Smith/" ] )
+    @finder.add( 1, "John /Smyth/", "M", "12 MAR 1850", nil, [ "Thomas /Smith/" ] )
+    @finder.add( 2, "Jane /Smith/", "F", "12 MAR 1850" )
+    @finder.add( 3, "John /Smith/", "M", "1880" )
+    @finder.add( 4, "J. /Smith/", nil, "ABT 1851" )
+  end
+
+  it "ranks the likely duplicates best first" do
+    @finder.candidates.should == [ [ 0, 1, 75 ] ]
+    @finder.candidates( 30 ).should == [ [ 0, 1, 75 ], [ 0, 4, 35 ], [ 2, 4, 35 ] ]
+  end
+
+  it "never pairs people of a different sex or a distant birth year" do
+    @finder.candidates( 0 ).collect { |a, b, s| [ a, b ] }.include?( [ 0, 2 ] ).should == false
+    @finder.candidates( 0 ).collect { |a, b, s| [ a, b ] }.include?( [ 0, 3 ] ).should == false
+  end
+
+  it "finds the duplicates of a loaded file" do
+    loader = GEDCOM::Loader.new
+    loader.parse( File.dirname( __FILE__ ) + "/../samples/royal.ged" )
+    id1, id2, score = loader.duplicates.first
+    loader.individuals[ id1 ].name.should == "Henry_(1)  /Tudor/"
+    loader.individuals[ id2 ].name.should == "Henry_(2)  /Tudor/"
+  end
+
+  it "gives the same answer on any number of threads" do
+    @finder.candidates( 0, 4 ).should == @finder.candidates( 0, 1 )
+  end
+
+  it "refuses to change while another thread searches it" do
+    2000.times { |i| @finder.add( 10 + i, "John /Smith/", "M", ( 1800 + i % 100 ).to_s ) }
+    done = false
+    searcher = Thread.new { @finder.candidates( 60, 2 ) until done }
+
+    refused = 0
+    deadline = Time.now + 30
+    while refused == 0 && Time.now < deadline
+      begin
+        @finder.add( 5000, "Jane /Smith/" )
+        Thread.pass
+      rescue RuntimeError
+        refused += 1
+      end
+    end
+    done = true
+    searcher.join
+
+    refused.should > 0
+    @finder.size.should > 2005
+  end
+
+  it "skips names without a surname" do
+    @finder.add( 5, "Mary" ).should == false
+    @finder.size.should == 5
+  end
+end
@@ -0,0 +1,64 @@
+require 'gedcom'
+require 'tempfile'
+require 'stringio'
+include GEDCOM
+
+describe "GEDCOM.diff" do
+  before(:each) do
+    @files = []
+    @base = "0 HEAD\n1 CHAR ASCII\n" +
+            "0 @I1@ INDI\n1 NAME John /Smith/\n1 BIRT\n2 DATE 1850\n1 SEX M\n" +
+            "0 @I2@ INDI\n1 NAME Jane /Doe/\n" +
+            "0 @I3@ INDI\n1 NAME Ann /Lee/\n" +
+            "0 @N1@ NOTE lost\n" +
+            "0 TRLR\n"
+    @edited = "0 HEAD\n1 CHAR ASCII\n" +
+              "0 @I1@ INDI\n1 NAME John /Smith/\n1 BIRT\n2 DATE 1851\n1 SEX M\n1 SEX M\n" +
+              "0 @I3@ INDI\n1 NAME Ann /Lee/\n" +
+              "0 @I4@ INDI\n1 NAME Tom /Lee/\n" +
+              "0 @N9@ NOTE lost\n" +
+              "0 TRLR\n"
+  end
+
+  after(:each) do
+    @files.each { |file| file.close! }
+  end
+
+  def path( text )
+    file = Tempfile.new( "diff" )
+    file.binmode
+    file.write( text )
+    file.close
+    @files << file
+    file.path
+  end
+
+  it "finds added, removed, changed and renamed records" do
+    GEDCOM.diff( path( @base ), path( @edited ) ).should ==
+      [ [ :changed, "@I1@", "@I1@", 20, 20, [ 1 ], [ 1, 3 ] ],
+        [ :added, nil, "@I4@", nil, 116, nil, nil ],
+        [ :renamed, "@N1@", "@N9@", 138, 145, nil, nil ],
+        [ :removed, "@I2@", nil, 79, nil, nil, nil ] ]
+    GEDCOM.diff( path( @base ), path( @base ) ).should == []
+  end
+
+  it "keys records without xrefs by tag and leaves out subtrees if asked" do
+    changes = GEDCOM.diff( path( @base + "0 TRLR\n" ), path( @edited ), :subtrees => false )
+    changes.first.should == [ :changed, "@I1@", "@I1@", 20, 20, nil, nil ]
+    changes.last.should == [ :removed, "TRLR:2", nil, 162, nil, nil, nil ]
+  end
+
+  it "merges the records two sides changed" do
+    ours = @base.sub( "Jane /Doe/", "Jane /Smith/" ).sub( "0 TRLR", "0 @I5@ INDI\n1 NAME Ed /Lee/\n0 TRLR" )
+    io = StringIO.new( "".b )
+    GEDCOM.merge( path( @base ), path( ours ), path( @edited ), io ).should == [ "@I2@" ]
+    io.string.should == "0 HEAD\n1 CHAR ASCII\n" +
+                        "0 @I1@ INDI\n1 NAME John /Smith/\n1 BIRT\n2 DATE 1851\n1 SEX M\n1 SEX M\n" +
+                        "0 @I2@ INDI\n1 NAME Jane /Smith/\n" +
+                        "0 @I3@ INDI\n1 NAME Ann /Lee/\n" +
+                        "0 @I5@ INDI\n1 NAME Ed /Lee/\n" +
+                        "0 @I4@ INDI\n1 NAME Tom /Lee/\n" +
+                        "0 @N9@ NOTE lost\n" +
+                        "0 TRLR\n"
+  end
+end
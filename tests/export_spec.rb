@@ -0,0 +1,58 @@
+require 'gedcom'
+require 'stringio'
+include GEDCOM
+
+describe "GEDCOM.export_events" do
+  before(:each) do
+    @text = "0 HEAD\n1 CHAR ASCII\n" +
+            "0 @I1@ INDI\n1 NAME John /Smith/\n1 SEX M\n" +
+            "1 BIRT\n2 DATE 12 MAR 1850\n2 PLAC Leeds, England\n" +
+            "1 DEAT\n2 PLAC \"The Grange\"\n2 DATE BET 1900 AND FEB 1901\n" +
+            "0 @I2@ INDI\n1 SEX F\n1 NAME Jane /Doe/\n1 NAME Jane /Smith/\n" +
+            "1 CHR\n2 DATE @#DJULIAN@ 1 JAN 1700\n1 BURI\n2 DATE BEF 1750\n" +
+            "0 @F1@ FAM\n1 HUSB @I1@\n" +
+            "0 @I3@ INDI\n1 NAME Nobody //\n" +
+            "0 TRLR\n"
+  end
+
+  def export( format = :csv, threads = 1 )
+    io = StringIO.new( "".b )
+    rows = GEDCOM.export_events( @text, io, format, threads )
+    [ rows, io.string ]
+  end
+
+  it "writes a CSV row per event, and one for people without events" do
+    rows, csv = export
+    rows.should == 5
+    csv.should == "id,xref,sex,name,event,date,sort_key,start,end,place\n" +
+                  "0,@I1@,M,John /Smith/,BIRT,12 MAR 1850,947308,1850-03-12,1850-03-12,\"Leeds, England\"\n" +
+                  "0,@I1@,M,John /Smith/,DEAT,BET 1900 AND FEB 1901,972800,1900-01-01,1901-02-28,\"\"\"The Grange\"\"\"\n" +
+                  "1,@I2@,F,Jane /Doe/,CHR,@#DJULIAN@ 1 JAN 1700,870433,1700-01-11,1700-01-11,\n" +
+                  "1,@I2@,F,Jane /Doe/,BURI,BEF 1750,896000,,1750-12-31,\n" +
+                  "2,@I3@,,Nobody //,,,0,,,\n"
+  end
+
+  it "writes column batches with a header and an empty closing batch" do
+    rows, data = export( :columns )
+    rows.should == 5
+    data[ 0, 8 ].should == "GEDCOLS1"
+    data[ 8, 4 ].unpack( "V" ).first.should == 10
+    data[ -16, 16 ].should == "\0" * 16
+    ( data.bytesize % 8 ).should == 0
+
+    header = 16 + [ "id", "xref", "sex", "name", "event", "date", "sort_key", "start", "end", "place" ].inject( 0 ) { |sum, name| sum + 2 + name.length }
+    batch = data[ ( header + 7 ) / 8 * 8, 16 ].unpack( "VVQ<" )
+    batch[ 0 ].should == 5
+    batch[ 2 ].should == data.bytesize - ( header + 7 ) / 8 * 8 - 32
+  end
+
+  it "writes the same bytes whatever the number of threads" do
+    @text = @text * 600
+    export( :csv, 4 ).should == export( :csv, 1 )
+    export( :columns, 4 ).should == export( :columns, 1 )
+  end
+
+  it "rejects unknown formats" do
+    lambda { export( :xml ) }.should raise_error( ArgumentError )
+  end
+end
@@ -0,0 +1,99 @@
+# encoding: utf-8
+require 'gedcom'
+include GEDCOM
+
+describe Name do
+  it "splits a NAME value into given name, surname and suffix" do
+    Name.split( "John Paul /Smith/ Jr." ).should == [ "John Paul", "Smith", "Jr." ]
+    Name.split( "Anne /Boleyn" ).should == [ "Anne", "Boleyn", "" ]
+    Name.split( "/Smith/" ).should == [ "", "Smith", "" ]
+    Name.split( "Mary" ).should == [ "Mary", "", "" ]
+  end
+
+  it "normalizes case, diacritics and punctuation" do
+    Name.normalize( "Müller-Lüdenscheidt" ).should == "MULLER LUDENSCHEIDT"
+    Name.normalize( "  d'Ávila " ).should == "D AVILA"
+    Name.normalize( "Straße" ).should == "STRASSE"
+    Name.normalize( "Łódź" ).should == "LODZ"
+  end
+
+  it "computes soundex codes" do
+    Name.soundex( "Robert" ).should == "R163"
+    Name.soundex( "Rupert" ).should == "R163"
+    Name.soundex( "Ashcraft" ).should == "A261"
+    Name.soundex( "Tymczak" ).should == "T522"
+    Name.soundex( "Lee" ).should == "L000"
+    Name.soundex( "" ).should == ""
+  end
+
+  it "computes daitch-mokotoff codes, with a code per alternative" do
+    Name.daitch_mokotoff( "Lewinsky" ).should == [ "876450" ]
+    Name.daitch_mokotoff( "Levinski" ).should == [ "876450" ]
+    Name.daitch_mokotoff( "Moskowitz" ).should == [ "645740" ]
+    Name.daitch_mokotoff( "Auerbach" ).sort.should == [ "097400", "097500" ]
+  end
+end
+
+describe NameIndex do
+  before(:each) do
+    @index = GEDCOM::NameIndex.new
+    @index.add( 0, "John /Smith/" )
+    @index.add( 1, "Jon /Smyth/" )
+    @index.add( 2, "Anna Maria /Müller/" )
+    @index.add( 3, "Ann /Mueller/" )
+    @index.add( 4, "/Smithers/" )
+    @index.add( 5, "Mary" )
+  end
+
+  it "finds surnames and given names by normalized prefix" do
+    @index.surname( "smith" ).should == [ 0, 4 ]
+    @index.surname( "SM" ).should == [ 0, 1, 4 ]
+    @index.surname( "muller" ).should == [ 2 ]
+    @index.given( "ann" ).should == [ 2, 3 ]
+    @index.given( "maria" ).should == [ 2 ]
+    @index.given( "mary" ).should == [ 5 ]
+    @index.surname( "Jones" ).should == []
+  end
+
+  it "finds surnames that sound alike" do
+    @index.soundex( "Smith" ).should == [ 0, 1 ]
+    @index.daitch_mokotoff( "Miller" ).should == [ 2, 3 ]
+    @index.soundex( "" ).should == []
+  end
+
+  it "picks up names added after a search" do
+    @index.surname( "smith" ).should == [ 0, 4 ]
+    @index.add( 6, "Jane /Smith/" )
+    @index.surname( "smith" ).should == [ 0, 4, 6 ]
+  end
+
+  it "reports the memory it holds to ObjectSpace" do
+    require 'objspace'
+    before = ObjectSpace.memsize_of( @index )
+    100.times { |id| @index.add( id + 10, "Given#{id} /Surname#{id}/" ) }
+    @index.surname( "surname" )
+    ( ObjectSpace.memsize_of( @index ) > before ).should == true if GEDCOM.backend == :native
+  end
+end
+
+describe Loader do
+  before(:all) do
+    @loader = GEDCOM::Loader.new
+    @loader.parse( File.dirname( __FILE__ ) + "/../samples/royal.ged" )
+  end
+
+  it "keeps every individual with its names, sex and events" do
+    @loader.individuals.length.should == 3010
+    victoria = @loader.individual( "@I1@" )
+    victoria.name.should == "Victoria  /Hanover/"
+    victoria.sex.should == "F"
+    victoria.events[ "BIRT" ].to_s.should == "24 May 1819"
+  end
+
+  it "indexes names and birthdays by record id" do
+    ids = @loader.names.surname( "tudor" )
+    ids.length.should == 21
+    @loader.individuals[ ids.first ].name.should == "Henry_VII  /Tudor/"
+    @loader.anniversaries.on( "BIRT", 5, 24 ).include?( 0 ).should == true
+  end
+end
@@ -0,0 +1,78 @@
+require 'gedcom'
+require 'tempfile'
+include GEDCOM
+
+describe "Parser#stats" do
+  before(:each) do
+    @text = "0 HEAD\n1 CHAR ASCII\n" +
+            "0 @I1@ INDI\n1 NAME John /Smith/\n1 BIRT\n2 DATE ABT 1850\n2 PLAC Leeds\n1 SEX M\n" +
+            "0 @I2@ INDI\n1 NAME Jane /Doe/\n1 BIRT\n2 DATE @#DJULIAN@ 1 JAN 1700\n" +
+            "1 DEAT\n2 DATE @#DNONE@ 1900\n2 DATE not a date\n" +
+            "0 @N1@ NOTE a note\n" +
+            "0 TRLR\n"
+    @file = Tempfile.new( "parser_stats" )
+    @file.binmode
+    @file.write( @text )
+    @file.flush
+  end
+
+  after(:each) do
+    @file.close!
+  end
+
+  def parser
+    parser = Parser.new
+    handler = lambda { |data, cookie, parm| }
+    parser.setPreHandler( [ "INDI" ], handler )
+    parser.setPostHandler( [ "INDI" ], handler )
+    parser.setPreHandler( [ "INDI", "BIRT", "DATE" ], handler )
+    parser
+  end
+
+  it "counts lines, records, handler lines and skipped subtrees" do
+    [ :parse, :parse_pipelined ].each do |parse|
+      first = parser
+      first.send( parse, @file.path )
+      stats = first.stats
+      stats.lines.should == 17
+      stats.bytes.should == @text.bytesize
+      stats.records.should == { "HEAD" => 1, "INDI" => 2, "NOTE" => 1, "TRLR" => 1 }
+      stats.handler_lines.should == { [ "INDI" ] => { :pre => 2, :post => 2 },
+                                      [ "INDI", "BIRT", "DATE" ] => { :pre => 2 } }
+
+      # HEAD, NOTE and TRLR, the NAMEs, SEX and DEAT, and the PLAC
+      stats.skipped.should == 8
+      stats.dates.should == {}
+      stats.running?.should == false
+      ( stats.wall_seconds >= 0 ).should == true
+      stats.scan_wall_seconds.should == nil
+    end
+  end
+
+  it "counts date outcomes and times the handlers when asked" do
+    timed = parser
+    timed.count_dates = true
+    timed.timing = true
+    timed.batch_size = 2
+    timed.parse( @file.path )
+    stats = timed.stats
+    stats.dates.should == { :about => 1, :none => 1, :bad_calendar => 1, :bad_format => 1 }
+    stats.handler_lines[ [ "INDI" ] ].should == { :pre => 2, :post => 2 }
+    ( stats.handler_wall_seconds >= 0 ).should == true
+    ( stats.scan_wall_seconds + stats.handler_wall_seconds - stats.wall_seconds ).abs.should < 1e-6
+    ( stats.scan_cpu_seconds + stats.handler_cpu_seconds - stats.cpu_seconds ).abs.should < 1e-6
+  end
+
+  it "writes the counters in the Prometheus text format" do
+    counted = parser
+    counted.parse( @file.path )
+    text = counted.stats.to_prometheus( "import", "file" => "a \"b\"\n" )
+    lines = text.split( "\n" )
+    lines.include?( "# TYPE import_lines_total counter" ).should == true
+    lines.include?( "import_lines_total{file=\"a \\\"b\\\"\\n\"} 17" ).should == true
+    lines.include?( "import_records_total{file=\"a \\\"b\\\"\\n\",tag=\"INDI\"} 2" ).should == true
+    lines.include?( "import_handler_lines_total{file=\"a \\\"b\\\"\\n\",context=\"INDI/BIRT/DATE\",handler=\"pre\"} 2" ).should == true
+    lines.grep( /\Aimport_seconds_total/ ).length.should == 2
+    lines.reject { |line| line.start_with?( "#" ) }.each { |line| line.should =~ /\Aimport_\w+(\{.*\})? \S+\z/ }
+  end
+end
@@ -0,0 +1,117 @@
+require 'gedcom'
+require 'tempfile'
+include GEDCOM
+
+describe "Parser#parse_pipelined" do
+  before(:each) do
+    @text = "0 HEAD\n1 CHAR ASCII\n" +
+            "0 @I1@ INDI\r\n1 NAME John /Smith/\r\n1 BIRT\r\n2 DATE 12 MAR 1850\r\n\r\n1 SEX M\r\n" +
+            "0 @N1@ NOTE " + "x" * 100000 + "\n1 CONT @ sign\n" +
+            "0 TRLR"
+    @file = Tempfile.new( "pipeline" )
+    @file.binmode
+    @file.write( @text )
+    @file.flush
+  end
+
+  after(:each) do
+    @file.close!
+  end
+
+  def calls( parser )
+    calls = []
+    pre = lambda { |data, cookie, parm| calls << [ :pre, parser.ctx.dup, data, cookie ] }
+    post = lambda { |data, cookie, parm| calls << [ :post, parser.ctx.dup, data, cookie ] }
+    [ [ "HEAD" ], [ "HEAD", "CHAR" ], [ "INDI" ], [ "INDI", "BIRT", "DATE" ], [ "NOTE" ], [ "TRLR" ], [ nil ] ].each do |context|
+      parser.setPreHandler( context, pre )
+      parser.setPostHandler( context, post )
+    end
+    calls
+  end
+
+  def parser
+    parser = Parser.new( :cookie )
+    def parser.ctx
+      @ctxStack
+    end
+    parser
+  end
+
+  it "calls the same handlers as parse" do
+    expected = calls( first = parser )
+    first.parse( @file.path )
+    expected.last.should == [ :pre, [ "TRLR" ], nil, :cookie ]
+    expected.length.should == 11
+
+    [ 1, 8 ].each do |slots|
+      got = calls( second = parser )
+      second.parse_pipelined( @file.path, slots )
+      got.should == expected
+    end
+  end
+
+  it "returns the pipeline's counters" do
+    stats = parser.parse_pipelined( @file.path, 2 )
+    stats[ :events ].should == 11
+    stats[ :bytes ].should == @text.bytesize
+    ( stats[ :batches ] >= 1 ).should == true
+    [ :reader_stalls, :reader_stall_seconds, :handler_stalls, :handler_stall_seconds ].each do |key|
+      ( stats[ key ] >= 0 ).should == true
+    end
+  end
+
+  it "yields the events of each line" do
+    events = []
+    GEDCOM.each_event( @file.path ) { |level, tag, data| events << [ level, tag, data ] }
+    events[ 2 ].should == [ 0, "INDI", "@I1@" ]
+    events[ 6 ].should == [ 0, nil, nil ]
+    events[ 9 ].should == [ 1, "CONT", "@ sign" ]
+    events.last.should == [ 0, "TRLR", nil ]
+  end
+
+  it "hands handlers arrays of data with a batch size" do
+    @file.truncate( 0 )
+    @file.rewind
+    @file.write( "0 @I1@ INDI\n1 NAME A\n0 @I2@ INDI\n1 NAME B\n0 @I3@ INDI\n1 NAME C\n0 TRLR\n" )
+    @file.flush
+
+    [ :parse, :parse_pipelined ].each do |parse|
+      calls = []
+      parser = Parser.new( :cookie )
+      parser.batch_size = 2
+      parser.setPreHandler( [ "INDI" ], lambda { |data, cookie, parm| calls << [ :indi, data, cookie, parm ] }, :parm )
+      parser.setPreHandler( [ "INDI", "NAME" ], lambda { |data, cookie, parm| calls << [ :name, data ] } )
+      parser.setPostHandler( [ "INDI" ], lambda { |data, cookie, parm| calls << [ :end, data ] } )
+      parser.send( parse, @file.path )
+      calls.should == [ [ :indi, [ "@I1@", "@I2@" ], :cookie, :parm ], [ :name, [ "A", "B" ] ],
+                        [ :end, [ "@I1@", "@I2@" ] ], [ :indi, [ "@I3@" ], :cookie, :parm ],
+                        [ :name, [ "C" ] ], [ :end, [ "@I3@" ] ] ]
+    end
+
+    lambda { Parser.new.batch_size = 0 }.should raise_error( ArgumentError )
+  end
+
+  it "yields event batches column by column" do
+    kept = nil
+    levels, tags, values = [], [], []
+    GEDCOM.each_event_batch( @file.path, 1 ) do |batch|
+      kept = batch
+      levels.concat( batch.levels )
+      tags.concat( batch.tags )
+      values.concat( batch.values )
+      batch.length.should == batch.collect { |level, tag, value| level }.length
+      batch.tag( -1 ).should == tags.last
+      batch.value( batch.length ).should == nil
+    end
+
+    events = []
+    GEDCOM.each_event( @file.path ) { |level, tag, data| events << [ level, tag, data ] }
+    levels.zip( tags, values ).should == events
+    lambda { kept.length }.should raise_error( RuntimeError )
+  end
+
+  it "rejects fewer than one slot and missing files" do
+    lambda { GEDCOM.each_event( @file.path, 0 ) { } }.should raise_error( ArgumentError )
+    lambda { GEDCOM.each_event( @file.path + ".missing" ) { } }.should raise_error( Errno::ENOENT )
+  end
+end
@@ -0,0 +1,53 @@
+require 'gedcom'
+include GEDCOM
+
+describe GEDCOM::Query do
+  before(:each) do
+    @text = "0 HEAD\n1 SOUR Test\n" +
+            "0 @I1@ INDI\n1 NAME John /Smith/\n1 SEX M\n1 BIRT\n2 DATE 12 MAR 1850\n2 PLAC Leeds\n" +
+            "0 @I2@ INDI\n1 NAME Jane /Doe/\n1 SEX F\n1 BIRT\n2 DATE BEF 1790\n2 PLAC York\n" +
+            "0 @F1@ FAM\n1 HUSB @I1@\n1 MARR\n2 DATE 1795\n" +
+            "0 @F2@ FAM\n1 MARR\n2 DATE AFT 1750\n" +
+            "0 TRLR\n"
+  end
+
+  def run( source )
+    Query.new( source ).run( @text )
+  end
+
+  it "finds the values at the end of a path, with the xref of their record" do
+    run( "INDI.BIRT.PLAC" ).should == [ [ "@I1@", "Leeds" ], [ "@I2@", "York" ] ]
+    run( "HEAD.SOUR" ).should == [ [ nil, "Test" ] ]
+    run( "@I1@.*.DATE" ).should == [ [ "@I1@", "12 MAR 1850" ] ]
+  end
+
+  it "only keeps lines whose condition holds" do
+    run( "FAM[MARR.DATE < 1800]" ).should == [ [ "@F1@", "" ] ]
+    run( "INDI[SEX = \"F\"].NAME" ).should == [ [ "@I2@", "Jane /Doe/" ] ]
+    run( "INDI.BIRT[DATE >= 1800].PLAC" ).should == [ [ "@I1@", "Leeds" ] ]
+    run( "INDI[*.DATE = 1850].NAME" ).should == [ [ "@I1@", "John /Smith/" ] ]
+    run( "FAM[HUSB].MARR.DATE" ).should == [ [ "@F1@", "1795" ] ]
+  end
+
+  it "yields the matches one at a time" do
+    names = []
+    Query.new( "INDI.NAME" ).each( @text * 3000 ) { |xref, value| names << value }
+    names.length.should == 6000
+    names.last.should == "Jane /Doe/"
+  end
+
+  it "points at the part of a query that does not make sense" do
+    message = lambda do |source|
+      begin
+        Query.new( source )
+        nil
+      rescue ArgumentError => e
+        e.message
+      end
+    end
+
+    message.call( "INDI..NAME" ).should == "bad query at '.NAME'"
+    message.call( "FAM[MARR.DATE < AFT 1800]" ).should == "bad query at 'AFT 1800]'"
+    message.call( "INDI[SEX < \"F\"]" ).should == "bad query at '\"F\"]'"
+  end
+end
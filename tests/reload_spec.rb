@@ -0,0 +1,74 @@
+require 'gedcom'
+require 'tempfile'
+include GEDCOM
+
+describe "GEDCOM.scan_records" do
+  it "splits a file into its level 0 records" do
+    text = "0 HEAD\n1 CHAR ASCII\n0 @I1@ INDI\r\n1 NAME John /Smith/\n0 TRLR\n"
+    records = GEDCOM.scan_records( text )
+    records.collect { |xref, tag, offset, length| [ xref, tag, offset, length ] }.should ==
+      [ [ nil, "HEAD", 0, 20 ], [ "@I1@", "INDI", 20, 33 ], [ nil, "TRLR", 53, 7 ] ]
+  end
+
+  it "hashes records by their content only" do
+    one = GEDCOM.scan_records( "0 @I1@ INDI\n1 SEX M\n0 @I2@ INDI\n1 SEX M\n" )
+    two = GEDCOM.scan_records( "0 @I1@ INDI\n1 SEX F\n0 @I2@ INDI\n1 SEX M\n" )
+    one[ 0 ][ 4 ].should_not == two[ 0 ][ 4 ]
+    one[ 1 ][ 4 ].should == two[ 1 ][ 4 ]
+  end
+end
+
+describe Loader, "reload" do
+  HEAD = "0 HEAD\n1 CHAR ASCII\n"
+  JOHN = "0 @I1@ INDI\n1 NAME John /Smith/\n1 SEX M\n1 BIRT\n2 DATE 12 MAR 1850\n"
+  MARY = "0 @I2@ INDI\n1 NAME Mary /Jones/\n1 SEX F\n1 BIRT\n2 DATE 3 JUN 1852\n"
+  FAMILY = "0 @F1@ FAM\n1 HUSB @I1@\n1 WIFE @I2@\n"
+  TRLR = "0 TRLR\n"
+
+  def write( text )
+    File.open( @file.path, "w" ) { |f| f.write( text ) }
+  end
+
+  before(:each) do
+    @file = Tempfile.new( "reload" )
+    write( HEAD + JOHN + MARY + FAMILY + TRLR )
+    @loader = GEDCOM::Loader.new
+    @loader.load( @file.path )
+  end
+
+  after(:each) do
+    @file.close!
+  end
+
+  it "does nothing when the file is unchanged" do
+    @loader.reload( @file.path ).should == { :added => [], :changed => [], :removed => [] }
+    @loader.individuals.length.should == 2
+  end
+
+  it "re-indexes changed records under their old ids" do
+    write( HEAD + JOHN.sub( "Smith", "Smyth" ).sub( "12 MAR", "14 APR" ) + MARY + FAMILY + TRLR )
+    @loader.reload( @file.path ).should == { :added => [], :changed => [ "@I1@" ], :removed => [] }
+
+    @loader.individual( "@I1@" ).id.should == 0
+    @loader.individual( "@I1@" ).name.should == "John /Smyth/"
+    @loader.names.surname( "smith" ).should == []
+    @loader.names.surname( "smyth" ).should == [ 0 ]
+    @loader.anniversaries.on( "BIRT", 3, 12 ).should == []
+    @loader.anniversaries.on( "BIRT", 4, 14 ).should == [ 0 ]
+  end
+
+  it "adds new records and drops removed ones" do
+    bob = "0 @I3@ INDI\n1 NAME Bob /Brown/\n"
+    write( HEAD + JOHN + bob + TRLR )
+    @loader.reload( @file.path ).should == { :added => [ "@I3@" ], :changed => [], :removed => [ "@I2@", "@F1@" ] }
+
+    @loader.individuals.length.should == 3
+    @loader.individuals[ 1 ].should == nil
+    @loader.individual( "@I2@" ).should == nil
+    @loader.individual( "@I3@" ).id.should == 2
+    @loader.families.compact.should == []
+    @loader.names.surname( "jones" ).should == []
+    @loader.names.surname( "brown" ).should == [ 2 ]
+    @loader.duplicates.should == []
+  end
+end
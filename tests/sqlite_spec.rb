@@ -0,0 +1,61 @@
+require 'gedcom'
+require 'tempfile'
+include GEDCOM
+begin
+  require 'sqlite3'
+rescue LoadError
+end
+
+describe "GEDCOM.to_sqlite" do
+  before(:each) do
+    @text = "0 HEAD\n1 CHAR ASCII\n" +
+            "0 @F1@ FAM\n1 HUSB @I1@\n1 WIFE @I2@\n1 CHIL @I9@\n1 MARR\n2 DATE ABT 1875\n2 PLAC Leeds\n" +
+            "0 @I1@ INDI\n1 NAME John /Smith/ Jr\n1 NAME Jack\n1 SEX M\n1 BIRT\n2 DATE 12 MAR 1850\n1 DEAT\n2 DATE sometime\n" +
+            "0 @I2@ INDI\n1 NAME Jane /Doe/\n1 SEX F\n" +
+            "0 @N1@ NOTE not loaded\n" +
+            "0 TRLR\n"
+    @source = Tempfile.new( "source" )
+    @source.binmode
+    @source.write( @text )
+    @source.close
+    @db = Tempfile.new( "db" )
+    @db.close
+  end
+
+  after(:each) do
+    @source.close!
+    @db.close!
+  end
+
+  def load
+    GEDCOM.to_sqlite( @source.path, @db.path )
+  end
+
+  if GEDCOM.respond_to?( :to_sqlite )
+    it "loads people and families into a database and returns the rows of each table" do
+      load.should == { :individuals => 2, :families => 1, :names => 3, :events => 3, :links => 3 }
+      File.binread( @db.path, 16 ).should == "SQLite format 3\0"
+    end
+
+    it "replaces the tables when loading again" do
+      load
+      load.should == { :individuals => 2, :families => 1, :names => 3, :events => 3, :links => 3 }
+    end
+
+    if defined?( SQLite3::Database )
+      it "stores dates as sort keys and day numbers, and links people by xref" do
+        load
+        db = SQLite3::Database.new( @db.path )
+        db.execute( "SELECT individual, family, tag, date, sort_key, first_day, last_day, place FROM events ORDER BY id" ).should ==
+          [ [ nil, 1, "MARR", "ABT 1875", 960000, 2405890, 2406254, "Leeds" ],
+            [ 1, nil, "BIRT", "12 MAR 1850", 947308, 2396829, 2396829, nil ],
+            [ 1, nil, "DEAT", "sometime", nil, nil, nil, nil ] ]
+        db.execute( "SELECT given, surname, suffix, surname_key FROM names ORDER BY individual, position" ).should ==
+          [ [ "John", "Smith", "Jr", "SMITH" ], [ "Jack", nil, nil, nil ], [ "Jane", "Doe", nil, "DOE" ] ]
+        db.execute( "SELECT family, role, individual FROM links" ).should ==
+          [ [ 1, "HUSB", 1 ], [ 1, "WIFE", 2 ], [ 1, "CHIL", nil ] ]
+        db.close
+      end
+    end
+  end
+end
@@ -0,0 +1,56 @@
+require 'gedcom'
+require 'tempfile'
+include GEDCOM
+
+describe "GEDCOM.stats" do
+  before(:each) do
+    @files = []
+    @text = "0 HEAD\n1 CHAR ASCII\n" +
+            "0 @I1@ INDI\n1 NAME John /Smith/\n1 BIRT\n2 DATE 12 MAR 1850\n2 DATE 1700\n" +
+            "1 DEAT\n2 DATE ABT 1901\n2 PLAC Leeds\n" +
+            "0 @I2@ INDI\n1 NAME Jane /smith/\n1 BIRT\n2 DATE @#DJULIAN@ 1 JAN 1856\n" +
+            "1 DIV\n2 DATE 1870\n" +
+            "0 @F1@ FAM\n1 HUSB @I1@\n1 MARR\n2 DATE BEF 1875\n" +
+            "1 EVEN\n2 DATE not a date\n" +
+            "bad line\n" +
+            "0 TRLR\n"
+  end
+
+  after(:each) do
+    @files.each { |file| file.close! }
+  end
+
+  def stats( text, options = nil )
+    file = Tempfile.new( "stats" )
+    file.binmode
+    file.write( text )
+    file.flush
+    @files << file
+    GEDCOM.stats( file.path, options )
+  end
+
+  it "counts lines, records, tags, levels, depths and surnames" do
+    result = stats( @text )
+    result[ :lines ].should == 24
+    result[ :malformed ].should == 1
+    result[ :records ].should == { "FAM" => 1, "HEAD" => 1, "INDI" => 2, "TRLR" => 1 }
+    result[ :tags ][ "DATE" ].should == 7
+    result[ :tags ][ "INDI" ].should == 2
+    result[ :levels ].should == [ 5, 10, 8 ]
+    result[ :depths ].should == [ 1, 1, 3 ]
+    result[ :surnames ].should == { "SMITH" => 2 }
+  end
+
+  it "counts events by decade and dates by qualifier and calendar" do
+    result = stats( @text )
+    result[ :events ].should == { "BIRT" => { 1850 => 2 }, "DEAT" => { 1900 => 1 }, "MARR" => { 1870 => 1 } }
+    result[ :dates ].should == { :none => 4, :about => 1, :before => 1, :invalid => 1 }
+    result[ :calendars ].should == { :gregorian => 5, :julian => 1 }
+  end
+
+  it "gives the same counts whatever the number of threads" do
+    text = @text * 5000
+    stats( text, :threads => 4 ).should == stats( text, :threads => 1 )
+    lambda { stats( @text, 1 ) }.should raise_error( TypeError )
+  end
+end
@@ -0,0 +1,49 @@
+require 'gedcom'
+require 'tempfile'
+include GEDCOM
+
+describe "GEDCOM.each_record" do
+  before(:each) do
+    @file = Tempfile.new( "stream" )
+    @file.binmode
+    @file.write( "0 HEAD\n1 CHAR ASCII\n" +
+                 "0 @I1@ INDI\r\n1 NAME John /Smith/\r\n1 BIRT\r\n2 DATE 12 MAR 1850\r\n2 PLAC Leeds\r\n1 SEX M\r\n" +
+                 "0 TRLR" )
+    @file.flush
+  end
+
+  after(:each) do
+    @file.close!
+  end
+
+  it "yields each level 0 record as a tree" do
+    records = []
+    count = GEDCOM.each_record( @file.path ) do |record|
+      records << [ record.level, record.xref, record.tag, record.collect { |child| child.tag } ]
+      if record.tag == "INDI"
+        record[ "BIRT" ][ "PLAC" ].value.should == "Leeds"
+        record[ "BIRT" ].children.collect { |child| child.value }.should == [ "12 MAR 1850", "Leeds" ]
+        record[ "BIRT" ].to_s.should == "1 BIRT\r\n2 DATE 12 MAR 1850\r\n2 PLAC Leeds\r\n"
+        record[ "DEAT" ].should == nil
+      end
+    end
+
+    count.should == 3
+    records.should == [ [ 0, nil, "HEAD", [ "CHAR" ] ], [ 0, "@I1@", "INDI", [ "NAME", "BIRT", "SEX" ] ],
+                        [ 0, nil, "TRLR", [] ] ]
+  end
+
+  it "does not let records outlive their block" do
+    kept = nil
+    GEDCOM.each_record( @file.path ) { |record| kept ||= record[ "CHAR" ] }
+    lambda { kept.value }.should raise_error( RuntimeError )
+  end
+
+  it "reads records larger than its buffer" do
+    @file.write( "\n0 @N1@ NOTE\n" + "1 CONT #{'x' * 100}\n" * 20000 + "0 TRLR\n" )
+    @file.flush
+    lines = []
+    GEDCOM.each_record( @file.path ) { |record| lines << record.children.length }
+    lines.should == [ 1, 3, 0, 20000, 0 ]
+  end
+end
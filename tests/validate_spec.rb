@@ -0,0 +1,47 @@
+require 'gedcom'
+require 'tempfile'
+include GEDCOM
+
+describe "GEDCOM.validate" do
+  before(:each) do
+    @text = "0 HEAD\n1 CHAR ASCII\n" +
+            "0 @I1@ INDI\n1 NAME John /Smith/\n3 NOTE too deep\n" +
+            "1 BIRT\n2 DATE 31 FOO 1850\n1 FAMS @F1@\n1 FAMC @F9@\n1 _MINE ok\n1 WHAT x\n" +
+            "0 @I1@ INDI\n1 NOTE @ home\n1 FAMS @F1\n" +
+            "0 @I2 INDI\n1NAME x\n" +
+            "0 @F1@ FAM\n1 HUSB @I1@\n1 CHIL @F9@\n2 DATE @#DJULIAN@ 1 JAN 1700\n" +
+            "0 TRLR"
+  end
+
+  def validate( options = {} )
+    file = Tempfile.new( "validate" )
+    file.binmode
+    file.write( @text )
+    file.close
+    GEDCOM.validate( file.path, options )
+  ensure
+    file.close!
+  end
+
+  it "finds each kind of problem, by offset" do
+    validate.should == [ [ 52, 5, :level_jump, nil ],
+                         [ 75, 7, :bad_date, "31 FOO 1850" ],
+                         [ 106, 9, :dangling_pointer, "@F9@" ],
+                         [ 129, 11, :unknown_tag, "WHAT" ],
+                         [ 138, 12, :duplicate_xref, "@I1@" ],
+                         [ 164, 14, :bad_pointer, "@F1" ],
+                         [ 175, 15, :bad_xref, "@I2" ],
+                         [ 186, 16, :malformed_line, nil ] ]
+  end
+
+  it "takes extra tags and a line length limit" do
+    codes = validate( :tags => [ "WHAT" ], :max_line_length => 20 ).collect { |offset, line, code, text| [ line, code ] }
+    codes.should == [ [ 5, :level_jump ], [ 7, :bad_date ], [ 9, :dangling_pointer ], [ 12, :duplicate_xref ],
+                      [ 14, :bad_pointer ], [ 15, :bad_xref ], [ 16, :malformed_line ], [ 20, :line_too_long ] ]
+  end
+
+  it "gives the same diagnostics whatever the number of threads" do
+    @text = ( @text + "\n" ) * 20000
+    validate( :threads => 4 ).should == validate( :threads => 1 )
+  end
+end
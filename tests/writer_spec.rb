@@ -0,0 +1,127 @@
+require 'gedcom'
+require 'stringio'
+include GEDCOM
+
+describe Writer do
+  before(:each) do
+    @io = StringIO.new
+    @writer = GEDCOM::Writer.new( @io, 40 )
+  end
+
+  it "writes level, xref, tag and value" do
+    @writer.line( 0, "INDI", nil, "@I1@" )
+    @writer.line( 1, "NAME", "John /Smith/" )
+    @writer.close
+    @io.string.should == "0 @I1@ INDI\n1 NAME John /Smith/\n"
+  end
+
+  ESCAPES = { "@#DJULIAN@" => DateType::JULIAN, "@#DHEBREW@" => DateType::HEBREW, "@#DFRENCH R@" => DateType::FRENCH }
+
+  # Parses a DATE value, which may start with a calendar escape
+  def parse_value( text )
+    calendar = DateType::DEFAULT
+    ESCAPES.each do |escape, type|
+      if text.start_with?( escape + " " )
+        text, calendar = text[ escape.length + 1 .. -1 ], type
+      end
+    end
+    GEDCOM::Date.new( text, calendar ) { |err_msg| raise "#{text} did not parse: #{err_msg}" }
+  end
+
+  def describe_part( part )
+    return [ part.calendar, part.compliance, part.phrase ] if part.compliance == DatePart::PHRASE
+    [ part.calendar, part.compliance, part.has_day? && part.day, part.has_month? && part.month,
+      part.has_year? && part.year, part.has_year_span? && part.to_year,
+      part.calendar == DateType::GREGORIAN && part.has_year? && part.epoch ]
+  end
+
+  def written_date( date )
+    io = StringIO.new
+    writer = GEDCOM::Writer.new( io )
+    writer.date( 1, date )
+    writer.close
+    io.string.should =~ /\A1 DATE .*\n\z/
+    io.string[ 7 .. -2 ]
+  end
+
+  it "writes dates in the GEDCOM date grammar" do
+    { "abt 12 march 1850" => "ABT 12 MAR 1850",
+      "(some phrase)" => "(some phrase)",
+      "int 1850 (after the war)" => "INT 1850 (after the war)",
+      "@#DHEBREW@ 3 ADAR SHENI 5760" => "@#DHEBREW@ 3 ADS 5760",
+      "11 Feb 1699-00" => "11 FEB 1699/00" }.each do |text, value|
+      written_date( parse_value( text ) ).should == value
+    end
+  end
+
+  it "writes dates that parse back to the same date" do
+    [ "ABT 12 MAR 1850", "CAL 1800", "EST MAR 1800", "BEF 1700", "AFT 2 JAN 1700",
+      "(some phrase)", "INT 1850 (after the war)", "INT 1850",
+      "BET 1850 AND 1860", "FROM 1 JAN 1900 TO 2 FEB 1910", "FROM 1900", "TO DEC 1910",
+      "@#DJULIAN@ 25 DEC 1699", "@#DJULIAN@ BET 1700 AND 1710", "@#DHEBREW@ 1 TSH 5760",
+      "@#DHEBREW@ 3 ADS 5760", "@#DFRENCH R@ 1 VEND 1", "@#DFRENCH R@ 2 COMP 3",
+      "11 FEB 1699/00", "44 BC", "12 MAR 44 BC", "STILLBORN", "DNSCAN" ].each do |text|
+      date = parse_value( text )
+      again = parse_value( written_date( date ) )
+      again.format.should == date.format
+      describe_part( again.first ).should == describe_part( date.first )
+      describe_part( again.last ).should == describe_part( date.last ) if date.is_range? || date.format == Date::INTERPRETED
+    end
+  end
+
+  it "writes DATE text as it is given" do
+    [ "abt 12 march 1850", "@#DJULIAN@ 25 DEC 1699", "(some phrase)", "not a date" ].each do |text|
+      written_date( text ).should == text
+    end
+    written_date( Struct.new( :to_str ).new( "ABT 1850" ) ).should == "ABT 1850"
+    lambda { written_date( 1850 ) }.should raise_error( TypeError )
+  end
+
+  it "splits line breaks into CONT and long lines into CONC" do
+    @writer.line( 1, "NOTE", "first\nsecond " + "x" * 60 )
+    @writer.close
+    @io.string.should == "1 NOTE first\n" +
+                         "2 CONT second xxxxxxxxxxxxxxxxxxxxxxxxx\n" +
+                         "2 CONC xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx\n" +
+                         "2 CONC xxx\n"
+    @io.string.split( "\n" ).each { |line| ( line.length < 40 ).should == true }
+  end
+
+  it "writes notes that read back the same" do
+    note = ( "The quick brown fox jumps over the lazy dog. " * 20 ).strip + "\nEnd."
+    @writer.line( 0, "INDI", nil, "@I1@" )
+    @writer.line( 1, "NOTE", note )
+    @writer.close
+
+    text = ""
+    parser = GEDCOM::Parser.new
+    parser.setPreHandler( [ "INDI", "NOTE" ], lambda { |data, cookie, parm| text << data } )
+    parser.setPreHandler( [ "INDI", "NOTE", "CONC" ], lambda { |data, cookie, parm| text << data } )
+    parser.setPreHandler( [ "INDI", "NOTE", "CONT" ], lambda { |data, cookie, parm| text << "\n" << data } )
+
+    file = File.dirname( __FILE__ ) + "/writer_spec.ged"
+    File.open( file, "wb" ) { |f| f.write( @io.string ) }
+    begin
+      parser.parse( file )
+    ensure
+      File.delete( file )
+    end
+
+    text.should == note
+  end
+
+  it "keeps writing to its io after the heap is compacted" do
+    dates = ( 1..500 ).map { |n| GEDCOM::Date.new( "#{n % 28 + 1} MAR #{1500 + n}" ) }
+    @writer.line( 0, "INDI", nil, "@I1@" )
+    GC.compact if GC.respond_to?( :compact )
+    @writer.date( 1, dates.last )
+    @writer.close
+    @io.string.should == "0 @I1@ INDI\n1 DATE 25 MAR 2000\n"
+    dates.first.first.day.should == 2
+  end
+
+  it "refuses to write once closed" do
+    @writer.close
+    lambda { @writer.line( 0, "TRLR" ) }.should raise_error( IOError )
+  end
+end